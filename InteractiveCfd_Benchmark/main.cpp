@@ -0,0 +1,593 @@
+#include "Graphics/CpuLbm.h"
+#include "CpuKernel.h"
+#include "LatticeStorage.h"
+#include "Domain.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+
+struct GridSize
+{
+    int xDim;
+    int yDim;
+};
+
+struct BenchmarkOptions
+{
+    std::vector<GridSize> gridSizes;
+    std::vector<int> obstructionCounts;
+    std::vector<int> shapes;
+    std::vector<CollisionModel> collisionModels;
+    float inletVelocity;
+    float omega;
+    int timeSteps;
+    int warmupSteps;
+    int repetitions;
+    int numThreads;
+    bool isThreadPinning;
+    SimdIsa simdIsa;
+    StreamingMode streamingMode;
+    int temporalBlockingDepth;
+    LatticeStorage latticeStorage;
+    std::string csvPath;
+};
+
+// ! Throughput of one combination of grid, scene and collision model over all repetitions
+struct BenchmarkResult
+{
+    GridSize gridSize;
+    int obstructionCount;
+    int shape;
+    CollisionModel collisionModel;
+    float fluidFraction;
+    float bytesPerUpdate;
+    double mlupsMean;
+    double mlupsStdDev;
+    double mlupsMin;
+    double mlupsMax;
+    double bandwidth;
+};
+
+void PrintUsage(const char* executable)
+{
+    std::cout << "Usage: " << executable << " [options]" << std::endl
+        << "Every combination of the lists below is run as a case of its own." << std::endl
+        << "  --sizes <WxH,...>       lattice sizes (default 256x256,512x512,1024x1024)"
+        << std::endl
+        << "  --obst-counts <n,...>   obstructions per case, laid out on a regular grid"
+        << " (default 0,16,64)" << std::endl
+        << "  --shapes <name,...>     obstruction shapes, square, circle, hline or vline"
+        << " (default circle,square)" << std::endl
+        << "  --collisions <name,...> collision operators, bgk, trt, mrt or smagorinsky"
+        << " (default all)" << std::endl
+        << "  --inlet <u>             inlet velocity in lattice units (default 0.05)" << std::endl
+        << "  --omega <w>             relaxation parameter, low enough for every operator to stay"
+        << " stable (default 1.7)" << std::endl
+        << "  --steps <n>             time steps per repetition (default 1000)" << std::endl
+        << "  --warmup <n>            untimed time steps before the first repetition (default 200)"
+        << std::endl
+        << "  --reps <n>              timed repetitions per case (default 5)" << std::endl
+        << "  --threads <n>           solver threads, 0 for all cores (default 0)" << std::endl
+        << "  --pin <0|1>             pin solver thread t to core t (default 0)" << std::endl
+        << "  --isa <name>            collide instruction set, scalar, avx2 or avx512. Capped to"
+        << " what the CPU supports (default widest available)" << std::endl
+        << "  --streaming <mode>      twobuffer or inplace (default twobuffer)" << std::endl
+        << "  --tblock <n>            temporal blocking depth, 0 for full sweeps. Even, since steps"
+        << " are taken in pairs (default 0)" << std::endl
+        << "  --storage <format>      distribution storage, fp32, fp16, bf16 or fixed16"
+        << " (default fp32)" << std::endl
+        << "  --csv <path>            also write one line per case to a CSV file" << std::endl;
+}
+
+bool ParseStreamingMode(const std::string &name, StreamingMode &mode)
+{
+    if (name == "twobuffer")
+        mode = StreamingMode::TWO_BUFFER;
+    else if (name == "inplace")
+        mode = StreamingMode::IN_PLACE;
+    else
+        return false;
+    return true;
+}
+
+bool ParseLatticeStorage(const std::string &name, LatticeStorage &format)
+{
+    if (name == "fp32")
+        format = STORAGE_FP32;
+    else if (name == "fp16")
+        format = STORAGE_FP16;
+    else if (name == "bf16")
+        format = STORAGE_BF16;
+    else if (name == "fixed16")
+        format = STORAGE_FIXED16;
+    else
+        return false;
+    return true;
+}
+
+bool ParseCollisionModel(const std::string &name, CollisionModel &model)
+{
+    if (name == "bgk")
+        model = COLLISION_BGK;
+    else if (name == "trt")
+        model = COLLISION_TRT;
+    else if (name == "mrt")
+        model = COLLISION_MRT;
+    else if (name == "smagorinsky")
+        model = COLLISION_MRT_SMAGORINSKY;
+    else
+        return false;
+    return true;
+}
+
+bool ParseSimdIsa(const std::string &name, SimdIsa &isa)
+{
+    if (name == "scalar")
+        isa = SIMD_SCALAR;
+    else if (name == "avx2")
+        isa = SIMD_AVX2;
+    else if (name == "avx512")
+        isa = SIMD_AVX512;
+    else
+        return false;
+    return true;
+}
+
+bool ParseShape(const std::string &name, int &shape)
+{
+    if (name == "square")
+        shape = Shape::SQUARE;
+    else if (name == "circle")
+        shape = Shape::CIRCLE;
+    else if (name == "hline")
+        shape = Shape::HORIZONTAL_LINE;
+    else if (name == "vline")
+        shape = Shape::VERTICAL_LINE;
+    else
+        return false;
+    return true;
+}
+
+const char* GetShapeName(const int shape)
+{
+    switch (shape)
+    {
+    case Shape::SQUARE:
+        return "square";
+    case Shape::CIRCLE:
+        return "circle";
+    case Shape::HORIZONTAL_LINE:
+        return "hline";
+    case Shape::VERTICAL_LINE:
+        return "vline";
+    default:
+        return "none";
+    }
+}
+
+std::vector<std::string> SplitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+bool ParseGridSize(const std::string &arg, GridSize &size)
+{
+    size_t separator = arg.find('x');
+    if (separator == std::string::npos)
+        return false;
+    size.xDim = std::stoi(arg.substr(0, separator));
+    size.yDim = std::stoi(arg.substr(separator + 1));
+    return size.xDim >= 4 && size.yDim >= 4;
+}
+
+bool ParseArguments(int argc, char **argv, BenchmarkOptions &options)
+{
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg(argv[i]);
+            if (arg == "--help" || arg == "-h")
+                return false;
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            const std::string value(argv[++i]);
+            const std::vector<std::string> items = SplitList(value);
+            if (arg == "--sizes")
+            {
+                options.gridSizes.clear();
+                for (size_t n = 0; n < items.size(); n++)
+                {
+                    GridSize size;
+                    if (!ParseGridSize(items[n], size))
+                    {
+                        std::cerr << "Invalid lattice size '" << items[n] << "'" << std::endl;
+                        return false;
+                    }
+                    options.gridSizes.push_back(size);
+                }
+            }
+            else if (arg == "--obst-counts")
+            {
+                options.obstructionCounts.clear();
+                for (size_t n = 0; n < items.size(); n++)
+                {
+                    options.obstructionCounts.push_back(std::stoi(items[n]));
+                }
+            }
+            else if (arg == "--shapes")
+            {
+                options.shapes.clear();
+                for (size_t n = 0; n < items.size(); n++)
+                {
+                    int shape;
+                    if (!ParseShape(items[n], shape))
+                    {
+                        std::cerr << "Unknown shape '" << items[n] << "'" << std::endl;
+                        return false;
+                    }
+                    options.shapes.push_back(shape);
+                }
+            }
+            else if (arg == "--collisions")
+            {
+                options.collisionModels.clear();
+                for (size_t n = 0; n < items.size(); n++)
+                {
+                    CollisionModel model;
+                    if (!ParseCollisionModel(items[n], model))
+                    {
+                        std::cerr << "Unknown collision model '" << items[n] << "'" << std::endl;
+                        return false;
+                    }
+                    options.collisionModels.push_back(model);
+                }
+            }
+            else if (arg == "--inlet")
+                options.inletVelocity = std::stof(value);
+            else if (arg == "--omega")
+                options.omega = std::stof(value);
+            else if (arg == "--steps")
+                options.timeSteps = std::stoi(value);
+            else if (arg == "--warmup")
+                options.warmupSteps = std::stoi(value);
+            else if (arg == "--reps")
+                options.repetitions = std::stoi(value);
+            else if (arg == "--threads")
+                options.numThreads = std::stoi(value);
+            else if (arg == "--pin")
+                options.isThreadPinning = std::stoi(value) != 0;
+            else if (arg == "--tblock")
+                options.temporalBlockingDepth = std::stoi(value);
+            else if (arg == "--csv")
+                options.csvPath = value;
+            else if (arg == "--isa")
+            {
+                if (!ParseSimdIsa(value, options.simdIsa))
+                {
+                    std::cerr << "Unknown instruction set '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--streaming")
+            {
+                if (!ParseStreamingMode(value, options.streamingMode))
+                {
+                    std::cerr << "Unknown streaming mode '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--storage")
+            {
+                if (!ParseLatticeStorage(value, options.latticeStorage))
+                {
+                    std::cerr << "Unknown storage format '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid numeric argument" << std::endl;
+        return false;
+    }
+    bool hasNegativeCount = false;
+    for (size_t n = 0; n < options.obstructionCounts.size(); n++)
+    {
+        hasNegativeCount = hasNegativeCount || options.obstructionCounts[n] < 0;
+    }
+    if (options.gridSizes.empty() || options.obstructionCounts.empty() || options.shapes.empty() ||
+        options.collisionModels.empty() || hasNegativeCount || options.timeSteps < 2 ||
+        options.warmupSteps < 0 || options.repetitions < 1 || options.numThreads < 0 ||
+        options.temporalBlockingDepth < 0)
+    {
+        std::cerr << "Arguments out of range" << std::endl;
+        return false;
+    }
+    if (options.temporalBlockingDepth % 2 != 0)
+    {
+        std::cerr << "--tblock must be even" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ! Spreads count obstructions over a regular grid of cells with about the aspect ratio of the
+// ! lattice, one in the middle of each cell and a quarter of the cell across, so each scene is the
+// ! same from run to run
+std::vector<Obstruction> LayOutObstructions(const GridSize &size, const int count, const int shape)
+{
+    std::vector<Obstruction> obstructions;
+    if (count == 0)
+        return obstructions;
+    int columns = std::max(1, static_cast<int>(ceil(sqrt(static_cast<float>(count)*size.xDim /
+        size.yDim))));
+    int rows = (count + columns - 1) / columns;
+    float cellWidth = static_cast<float>(size.xDim) / columns;
+    float cellHeight = static_cast<float>(size.yDim) / rows;
+    for (int n = 0; n < count; n++)
+    {
+        Obstruction obst;
+        obst.shape = shape;
+        obst.x = (n % columns + 0.5f)*cellWidth;
+        obst.y = (n / columns + 0.5f)*cellHeight;
+        obst.r1 = std::max(1.f, 0.25f*std::min(cellWidth, cellHeight));
+        obst.r2 = 0.f;
+        obst.u = 0.f;
+        obst.v = 0.f;
+        obst.state = State::ACTIVE;
+        obstructions.push_back(obst);
+    }
+    return obstructions;
+}
+
+float GetFluidFraction(CpuLbm &lbm)
+{
+    Domain* domain = lbm.GetDomain();
+    int* im = lbm.GetImage();
+    int fluidNodes = 0;
+    for (int y = 0; y < domain->GetYDim(); y++)
+    {
+        for (int x = 0; x < domain->GetXDim(); x++)
+        {
+            if (im[x + y*domain->GetMaxXDim()] == 0)
+                fluidNodes++;
+        }
+    }
+    return static_cast<float>(fluidNodes) / (domain->GetXDim()*domain->GetYDim());
+}
+
+// ! Sets up a fresh solver for one case, steps it through the warmup and then times each
+// ! repetition separately. MLUPS count every node of the lattice, as in the headless solver, so
+// ! scenes that skip tiles inside obstructions show up as faster. The bytes per update are the
+// ! distributions one update moves through memory with the solver's stepping scheme, which is what
+// ! the achieved bandwidth is derived from.
+BenchmarkResult RunCase(const BenchmarkOptions &options, const GridSize &size,
+    const int obstructionCount, const int shape, const CollisionModel collisionModel)
+{
+    CpuLbm lbm(size.xDim, size.yDim);
+    Domain* domain = lbm.GetDomain();
+    domain->SetXDimVisible(size.xDim);
+    domain->SetYDimVisible(size.yDim);
+    lbm.SetInletVelocity(options.inletVelocity);
+    lbm.SetOmega(options.omega);
+    lbm.SetNumberOfThreads(options.numThreads);
+    lbm.SetThreadPinning(options.isThreadPinning);
+    lbm.SetSimdIsa(options.simdIsa);
+    lbm.SetStreamingMode(options.streamingMode);
+    lbm.SetTemporalBlockingDepth(options.temporalBlockingDepth);
+    lbm.SetLatticeStorage(options.latticeStorage);
+    lbm.SetCollisionModel(collisionModel);
+    lbm.AllocateHostMemory();
+    lbm.InitializeHostMemory();
+    std::vector<Obstruction> obstructions = LayOutObstructions(size, obstructionCount, shape);
+    for (size_t i = 0; i < obstructions.size(); i++)
+    {
+        int obstId = lbm.GetHostObst()->Add(obstructions[i]);
+        UpdateSolverObstructions(&lbm, obstId, obstructions[i], 1.f);
+    }
+    InitializeDomain(&lbm);
+
+    // MarchSolution advances the lattice in pairs of time steps
+    if (options.warmupSteps > 0)
+    {
+        lbm.SetTimeStepsPerFrame((options.warmupSteps + 1) / 2);
+        MarchSolution(&lbm);
+    }
+    const int stepPairs = options.timeSteps / 2;
+    lbm.SetTimeStepsPerFrame(stepPairs);
+    const double nodeUpdates = static_cast<double>(size.xDim)*size.yDim*stepPairs * 2;
+    std::vector<double> mlups;
+    for (int rep = 0; rep < options.repetitions; rep++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        MarchSolution(&lbm);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+            start).count();
+        mlups.push_back(seconds > 0.0 ? nodeUpdates / seconds*1e-6 : 0.0);
+    }
+
+    BenchmarkResult result;
+    result.gridSize = size;
+    result.obstructionCount = obstructionCount;
+    result.shape = obstructionCount > 0 ? shape : -1;
+    result.collisionModel = collisionModel;
+    result.fluidFraction = GetFluidFraction(lbm);
+    result.bytesPerUpdate = GetBytesPerUpdate(&lbm);
+    double sum = 0.0;
+    result.mlupsMin = mlups[0];
+    result.mlupsMax = mlups[0];
+    for (size_t rep = 0; rep < mlups.size(); rep++)
+    {
+        sum += mlups[rep];
+        result.mlupsMin = std::min(result.mlupsMin, mlups[rep]);
+        result.mlupsMax = std::max(result.mlupsMax, mlups[rep]);
+    }
+    result.mlupsMean = sum / mlups.size();
+    double squares = 0.0;
+    for (size_t rep = 0; rep < mlups.size(); rep++)
+    {
+        squares += (mlups[rep] - result.mlupsMean)*(mlups[rep] - result.mlupsMean);
+    }
+    result.mlupsStdDev = mlups.size() > 1 ? sqrt(squares / (mlups.size() - 1)) : 0.0;
+    result.bandwidth = result.mlupsMean*result.bytesPerUpdate*1e-3;
+    lbm.DeallocateHostMemory();
+    return result;
+}
+
+int GetSolverThreadCount(const BenchmarkOptions &options)
+{
+    return options.numThreads > 0 ? options.numThreads : GetHardwareThreadCount();
+}
+
+void WriteCsvHeader(std::ostream &csv)
+{
+    csv << "xdim,ydim,obstructions,shape,collision,isa,storage,streaming,tblock,threads,steps,"
+        << "repetitions,fluid_fraction,bytes_per_update,mlups_mean,mlups_stddev,mlups_min,"
+        << "mlups_max,bandwidth_gbs" << std::endl;
+}
+
+void WriteCsvLine(std::ostream &csv, const BenchmarkOptions &options, CpuLbm &settings,
+    const BenchmarkResult &result)
+{
+    csv << result.gridSize.xDim << "," << result.gridSize.yDim << ","
+        << result.obstructionCount << "," << GetShapeName(result.shape) << ","
+        << GetCollisionModelName(result.collisionModel) << ","
+        << GetSimdIsaName(settings.GetSimdIsa()) << ","
+        << GetLatticeStorageName(settings.GetLatticeStorage()) << ","
+        << (options.streamingMode == StreamingMode::IN_PLACE ? "inplace" : "twobuffer") << ","
+        << options.temporalBlockingDepth << ","
+        << GetSolverThreadCount(options) << ","
+        << options.timeSteps / 2 * 2 << "," << options.repetitions << ","
+        << result.fluidFraction << "," << result.bytesPerUpdate << ","
+        << result.mlupsMean << "," << result.mlupsStdDev << ","
+        << result.mlupsMin << "," << result.mlupsMax << "," << result.bandwidth << std::endl;
+}
+
+void PrintResult(const BenchmarkResult &result)
+{
+    std::ostringstream size;
+    size << result.gridSize.xDim << "x" << result.gridSize.yDim;
+    std::cout << std::left << std::setw(11) << size.str()
+        << std::right << std::setw(6) << result.obstructionCount << " "
+        << std::left << std::setw(7) << GetShapeName(result.shape)
+        << std::setw(17) << GetCollisionModelName(result.collisionModel)
+        << std::right << std::fixed << std::setprecision(2)
+        << std::setw(7) << result.fluidFraction
+        << std::setw(10) << result.mlupsMean
+        << std::setw(9) << result.mlupsStdDev
+        << std::setw(10) << result.mlupsMin
+        << std::setw(10) << result.mlupsMax
+        << std::setw(7) << result.bytesPerUpdate
+        << std::setw(9) << result.bandwidth << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    GridSize defaultSizes[] = { { 256, 256 }, { 512, 512 }, { 1024, 1024 } };
+    options.gridSizes.assign(defaultSizes, defaultSizes + 3);
+    int defaultCounts[] = { 0, 16, 64 };
+    options.obstructionCounts.assign(defaultCounts, defaultCounts + 3);
+    options.shapes.push_back(Shape::CIRCLE);
+    options.shapes.push_back(Shape::SQUARE);
+    options.collisionModels.push_back(COLLISION_BGK);
+    options.collisionModels.push_back(COLLISION_TRT);
+    options.collisionModels.push_back(COLLISION_MRT);
+    options.collisionModels.push_back(COLLISION_MRT_SMAGORINSKY);
+    options.inletVelocity = 0.05f;
+    options.omega = 1.7f;
+    options.timeSteps = 1000;
+    options.warmupSteps = 200;
+    options.repetitions = 5;
+    options.numThreads = 0;
+    options.isThreadPinning = false;
+    options.simdIsa = DetectSimdIsa();
+    options.streamingMode = StreamingMode::TWO_BUFFER;
+    options.temporalBlockingDepth = 0;
+    options.latticeStorage = STORAGE_FP32;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!options.csvPath.empty())
+    {
+        csv.open(options.csvPath.c_str());
+        if (!csv)
+        {
+            std::cerr << "Cannot write " << options.csvPath << std::endl;
+            return 1;
+        }
+        WriteCsvHeader(csv);
+    }
+
+    // the solver settings shared by all cases, resolved the way each case's solver resolves them
+    CpuLbm settings(4, 4);
+    settings.SetSimdIsa(options.simdIsa);
+    settings.SetStreamingMode(options.streamingMode);
+    settings.SetLatticeStorage(options.latticeStorage);
+    std::cout << GetSimdIsaName(settings.GetSimdIsa()) << " collide, "
+        << GetLatticeStorageName(settings.GetLatticeStorage()) << " storage, "
+        << GetSolverThreadCount(options) << " threads, "
+        << options.timeSteps / 2 * 2 << " steps x " << options.repetitions << " repetitions"
+        << std::endl;
+    std::cout << std::left << std::setw(11) << "lattice"
+        << std::right << std::setw(6) << "obst" << " "
+        << std::left << std::setw(7) << "shape" << std::setw(17) << "collision"
+        << std::right << std::setw(7) << "fluid" << std::setw(10) << "MLUPS"
+        << std::setw(9) << "stddev" << std::setw(10) << "min" << std::setw(10) << "max"
+        << std::setw(7) << "B/LU" << std::setw(9) << "GB/s" << std::endl;
+
+    for (size_t s = 0; s < options.gridSizes.size(); s++)
+    {
+        for (size_t c = 0; c < options.collisionModels.size(); c++)
+        {
+            for (size_t n = 0; n < options.obstructionCounts.size(); n++)
+            {
+                for (size_t shape = 0; shape < options.shapes.size(); shape++)
+                {
+                    // without obstructions the shape makes no difference
+                    if (options.obstructionCounts[n] == 0 && shape > 0)
+                        break;
+                    BenchmarkResult result = RunCase(options, options.gridSizes[s],
+                        options.obstructionCounts[n], options.shapes[shape],
+                        options.collisionModels[c]);
+                    PrintResult(result);
+                    if (csv.is_open())
+                    {
+                        WriteCsvLine(csv, options, settings, result);
+                        csv.flush();
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "ActiveTiles.h"
+#include "NodeLists.h"
+#include <algorithm>
+
+ActiveTiles::ActiveTiles(const int maxXDim, const int maxYDim)
+{
+    m_tilesX = (maxXDim + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    m_tilesY = (maxYDim + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    m_isActive.assign(m_tilesX*m_tilesY, 0);
+    m_isStale.assign(m_tilesX*m_tilesY, 0);
+    m_rowSpans.resize(m_tilesY);
+}
+
+bool IsWallNode(const int im)
+{
+    BoundaryType type = GetBoundaryType(im);
+    return type == BOUNDARY_BOUNCE_BACK || type == BOUNDARY_MOVING_WALL;
+}
+
+// ! Reclassifies the tiles that rect, grown by one node, touches. rect is the part of the node
+// ! image that was rebuilt. A tile that comes back into use after being skipped as a wall holds
+// ! stale distributions, so it is added to the activated tiles for the solver to reinitialize.
+void ActiveTiles::Update(const int* Im, const int pitch, const int xDim, const int yDim,
+    const RectInt &rect)
+{
+    int tileXBegin = std::max(rect.m_x - 1, 0) / ACTIVE_TILE_SIZE;
+    int tileYBegin = std::max(rect.m_y - 1, 0) / ACTIVE_TILE_SIZE;
+    int tileXEnd = std::min((rect.m_x + rect.m_w) / ACTIVE_TILE_SIZE + 1, m_tilesX);
+    int tileYEnd = std::min((rect.m_y + rect.m_h) / ACTIVE_TILE_SIZE + 1, m_tilesY);
+    for (int tileY = tileYBegin; tileY < tileYEnd; tileY++)
+    {
+        for (int tileX = tileXBegin; tileX < tileXEnd; tileX++)
+        {
+            int n = tileX + tileY*m_tilesX;
+            int x0 = tileX*ACTIVE_TILE_SIZE;
+            int y0 = tileY*ACTIVE_TILE_SIZE;
+            if (x0 >= xDim || y0 >= yDim)
+            {
+                m_isActive[n] = 0;
+                continue;
+            }
+            int xMin = std::max(x0 - 1, 0);
+            int yMin = std::max(y0 - 1, 0);
+            int xMax = std::min(x0 + ACTIVE_TILE_SIZE + 1, xDim);
+            int yMax = std::min(y0 + ACTIVE_TILE_SIZE + 1, yDim);
+            bool isActive = false;
+            for (int y = yMin; y < yMax && !isActive; y++)
+            {
+                for (int x = xMin; x < xMax; x++)
+                {
+                    if (!IsWallNode(Im[x + y*pitch]))
+                    {
+                        isActive = true;
+                        break;
+                    }
+                }
+            }
+            if (isActive && m_isStale[n])
+            {
+                m_activatedTiles.push_back(n);
+            }
+            m_isActive[n] = isActive ? 1 : 0;
+            m_isStale[n] = isActive ? 0 : 1;
+        }
+    }
+
+    m_activeTiles.clear();
+    for (int tileY = 0; tileY < m_tilesY; tileY++)
+    {
+        std::vector<int> &spans = m_rowSpans[tileY];
+        spans.clear();
+        for (int tileX = 0; tileX < m_tilesX; tileX++)
+        {
+            if (!m_isActive[tileX + tileY*m_tilesX])
+                continue;
+            m_activeTiles.push_back(tileX + tileY*m_tilesX);
+            int x0 = tileX*ACTIVE_TILE_SIZE;
+            int x1 = std::min(x0 + ACTIVE_TILE_SIZE, xDim);
+            if (!spans.empty() && spans.back() == x0)
+                spans.back() = x1;
+            else
+            {
+                spans.push_back(x0);
+                spans.push_back(x1);
+            }
+        }
+    }
+}
+
+int ActiveTiles::GetTilesX() const
+{
+    return m_tilesX;
+}
+
+int ActiveTiles::GetTilesY() const
+{
+    return m_tilesY;
+}
+
+bool ActiveTiles::IsActive(const int tileX, const int tileY) const
+{
+    return m_isActive[tileX + tileY*m_tilesX] != 0;
+}
+
+bool ActiveTiles::IsNodeActive(const int x, const int y) const
+{
+    return IsActive(x / ACTIVE_TILE_SIZE, y / ACTIVE_TILE_SIZE);
+}
+
+// ! Indices tileX + tileY*GetTilesX() of the tiles to step, in row order
+const std::vector<int> &ActiveTiles::GetActiveTiles() const
+{
+    return m_activeTiles;
+}
+
+// ! [begin, end) pairs of the x-adjacent active tiles in the tile row of node row y, in nodes
+const std::vector<int> &ActiveTiles::GetRowSpans(const int y) const
+{
+    return m_rowSpans[y / ACTIVE_TILE_SIZE];
+}
+
+const std::vector<int> &ActiveTiles::GetActivatedTiles() const
+{
+    return m_activatedTiles;
+}
+
+void ActiveTiles::ClearActivatedTiles()
+{
+    m_activatedTiles.clear();
+}
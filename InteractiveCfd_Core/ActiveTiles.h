@@ -0,0 +1,32 @@
+#pragma once
+#include "RectInt.h"
+#include <vector>
+
+#define ACTIVE_TILE_SIZE 16
+
+// ! The lattice split into ACTIVE_TILE_SIZE square tiles, flagged by whether they have to be
+// ! stepped. A tile is skipped when it and the ring of nodes around it are all walls, since what
+// ! such nodes hold never streams into a fluid node. Tiles beyond the current domain size are
+// ! skipped too. Only the tiles around the part of the node image that changed are reclassified.
+class ActiveTiles
+{
+    int m_tilesX;
+    int m_tilesY;
+    std::vector<unsigned char> m_isActive;
+    std::vector<unsigned char> m_isStale;
+    std::vector<int> m_activeTiles;
+    std::vector<int> m_activatedTiles;
+    std::vector<std::vector<int> > m_rowSpans;
+public:
+    ActiveTiles(const int maxXDim, const int maxYDim);
+    void Update(const int* Im, const int pitch, const int xDim, const int yDim,
+        const RectInt &rect);
+    int GetTilesX() const;
+    int GetTilesY() const;
+    bool IsActive(const int tileX, const int tileY) const;
+    bool IsNodeActive(const int x, const int y) const;
+    const std::vector<int> &GetActiveTiles() const;
+    const std::vector<int> &GetRowSpans(const int y) const;
+    const std::vector<int> &GetActivatedTiles() const;
+    void ClearActivatedTiles();
+};
@@ -0,0 +1,413 @@
+#include "Checkpoint.h"
+#include "Graphics/CpuLbm.h"
+#include "Domain.h"
+#include "NodeLists.h"
+#include "ActiveTiles.h"
+#include "ObstructionStore.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    m_data = NULL;
+    m_size = 0;
+#ifdef _MSC_VER
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#else
+    m_file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+// ! Maps the whole of an existing file for reading. Pages are only read from disk as they are
+// ! touched.
+bool MappedFile::Open(const std::string &path)
+{
+    Close();
+#ifdef _MSC_VER
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER size;
+    if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+    m_size = size.QuadPart;
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping != NULL)
+        m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    m_file = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (m_file < 0 || fstat(m_file, &status) != 0 || status.st_size == 0)
+    {
+        Close();
+        return false;
+    }
+    m_size = status.st_size;
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (data != MAP_FAILED)
+    {
+        m_data = static_cast<char*>(data);
+        madvise(data, m_size, MADV_WILLNEED);
+    }
+#endif
+    if (m_data == NULL)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// ! Creates or truncates the file at path, sizes it and maps it for writing. What is written to
+// ! the mapping reaches the file by the time it is closed.
+bool MappedFile::Create(const std::string &path, const long long size)
+{
+    Close();
+#ifdef _MSC_VER
+    m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        Close();
+        return false;
+    }
+    m_size = size;
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+        static_cast<DWORD>(size & 0xffffffff), NULL);
+    if (m_mapping != NULL)
+        m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0));
+#else
+    m_file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_file < 0 || ftruncate(m_file, size) != 0)
+    {
+        Close();
+        return false;
+    }
+    m_size = size;
+    void* data = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+    if (data != MAP_FAILED)
+        m_data = static_cast<char*>(data);
+#endif
+    if (m_data == NULL)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _MSC_VER
+    if (m_data != NULL)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != NULL)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != NULL)
+        munmap(m_data, m_size);
+    if (m_file >= 0)
+        close(m_file);
+    m_file = -1;
+#endif
+    m_data = NULL;
+    m_size = 0;
+}
+
+char* MappedFile::GetData()
+{
+    return m_data;
+}
+
+long long MappedFile::GetSize()
+{
+    return m_size;
+}
+
+// ! Lays out the sections of a checkpoint of a lattice the size of domain, one after the other
+// ! from the end of the header. The magic is left blank for the writer to fill in last.
+CheckpointHeader MakeCheckpointHeader(Domain &domain, const LatticeStorage storage,
+    const StreamingMode streamingMode, const CollisionModel model, const float omega, const float inletVelocity,
+    const long long timeStep, const int solverObstCount, const int hostObstCount)
+{
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.version = CHECKPOINT_VERSION;
+    header.headerSize = sizeof(CheckpointHeader);
+    header.maxXDim = domain.GetMaxXDim();
+    header.maxYDim = domain.GetMaxYDim();
+    header.xDim = domain.GetXDim();
+    header.yDim = domain.GetYDim();
+    header.xDimVisible = domain.GetXDimVisible();
+    header.yDimVisible = domain.GetYDimVisible();
+    header.latticeStorage = storage;
+    header.streamingMode = streamingMode;
+    header.collisionModel = model;
+    header.omega = omega;
+    header.inletVelocity = inletVelocity;
+    header.timeStep = timeStep;
+    header.solverObstCount = solverObstCount;
+    header.hostObstCount = hostObstCount;
+
+    long long planeSize = domain.GetPlaneSize();
+    long long sizes[CHECKPOINT_SECTION_COUNT];
+    sizes[CHECKPOINT_DISTRIBUTIONS] = 9 * planeSize*GetBytesPerDistribution(storage);
+    sizes[CHECKPOINT_IMAGE] = planeSize*sizeof(int);
+    sizes[CHECKPOINT_OBST_ID_MAP] = planeSize*sizeof(int);
+    sizes[CHECKPOINT_SOLVER_OBST] = solverObstCount*sizeof(Obstruction);
+    sizes[CHECKPOINT_SOLVER_OBST_IDS] = solverObstCount*sizeof(int);
+    sizes[CHECKPOINT_HOST_OBST] = hostObstCount*sizeof(Obstruction);
+    sizes[CHECKPOINT_HOST_OBST_IDS] = hostObstCount*sizeof(int);
+    long long offset = (sizeof(CheckpointHeader) + CHECKPOINT_ALIGNMENT - 1) /
+        CHECKPOINT_ALIGNMENT*CHECKPOINT_ALIGNMENT;
+    for (int section = 0; section < CHECKPOINT_SECTION_COUNT; section++)
+    {
+        header.sections[section].offset = offset;
+        header.sections[section].size = sizes[section];
+        offset += (sizes[section] + CHECKPOINT_ALIGNMENT - 1) /
+            CHECKPOINT_ALIGNMENT*CHECKPOINT_ALIGNMENT;
+    }
+    return header;
+}
+
+// ! Maps the checkpoint at path and checks that its header is complete and describes sections that
+// ! fit the file and the lattice it names
+CheckpointStatus OpenCheckpoint(MappedFile &file, const std::string &path,
+    CheckpointHeader &header)
+{
+    if (!file.Open(path))
+        return CHECKPOINT_IO_ERROR;
+    if (file.GetSize() < static_cast<long long>(sizeof(CheckpointHeader)))
+        return CHECKPOINT_BAD_FORMAT;
+    std::memcpy(&header, file.GetData(), sizeof(CheckpointHeader));
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+        return CHECKPOINT_BAD_FORMAT;
+    if (header.version != CHECKPOINT_VERSION || header.headerSize != sizeof(CheckpointHeader))
+        return CHECKPOINT_VERSION_MISMATCH;
+    if (header.maxXDim <= 0 || header.maxYDim <= 0 || header.solverObstCount < 0 ||
+        header.hostObstCount < 0 || header.latticeStorage < STORAGE_FP32 ||
+        header.latticeStorage > STORAGE_FIXED16 || header.streamingMode < TWO_BUFFER ||
+        header.streamingMode > IN_PLACE)
+        return CHECKPOINT_BAD_FORMAT;
+    long long planeSize = static_cast<long long>(header.maxXDim)*header.maxYDim;
+    long long expectedSizes[CHECKPOINT_SECTION_COUNT] = {
+        9 * planeSize*GetBytesPerDistribution(static_cast<LatticeStorage>(header.latticeStorage)),
+        planeSize*static_cast<long long>(sizeof(int)),
+        planeSize*static_cast<long long>(sizeof(int)),
+        header.solverObstCount*static_cast<long long>(sizeof(Obstruction)),
+        header.solverObstCount*static_cast<long long>(sizeof(int)),
+        header.hostObstCount*static_cast<long long>(sizeof(Obstruction)),
+        header.hostObstCount*static_cast<long long>(sizeof(int)) };
+    for (int section = 0; section < CHECKPOINT_SECTION_COUNT; section++)
+    {
+        const CheckpointSection &range = header.sections[section];
+        if (range.size != expectedSizes[section] || range.offset % CHECKPOINT_ALIGNMENT != 0 ||
+            range.offset < 0 || range.offset + range.size > file.GetSize())
+            return CHECKPOINT_BAD_FORMAT;
+    }
+    return CHECKPOINT_OK;
+}
+
+// ! Reads only the header, so that a solver can be set up to the checkpoint's lattice before it
+// ! is loaded
+CheckpointStatus ReadCheckpointHeader(const std::string &path, CheckpointHeader &header)
+{
+    MappedFile file;
+    return OpenCheckpoint(file, path, header);
+}
+
+void WriteCheckpointObstructions(char* data, const CheckpointHeader &header,
+    const ObstructionStore &solverObst, const ObstructionStore &hostObst)
+{
+    const ObstructionStore* stores[2] = { &solverObst, &hostObst };
+    const int obstSections[2] = { CHECKPOINT_SOLVER_OBST, CHECKPOINT_HOST_OBST };
+    const int idSections[2] = { CHECKPOINT_SOLVER_OBST_IDS, CHECKPOINT_HOST_OBST_IDS };
+    for (int store = 0; store < 2; store++)
+    {
+        int count = stores[store]->GetCount();
+        if (count == 0)
+            continue;
+        std::memcpy(data + header.sections[obstSections[store]].offset,
+            stores[store]->GetData(), count*sizeof(Obstruction));
+        int* ids = reinterpret_cast<int*>(data + header.sections[idSections[store]].offset);
+        for (int i = 0; i < count; i++)
+        {
+            ids[i] = stores[store]->GetId(i);
+        }
+    }
+}
+
+// ! Replaces the contents of both stores. Entries are set in dense order, so the dense indices the
+// ! node image and the obstruction id map refer to come back unchanged.
+void ReadCheckpointObstructions(const char* data, const CheckpointHeader &header,
+    ObstructionStore &solverObst, ObstructionStore &hostObst)
+{
+    ObstructionStore* stores[2] = { &solverObst, &hostObst };
+    const int counts[2] = { header.solverObstCount, header.hostObstCount };
+    const int obstSections[2] = { CHECKPOINT_SOLVER_OBST, CHECKPOINT_HOST_OBST };
+    const int idSections[2] = { CHECKPOINT_SOLVER_OBST_IDS, CHECKPOINT_HOST_OBST_IDS };
+    for (int store = 0; store < 2; store++)
+    {
+        stores[store]->Clear();
+        const Obstruction* obstructions = reinterpret_cast<const Obstruction*>(
+            data + header.sections[obstSections[store]].offset);
+        const int* ids = reinterpret_cast<const int*>(
+            data + header.sections[idSections[store]].offset);
+        for (int i = 0; i < counts[store]; i++)
+        {
+            stores[store]->Set(ids[i], obstructions[i]);
+        }
+    }
+}
+
+// ! Sets the domain to the checkpoint's size. The caller has checked that the pitch matches.
+void RestoreCheckpointDomain(const CheckpointHeader &header, Domain &domain)
+{
+    domain.SetXDimVisible(header.xDimVisible);
+    domain.SetYDimVisible(header.yDimVisible);
+    domain.SetXDim(header.xDim);
+    domain.SetYDim(header.yDim);
+}
+
+// ! Copies planeCount planes of maxYDim rows between solver arrays and a mapped checkpoint, in the
+// ! row bands the solver steps in, so each band of a solver array is written by the thread that
+// ! first touched it and the pages of the mapping are faulted in on all threads at once
+void CopyRowBands(ThreadPool* threadPool, char* dst, const char* src, const int planeCount,
+    const long long rowBytes, Domain &simDomain)
+{
+    int maxYDim = simDomain.GetMaxYDim();
+    long long planeBytes = rowBytes*maxYDim;
+    threadPool->ParallelFor(0, maxYDim, threadPool->GetBandSize(maxYDim),
+        [&](const int yBegin, const int yEnd, const int /*thread*/)
+    {
+        for (int plane = 0; plane < planeCount; plane++)
+        {
+            long long offset = plane*planeBytes + yBegin*rowBytes;
+            std::memcpy(dst + offset, src + offset, (yEnd - yBegin)*rowBytes);
+        }
+    });
+}
+
+// ! Holds the newest solution in fA or packedFA, which is where MarchSolution leaves it after
+// ! every pair of steps in either streaming mode
+char* GetCheckpointDistributions(CpuLbm* cpuLbm)
+{
+    if (cpuLbm->GetLatticeStorage() != STORAGE_FP32)
+        return reinterpret_cast<char*>(cpuLbm->GetPackedFA());
+    return reinterpret_cast<char*>(cpuLbm->GetFA());
+}
+
+// ! Writes the complete state of the solver, including its obstructions, so that LoadCheckpoint
+// ! can carry on from timeStep
+CheckpointStatus SaveCheckpoint(CpuLbm* cpuLbm, const std::string &path, const long long timeStep)
+{
+    Domain* domain = cpuLbm->GetDomain();
+    CheckpointHeader header = MakeCheckpointHeader(*domain, cpuLbm->GetLatticeStorage(),
+        cpuLbm->GetStreamingMode(), cpuLbm->GetCollisionModel(), cpuLbm->GetOmega(),
+        cpuLbm->GetInletVelocity(), timeStep, cpuLbm->GetSolverObst()->GetCount(),
+        cpuLbm->GetHostObst()->GetCount());
+    const CheckpointSection &last = header.sections[CHECKPOINT_SECTION_COUNT - 1];
+    MappedFile file;
+    if (!file.Create(path, last.offset + last.size))
+        return CHECKPOINT_IO_ERROR;
+    char* data = file.GetData();
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    long long pitch = domain->GetMaxXDim();
+    CopyRowBands(threadPool, data + header.sections[CHECKPOINT_DISTRIBUTIONS].offset,
+        GetCheckpointDistributions(cpuLbm), 9,
+        pitch*GetBytesPerDistribution(cpuLbm->GetLatticeStorage()), *domain);
+    CopyRowBands(threadPool, data + header.sections[CHECKPOINT_IMAGE].offset,
+        reinterpret_cast<char*>(cpuLbm->GetImage()), 1, pitch*sizeof(int), *domain);
+    CopyRowBands(threadPool, data + header.sections[CHECKPOINT_OBST_ID_MAP].offset,
+        reinterpret_cast<char*>(cpuLbm->GetObstIdMap()), 1, pitch*sizeof(int), *domain);
+    WriteCheckpointObstructions(data, header, *cpuLbm->GetSolverObst(), *cpuLbm->GetHostObst());
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    std::memcpy(data, &header, sizeof(header));
+    file.Close();
+    return CHECKPOINT_OK;
+}
+
+// ! Restores a checkpoint into a solver whose memory was allocated for the same lattice pitch,
+// ! storage format and streaming mode. The arrays are copied straight from the mapped file; only the node lists and
+// ! active tiles are derived again from the restored node image. Omega, the inlet velocity and the
+// ! collision model are taken from the checkpoint, and the residual monitor starts over.
+CheckpointStatus LoadCheckpoint(CpuLbm* cpuLbm, const std::string &path, long long &timeStep)
+{
+    MappedFile file;
+    CheckpointHeader header;
+    CheckpointStatus status = OpenCheckpoint(file, path, header);
+    if (status != CHECKPOINT_OK)
+        return status;
+    Domain* domain = cpuLbm->GetDomain();
+    if (header.maxXDim != domain->GetMaxXDim() || header.maxYDim != domain->GetMaxYDim() ||
+        header.latticeStorage != cpuLbm->GetLatticeStorage() ||
+        header.streamingMode != cpuLbm->GetStreamingMode())
+        return CHECKPOINT_LATTICE_MISMATCH;
+
+    const char* data = file.GetData();
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    long long pitch = domain->GetMaxXDim();
+    CopyRowBands(threadPool, GetCheckpointDistributions(cpuLbm),
+        data + header.sections[CHECKPOINT_DISTRIBUTIONS].offset, 9,
+        pitch*GetBytesPerDistribution(cpuLbm->GetLatticeStorage()), *domain);
+    CopyRowBands(threadPool, reinterpret_cast<char*>(cpuLbm->GetImage()),
+        data + header.sections[CHECKPOINT_IMAGE].offset, 1, pitch*sizeof(int), *domain);
+    CopyRowBands(threadPool, reinterpret_cast<char*>(cpuLbm->GetObstIdMap()),
+        data + header.sections[CHECKPOINT_OBST_ID_MAP].offset, 1, pitch*sizeof(int), *domain);
+    ReadCheckpointObstructions(data, header, *cpuLbm->GetSolverObst(), *cpuLbm->GetHostObst());
+
+    RestoreCheckpointDomain(header, *domain);
+    cpuLbm->GetNodeLists()->UpdateRows(cpuLbm->GetImage(), domain->GetMaxXDim(),
+        domain->GetXDim(), 0, domain->GetMaxYDim());
+    cpuLbm->GetActiveTiles()->Update(cpuLbm->GetImage(), domain->GetMaxXDim(), domain->GetXDim(),
+        domain->GetYDim(), RectInt(0, 0, domain->GetMaxXDim(), domain->GetMaxYDim()));
+    // the restored lattice already holds the flow of every tile that became active
+    cpuLbm->GetActiveTiles()->ClearActivatedTiles();
+    domain->ClearImageDirtyRect();
+
+    cpuLbm->SetOmega(header.omega);
+    cpuLbm->SetInletVelocity(header.inletVelocity);
+    cpuLbm->SetCollisionModel(static_cast<CollisionModel>(header.collisionModel));
+    cpuLbm->GetResidualMonitor()->Reset();
+    timeStep = header.timeStep;
+    return CHECKPOINT_OK;
+}
+
+const char* GetCheckpointStatusName(const CheckpointStatus status)
+{
+    switch (status)
+    {
+    case CHECKPOINT_IO_ERROR:
+        return "cannot read or write the file";
+    case CHECKPOINT_BAD_FORMAT:
+        return "not a complete checkpoint";
+    case CHECKPOINT_VERSION_MISMATCH:
+        return "checkpoint version not supported";
+    case CHECKPOINT_LATTICE_MISMATCH:
+        return "lattice size, storage or streaming mode differs from the checkpoint";
+    default:
+        return "ok";
+    }
+}
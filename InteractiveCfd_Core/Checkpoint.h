@@ -0,0 +1,108 @@
+#pragma once
+#include "common.h"
+#include "CollisionModels.h"
+#include "LatticeStorage.h"
+#include <string>
+
+// ! Identifies a checkpoint file, followed by CHECKPOINT_VERSION
+#define CHECKPOINT_MAGIC "ICFDCKPT"
+// ! Raised whenever the layout of the header or of a section changes
+#define CHECKPOINT_VERSION 2
+// ! The header and every section start on a multiple of this, so each section can be mapped on
+// ! its own and copied with aligned page-sized transfers
+#define CHECKPOINT_ALIGNMENT 4096
+// ! File the interactive window saves to and restores from
+#define CHECKPOINT_FILE "checkpoint.icfd"
+
+#ifdef LBM_GL_CPP_EXPORTS
+#define FW_API __declspec(dllexport)
+#else
+#define FW_API __declspec(dllimport)
+#endif
+
+class Domain;
+class CpuLbm;
+class ObstructionStore;
+
+enum CheckpointStatus{CHECKPOINT_OK, CHECKPOINT_IO_ERROR, CHECKPOINT_BAD_FORMAT,
+    CHECKPOINT_VERSION_MISMATCH, CHECKPOINT_LATTICE_MISMATCH};
+
+enum CheckpointSectionId{CHECKPOINT_DISTRIBUTIONS, CHECKPOINT_IMAGE, CHECKPOINT_OBST_ID_MAP,
+    CHECKPOINT_SOLVER_OBST, CHECKPOINT_SOLVER_OBST_IDS, CHECKPOINT_HOST_OBST,
+    CHECKPOINT_HOST_OBST_IDS, CHECKPOINT_SECTION_COUNT};
+
+struct CheckpointSection
+{
+    long long offset;
+    long long size;
+};
+
+// ! Start of a checkpoint file. Every array is stored exactly as the solvers hold it: the 9
+// ! distribution planes and the node image and obstruction id map with a pitch of maxXDim and
+// ! maxYDim rows, in the host's byte order. The solver obstructions are the scaled copy the node
+// ! image refers to, in dense order, and the host obstructions the ones the user placed, each with
+// ! the id of every entry. In-place lattices are stored as they are left after an odd step, so they
+// ! only load into a solver of the same streaming mode. The magic is written last, so an
+// ! interrupted save is not loaded.
+struct CheckpointHeader
+{
+    char magic[8];
+    int version;
+    int headerSize;
+    int maxXDim;
+    int maxYDim;
+    int xDim;
+    int yDim;
+    int xDimVisible;
+    int yDimVisible;
+    int latticeStorage;
+    int streamingMode;
+    int collisionModel;
+    float omega;
+    float inletVelocity;
+    long long timeStep;
+    int solverObstCount;
+    int hostObstCount;
+    CheckpointSection sections[CHECKPOINT_SECTION_COUNT];
+};
+
+// ! A file mapped into memory, read-only when opened and writable when created. The mapping is
+// ! released by Close or the destructor.
+class FW_API MappedFile
+{
+    char* m_data;
+    long long m_size;
+#ifdef _MSC_VER
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+public:
+    MappedFile();
+    ~MappedFile();
+    bool Open(const std::string &path);
+    bool Create(const std::string &path, const long long size);
+    void Close();
+    char* GetData();
+    long long GetSize();
+};
+
+FW_API CheckpointHeader MakeCheckpointHeader(Domain &domain, const LatticeStorage storage,
+    const StreamingMode streamingMode, const CollisionModel model, const float omega, const float inletVelocity,
+    const long long timeStep, const int solverObstCount, const int hostObstCount);
+FW_API CheckpointStatus OpenCheckpoint(MappedFile &file, const std::string &path,
+    CheckpointHeader &header);
+FW_API CheckpointStatus ReadCheckpointHeader(const std::string &path, CheckpointHeader &header);
+FW_API void WriteCheckpointObstructions(char* data, const CheckpointHeader &header,
+    const ObstructionStore &solverObst, const ObstructionStore &hostObst);
+FW_API void ReadCheckpointObstructions(const char* data, const CheckpointHeader &header,
+    ObstructionStore &solverObst, ObstructionStore &hostObst);
+FW_API void RestoreCheckpointDomain(const CheckpointHeader &header, Domain &domain);
+
+FW_API CheckpointStatus SaveCheckpoint(CpuLbm* cpuLbm, const std::string &path,
+    const long long timeStep);
+FW_API CheckpointStatus LoadCheckpoint(CpuLbm* cpuLbm, const std::string &path,
+    long long &timeStep);
+
+FW_API const char* GetCheckpointStatusName(const CheckpointStatus status);
@@ -0,0 +1,167 @@
+#pragma once
+#include "CudaCompat.h"
+#include "common.h"
+#include <math.h>
+
+enum CollisionModel{COLLISION_BGK, COLLISION_TRT, COLLISION_MRT, COLLISION_MRT_SMAGORINSKY};
+
+// Magic parameter of the two relaxation time operator, (1/omegaPlus - 1/2)(1/omegaMinus - 1/2)
+#define TRT_MAGIC 0.25f
+
+// ! Collision operators used as compile time policies by LbmNode, the CUDA stepping kernels and
+// ! the CPU row collide. V is float or one of the SIMD wrappers of the CPU solver, which provide
+// ! arithmetic operators and SimdSqrt. Each operator only computes what it needs, so selecting BGK
+// ! skips the moment transform and the strain rate entirely.
+
+__host__ __device__ inline float SimdSqrt(const float a)
+{
+    return sqrtf(a);
+}
+
+template <typename V>
+__host__ __device__ inline void ComputeEquilibria(V* fEq, const V &rho, const V &u, const V &v,
+    const V &usqr)
+{
+    fEq[0] = 0.4444444444f*(rho - 1.5f*usqr);
+    fEq[1] = 0.1111111111f*(rho + 3.0f*u + 4.5f*u*u - 1.5f*usqr);
+    fEq[2] = 0.1111111111f*(rho + 3.0f*v + 4.5f*v*v - 1.5f*usqr);
+    fEq[3] = 0.1111111111f*(rho - 3.0f*u + 4.5f*u*u - 1.5f*usqr);
+    fEq[4] = 0.1111111111f*(rho - 3.0f*v + 4.5f*v*v - 1.5f*usqr);
+    fEq[5] = 0.02777777778f*(rho + 3.0f*(u + v) + 4.5f*(u + v)*(u + v) - 1.5f*usqr);
+    fEq[6] = 0.02777777778f*(rho + 3.0f*(v - u) + 4.5f*(v - u)*(v - u) - 1.5f*usqr);
+    fEq[7] = 0.02777777778f*(rho - 3.0f*(u + v) + 4.5f*(u + v)*(u + v) - 1.5f*usqr);
+    fEq[8] = 0.02777777778f*(rho + 3.0f*(u - v) + 4.5f*(u - v)*(u - v) - 1.5f*usqr);
+}
+
+// ! MRT update shared by the plain and Smagorinsky variants. The stress moments m7 and m8 relax
+// ! with omegaStress, the other moments are set to equilibrium.
+template <typename V>
+__host__ __device__ inline void RelaxMoments(V* f, const V &u, const V &v, const V &usqr,
+    const V &omegaStress)
+{
+    V m1 = -2.f*f[0] + f[1] + f[2] + f[3] + f[4] + 4.f*f[5] + 4.f*f[6] + 4.f*f[7]
+        + 4.f*f[8] - 3.0f*usqr;
+    V m2 = 3.f*f[0] - 3.f*f[1] - 3.f*f[2] - 3.f*f[3] - 3.f*f[4] + 3.0f*usqr;
+    V m4 = -f[1] + f[3] + 2.f*f[5] - 2.f*f[6] - 2.f*f[7] + 2.f*f[8];
+    V m6 = -f[2] + f[4] + 2.f*f[5] + 2.f*f[6] - 2.f*f[7] - 2.f*f[8];
+    V m7 = f[1] - f[2] + f[3] - f[4] - (u*u - v*v);
+    V m8 = f[5] - f[6] + f[7] - f[8] - (u*v);
+
+    V m1m2Axis = -m1*0.027777777f - 0.05555555556f*m2;
+    V m1m2Diag = 0.05555555556f*m1 + m2*0.027777777f;
+    V m7Relaxed = m7*omegaStress*0.25f;
+    V m8Relaxed = m8*omegaStress*0.25f;
+
+    f[0] = f[0] - (-m1 + m2)*0.11111111f;
+    f[1] = f[1] - (m1m2Axis - 0.16666666667f*m4 + m7Relaxed);
+    f[2] = f[2] - (m1m2Axis - 0.16666666667f*m6 - m7Relaxed);
+    f[3] = f[3] - (m1m2Axis + 0.16666666667f*m4 + m7Relaxed);
+    f[4] = f[4] - (m1m2Axis + 0.16666666667f*m6 - m7Relaxed);
+    f[5] = f[5] - (m1m2Diag + 0.08333333333f*m4 + 0.08333333333f*m6 + m8Relaxed);
+    f[6] = f[6] - (m1m2Diag - 0.08333333333f*m4 + 0.08333333333f*m6 - m8Relaxed);
+    f[7] = f[7] - (m1m2Diag - 0.08333333333f*m4 - 0.08333333333f*m6 + m8Relaxed);
+    f[8] = f[8] - (m1m2Diag + 0.08333333333f*m4 - 0.08333333333f*m6 - m8Relaxed);
+}
+
+// Single relaxation time towards the equilibrium
+struct BgkCollision
+{
+    template <typename V>
+    __host__ __device__ static void Collide(V* f, const V &omega)
+    {
+        V rho = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7] + f[8];
+        V u = f[1] - f[3] + f[5] - f[6] - f[7] + f[8];
+        V v = f[2] - f[4] + f[5] + f[6] - f[7] - f[8];
+        V usqr = u*u + v*v;
+        V fEq[9];
+        ComputeEquilibria(fEq, rho, u, v, usqr);
+        for (int i = 0; i < 9; i++)
+        {
+            f[i] = f[i] - omega*(f[i] - fEq[i]);
+        }
+    }
+};
+
+// Symmetric parts relax with omega, antisymmetric parts with the rate given by TRT_MAGIC
+struct TrtCollision
+{
+    template <typename V>
+    __host__ __device__ static void Collide(V* f, const V &omega)
+    {
+        V rho = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7] + f[8];
+        V u = f[1] - f[3] + f[5] - f[6] - f[7] + f[8];
+        V v = f[2] - f[4] + f[5] + f[6] - f[7] - f[8];
+        V usqr = u*u + v*v;
+        V fEq[9];
+        ComputeEquilibria(fEq, rho, u, v, usqr);
+        V omegaMinus = V(1.f) / (V(TRT_MAGIC) / (V(1.f) / omega - 0.5f) + 0.5f);
+        V halfOmega = 0.5f*omega;
+        V halfOmegaMinus = 0.5f*omegaMinus;
+
+        f[0] = f[0] - omega*(f[0] - fEq[0]);
+        const int pairs[4][2] = { { 1, 3 }, { 2, 4 }, { 5, 7 }, { 6, 8 } };
+        for (int n = 0; n < 4; n++)
+        {
+            const int i = pairs[n][0];
+            const int j = pairs[n][1];
+            V symmetric = halfOmega*((f[i] + f[j]) - (fEq[i] + fEq[j]));
+            V antisymmetric = halfOmegaMinus*((f[i] - f[j]) - (fEq[i] - fEq[j]));
+            f[i] = f[i] - symmetric - antisymmetric;
+            f[j] = f[j] - symmetric + antisymmetric;
+        }
+    }
+};
+
+// MRT with the stress moments relaxed at the molecular viscosity
+struct MrtCollision
+{
+    template <typename V>
+    __host__ __device__ static void Collide(V* f, const V &omega)
+    {
+        V u = f[1] - f[3] + f[5] - f[6] - f[7] + f[8];
+        V v = f[2] - f[4] + f[5] + f[6] - f[7] - f[8];
+        V usqr = u*u + v*v;
+        RelaxMoments(f, u, v, usqr, omega);
+    }
+};
+
+// MRT with a Smagorinsky eddy viscosity from the non-equilibrium strain rate
+struct MrtSmagorinskyCollision
+{
+    template <typename V>
+    __host__ __device__ static void Collide(V* f, const V &omega)
+    {
+        V rho = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7] + f[8];
+        V u = f[1] - f[3] + f[5] - f[6] - f[7] + f[8];
+        V v = f[2] - f[4] + f[5] + f[6] - f[7] - f[8];
+        V usqr = u*u + v*v;
+        V fEq[9];
+        ComputeEquilibria(fEq, rho, u, v, usqr);
+
+        V qxx = (f[1] - fEq[1]) + (f[3] - fEq[3]) + (f[5] - fEq[5]) + (f[6] - fEq[6])
+            + (f[7] - fEq[7]) + (f[8] - fEq[8]);
+        V qxy = (f[5] - fEq[5]) - (f[6] - fEq[6]) + (f[7] - fEq[7]) - (f[8] - fEq[8]);
+        V qyy = (f[5] - fEq[5]) + (f[2] - fEq[2]) + (f[6] - fEq[6]) + (f[7] - fEq[7])
+            + (f[4] - fEq[4]) + (f[8] - fEq[8]);
+        V Q = SimdSqrt(qxx*qxx + qxy*qxy*2.f + qyy*qyy);
+
+        V tau0 = V(1.f) / omega;
+        V tau = 0.5f*tau0 + 0.5f*SimdSqrt(tau0*tau0 + (18.f*SMAG_CONST*sqrtf(2.f))*Q);
+        RelaxMoments(f, u, v, usqr, V(1.f) / tau);
+    }
+};
+
+inline const char* GetCollisionModelName(const CollisionModel model)
+{
+    switch (model)
+    {
+    case COLLISION_BGK:
+        return "BGK";
+    case COLLISION_TRT:
+        return "TRT";
+    case COLLISION_MRT:
+        return "MRT";
+    default:
+        return "MRT-Smagorinsky";
+    }
+}
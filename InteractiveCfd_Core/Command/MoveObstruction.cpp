@@ -41,3 +41,8 @@ void MoveObstruction::End()
     m_state = INACTIVE;
 }
 
+bool MoveObstruction::IsActive()
+{
+    return m_state == ACTIVE;
+}
+
@@ -11,4 +11,5 @@ public:
     void Start(const float currentX, const float currentY);
     void Track(const float currentX, const float currentY);
     void End();
+    bool IsActive();
 };
\ No newline at end of file
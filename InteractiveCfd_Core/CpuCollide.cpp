@@ -0,0 +1,94 @@
+#include "CpuCollide.h"
+#include "CpuCollideRow.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+CollideRowFunction GetCollideRowScalar(const CollisionModel model)
+{
+    return SelectCollideRow<float>(model);
+}
+
+void CpuId(int info[4], const int leaf, const int subLeaf)
+{
+#ifdef _MSC_VER
+    __cpuidex(info, leaf, subLeaf);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, subLeaf, a, b, c, d);
+    info[0] = a;
+    info[1] = b;
+    info[2] = c;
+    info[3] = d;
+#endif
+}
+
+// ! Register state the OS saves on context switches (XCR0)
+unsigned long long GetEnabledXStateFeatures()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+SimdIsa ProbeSimdIsa()
+{
+    int info[4];
+    CpuId(info, 0, 0);
+    if (info[0] < 7)
+        return SIMD_SCALAR;
+
+    CpuId(info, 1, 0);
+    const bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+    const bool hasAvx = (info[2] & (1 << 28)) != 0;
+    const bool hasFma = (info[2] & (1 << 12)) != 0;
+    if (!hasOsxsave || !hasAvx || !hasFma)
+        return SIMD_SCALAR;
+    const unsigned long long xState = GetEnabledXStateFeatures();
+    if ((xState & 0x6) != 0x6)
+        return SIMD_SCALAR;
+
+    CpuId(info, 7, 0);
+    const bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+    const bool hasAvx512f = (info[1] & (1 << 16)) != 0;
+    if (hasAvx512f && (xState & 0xe6) == 0xe6 && IsAvx512Compiled())
+        return SIMD_AVX512;
+    if (hasAvx2 && IsAvx2Compiled())
+        return SIMD_AVX2;
+    return SIMD_SCALAR;
+}
+
+// ! Widest kernel this CPU and binary support. cpuid is slow and serializing, so the CPU is only
+// ! probed on the first call, which CpuLbm's constructor makes before any solver thread runs.
+SimdIsa DetectSimdIsa()
+{
+    static const SimdIsa s_supportedIsa = ProbeSimdIsa();
+    return s_supportedIsa;
+}
+
+const char* GetSimdIsaName(const SimdIsa isa)
+{
+    if (isa == SIMD_AVX512)
+        return "AVX-512";
+    else if (isa == SIMD_AVX2)
+        return "AVX2";
+    return "scalar";
+}
+
+// ! Falls back to the widest kernel below the requested one that this CPU and binary support
+CollideRowFunction GetCollideRowFunction(const SimdIsa isa, const CollisionModel model)
+{
+    const SimdIsa supportedIsa = DetectSimdIsa();
+    const SimdIsa selectedIsa = isa < supportedIsa ? isa : supportedIsa;
+    if (selectedIsa == SIMD_AVX512)
+        return GetCollideRowAvx512(model);
+    else if (selectedIsa == SIMD_AVX2)
+        return GetCollideRowAvx2(model);
+    return GetCollideRowScalar(model);
+}
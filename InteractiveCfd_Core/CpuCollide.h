@@ -0,0 +1,21 @@
+#pragma once
+#include "CollisionModels.h"
+
+enum SimdIsa{SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+
+// ! Collides n x-adjacent nodes stored as 9 planes of length stride starting at rowF. Nodes whose
+// ! rowMask entry is 0 (walls that were already handled) are passed through unchanged.
+typedef void(*CollideRowFunction)(float* rowF, const float* rowMask, const int n,
+    const int stride, const float omega);
+
+// ! Row kernels of each instruction set, instantiated for every collision model
+CollideRowFunction GetCollideRowScalar(const CollisionModel model);
+CollideRowFunction GetCollideRowAvx2(const CollisionModel model);
+CollideRowFunction GetCollideRowAvx512(const CollisionModel model);
+
+bool IsAvx2Compiled();
+bool IsAvx512Compiled();
+
+SimdIsa DetectSimdIsa();
+const char* GetSimdIsaName(const SimdIsa isa);
+CollideRowFunction GetCollideRowFunction(const SimdIsa isa, const CollisionModel model);
@@ -0,0 +1,77 @@
+#include "CpuCollide.h"
+
+// ! Built with /arch:AVX2. Only called after DetectSimdIsa has confirmed AVX2 support.
+#ifdef __AVX2__
+#include "CpuCollideRow.h"
+#include <immintrin.h>
+
+struct Avx2Float
+{
+    __m256 v;
+    Avx2Float() {}
+    Avx2Float(const __m256 value) : v(value) {}
+    Avx2Float(const float value) : v(_mm256_set1_ps(value)) {}
+};
+
+inline Avx2Float operator+(const Avx2Float &a, const Avx2Float &b)
+{
+    return _mm256_add_ps(a.v, b.v);
+}
+
+inline Avx2Float operator-(const Avx2Float &a, const Avx2Float &b)
+{
+    return _mm256_sub_ps(a.v, b.v);
+}
+
+inline Avx2Float operator-(const Avx2Float &a)
+{
+    return _mm256_sub_ps(_mm256_setzero_ps(), a.v);
+}
+
+inline Avx2Float operator*(const Avx2Float &a, const Avx2Float &b)
+{
+    return _mm256_mul_ps(a.v, b.v);
+}
+
+inline Avx2Float operator/(const Avx2Float &a, const Avx2Float &b)
+{
+    return _mm256_div_ps(a.v, b.v);
+}
+
+inline Avx2Float SimdSqrt(const Avx2Float &a)
+{
+    return _mm256_sqrt_ps(a.v);
+}
+
+template <>
+struct SimdTraits<Avx2Float>
+{
+    static const int width = 8;
+    static Avx2Float Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, const Avx2Float &value) { _mm256_storeu_ps(p, value.v); }
+    static Avx2Float Select(const Avx2Float &mask, const Avx2Float &a, const Avx2Float &b)
+    {
+        return _mm256_blendv_ps(b.v, a.v, _mm256_cmp_ps(mask.v, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+    }
+};
+
+CollideRowFunction GetCollideRowAvx2(const CollisionModel model)
+{
+    return SelectCollideRow<Avx2Float>(model);
+}
+
+bool IsAvx2Compiled()
+{
+    return true;
+}
+#else
+CollideRowFunction GetCollideRowAvx2(const CollisionModel model)
+{
+    return GetCollideRowScalar(model);
+}
+
+bool IsAvx2Compiled()
+{
+    return false;
+}
+#endif
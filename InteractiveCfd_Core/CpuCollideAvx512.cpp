@@ -0,0 +1,79 @@
+#include "CpuCollide.h"
+
+// ! Built with /arch:AVX512. Toolsets without AVX-512 support leave __AVX512F__ undefined and
+// ! this kernel falls back to the AVX2 one.
+#ifdef __AVX512F__
+#include "CpuCollideRow.h"
+#include <immintrin.h>
+
+struct Avx512Float
+{
+    __m512 v;
+    Avx512Float() {}
+    Avx512Float(const __m512 value) : v(value) {}
+    Avx512Float(const float value) : v(_mm512_set1_ps(value)) {}
+};
+
+inline Avx512Float operator+(const Avx512Float &a, const Avx512Float &b)
+{
+    return _mm512_add_ps(a.v, b.v);
+}
+
+inline Avx512Float operator-(const Avx512Float &a, const Avx512Float &b)
+{
+    return _mm512_sub_ps(a.v, b.v);
+}
+
+inline Avx512Float operator-(const Avx512Float &a)
+{
+    return _mm512_sub_ps(_mm512_setzero_ps(), a.v);
+}
+
+inline Avx512Float operator*(const Avx512Float &a, const Avx512Float &b)
+{
+    return _mm512_mul_ps(a.v, b.v);
+}
+
+inline Avx512Float operator/(const Avx512Float &a, const Avx512Float &b)
+{
+    return _mm512_div_ps(a.v, b.v);
+}
+
+inline Avx512Float SimdSqrt(const Avx512Float &a)
+{
+    return _mm512_sqrt_ps(a.v);
+}
+
+template <>
+struct SimdTraits<Avx512Float>
+{
+    static const int width = 16;
+    static Avx512Float Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, const Avx512Float &value) { _mm512_storeu_ps(p, value.v); }
+    static Avx512Float Select(const Avx512Float &mask, const Avx512Float &a, const Avx512Float &b)
+    {
+        return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(mask.v, _mm512_setzero_ps(), _CMP_NEQ_OQ),
+            b.v, a.v);
+    }
+};
+
+CollideRowFunction GetCollideRowAvx512(const CollisionModel model)
+{
+    return SelectCollideRow<Avx512Float>(model);
+}
+
+bool IsAvx512Compiled()
+{
+    return true;
+}
+#else
+CollideRowFunction GetCollideRowAvx512(const CollisionModel model)
+{
+    return GetCollideRowAvx2(model);
+}
+
+bool IsAvx512Compiled()
+{
+    return false;
+}
+#endif
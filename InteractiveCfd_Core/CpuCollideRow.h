@@ -0,0 +1,76 @@
+#pragma once
+#include "CollisionModels.h"
+#include "CpuCollide.h"
+
+// ! Shared body of the CPU collide kernels. V is either float or one of the SIMD wrappers defined
+// ! in the per-ISA translation units, which provide arithmetic operators, SimdSqrt and a
+// ! SimdTraits specialization for loads, stores and masked selects. Collision is one of the
+// ! operators of CollisionModels.h, so every ISA and model pair gets its own row loop.
+
+template <typename V>
+struct SimdTraits;
+
+template <>
+struct SimdTraits<float>
+{
+    static const int width = 1;
+    static float Load(const float* p) { return *p; }
+    static void Store(float* p, const float value) { *p = value; }
+    static float Select(const float mask, const float a, const float b)
+    {
+        return mask != 0.f ? a : b;
+    }
+};
+
+// Collides width nodes starting at rowF[x], keeping the input where rowMask is 0
+template <typename V, typename Collision>
+inline void CollideNodes(float* rowF, const float* rowMask, const int x, const int stride,
+    const V &omega)
+{
+    V f[9];
+    V fIn[9];
+    for (int i = 0; i < 9; i++)
+    {
+        fIn[i] = SimdTraits<V>::Load(&rowF[x + i*stride]);
+        f[i] = fIn[i];
+    }
+    Collision::Collide(f, omega);
+    V mask = SimdTraits<V>::Load(&rowMask[x]);
+    for (int i = 0; i < 9; i++)
+    {
+        SimdTraits<V>::Store(&rowF[x + i*stride], SimdTraits<V>::Select(mask, f[i], fIn[i]));
+    }
+}
+
+template <typename V, typename Collision>
+void CollideRow(float* rowF, const float* rowMask, const int n, const int stride,
+    const float omega)
+{
+    const int width = SimdTraits<V>::width;
+    const V omegaV(omega);
+    int x = 0;
+    for (; x + width <= n; x += width)
+    {
+        CollideNodes<V, Collision>(rowF, rowMask, x, stride, omegaV);
+    }
+    for (; x < n; x++)
+    {
+        CollideNodes<float, Collision>(rowF, rowMask, x, stride, omega);
+    }
+}
+
+template <typename V>
+CollideRowFunction SelectCollideRow(const CollisionModel model)
+{
+    switch (model)
+    {
+    case COLLISION_BGK:
+        return CollideRow<V, BgkCollision>;
+    case COLLISION_TRT:
+        return CollideRow<V, TrtCollision>;
+    case COLLISION_MRT:
+        return CollideRow<V, MrtCollision>;
+    default:
+        return CollideRow<V, MrtSmagorinskyCollision>;
+    }
+}
@@ -0,0 +1,870 @@
+#include "CpuKernel.h"
+#include "LbmNode.h"
+#include "ObstructionGeometry.h"
+#include "CpuCollide.h"
+#include "LatticeStorage.h"
+#include "NodeLists.h"
+#include "ActiveTiles.h"
+#include "ThreadPool.h"
+#include "FieldWriter.h"
+#include "Graphics/CpuLbm.h"
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/*----------------------------------------------------------------------------------------
+ *	Host functions. These mirror the device kernels in kernel.cu one lattice row at a time.
+ */
+
+// ! One of the two distribution arrays of CpuLbm, either float or packed to 16 bits
+struct HostLattice
+{
+    float* f;
+    unsigned short* packed;
+    LatticeStorage format;
+};
+
+HostLattice GetLatticeA(CpuLbm* cpuLbm)
+{
+    HostLattice lattice = { cpuLbm->GetFA(), cpuLbm->GetPackedFA(), cpuLbm->GetLatticeStorage() };
+    return lattice;
+}
+
+HostLattice GetLatticeB(CpuLbm* cpuLbm)
+{
+    HostLattice lattice = { cpuLbm->GetFB(), cpuLbm->GetPackedFB(), cpuLbm->GetLatticeStorage() };
+    return lattice;
+}
+
+// ! Reads count distributions of direction i starting at node (x, y) into dst as float
+void LoadLatticeSpan(float* dst, const HostLattice &lattice, const int i, const int x,
+    const int y, const int count, Domain &simDomain)
+{
+    int n = f_mem(i, x, y, simDomain);
+    if (lattice.format == STORAGE_FP32)
+        std::memcpy(dst, &lattice.f[n], count*sizeof(float));
+    else
+        UnpackDistributions(dst, &lattice.packed[n], count, i, lattice.format);
+}
+
+// ! Writes count float distributions of direction i to the lattice starting at node (x, y)
+void StoreLatticeSpan(const HostLattice &lattice, const float* src, const int i, const int x,
+    const int y, const int count, Domain &simDomain)
+{
+    int n = f_mem(i, x, y, simDomain);
+    if (lattice.format == STORAGE_FP32)
+        std::memcpy(&lattice.f[n], src, count*sizeof(float));
+    else
+        PackDistributions(&lattice.packed[n], src, count, i, lattice.format);
+}
+
+// Lattice velocity and opposite direction of each distribution
+static const int cx[9] = { 0, 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int cy[9] = { 0, 0, 1, 0, -1, 1, 1, -1, -1 };
+static const int opposite[9] = { 0, 3, 4, 1, 2, 7, 8, 5, 6 };
+
+// Initialize one row using constant velocity. rowF holds the 9 planes of the row before they are
+// stored in the lattice. An in-place lattice is laid out as after an odd step, so the slots that
+// would receive from outside the domain hold the opposite distribution of their node.
+void InitializeLbmRow(const HostLattice &lattice, const float uMax, const int y,
+    const bool isInPlace, Domain &simDomain, float* rowF)
+{
+    int pitch = simDomain.GetMaxXDim();
+    int xDim = simDomain.GetXDim();
+    int yDim = simDomain.GetYDim();
+    for (int x = 0; x < pitch; x++)
+    {
+        LbmNode lbm;
+        lbm.SetMemoryLayout(pitch, 1);
+        lbm.Initialize(rowF, 1.f, uMax, 0.f);
+        lbm.WriteDistributions(rowF, x, 0);
+        if (!isInPlace || x >= xDim || y >= yDim)
+            continue;
+        for (int i = 1; i < 9; i++)
+        {
+            int xSource = x - cx[i];
+            int ySource = y - cy[i];
+            if (xSource < 0 || xSource >= xDim || ySource < 0 || ySource >= yDim)
+                rowF[x + i*pitch] = lbm.GetDistribution(opposite[i]);
+        }
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        StoreLatticeSpan(lattice, &rowF[i*pitch], i, 0, y, pitch, simDomain);
+    }
+}
+
+// Interior size of the tiles used for temporal blocking. Together with a halo of a few nodes and
+// the second buffer this keeps a tile within a typical per-core L2 cache
+static const int TEMPORAL_TILE_XDIM = 128;
+static const int TEMPORAL_TILE_YDIM = 64;
+
+// ! Block of the lattice held in one array: domain columns [x0, x0 + xCount) and rows
+// ! [y0, y0 + yCount), stored as 9 planes with the given pitch and number of rows. The lattice of
+// ! CpuLbm is the window at the origin covering the domain.
+struct LatticeWindow
+{
+    int x0, y0;
+    int xCount, yCount;
+    int pitch, planeRows;
+};
+
+LatticeWindow GetDomainWindow(Domain &simDomain)
+{
+    LatticeWindow window;
+    window.x0 = 0;
+    window.y0 = 0;
+    window.xCount = simDomain.GetXDim();
+    window.yCount = simDomain.GetYDim();
+    window.pitch = simDomain.GetMaxXDim();
+    window.planeRows = simDomain.GetMaxYDim();
+    return window;
+}
+
+// ! How a row reads its incoming distributions: pulled from the upstream neighbors of a second
+// ! lattice, or one of the two steps of the in-place AA pattern, see LbmNode
+enum RowStep{PULL_STEP, EVEN_STEP, ODD_STEP};
+
+void ReadNode(LbmNode &lbm, float* f, const RowStep step, const int x, const int y)
+{
+    if (step == PULL_STEP)
+        lbm.ReadIncomingDistributions(f, x, y);
+    else if (step == EVEN_STEP)
+        lbm.ReadDistributions(f, x, y);
+    else
+        lbm.ReadOddStepDistributions(f, x, y);
+}
+
+// ! Stages the boundary nodes of one type within [xBegin, xEnd) of row y. Each node is read with
+// ! the edge clamping of LbmNode and gets the boundary condition of Type. Walls are finished here
+// ! and masked out of the collide.
+template <int Type>
+void StageBoundaryNodes(float* f, const LatticeWindow &window, const RowStep step,
+    int *obstIdMap, Obstruction *obstructions, const float uMax, const int y, const int xBegin,
+    const int xEnd, const std::vector<int> &nodes, Domain &simDomain, float* rowBuffer)
+{
+    int xDim = simDomain.GetXDim();
+    int yDim = simDomain.GetYDim();
+    int pitch = simDomain.GetMaxXDim();
+    float* rowMask = &rowBuffer[9 * pitch];
+    std::vector<int>::const_iterator node = std::lower_bound(nodes.begin(), nodes.end(), xBegin);
+    for (; node != nodes.end() && *node < xEnd; ++node)
+    {
+        int x = *node;
+        int n = x - xBegin;
+        LbmNode lbm;
+        lbm.SetXDim(window.xCount);
+        lbm.SetYDim(window.yCount);
+        lbm.SetMemoryLayout(window.pitch, window.planeRows);
+        ReadNode(lbm, f, step, x - window.x0, y - window.y0);
+        bool isOpen = ApplyBoundaryCondition<Type>(lbm, x + y*pitch, y, xDim, yDim, uMax,
+            obstIdMap, obstructions);
+        rowMask[n] = isOpen ? 1.f : 0.f;
+        for (int i = 0; i < 9; i++)
+        {
+            rowBuffer[n + i*pitch] = lbm.GetDistribution(i);
+        }
+    }
+}
+
+// ! Fills the row buffer with the incoming distributions of nodes [xBegin, xEnd) of row y after the
+// ! boundary conditions. The buffer holds the 9 distributions of the row as planes of length
+// ! maxXDim followed by the collide mask. Fluid runs are streamed as whole spans with one copy per
+// ! plane, without clamping or branches, and each boundary type is staged by its own loop.
+void StageLbmRow(float* f, const LatticeWindow &window, const RowStep step, int *obstIdMap,
+    Obstruction *obstructions, const float uMax, const int y, const int xBegin, const int xEnd,
+    const RowNodes &rowNodes, Domain &simDomain, float* rowBuffer)
+{
+    int stride = simDomain.GetMaxXDim();
+    float* rowMask = &rowBuffer[9 * stride];
+    const std::vector<int> &runs = rowNodes.fluidRuns;
+    for (size_t n = 0; n < runs.size(); n += 2)
+    {
+        int runBegin = std::max(runs[n], xBegin);
+        int runEnd = std::min(runs[n + 1], xEnd);
+        if (runBegin >= runEnd)
+            continue;
+        int count = runEnd - runBegin;
+        for (int i = 0; i < 9; i++)
+        {
+            int plane = step == ODD_STEP ? opposite[i] : i;
+            int dx = step == EVEN_STEP ? 0 : cx[i];
+            int dy = step == EVEN_STEP ? 0 : cy[i];
+            std::memcpy(&rowBuffer[runBegin - xBegin + i*stride],
+                &f[f_mem(plane, runBegin - window.x0 - dx, y - window.y0 - dy, window.pitch,
+                window.planeRows)], count*sizeof(float));
+        }
+        std::fill(&rowMask[runBegin - xBegin], &rowMask[runEnd - xBegin], 1.f);
+    }
+
+    const std::vector<int>* nodes = rowNodes.boundaryNodes;
+    StageBoundaryNodes<BOUNDARY_BOUNCE_BACK>(f, window, step, obstIdMap, obstructions, uMax, y,
+        xBegin, xEnd, nodes[BOUNDARY_BOUNCE_BACK], simDomain, rowBuffer);
+    StageBoundaryNodes<BOUNDARY_MOVING_WALL>(f, window, step, obstIdMap, obstructions, uMax, y,
+        xBegin, xEnd, nodes[BOUNDARY_MOVING_WALL], simDomain, rowBuffer);
+    StageBoundaryNodes<BOUNDARY_INLET>(f, window, step, obstIdMap, obstructions, uMax, y,
+        xBegin, xEnd, nodes[BOUNDARY_INLET], simDomain, rowBuffer);
+    StageBoundaryNodes<BOUNDARY_OUTLET>(f, window, step, obstIdMap, obstructions, uMax, y,
+        xBegin, xEnd, nodes[BOUNDARY_OUTLET], simDomain, rowBuffer);
+    StageBoundaryNodes<BOUNDARY_SYMMETRY_TOP>(f, window, step, obstIdMap, obstructions, uMax, y,
+        xBegin, xEnd, nodes[BOUNDARY_SYMMETRY_TOP], simDomain, rowBuffer);
+    StageBoundaryNodes<BOUNDARY_SYMMETRY_BOTTOM>(f, window, step, obstIdMap, obstructions, uMax,
+        y, xBegin, xEnd, nodes[BOUNDARY_SYMMETRY_BOTTOM], simDomain, rowBuffer);
+}
+
+// ! Advances the active nodes within [xBegin, xEnd) of row y from fA to fB, both laid out as
+// ! window. Each span of active tiles is staged into the row buffer, then the collide is vectorized
+// ! across the span before it is written to fB.
+void MarchLbmRow(float* fA, float* fB, const LatticeWindow &window, const float omega,
+    int *obstIdMap, Obstruction *obstructions, const float uMax, const int y, const int xBegin,
+    const int xEnd, const NodeLists &nodeLists, const ActiveTiles &activeTiles,
+    Domain &simDomain, float* rowBuffer, CollideRowFunction collideRow)
+{
+    int stride = simDomain.GetMaxXDim();
+    const std::vector<int> &spans = activeTiles.GetRowSpans(y);
+    for (size_t n = 0; n < spans.size(); n += 2)
+    {
+        int spanBegin = std::max(spans[n], xBegin);
+        int spanEnd = std::min(spans[n + 1], xEnd);
+        if (spanBegin >= spanEnd)
+            continue;
+        StageLbmRow(fA, window, PULL_STEP, obstIdMap, obstructions, uMax, y, spanBegin, spanEnd,
+            nodeLists.GetRow(y), simDomain, rowBuffer);
+
+        int count = spanEnd - spanBegin;
+        collideRow(rowBuffer, &rowBuffer[9 * stride], count, stride, omega);
+
+        for (int i = 0; i < 9; i++)
+        {
+            std::memcpy(&fB[f_mem(i, spanBegin - window.x0, y - window.y0, window.pitch,
+                window.planeRows)], &rowBuffer[i*stride], count*sizeof(float));
+        }
+    }
+}
+
+// ! True if any of the active tiles overlaps rect
+bool HasActiveTiles(const ActiveTiles &activeTiles, const RectInt &rect)
+{
+    int tileXEnd = (rect.m_x + rect.m_w + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    int tileYEnd = (rect.m_y + rect.m_h + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    for (int tileY = rect.m_y / ACTIVE_TILE_SIZE; tileY < tileYEnd; tileY++)
+    {
+        for (int tileX = rect.m_x / ACTIVE_TILE_SIZE; tileX < tileXEnd; tileX++)
+        {
+            if (activeTiles.IsActive(tileX, tileY))
+                return true;
+        }
+    }
+    return false;
+}
+
+// ! Temporal blocking: advances the nodes of one tile by depth steps from fA and writes them to
+// ! fB. The tile is copied into tileA with a halo of depth nodes, and each step is computed on a
+// ! region one node smaller per side than the last, so after depth steps the tile itself is exact
+// ! without touching the neighbouring tiles. The halo is recomputed by every tile that overlaps it,
+// ! which costs a few extra collides but keeps the working set in cache across all depth steps.
+// ! Tiles without any active tiles are left as they are, since nothing they hold is ever read.
+void MarchLbmTile(const HostLattice &fA, const HostLattice &fB, const RectInt &tile, const int depth, const float omega,
+    int *obstIdMap, Obstruction *obstructions, const float uMax, const NodeLists &nodeLists,
+    const ActiveTiles &activeTiles, Domain &simDomain, float* tileA, float* tileB, const int tilePitch, const int tileRows, float* rowBuffer,
+    CollideRowFunction collideRow)
+{
+    int xDim = simDomain.GetXDim();
+    int yDim = simDomain.GetYDim();
+    int xEnd = tile.m_x + tile.m_w;
+    int yEnd = tile.m_y + tile.m_h;
+    if (!HasActiveTiles(activeTiles, tile))
+        return;
+    LatticeWindow window;
+    window.x0 = std::max(tile.m_x - depth, 0);
+    window.y0 = std::max(tile.m_y - depth, 0);
+    window.xCount = std::min(xEnd + depth, xDim) - window.x0;
+    window.yCount = std::min(yEnd + depth, yDim) - window.y0;
+    window.pitch = tilePitch;
+    window.planeRows = tileRows;
+
+    for (int i = 0; i < 9; i++)
+    {
+        for (int y = 0; y < window.yCount; y++)
+        {
+            LoadLatticeSpan(&tileA[f_mem(i, 0, y, tilePitch, tileRows)], fA, i, window.x0,
+                window.y0 + y, window.xCount, simDomain);
+        }
+    }
+
+    for (int step = 1; step <= depth; step++)
+    {
+        float* src = step % 2 == 1 ? tileA : tileB;
+        float* dst = step % 2 == 1 ? tileB : tileA;
+        int halo = depth - step;
+        int xBegin = std::max(tile.m_x - halo, 0);
+        int xStop = std::min(xEnd + halo, xDim);
+        int yStop = std::min(yEnd + halo, yDim);
+        for (int y = std::max(tile.m_y - halo, 0); y < yStop; y++)
+        {
+            MarchLbmRow(src, dst, window, omega, obstIdMap, obstructions, uMax, y, xBegin,
+                xStop, nodeLists, activeTiles, simDomain, rowBuffer, collideRow);
+        }
+    }
+
+    // a pass is a whole number of step pairs, so the result is back in tileA
+    for (int i = 0; i < 9; i++)
+    {
+        for (int y = tile.m_y; y < yEnd; y++)
+        {
+            StoreLatticeSpan(fB,
+                &tileA[f_mem(i, tile.m_x - window.x0, y - window.y0, tilePitch, tileRows)],
+                i, tile.m_x, y, tile.m_w, simDomain);
+        }
+    }
+}
+
+// ! AA pattern counterpart of MarchLbmRow on a single lattice, see
+// ! LbmNode::WriteEvenStepDistributions. Even steps write each plane back to the opposite plane of
+// ! the same row. Odd steps write each plane shifted by its lattice velocity, and what would leave
+// ! the domain to the opposite plane of its own node, as LbmNode::WriteOddStepDistributions does.
+// ! Each slot belongs to one node within a step, so rows can run concurrently.
+void MarchLbmRowInPlace(float* f, const bool isEvenStep, const float omega, int *obstIdMap,
+    Obstruction *obstructions, const float uMax, const int y, const NodeLists &nodeLists,
+    const ActiveTiles &activeTiles, Domain &simDomain, float* rowBuffer,
+    CollideRowFunction collideRow)
+{
+    int xDim = simDomain.GetXDim();
+    int yDim = simDomain.GetYDim();
+    int pitch = simDomain.GetMaxXDim();
+    const std::vector<int> &spans = activeTiles.GetRowSpans(y);
+    for (size_t n = 0; n < spans.size(); n += 2)
+    {
+        int spanBegin = spans[n];
+        int count = spans[n + 1] - spanBegin;
+        StageLbmRow(f, GetDomainWindow(simDomain), isEvenStep ? EVEN_STEP : ODD_STEP, obstIdMap,
+            obstructions, uMax, y, spanBegin, spanBegin + count, nodeLists.GetRow(y), simDomain,
+            rowBuffer);
+
+        collideRow(rowBuffer, &rowBuffer[9 * pitch], count, pitch, omega);
+
+        for (int i = 0; i < 9; i++)
+        {
+            if (isEvenStep)
+            {
+                std::memcpy(&f[f_mem(opposite[i], spanBegin, y, simDomain)], &rowBuffer[i*pitch],
+                    count*sizeof(float));
+                continue;
+            }
+            int yDest = y + cy[i];
+            if (yDest < 0 || yDest >= yDim)
+            {
+                std::memcpy(&f[f_mem(opposite[i], spanBegin, y, simDomain)], &rowBuffer[i*pitch],
+                    count*sizeof(float));
+                continue;
+            }
+            int xStart = std::max(spanBegin + cx[i], 0);
+            int xStop = std::min(spanBegin + count + cx[i], xDim);
+            std::memcpy(&f[f_mem(i, xStart, yDest, simDomain)],
+                &rowBuffer[xStart - cx[i] - spanBegin + i*pitch], (xStop - xStart)*sizeof(float));
+            if (spanBegin + cx[i] < 0)
+                f[f_mem(opposite[i], spanBegin, y, simDomain)] = rowBuffer[i*pitch];
+            if (spanBegin + count + cx[i] > xDim)
+            {
+                f[f_mem(opposite[i], spanBegin + count - 1, y, simDomain)] =
+                    rowBuffer[count - 1 + i*pitch];
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------------------
+ * End of host functions
+ */
+
+void InitializeDomain(CpuLbm* cpuLbm)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    HostLattice lattice = GetLatticeA(cpuLbm);
+    float u = cpuLbm->GetInletVelocity();
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    int numThreads = threadPool->GetThreadCount();
+    int pitch = simDomain->GetMaxXDim();
+    int yDim = simDomain->GetMaxYDim();
+    bool isInPlace = cpuLbm->GetStreamingMode() == StreamingMode::IN_PLACE;
+    std::vector<float> rowBuffers(numThreads * 9 * pitch, 0.f);
+
+    threadPool->ParallelFor(0, yDim, threadPool->GetBandSize(yDim),
+        [&](const int yBegin, const int yEnd, const int thread)
+    {
+        float* rowF = &rowBuffers[thread * 9 * pitch];
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            InitializeLbmRow(lattice, u, y, isInPlace, *simDomain, rowF);
+        }
+    });
+}
+
+// ! Tiles that are stepped again after being skipped as walls still hold whatever they had when
+// ! they were dropped, so they are reset to fluid at rest before the next step. An in-place lattice
+// ! gets the rest state the way an odd step writes it, so the neighbors of a tile pull it from
+// ! their own slots just as the two-buffer neighbours pull it from the tile.
+void InitializeActivatedTiles(CpuLbm* cpuLbm)
+{
+    ActiveTiles* activeTiles = cpuLbm->GetActiveTiles();
+    const std::vector<int> &tiles = activeTiles->GetActivatedTiles();
+    if (tiles.empty())
+        return;
+    Domain* simDomain = cpuLbm->GetDomain();
+    if (cpuLbm->GetStreamingMode() == StreamingMode::IN_PLACE)
+    {
+        for (size_t n = 0; n < tiles.size(); n++)
+        {
+            int x0 = tiles[n] % activeTiles->GetTilesX() * ACTIVE_TILE_SIZE;
+            int y0 = tiles[n] / activeTiles->GetTilesX() * ACTIVE_TILE_SIZE;
+            int xEnd = std::min(x0 + ACTIVE_TILE_SIZE, simDomain->GetXDim());
+            int yEnd = std::min(y0 + ACTIVE_TILE_SIZE, simDomain->GetYDim());
+            for (int y = y0; y < yEnd; y++)
+            {
+                for (int x = x0; x < xEnd; x++)
+                {
+                    LbmNode lbm;
+                    lbm.SetXDim(simDomain->GetXDim());
+                    lbm.SetYDim(simDomain->GetYDim());
+                    lbm.SetMemoryLayout(*simDomain);
+                    lbm.Initialize(cpuLbm->GetFA(), 1.f, 0.f, 0.f);
+                    lbm.WriteOddStepDistributions(cpuLbm->GetFA(), x, y);
+                }
+            }
+        }
+        activeTiles->ClearActivatedTiles();
+        return;
+    }
+    HostLattice lattice = GetLatticeA(cpuLbm);
+    float rowF[9 * ACTIVE_TILE_SIZE];
+    for (int x = 0; x < ACTIVE_TILE_SIZE; x++)
+    {
+        LbmNode lbm;
+        lbm.SetMemoryLayout(ACTIVE_TILE_SIZE, 1);
+        lbm.Initialize(rowF, 1.f, 0.f, 0.f);
+        lbm.WriteDistributions(rowF, x, 0);
+    }
+    for (size_t n = 0; n < tiles.size(); n++)
+    {
+        int x0 = tiles[n] % activeTiles->GetTilesX() * ACTIVE_TILE_SIZE;
+        int y0 = tiles[n] / activeTiles->GetTilesX() * ACTIVE_TILE_SIZE;
+        int count = std::min(ACTIVE_TILE_SIZE, simDomain->GetMaxXDim() - x0);
+        int yEnd = std::min(y0 + ACTIVE_TILE_SIZE, simDomain->GetMaxYDim());
+        for (int y = y0; y < yEnd; y++)
+        {
+            for (int i = 0; i < 9; i++)
+            {
+                StoreLatticeSpan(lattice, &rowF[i*ACTIVE_TILE_SIZE], i, x0, y, count, *simDomain);
+            }
+        }
+    }
+    activeTiles->ClearActivatedTiles();
+}
+
+// ! Reads the distributions of node (x, y) of the current solution into lbm whatever the storage
+// ! format and streaming mode of the lattice
+void ReadNodeDistributions(CpuLbm* cpuLbm, LbmNode &lbm, const int x, const int y)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    if (cpuLbm->GetStreamingMode() == StreamingMode::IN_PLACE)
+    {
+        lbm.SetXDim(simDomain->GetXDim());
+        lbm.SetYDim(simDomain->GetYDim());
+        lbm.SetMemoryLayout(*simDomain);
+        lbm.ReadInPlaceDistributions(cpuLbm->GetFA(), x, y);
+        return;
+    }
+    HostLattice lattice = GetLatticeA(cpuLbm);
+    float f[9];
+    for (int i = 0; i < 9; i++)
+    {
+        LoadLatticeSpan(&f[i], lattice, i, x, y, 1, *simDomain);
+    }
+    lbm.SetMemoryLayout(1, 1);
+    lbm.ReadDistributions(f, 0, 0);
+}
+
+// ! Row counterpart of ReadNodeDistributions: loads the distributions of the current solution in
+// ! row y of the domain into the 9 planes of rowF, each GetXDim() long. In-place lattices are
+// ! gathered plane by plane the way LbmNode::ReadInPlaceDistributions reads a node.
+void LoadSolutionRow(CpuLbm* cpuLbm, float* rowF, const int y)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    int xDim = simDomain->GetXDim();
+    int yDim = simDomain->GetYDim();
+    if (cpuLbm->GetStreamingMode() != StreamingMode::IN_PLACE)
+    {
+        HostLattice lattice = GetLatticeA(cpuLbm);
+        for (int i = 0; i < 9; i++)
+        {
+            LoadLatticeSpan(&rowF[i*xDim], lattice, i, 0, y, xDim, *simDomain);
+        }
+        return;
+    }
+    float* f = cpuLbm->GetFA();
+    for (int i = 0; i < 9; i++)
+    {
+        int ySource = y + cy[i];
+        if (ySource < 0 || ySource >= yDim)
+        {
+            std::memcpy(&rowF[i*xDim], &f[f_mem(opposite[i], 0, y, *simDomain)],
+                xDim*sizeof(float));
+            continue;
+        }
+        int xBegin = std::max(-cx[i], 0);
+        int xEnd = std::min(xDim - cx[i], xDim);
+        std::memcpy(&rowF[xBegin + i*xDim], &f[f_mem(i, xBegin + cx[i], ySource, *simDomain)],
+            (xEnd - xBegin)*sizeof(float));
+        if (xBegin > 0)
+            rowF[i*xDim] = f[f_mem(opposite[i], 0, y, *simDomain)];
+        if (xEnd < xDim)
+            rowF[xDim - 1 + i*xDim] = f[f_mem(opposite[i], xDim - 1, y, *simDomain)];
+    }
+}
+
+void SetObstructionVelocitiesToZero(CpuLbm* cpuLbm, const float scaleFactor)
+{
+    ObstructionStore* obstructions = cpuLbm->GetHostObst();
+    Obstruction* obst_h = obstructions->GetData();
+    for (int i = 0; i < obstructions->GetCount(); i++)
+    {
+        if ((fabs(obst_h[i].u) > 0.f || fabs(obst_h[i].v) > 0.f) &&
+            obst_h[i].state != State::REMOVED && obst_h[i].state != State::INACTIVE)
+        {
+            Obstruction newObst = obst_h[i];
+            newObst.u = 0.f;
+            newObst.v = 0.f;
+            UpdateSolverObstructions(cpuLbm, obstructions->GetId(i), newObst, scaleFactor);
+        }
+    }
+}
+
+// ! Temporal blocking counterpart of the two-buffer sweeps in MarchSolutionInRows. Each pass
+// ! every tile by up to depth steps from fA into fB, after which the two lattices are swapped so the
+// ! latest solution is in fA again. Packed lattices are always stepped here, at least a pair of
+// ! steps per pass, so each tile is unpacked and packed once per pass.
+void MarchSolutionInTiles(CpuLbm* cpuLbm, CollideRowFunction collideRow,
+    ThreadPool* threadPool)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    int xDim = simDomain->GetXDim();
+    int yDim = simDomain->GetYDim();
+    int tStep = cpuLbm->GetTimeStepsPerFrame();
+    int depth = std::max(cpuLbm->GetTemporalBlockingDepth(), 2);
+    const NodeLists &nodeLists = *cpuLbm->GetNodeLists();
+    const ActiveTiles &activeTiles = *cpuLbm->GetActiveTiles();
+    int* obstIdMap = cpuLbm->GetObstIdMap();
+    Obstruction* obst = cpuLbm->GetSolverObst()->GetData();
+    float u = cpuLbm->GetInletVelocity();
+    float omega = cpuLbm->GetOmega();
+
+    int tilesX = (xDim + TEMPORAL_TILE_XDIM - 1) / TEMPORAL_TILE_XDIM;
+    int tilesY = (yDim + TEMPORAL_TILE_YDIM - 1) / TEMPORAL_TILE_YDIM;
+    int tilePitch = TEMPORAL_TILE_XDIM + 2 * depth;
+    int tileRows = TEMPORAL_TILE_YDIM + 2 * depth;
+    int tileSize = 9 * tilePitch * tileRows;
+    int numThreads = threadPool->GetThreadCount();
+    int pitch = simDomain->GetMaxXDim();
+    std::vector<float> rowBuffers(numThreads * 10 * pitch, 0.f);
+    std::vector<float> tileBuffers(numThreads * 2 * tileSize, 0.f);
+
+    // steps are taken in pairs, like the untiled sweeps
+    for (int i = 0; i < tStep; i += depth / 2)
+    {
+        if (cpuLbm->IsPaused())
+            return;
+        int passDepth = 2 * std::min(depth / 2, tStep - i);
+        HostLattice fA = GetLatticeA(cpuLbm);
+        HostLattice fB = GetLatticeB(cpuLbm);
+        // tiles are already large, so each one is a band of its own
+        threadPool->ParallelFor(0, tilesX*tilesY, 1,
+            [&](const int nBegin, const int nEnd, const int thread)
+        {
+            float* rowBuffer = &rowBuffers[thread * 10 * pitch];
+            float* tileA = &tileBuffers[thread * 2 * tileSize];
+            float* tileB = tileA + tileSize;
+            for (int n = nBegin; n < nEnd; n++)
+            {
+                int x = (n % tilesX) * TEMPORAL_TILE_XDIM;
+                int y = (n / tilesX) * TEMPORAL_TILE_YDIM;
+                RectInt tile(x, y, std::min(TEMPORAL_TILE_XDIM, xDim - x),
+                    std::min(TEMPORAL_TILE_YDIM, yDim - y));
+                MarchLbmTile(fA, fB, tile, passDepth, omega, obstIdMap, obst, u, nodeLists,
+                    activeTiles, *simDomain, tileA, tileB, tilePitch, tileRows, rowBuffer, collideRow);
+            }
+        });
+        cpuLbm->SwapLattices();
+    }
+}
+
+// ! Temporal blocking and packed lattices are only supported for two-buffer streaming, in-place
+// ! lattices are always stepped in rows
+static bool IsMarchedInTiles(CpuLbm* cpuLbm)
+{
+    return (cpuLbm->GetTemporalBlockingDepth() > 0 || cpuLbm->GetLatticeStorage() != STORAGE_FP32)
+        && cpuLbm->GetStreamingMode() == StreamingMode::TWO_BUFFER;
+}
+
+// ! Rows are independent within a time step, so each step is split across the thread pool in
+// ! bands of rows and each thread keeps its own row buffer for the vectorized collide.
+// ! The pause flag is checked before each pair of steps so the latest solution is always in fA,
+// ! which for IN_PLACE streaming is laid out as after an odd step, see ReadNodeDistributions.
+// ! Only the spans of active tiles in each row are stepped.
+void MarchSolutionInRows(CpuLbm* cpuLbm, CollideRowFunction collideRow,
+    ThreadPool* threadPool)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    int xDim = simDomain->GetXDim();
+    int yDim = simDomain->GetYDim();
+    int tStep = cpuLbm->GetTimeStepsPerFrame();
+    float* fA = cpuLbm->GetFA();
+    float* fB = cpuLbm->GetFB();
+    const NodeLists &nodeLists = *cpuLbm->GetNodeLists();
+    const ActiveTiles &activeTiles = *cpuLbm->GetActiveTiles();
+    int* obstIdMap = cpuLbm->GetObstIdMap();
+    Obstruction* obst = cpuLbm->GetSolverObst()->GetData();
+    float u = cpuLbm->GetInletVelocity();
+    float omega = cpuLbm->GetOmega();
+    LatticeWindow window = GetDomainWindow(*simDomain);
+    int pitch = simDomain->GetMaxXDim();
+    int numThreads = threadPool->GetThreadCount();
+    int bandSize = threadPool->GetBandSize(yDim);
+    std::vector<float> rowBuffers(numThreads * 10 * pitch, 0.f);
+
+    for (int i = 0; i < tStep; i++)
+    {
+        if (cpuLbm->IsPaused())
+            return;
+        if (cpuLbm->GetStreamingMode() == StreamingMode::IN_PLACE)
+        {
+            for (int pass = 0; pass < 2; pass++)
+            {
+                bool isEvenStep = pass == 0;
+                threadPool->ParallelFor(0, yDim, bandSize,
+                    [&](const int yBegin, const int yEnd, const int thread)
+                {
+                    float* rowBuffer = &rowBuffers[thread * 10 * pitch];
+                    for (int y = yBegin; y < yEnd; y++)
+                    {
+                        MarchLbmRowInPlace(fA, isEvenStep, omega, obstIdMap, obst, u, y,
+                            nodeLists, activeTiles, *simDomain, rowBuffer, collideRow);
+                    }
+                });
+            }
+        }
+        else
+        {
+            for (int pass = 0; pass < 2; pass++)
+            {
+                float* fSource = pass == 0 ? fA : fB;
+                float* fTarget = pass == 0 ? fB : fA;
+                threadPool->ParallelFor(0, yDim, bandSize,
+                    [&](const int yBegin, const int yEnd, const int thread)
+                {
+                    float* rowBuffer = &rowBuffers[thread * 10 * pitch];
+                    for (int y = yBegin; y < yEnd; y++)
+                    {
+                        MarchLbmRow(fSource, fTarget, window, omega, obstIdMap, obst, u, y, 0,
+                            xDim, nodeLists, activeTiles, *simDomain, rowBuffer, collideRow);
+                    }
+                });
+            }
+        }
+    }
+}
+
+// ! Host counterpart of SampleResidual and FinishResidualSample in kernel.cu. Each thread sums its
+// ! bands of rows in double precision, and the partial sums are added up in thread order.
+void SampleResidual(CpuLbm* cpuLbm)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    int xDim = simDomain->GetXDim();
+    int yDim = simDomain->GetYDim();
+    int pitch = simDomain->GetMaxXDim();
+    int planeSize = simDomain->GetPlaneSize();
+    int* im = cpuLbm->GetImage();
+    float* prev = cpuLbm->GetResidualPrev();
+    std::vector<double> partials(threadPool->GetThreadCount() * 4, 0.0);
+
+    threadPool->ParallelFor(0, yDim, threadPool->GetBandSize(yDim),
+        [&](const int yBegin, const int yEnd, const int thread)
+    {
+        double* sums = &partials[thread * 4];
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            for (int x = 0; x < xDim; x++)
+            {
+                int j = x + y*pitch;
+                if (im[j] == 1 || im[j] == 10 || im[j] == 20)
+                    continue;
+                LbmNode lbm;
+                ReadNodeDistributions(cpuLbm, lbm, x, y);
+                float rho = lbm.ComputeRho();
+                float u = lbm.ComputeU();
+                float v = lbm.ComputeV();
+                float du = u - prev[j + planeSize];
+                float dv = v - prev[j + 2 * planeSize];
+                float drho = rho - prev[j];
+                sums[0] += du*du + dv*dv;
+                sums[1] += u*u + v*v;
+                sums[2] += drho*drho;
+                sums[3] += 1.0;
+                prev[j] = rho;
+                prev[j + planeSize] = u;
+                prev[j + 2 * planeSize] = v;
+            }
+        }
+    });
+
+    double total[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (int thread = 0; thread < threadPool->GetThreadCount(); thread++)
+    {
+        for (int n = 0; n < 4; n++)
+        {
+            total[n] += partials[thread * 4 + n];
+        }
+    }
+    ResidualSums sums;
+    sums.velocityChange = static_cast<float>(total[0]);
+    sums.velocity = static_cast<float>(total[1]);
+    sums.densityChange = static_cast<float>(total[2]);
+    sums.nodes = static_cast<float>(total[3]);
+    cpuLbm->GetResidualMonitor()->AddSample(sums);
+}
+
+// ! Fills the buffers of frame with the macro fields of the current solution. Each thread loads
+// ! the 9 planes of a row of its band at once into its own row buffer with LoadSolutionRow.
+// ! Walls and obstruction interiors have no flow and are written as NaN, which post-processors
+// ! leave blank.
+void WriteFieldFrame(CpuLbm* cpuLbm, FieldFrame* frame)
+{
+    Domain* simDomain = cpuLbm->GetDomain();
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    int rowLength = simDomain->GetXDim();
+    int xDim = std::min(frame->xDim, rowLength);
+    int yDim = std::min(frame->yDim, simDomain->GetYDim());
+    int pitch = simDomain->GetMaxXDim();
+    int* im = cpuLbm->GetImage();
+    const float noFlow = std::numeric_limits<float>::quiet_NaN();
+    std::vector<std::vector<float> > rowBuffers(threadPool->GetThreadCount(),
+        std::vector<float>(9 * rowLength));
+
+    threadPool->ParallelFor(0, yDim, threadPool->GetBandSize(yDim),
+        [&](const int yBegin, const int yEnd, const int thread)
+    {
+        float* rowF = &rowBuffers[thread][0];
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            LoadSolutionRow(cpuLbm, rowF, y);
+            for (int x = 0; x < xDim; x++)
+            {
+                int j = x + y*pitch;
+                float values[FIELD_VARIABLE_COUNT] = { noFlow, noFlow, noFlow, noFlow };
+                if (im[j] != 1 && im[j] != 10 && im[j] != 20)
+                {
+                    LbmNode lbm;
+                    lbm.SetMemoryLayout(rowLength, 1);
+                    lbm.ReadDistributions(rowF, x, 0);
+                    values[0] = lbm.ComputeRho();
+                    values[1] = lbm.ComputeU();
+                    values[2] = lbm.ComputeV();
+                    if (frame->fields[3] != NULL)
+                        values[3] = lbm.ComputeStrainRateMagnitude();
+                }
+                for (int i = 0; i < FIELD_VARIABLE_COUNT; i++)
+                {
+                    if (frame->fields[i] != NULL)
+                        frame->fields[i][x + y*frame->xDim] = values[i];
+                }
+            }
+        }
+    });
+}
+
+// ! Once the residual monitor finds the flow steady, only the node image is kept up to date, and
+// ! stepping resumes when an input change resets the monitor. A residual sample that is due is
+// ! taken right after the steps, as long as the batch was not cut short by a pause.
+void MarchSolution(CpuLbm* cpuLbm)
+{
+    cpuLbm->UpdateHostImage();
+    InitializeActivatedTiles(cpuLbm);
+    ResidualMonitor* residualMonitor = cpuLbm->GetResidualMonitor();
+    if (residualMonitor->IsConverged())
+        return;
+    ThreadPool* threadPool = cpuLbm->GetThreadPool();
+    CollideRowFunction collideRow = GetCollideRowFunction(cpuLbm->GetSimdIsa(),
+        cpuLbm->GetCollisionModel());
+    if (IsMarchedInTiles(cpuLbm))
+    {
+        MarchSolutionInTiles(cpuLbm, collideRow, threadPool);
+    }
+    else
+    {
+        MarchSolutionInRows(cpuLbm, collideRow, threadPool);
+    }
+    if (cpuLbm->IsPaused())
+        return;
+    residualMonitor->AddSteps(2 * cpuLbm->GetTimeStepsPerFrame());
+    if (residualMonitor->BeginSample())
+        SampleResidual(cpuLbm);
+}
+
+// ! Bytes of distributions one node update moves through memory, for estimating the bandwidth a
+// ! run achieves. Row sweeps read and write all 9 distributions of every node each step. A tile
+// ! pass reads its tile together with the halo and writes the tile back once for all the steps of
+// ! the pass, so its traffic per update falls with the depth.
+float GetBytesPerUpdate(CpuLbm* cpuLbm)
+{
+    float bytesPerNode = 9.f * GetBytesPerDistribution(cpuLbm->GetLatticeStorage());
+    if (!IsMarchedInTiles(cpuLbm))
+        return 2.f * bytesPerNode;
+    int depth = std::max(cpuLbm->GetTemporalBlockingDepth(), 2);
+    float tileNodes = static_cast<float>(TEMPORAL_TILE_XDIM * TEMPORAL_TILE_YDIM);
+    float haloNodes = static_cast<float>((TEMPORAL_TILE_XDIM + 2 * depth) *
+        (TEMPORAL_TILE_YDIM + 2 * depth));
+    return bytesPerNode * (haloNodes + tileNodes) / (tileNodes * depth);
+}
+
+// ! Same scaling as UpdateDeviceObstructions: host obstruction data is stored relative to the
+// ! max resolution and is scaled down to the current resolution for the solver copy. Only the
+// ! nodes under the old and new footprint are flagged for the next image rebuild.
+void UpdateSolverObstructions(CpuLbm* cpuLbm, const int targetObstID,
+    const Obstruction &newObst, const float scaleFactor)
+{
+    Obstruction scaledObst = newObst;
+    scaledObst.x /= scaleFactor;
+    scaledObst.y /= scaleFactor;
+    scaledObst.r1 /= scaleFactor;
+    scaledObst.r2 /= scaleFactor;
+    ObstructionStore* obst = cpuLbm->GetSolverObst();
+    Domain* simDomain = cpuLbm->GetDomain();
+    if (obst->Contains(targetObstID))
+    {
+        if (std::memcmp(&obst->Get(targetObstID), &scaledObst, sizeof(Obstruction)) == 0)
+            return;
+        simDomain->MarkImageDirty(GetObstructionBounds(obst->Get(targetObstID)));
+    }
+    simDomain->MarkImageDirty(GetObstructionBounds(scaledObst));
+    obst->Set(targetObstID, scaledObst);
+    cpuLbm->GetResidualMonitor()->Reset();
+}
+
+// ! Drops the obstruction from the solver copy. The entry moved into its slot keeps its nodes but
+// ! changes index, so its footprint is flagged too and the id map is rebuilt under it.
+void RemoveSolverObstruction(CpuLbm* cpuLbm, const int targetObstID)
+{
+    ObstructionStore* obst = cpuLbm->GetSolverObst();
+    if (!obst->Contains(targetObstID))
+        return;
+    Domain* simDomain = cpuLbm->GetDomain();
+    simDomain->MarkImageDirty(GetObstructionBounds(obst->Get(targetObstID)));
+    int movedIndex = obst->Remove(targetObstID);
+    if (movedIndex >= 0)
+    {
+        simDomain->MarkImageDirty(GetObstructionBounds(obst->GetData()[movedIndex]));
+    }
+    cpuLbm->GetResidualMonitor()->Reset();
+}
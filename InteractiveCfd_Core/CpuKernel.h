@@ -0,0 +1,24 @@
+#pragma once
+#include "Domain.h"
+#include "common.h"
+
+class CpuLbm;
+class LbmNode;
+struct FieldFrame;
+
+void InitializeDomain(CpuLbm* cpuLbm);
+
+void ReadNodeDistributions(CpuLbm* cpuLbm, LbmNode &lbm, const int x, const int y);
+
+void SetObstructionVelocitiesToZero(CpuLbm* cpuLbm, const float scaleFactor);
+
+void MarchSolution(CpuLbm* cpuLbm);
+
+float GetBytesPerUpdate(CpuLbm* cpuLbm);
+
+void WriteFieldFrame(CpuLbm* cpuLbm, FieldFrame* frame);
+
+void UpdateSolverObstructions(CpuLbm* cpuLbm, const int targetObstID,
+    const Obstruction &newObst, const float scaleFactor);
+
+void RemoveSolverObstruction(CpuLbm* cpuLbm, const int targetObstID);
@@ -0,0 +1,11 @@
+#pragma once
+
+// ! Solver headers include this instead of cuda_runtime.h so that the CPU solver can be built
+// ! by a plain C++ compiler. Define LBM_CPU_ONLY for targets that do not use the CUDA toolkit.
+#ifdef LBM_CPU_ONLY
+#include <stddef.h>
+#define __host__
+#define __device__
+#else
+#include "cuda_runtime.h"
+#endif
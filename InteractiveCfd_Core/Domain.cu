@@ -4,10 +4,41 @@
 
 Domain::Domain()
 {
-    m_xDim = BLOCKSIZEX * 2;
-    m_yDim = BLOCKSIZEX;
+    Initialize(MAX_XDIM, MAX_YDIM);
+}
+
+// ! maxXDim and maxYDim size every lattice array of the solver and are rounded up to whole blocks.
+// ! The padded maxXDim is also the row pitch of those arrays.
+Domain::Domain(const int maxXDim, const int maxYDim)
+{
+    Initialize(maxXDim, maxYDim);
+}
+
+__host__ void Domain::Initialize(const int maxXDim, const int maxYDim)
+{
+    m_maxXDim = ceil(static_cast<float>(maxXDim)/BLOCKSIZEX)*BLOCKSIZEX;
+    m_maxYDim = ceil(static_cast<float>(maxYDim)/BLOCKSIZEY)*BLOCKSIZEY;
+    m_xDim = BLOCKSIZEX * 2 < m_maxXDim ? BLOCKSIZEX * 2 : m_maxXDim;
+    m_yDim = BLOCKSIZEX < m_maxYDim ? BLOCKSIZEX : m_maxYDim;
     m_xDimVisible = m_xDim;
     m_yDimVisible = m_yDim;
+    MarkImageDirty(RectInt(0, 0, m_maxXDim, m_maxYDim));
+}
+
+__host__ __device__ int Domain::GetMaxXDim()
+{
+    return m_maxXDim;
+}
+
+__host__ __device__ int Domain::GetMaxYDim()
+{
+    return m_maxYDim;
+}
+
+// ! Number of nodes in one plane of a lattice array
+__host__ __device__ int Domain::GetPlaneSize()
+{
+    return m_maxXDim*m_maxYDim;
 }
 
 __host__ __device__ int Domain::GetXDim()
@@ -34,80 +65,146 @@ __host__ void Domain::SetXDim(const int xDim)
 {
     //x dimension must be multiple of BLOCKSIZEX
     int xDimAsMultipleOfBlocksize = ceil(static_cast<float>(xDim)/BLOCKSIZEX)*BLOCKSIZEX;
-    m_xDim = xDimAsMultipleOfBlocksize < MAX_XDIM ? xDimAsMultipleOfBlocksize : MAX_XDIM;
+    int newXDim = xDimAsMultipleOfBlocksize < m_maxXDim ? xDimAsMultipleOfBlocksize : m_maxXDim;
+    if (newXDim != m_xDim)
+    {
+        //only the columns between the old and new east edge change type
+        int xMin = (newXDim < m_xDim ? newXDim : m_xDim) - 1;
+        int xMax = newXDim > m_xDim ? newXDim : m_xDim;
+        MarkImageDirty(RectInt(xMin, 0, xMax - xMin, m_maxYDim));
+        m_xDim = newXDim;
+    }
 }
 
 __host__ void Domain::SetYDim(const int yDim)
 {
     //y dimension must be multiple of BLOCKSIZEY
     int yDimAsMultipleOfBlocksize = ceil(static_cast<float>(yDim)/BLOCKSIZEY)*BLOCKSIZEY;
-    m_yDim = yDimAsMultipleOfBlocksize < MAX_YDIM ? yDimAsMultipleOfBlocksize : MAX_YDIM;
+    int newYDim = yDimAsMultipleOfBlocksize < m_maxYDim ? yDimAsMultipleOfBlocksize : m_maxYDim;
+    if (newYDim != m_yDim)
+    {
+        //only the rows between the old and new top edge change type
+        int yMin = (newYDim < m_yDim ? newYDim : m_yDim) - 1;
+        int yMax = newYDim > m_yDim ? newYDim : m_yDim;
+        MarkImageDirty(RectInt(0, yMin, m_maxXDim, yMax - yMin));
+        m_yDim = newYDim;
+    }
 }
 
 __host__ void Domain::SetXDimVisible(const int xDimVisible)
 {
-    m_xDimVisible = xDimVisible < MAX_XDIM ? xDimVisible : MAX_XDIM;
+    m_xDimVisible = xDimVisible < m_maxXDim ? xDimVisible : m_maxXDim;
     SetXDim(xDimVisible);
 }
 
 __host__ void Domain::SetYDimVisible(const int yDimVisible)
 {
-    m_yDimVisible = yDimVisible < MAX_YDIM ? yDimVisible : MAX_YDIM;
+    m_yDimVisible = yDimVisible < m_maxYDim ? yDimVisible : m_maxYDim;
     SetYDim(yDimVisible);
 }
 
-__device__ int dmin(const int a, const int b)
+// ! Node type from the domain boundaries alone. Obstructions are rasterized on top of this.
+__host__ __device__ int Domain::ImageFcn(const int x, const int y)
+{
+    if (x < 0.1f)
+        return 3;//west
+    else if ((m_xDim - x) < 1.1f)
+        return 2;//east
+    else if ((m_yDim - y) < 1.1f)
+        return 11;//xsymmetry top
+    else if (y < 0.1f)
+        return 12;//xsymmetry bottom
+    return 0;
+}
+
+// ! Grows the region of the node image that has to be rebuilt to also cover rect. The region is
+// ! kept as a single bounding rectangle clipped to the lattice.
+__host__ void Domain::MarkImageDirty(const RectInt &rect)
+{
+    int xMin = rect.m_x > 0 ? rect.m_x : 0;
+    int yMin = rect.m_y > 0 ? rect.m_y : 0;
+    int xMax = rect.m_x + rect.m_w < m_maxXDim ? rect.m_x + rect.m_w : m_maxXDim;
+    int yMax = rect.m_y + rect.m_h < m_maxYDim ? rect.m_y + rect.m_h : m_maxYDim;
+    if (xMin >= xMax || yMin >= yMax)
+        return;
+    if (IsImageDirty())
+    {
+        const RectInt &dirty = m_imageDirtyRect;
+        xMin = dirty.m_x < xMin ? dirty.m_x : xMin;
+        yMin = dirty.m_y < yMin ? dirty.m_y : yMin;
+        xMax = dirty.m_x + dirty.m_w > xMax ? dirty.m_x + dirty.m_w : xMax;
+        yMax = dirty.m_y + dirty.m_h > yMax ? dirty.m_y + dirty.m_h : yMax;
+    }
+    m_imageDirtyRect = RectInt(xMin, yMin, xMax - xMin, yMax - yMin);
+}
+
+__host__ bool Domain::IsImageDirty()
+{
+    return m_imageDirtyRect.m_w > 0 && m_imageDirtyRect.m_h > 0;
+}
+
+__host__ RectInt Domain::GetImageDirtyRect()
+{
+    return m_imageDirtyRect;
+}
+
+__host__ void Domain::ClearImageDirtyRect()
+{
+    m_imageDirtyRect = RectInt();
+}
+
+__host__ __device__ int dmin(const int a, const int b)
 {
     if (a<b) return a;
     else return b - 1;
 }
-__device__ int dmax(const int a)
+__host__ __device__ int dmax(const int a)
 {
     if (a>-1) return a;
     else return 0;
 }
-__device__ int dmax(const int a, const int b)
+__host__ __device__ int dmax(const int a, const int b)
 {
     if (a>b) return a;
     else return b;
 }
-__device__ float dmin(const float a, const float b)
+__host__ __device__ float dmin(const float a, const float b)
 {
     if (a<b) return a;
     else return b;
 }
-__device__ float dmin(const float a, const float b, const float c, const float d)
+__host__ __device__ float dmin(const float a, const float b, const float c, const float d)
 {
     return dmin(dmin(a, b), dmin(c, d));
 }
-__device__ float dmax(const float a)
+__host__ __device__ float dmax(const float a)
 {
     if (a>0) return a;
     else return 0;
 }
-__device__ float dmax(const float a, const float b)
+__host__ __device__ float dmax(const float a, const float b)
 {
     if (a>b) return a;
     else return b;
 }
-__device__ float dmax(const float a, const float b, const float c, const float d)
+__host__ __device__ float dmax(const float a, const float b, const float c, const float d)
 {
     return dmax(dmax(a, b), dmax(c, d));
 }
 
-__device__ int f_mem(const int f_num, const int x, const int y,
+__host__ __device__ int f_mem(const int f_num, const int x, const int y,
     const size_t pitch, const int yDim)
 {
     return (x + y*pitch) + f_num*pitch*yDim;
 }
 
-__device__ int f_mem(const int f_num, const int x, const int y)
+// ! Index into a lattice array laid out for simDomain
+__host__ __device__ int f_mem(const int f_num, const int x, const int y, Domain &simDomain)
 {
-
-    return (x + y*MAX_XDIM) + f_num*MAX_XDIM*MAX_YDIM;
+    return f_mem(f_num, x, y, simDomain.GetMaxXDim(), simDomain.GetMaxYDim());
 }
 
-__device__ void Swap(float &a, float &b)
+__host__ __device__ void Swap(float &a, float &b)
 {
     float c = a;
     a = b;
@@ -1,5 +1,6 @@
 #pragma once
-#include "cuda_runtime.h"
+#include "CudaCompat.h"
+#include "RectInt.h"
 
 #ifdef LBM_GL_CPP_EXPORTS  
 #define FW_API __declspec(dllexport)   
@@ -9,13 +10,23 @@
 
 class FW_API Domain
 {
+    int m_maxXDim;
+    int m_maxYDim;
     int m_xDim;
     int m_yDim;
     int m_xDimVisible;
     int m_yDimVisible;
+    RectInt m_imageDirtyRect;
+
+    __host__ void Initialize(const int maxXDim, const int maxYDim);
 
 public:
     Domain();
+    Domain(const int maxXDim, const int maxYDim);
+
+    __host__ __device__ int GetMaxXDim();
+    __host__ __device__ int GetMaxYDim();
+    __host__ __device__ int GetPlaneSize();
 
     __host__ __device__ int GetXDim();
     __host__ __device__ int GetYDim();
@@ -27,18 +38,24 @@ public:
     __host__ void SetXDimVisible(const int xDimVisible);
     __host__ void SetYDimVisible(const int yDimVisible);
 
+    __host__ __device__ int ImageFcn(const int x, const int y);
+    __host__ void MarkImageDirty(const RectInt &rect);
+    __host__ bool IsImageDirty();
+    __host__ RectInt GetImageDirtyRect();
+    __host__ void ClearImageDirtyRect();
+
 };
 
-__device__ int dmin(const int a, const int b);
-__device__ int dmax(const int a);
-__device__ int dmax(const int a, const int b);
-__device__ float dmin(const float a, const float b);
-__device__ float dmin(const float a, const float b, const float c, const float d);
-__device__ float dmax(const float a);
-__device__ float dmax(const float a, const float b);
-__device__ float dmax(const float a, const float b, const float c, const float d);
-__device__ int f_mem(const int f_num, const int x, const int y, const size_t pitch,
+__host__ __device__ int dmin(const int a, const int b);
+__host__ __device__ int dmax(const int a);
+__host__ __device__ int dmax(const int a, const int b);
+__host__ __device__ float dmin(const float a, const float b);
+__host__ __device__ float dmin(const float a, const float b, const float c, const float d);
+__host__ __device__ float dmax(const float a);
+__host__ __device__ float dmax(const float a, const float b);
+__host__ __device__ float dmax(const float a, const float b, const float c, const float d);
+__host__ __device__ int f_mem(const int f_num, const int x, const int y, const size_t pitch,
     const int yDim);
-__device__ int f_mem(const int f_num, const int x, const int y);
-__device__ void Swap(float &a, float &b);
+__host__ __device__ int f_mem(const int f_num, const int x, const int y, Domain &simDomain);
+__host__ __device__ void Swap(float &a, float &b);
 
@@ -0,0 +1,306 @@
+#include "FieldWriter.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// ! Attribute names in the index, in the order of the FieldVariable bits
+static const char* fieldVariableNames[FIELD_VARIABLE_COUNT] = { "rho", "u", "v", "strainRate" };
+
+const char* GetFieldVariableName(const int index)
+{
+    if (index < 0 || index >= FIELD_VARIABLE_COUNT)
+        return "unknown";
+    return fieldVariableNames[index];
+}
+
+// ! File name without its directory, which is how the index refers to the frames next to it
+static std::string GetFileName(const std::string &path)
+{
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+FieldWriter::FieldWriter()
+{
+    m_variables = 0;
+    m_xDim = 0;
+    m_yDim = 0;
+    m_dropPolicy = FIELD_DROP_NEWEST;
+    m_isRunning = false;
+    m_isStopping = false;
+    m_submittedCount = 0;
+    m_droppedCount = 0;
+    m_writtenCount = 0;
+    m_failedCount = 0;
+}
+
+FieldWriter::~FieldWriter()
+{
+    Stop();
+}
+
+// ! Allocates bufferCount frames of the requested variables up front, so no memory is allocated
+// ! while the solver runs, and starts the writer thread. At least two buffers are kept, so the
+// ! solver can fill one while the other is written.
+bool FieldWriter::Start(const std::string &prefix, const int variables, const int xDim,
+    const int yDim, const int bufferCount, const FieldDropPolicy dropPolicy)
+{
+    if (m_isRunning || prefix.empty() || (variables & FIELD_ALL_VARIABLES) == 0 || xDim <= 0 ||
+        yDim <= 0)
+        return false;
+    m_prefix = prefix;
+    m_variables = variables & FIELD_ALL_VARIABLES;
+    m_xDim = xDim;
+    m_yDim = yDim;
+    m_dropPolicy = dropPolicy;
+    const int frameCount = bufferCount < 2 ? 2 : bufferCount;
+    const size_t planeSize = static_cast<size_t>(xDim)*yDim;
+    m_storage.assign(frameCount*FIELD_VARIABLE_COUNT, std::vector<float>());
+    m_frames.assign(frameCount, FieldFrame());
+    m_freeFrames.clear();
+    m_queuedFrames.clear();
+    for (int n = 0; n < frameCount; n++)
+    {
+        FieldFrame &frame = m_frames[n];
+        frame.timeStep = 0;
+        frame.xDim = xDim;
+        frame.yDim = yDim;
+        for (int i = 0; i < FIELD_VARIABLE_COUNT; i++)
+        {
+            frame.fields[i] = NULL;
+            if (m_variables & (1 << i))
+            {
+                std::vector<float> &plane = m_storage[n*FIELD_VARIABLE_COUNT + i];
+                plane.resize(planeSize);
+                frame.fields[i] = &plane[0];
+            }
+        }
+        m_freeFrames.push_back(n);
+    }
+    m_indexGrids.clear();
+    m_submittedCount = 0;
+    m_droppedCount = 0;
+    m_writtenCount = 0;
+    m_failedCount = 0;
+    m_isStopping = false;
+    m_isRunning = true;
+    m_thread = std::thread(&FieldWriter::WriterLoop, this);
+    return true;
+}
+
+// ! Writes out every frame still queued, then joins the writer thread and releases the buffers
+void FieldWriter::Stop()
+{
+    if (!m_isRunning)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_queueCondition.notify_one();
+    m_freeCondition.notify_all();
+    m_thread.join();
+    m_isRunning = false;
+    m_frames.clear();
+    m_storage.clear();
+    m_freeFrames.clear();
+}
+
+bool FieldWriter::IsRunning()
+{
+    return m_isRunning;
+}
+
+int FieldWriter::GetVariables()
+{
+    return m_variables;
+}
+
+// ! A frame for timeStep to fill, or null if it is to be skipped under the drop policy. The caller
+// ! owns the frame until it passes it to SubmitFrame. Only WAIT ever blocks.
+FieldFrame* FieldWriter::AcquireFrame(const long long timeStep)
+{
+    if (!m_isRunning)
+        return NULL;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_freeFrames.empty())
+    {
+        if (m_dropPolicy == FIELD_WAIT)
+        {
+            m_freeCondition.wait(lock, [this]{ return !m_freeFrames.empty() || m_isStopping; });
+        }
+        else if (m_dropPolicy == FIELD_DROP_OLDEST && !m_queuedFrames.empty())
+        {
+            m_freeFrames.push_back(m_queuedFrames.front());
+            m_queuedFrames.pop_front();
+            m_droppedCount++;
+        }
+    }
+    if (m_freeFrames.empty())
+    {
+        m_droppedCount++;
+        return NULL;
+    }
+    FieldFrame* frame = &m_frames[m_freeFrames.front()];
+    m_freeFrames.pop_front();
+    frame->timeStep = timeStep;
+    return frame;
+}
+
+void FieldWriter::SubmitFrame(FieldFrame* frame)
+{
+    if (frame == NULL)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queuedFrames.push_back(static_cast<int>(frame - &m_frames[0]));
+        m_submittedCount++;
+    }
+    m_queueCondition.notify_one();
+}
+
+int FieldWriter::GetSubmittedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_submittedCount;
+}
+
+// ! Frames skipped or taken back under the drop policy
+int FieldWriter::GetDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_droppedCount;
+}
+
+int FieldWriter::GetWrittenCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_writtenCount;
+}
+
+// ! Frames and index updates that could not be written to disk
+int FieldWriter::GetFailedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failedCount;
+}
+
+std::string FieldWriter::GetIndexPath()
+{
+    return m_prefix + ".xmf";
+}
+
+std::string FieldWriter::GetFramePath(const long long timeStep)
+{
+    std::ostringstream path;
+    path << m_prefix << "_" << std::setfill('0') << std::setw(10) << timeStep << ".bin";
+    return path.str();
+}
+
+// ! Takes queued frames in submission order until Stop was called and the queue is empty. The
+// ! frame being written is off the queue, so DROP_OLDEST never takes it back. The index is only
+// ! rewritten once the queue is empty, so a writer that fell behind catches up on frames first.
+void FieldWriter::WriterLoop()
+{
+    bool isIndexStale = false;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_queueCondition.wait(lock, [this]{ return !m_queuedFrames.empty() || m_isStopping; });
+        if (m_queuedFrames.empty())
+            break;
+        int index = m_queuedFrames.front();
+        m_queuedFrames.pop_front();
+        lock.unlock();
+
+        const FieldFrame &frame = m_frames[index];
+        bool isWritten = WriteFrame(frame);
+        if (isWritten)
+        {
+            AddIndexGrid(frame.timeStep);
+            isIndexStale = true;
+        }
+
+        lock.lock();
+        if (isWritten)
+            m_writtenCount++;
+        else
+            m_failedCount++;
+        m_freeFrames.push_back(index);
+        m_freeCondition.notify_one();
+        if (isIndexStale && m_queuedFrames.empty())
+        {
+            lock.unlock();
+            bool isIndexWritten = WriteIndex();
+            lock.lock();
+            isIndexStale = false;
+            if (!isIndexWritten)
+                m_failedCount++;
+        }
+    }
+}
+
+// ! The planes of the requested variables one after the other, as floats in the host's byte order
+bool FieldWriter::WriteFrame(const FieldFrame &frame)
+{
+    std::ofstream file(GetFramePath(frame.timeStep).c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    const std::streamsize planeBytes = static_cast<std::streamsize>(frame.xDim)*frame.yDim*
+        sizeof(float);
+    for (int i = 0; i < FIELD_VARIABLE_COUNT; i++)
+    {
+        if (frame.fields[i] != NULL)
+            file.write(reinterpret_cast<const char*>(frame.fields[i]), planeBytes);
+    }
+    return static_cast<bool>(file);
+}
+
+// ! Appends the grid of a written frame to the index. The lattice spacing and time are in lattice
+// ! units: one node, one step.
+void FieldWriter::AddIndexGrid(const long long timeStep)
+{
+    const long long planeBytes = static_cast<long long>(m_xDim)*m_yDim*sizeof(float);
+    std::string file = GetFileName(GetFramePath(timeStep));
+    std::ostringstream grid;
+    grid << "   <Grid Name=\"step " << timeStep << "\" GridType=\"Uniform\">" << std::endl
+        << "    <Time Value=\"" << timeStep << "\"/>" << std::endl
+        << "    <Topology TopologyType=\"2DCoRectMesh\" Dimensions=\"" << m_yDim << " " << m_xDim
+        << "\"/>" << std::endl
+        << "    <Geometry GeometryType=\"ORIGIN_DXDY\">" << std::endl
+        << "     <DataItem Dimensions=\"2\" Format=\"XML\">0 0</DataItem>" << std::endl
+        << "     <DataItem Dimensions=\"2\" Format=\"XML\">1 1</DataItem>" << std::endl
+        << "    </Geometry>" << std::endl;
+    long long seek = 0;
+    for (int i = 0; i < FIELD_VARIABLE_COUNT; i++)
+    {
+        if ((m_variables & (1 << i)) == 0)
+            continue;
+        grid << "    <Attribute Name=\"" << fieldVariableNames[i]
+            << "\" AttributeType=\"Scalar\" Center=\"Node\">" << std::endl
+            << "     <DataItem Dimensions=\"" << m_yDim << " " << m_xDim
+            << "\" NumberType=\"Float\" Precision=\"4\" Format=\"Binary\" Seek=\"" << seek
+            << "\">" << file << "</DataItem>" << std::endl
+            << "    </Attribute>" << std::endl;
+        seek += planeBytes;
+    }
+    grid << "   </Grid>" << std::endl;
+    m_indexGrids += grid.str();
+}
+
+bool FieldWriter::WriteIndex()
+{
+    std::ofstream index(GetIndexPath().c_str());
+    if (!index)
+        return false;
+    index << "<?xml version=\"1.0\" ?>" << std::endl
+        << "<Xdmf Version=\"2.0\">" << std::endl
+        << " <Domain>" << std::endl
+        << "  <Grid Name=\"Fields\" GridType=\"Collection\" CollectionType=\"Temporal\">"
+        << std::endl
+        << m_indexGrids
+        << "  </Grid>" << std::endl
+        << " </Domain>" << std::endl
+        << "</Xdmf>" << std::endl;
+    return static_cast<bool>(index);
+}
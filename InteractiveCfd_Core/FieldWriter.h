@@ -0,0 +1,88 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ! Frames the writer holds by default: one being written, the rest filled or queued
+#define FIELD_WRITER_DEFAULT_BUFFERS 4
+
+#ifdef LBM_GL_CPP_EXPORTS
+#define FW_API __declspec(dllexport)
+#else
+#define FW_API __declspec(dllimport)
+#endif
+
+// ! Macro variables that can be written, as bits of a mask. Their planes are stored in this order.
+enum FieldVariable{FIELD_RHO = 1, FIELD_U = 2, FIELD_V = 4, FIELD_STRAIN_RATE = 8};
+#define FIELD_VARIABLE_COUNT 4
+#define FIELD_ALL_VARIABLES (FIELD_RHO | FIELD_U | FIELD_V | FIELD_STRAIN_RATE)
+
+// ! What AcquireFrame does once every buffer is filled or queued. DROP_NEWEST skips the frame that
+// ! was asked for, DROP_OLDEST takes back the oldest queued frame that was not being written yet,
+// ! and WAIT blocks the caller until the writer frees a buffer, so no frame is lost.
+enum FieldDropPolicy{FIELD_DROP_NEWEST, FIELD_DROP_OLDEST, FIELD_WAIT};
+
+// ! One time step of output. fields[i] is null unless variable bit i was asked for, and otherwise
+// ! holds xDim*yDim values row by row, without the padding of the solver's pitch.
+struct FieldFrame
+{
+    long long timeStep;
+    int xDim;
+    int yDim;
+    float* fields[FIELD_VARIABLE_COUNT];
+};
+
+// ! Writes time series of macro fields on a thread of its own, so the solver only pays for
+// ! filling a buffer. The solver takes a frame from a fixed pool with AcquireFrame, fills it and
+// ! hands it over with SubmitFrame; the writer thread stores each frame in order as raw floats in
+// ! <prefix>_<step>.bin and keeps <prefix>.xmf, an XDMF index of the frames written so far that
+// ! ParaView and VisIt open as a time series, up to date whenever it runs out of frames. When the
+// ! writer falls behind, the drop policy decides, and the frames dropped are counted.
+class FW_API FieldWriter
+{
+    std::string m_prefix;
+    int m_variables;
+    int m_xDim;
+    int m_yDim;
+    FieldDropPolicy m_dropPolicy;
+    std::vector<std::vector<float> > m_storage;
+    std::vector<FieldFrame> m_frames;
+    std::deque<int> m_freeFrames;
+    std::deque<int> m_queuedFrames;
+    std::string m_indexGrids;
+    std::mutex m_mutex;
+    std::condition_variable m_queueCondition;
+    std::condition_variable m_freeCondition;
+    std::thread m_thread;
+    bool m_isRunning;
+    bool m_isStopping;
+    int m_submittedCount;
+    int m_droppedCount;
+    int m_writtenCount;
+    int m_failedCount;
+    void WriterLoop();
+    bool WriteFrame(const FieldFrame &frame);
+    void AddIndexGrid(const long long timeStep);
+    bool WriteIndex();
+    std::string GetFramePath(const long long timeStep);
+public:
+    FieldWriter();
+    ~FieldWriter();
+    bool Start(const std::string &prefix, const int variables, const int xDim, const int yDim,
+        const int bufferCount, const FieldDropPolicy dropPolicy);
+    void Stop();
+    bool IsRunning();
+    int GetVariables();
+    FieldFrame* AcquireFrame(const long long timeStep);
+    void SubmitFrame(FieldFrame* frame);
+    int GetSubmittedCount();
+    int GetDroppedCount();
+    int GetWrittenCount();
+    int GetFailedCount();
+    std::string GetIndexPath();
+};
+
+FW_API const char* GetFieldVariableName(const int index);
@@ -1,32 +1,186 @@
 #include "FpsTracker.h"
+#include <algorithm>
+
+// ! Upper edges of the frame time histogram buckets in ms, around the 60, 30 and 15 fps marks
+static const float frameHistogramEdges[FRAME_HISTOGRAM_BUCKETS] =
+    { 8.f, 12.f, 17.f, 20.f, 25.f, 34.f, 67.f, 1e30f };
+
+static float GetMilliseconds(const std::chrono::steady_clock::duration &duration)
+{
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+RollingSamples::RollingSamples()
+{
+    Clear();
+}
+
+void RollingSamples::Add(const float sample)
+{
+    m_samples[m_next] = sample;
+    m_next = (m_next + 1) % FRAME_STATS_WINDOW;
+    m_count = std::min(m_count + 1, FRAME_STATS_WINDOW);
+}
+
+int RollingSamples::GetCount()
+{
+    return m_count;
+}
+
+float RollingSamples::GetSum()
+{
+    float sum = 0.f;
+    for (int i = 0; i < m_count; i++)
+    {
+        sum += m_samples[i];
+    }
+    return sum;
+}
+
+FrameStats RollingSamples::GetStats()
+{
+    FrameStats stats = { m_count, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+    if (m_count == 0)
+        return stats;
+    std::vector<float> sorted(m_samples, m_samples + m_count);
+    std::sort(sorted.begin(), sorted.end());
+    const float percentiles[3] = { 50.f, 95.f, 99.f };
+    float* fields[3] = { &stats.p50, &stats.p95, &stats.p99 };
+    for (int i = 0; i < 3; i++)
+    {
+        int rank = static_cast<int>(percentiles[i] / 100.f*m_count + 0.999f);
+        *fields[i] = sorted[std::min(std::max(rank, 1), m_count) - 1];
+    }
+    stats.mean = GetSum() / m_count;
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    return stats;
+}
+
+// ! Counts the samples falling into each bucket, where bucket i holds the samples not above
+// ! upperEdges[i] and above the edge before it
+void RollingSamples::GetHistogram(const float* upperEdges, const int bucketCount, int* counts)
+{
+    std::fill(counts, counts + bucketCount, 0);
+    for (int i = 0; i < m_count; i++)
+    {
+        int bucket = static_cast<int>(std::lower_bound(upperEdges, upperEdges + bucketCount,
+            m_samples[i]) - upperEdges);
+        counts[std::min(bucket, bucketCount - 1)]++;
+    }
+}
+
+void RollingSamples::Clear()
+{
+    m_next = 0;
+    m_count = 0;
+}
 
 FpsTracker::FpsTracker()
 {
-    m_frameCount = 0;
-    m_frameLimit = 20;
-    m_fps = 0;
+    Reset();
 }
 
 void FpsTracker::Tick()
 {
-    if (m_frameCount == 0)
+    Tick(std::chrono::steady_clock::now());
+}
+
+void FpsTracker::Tick(const std::chrono::steady_clock::time_point &now)
+{
+    if (m_hasTicked)
     {
-        m_before = clock();
+        m_frameTimes.Add(GetMilliseconds(now - m_lastTick));
     }
-    m_frameCount++;
+    m_lastTick = now;
+    m_hasTicked = true;
 }
 
+// ! Updates the frame rate, averaged over the frame time window
 void FpsTracker::Tock()
 {
-    if (m_frameCount == m_frameLimit)
-    {
-        m_diff = clock() - m_before;
-        m_fps = static_cast<float>(m_frameLimit) / (static_cast<float>(m_diff) / CLOCKS_PER_SEC);
-        m_frameCount = 0;
-    }
+    float sum = m_frameTimes.GetSum();
+    if (sum > 0.f)
+        m_fps = 1000.f*m_frameTimes.GetCount() / sum;
 }
 
 float FpsTracker::GetFps()
 {
     return m_fps;
 }
+
+// ! Records an input that shows once a solution of at least version is drawn. Only the first
+// ! input waiting for a version is kept, as the later ones show in the same frame.
+void FpsTracker::MarkInput(const int version)
+{
+    MarkInput(version, std::chrono::steady_clock::now());
+}
+
+void FpsTracker::MarkInput(const int version, const std::chrono::steady_clock::time_point &now)
+{
+    if (!m_pendingInputs.empty() && m_pendingInputs.back().version >= version)
+        return;
+    PendingInput input = { now, version };
+    m_pendingInputs.push_back(input);
+}
+
+// ! Called once the buffers of a frame showing a solution of version were swapped
+void FpsTracker::Present(const int version)
+{
+    Present(version, std::chrono::steady_clock::now());
+}
+
+void FpsTracker::Present(const int version, const std::chrono::steady_clock::time_point &now)
+{
+    while (!m_pendingInputs.empty() && m_pendingInputs.front().version <= version)
+    {
+        m_inputLatencies.Add(GetMilliseconds(now - m_pendingInputs.front().time));
+        m_pendingInputs.pop_front();
+    }
+}
+
+// ! Adds the rate the solver stepped at during the frame. Paused frames are left out.
+void FpsTracker::AddStepsPerSecond(const float stepsPerSecond)
+{
+    if (stepsPerSecond > 0.f)
+        m_stepsPerSecond.Add(stepsPerSecond);
+}
+
+// ! In ms
+FrameStats FpsTracker::GetFrameTimeStats()
+{
+    return m_frameTimes.GetStats();
+}
+
+// ! In ms
+FrameStats FpsTracker::GetInputLatencyStats()
+{
+    return m_inputLatencies.GetStats();
+}
+
+FrameStats FpsTracker::GetStepsPerSecondStats()
+{
+    return m_stepsPerSecond.GetStats();
+}
+
+// ! FRAME_HISTOGRAM_BUCKETS upper bucket edges in ms
+const float* FpsTracker::GetFrameHistogramEdges()
+{
+    return frameHistogramEdges;
+}
+
+// ! Fills FRAME_HISTOGRAM_BUCKETS counts of the frame times in the window
+void FpsTracker::GetFrameTimeHistogram(int* counts)
+{
+    m_frameTimes.GetHistogram(frameHistogramEdges, FRAME_HISTOGRAM_BUCKETS, counts);
+}
+
+void FpsTracker::Reset()
+{
+    m_hasTicked = false;
+    m_fps = 0.f;
+    m_frameTimes.Clear();
+    m_inputLatencies.Clear();
+    m_stepsPerSecond.Clear();
+    m_pendingInputs.clear();
+}
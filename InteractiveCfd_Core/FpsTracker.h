@@ -1,23 +1,86 @@
 #pragma once
-#include <time.h>
+#include <chrono>
+#include <deque>
+#include <vector>
 
-#ifdef LBM_GL_CPP_EXPORTS  
-#define FW_API __declspec(dllexport)   
-#else  
-#define FW_API __declspec(dllimport)   
-#endif  
+// ! Frames, drags and solver rates the rolling statistics are taken over, several seconds at 60 fps
+#define FRAME_STATS_WINDOW 240
+// ! Buckets of the frame time histogram, the last one open ended
+#define FRAME_HISTOGRAM_BUCKETS 8
 
+#ifdef LBM_GL_CPP_EXPORTS
+#define FW_API __declspec(dllexport)
+#else
+#define FW_API __declspec(dllimport)
+#endif
+
+// ! Summary of the samples in a RollingSamples window. Percentiles are nearest rank, and every
+// ! field is 0 while the window is empty.
+struct FrameStats
+{
+    int count;
+    float mean;
+    float min;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+};
+
+// ! The last FRAME_STATS_WINDOW samples of a quantity. Statistics are taken over the window when
+// ! asked for, so adding a sample stays cheap.
+class FW_API RollingSamples
+{
+    float m_samples[FRAME_STATS_WINDOW];
+    int m_next;
+    int m_count;
+public:
+    RollingSamples();
+    void Add(const float sample);
+    int GetCount();
+    float GetSum();
+    FrameStats GetStats();
+    void GetHistogram(const float* upperEdges, const int bucketCount, int* counts);
+    void Clear();
+};
+
+// ! Frame statistics of the window on the steady clock, so they are wall time on every platform.
+// ! Tick starts a frame and Tock ends it once its buffers were swapped; the frame time is the time
+// ! between two Ticks, including any wait for vsync. The input latency of obstruction drags runs
+// ! from the mouse event to the swap of the first frame showing a solution that includes it:
+// ! MarkInput records an event with the solution version it needs, and Present closes the
+// ! events that the version drawn by the frame includes. Each of these also takes the time of the
+// ! event instead of reading the clock, so recorded timings can be replayed.
 class FW_API FpsTracker
 {
 private:
-    clock_t m_before, m_diff;
-    int m_frameCount;
-    int m_frameLimit;
+    struct PendingInput
+    {
+        std::chrono::steady_clock::time_point time;
+        int version;
+    };
+    std::chrono::steady_clock::time_point m_lastTick;
+    bool m_hasTicked;
     float m_fps;
+    RollingSamples m_frameTimes;
+    RollingSamples m_inputLatencies;
+    RollingSamples m_stepsPerSecond;
+    std::deque<PendingInput> m_pendingInputs;
 public:
     FpsTracker();
     void Tick();
+    void Tick(const std::chrono::steady_clock::time_point &now);
     void Tock();
     float GetFps();
+    void MarkInput(const int version);
+    void MarkInput(const int version, const std::chrono::steady_clock::time_point &now);
+    void Present(const int version);
+    void Present(const int version, const std::chrono::steady_clock::time_point &now);
+    void AddStepsPerSecond(const float stepsPerSecond);
+    FrameStats GetFrameTimeStats();
+    FrameStats GetInputLatencyStats();
+    FrameStats GetStepsPerSecondStats();
+    static const float* GetFrameHistogramEdges();
+    void GetFrameTimeHistogram(int* counts);
+    void Reset();
 };
-
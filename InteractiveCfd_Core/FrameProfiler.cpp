@@ -0,0 +1,192 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+FrameProfiler::FrameProfiler()
+{
+    m_slots = new TraceSlot[FRAME_PROFILER_CAPACITY];
+    for (int i = 0; i < FRAME_PROFILER_CAPACITY; i++)
+    {
+        m_slots[i].sequence.store(0);
+    }
+    m_next.store(0);
+    m_isEnabled.store(true);
+    m_isDeviceSync.store(false);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    delete[] m_slots;
+}
+
+// ! Defined here rather than in the header, so the DLL and the executables share one profiler
+FrameProfiler& FrameProfiler::Instance()
+{
+    static FrameProfiler s_profiler;
+    return s_profiler;
+}
+
+bool FrameProfiler::IsEnabled()
+{
+    return m_isEnabled.load(std::memory_order_relaxed);
+}
+
+void FrameProfiler::SetEnabled(const bool isEnabled)
+{
+    m_isEnabled.store(isEnabled);
+}
+
+bool FrameProfiler::IsDeviceSync()
+{
+    return m_isDeviceSync.load(std::memory_order_relaxed);
+}
+
+// ! Only takes effect once a device sync function was set
+void FrameProfiler::SetDeviceSync(const bool isDeviceSync)
+{
+    m_isDeviceSync.store(isDeviceSync);
+}
+
+// ! Set by the code that owns the device, so the profiler itself does not depend on CUDA. Has to
+// ! be set before any thread records device stages.
+void FrameProfiler::SetDeviceSyncFunction(const std::function<void()> &deviceSync)
+{
+    m_deviceSync = deviceSync;
+}
+
+void FrameProfiler::SyncDevice()
+{
+    if (IsDeviceSync() && m_deviceSync)
+        m_deviceSync();
+}
+
+// ! Nanoseconds on the steady clock
+long long FrameProfiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameProfiler::Record(const char* name, const long long start, const long long end)
+{
+    unsigned long long index = m_next.fetch_add(1, std::memory_order_relaxed);
+    TraceSlot &slot = m_slots[index % FRAME_PROFILER_CAPACITY];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.thread.store(static_cast<unsigned int>(std::hash<std::thread::id>()(
+        std::this_thread::get_id())), std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(end - start, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+struct TraceEvent
+{
+    const char* name;
+    unsigned int thread;
+    long long start;
+    long long duration;
+};
+
+bool IsEarlier(const TraceEvent &a, const TraceEvent &b)
+{
+    return a.start < b.start;
+}
+
+// ! Nearest rank percentile of sorted durations, in milliseconds
+double GetPercentile(const std::vector<long long> &durations, const double percentile)
+{
+    size_t rank = static_cast<size_t>(percentile / 100.0*durations.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), durations.size());
+    return durations[rank - 1] * 1e-6;
+}
+
+// ! Writes every complete slot as a trace event, oldest first, and a summary of each stage both
+// ! into the file, under stageSummaries, and to stdout. Recording carries on meanwhile.
+bool FrameProfiler::WriteChromeTrace(const std::string &path)
+{
+    std::vector<TraceEvent> events;
+    for (int i = 0; i < FRAME_PROFILER_CAPACITY; i++)
+    {
+        TraceSlot &slot = m_slots[i];
+        unsigned long long sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0)
+            continue;
+        TraceEvent event = { slot.name.load(std::memory_order_relaxed),
+            slot.thread.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+            slot.duration.load(std::memory_order_relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+        events.push_back(event);
+    }
+    std::sort(events.begin(), events.end(), IsEarlier);
+
+    std::map<std::string, std::vector<long long> > stages;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        stages[events[i].name].push_back(events[i].duration);
+    }
+
+    std::ofstream trace(path.c_str());
+    if (!trace)
+        return false;
+    long long origin = events.empty() ? 0 : events[0].start;
+    trace << std::fixed << std::setprecision(3) << "{\"traceEvents\":[" << std::endl;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        trace << "{\"name\":\"" << events[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << events[i].thread << ",\"ts\":" << (events[i].start - origin)*1e-3
+            << ",\"dur\":" << events[i].duration*1e-3 << "}"
+            << (i + 1 < events.size() ? "," : "") << std::endl;
+    }
+    trace << "],\"displayTimeUnit\":\"ms\",\"stageSummaries\":[" << std::endl;
+    std::cout << std::left << std::setw(32) << "stage" << std::right << std::setw(8) << "count"
+        << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms"
+        << std::setw(10) << "max ms" << std::endl;
+    size_t stageIndex = 0;
+    for (std::map<std::string, std::vector<long long> >::iterator stage = stages.begin();
+        stage != stages.end(); ++stage, ++stageIndex)
+    {
+        std::vector<long long> &durations = stage->second;
+        std::sort(durations.begin(), durations.end());
+        double p50 = GetPercentile(durations, 50.0);
+        double p95 = GetPercentile(durations, 95.0);
+        double p99 = GetPercentile(durations, 99.0);
+        double max = durations.back()*1e-6;
+        trace << "{\"name\":\"" << stage->first << "\",\"count\":" << durations.size()
+            << ",\"p50Ms\":" << p50 << ",\"p95Ms\":" << p95 << ",\"p99Ms\":" << p99
+            << ",\"maxMs\":" << max << "}" << (stageIndex + 1 < stages.size() ? "," : "")
+            << std::endl;
+        std::cout << std::left << std::setw(32) << stage->first << std::right << std::fixed
+            << std::setprecision(3) << std::setw(8) << durations.size() << std::setw(10) << p50
+            << std::setw(10) << p95 << std::setw(10) << p99 << std::setw(10) << max << std::endl;
+    }
+    trace << "]}" << std::endl;
+    return static_cast<bool>(trace);
+}
+
+ScopedTimer::ScopedTimer(const char* name, const bool isDeviceStage)
+{
+    m_name = name;
+    m_isDeviceStage = isDeviceStage;
+    FrameProfiler &profiler = FrameProfiler::Instance();
+    m_start = profiler.IsEnabled() ? profiler.Now() : -1;
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    if (m_start < 0)
+        return;
+    FrameProfiler &profiler = FrameProfiler::Instance();
+    if (m_isDeviceStage)
+        profiler.SyncDevice();
+    profiler.Record(m_name, m_start, profiler.Now());
+}
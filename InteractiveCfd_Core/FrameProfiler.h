@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+
+// ! Timed scopes the ring buffer holds before the oldest are overwritten, several seconds of frames
+#define FRAME_PROFILER_CAPACITY 65536
+// ! File the trace is written to by the window's hotkey and --trace
+#define FRAME_TRACE_FILE "frame_trace.json"
+
+#ifdef LBM_GL_CPP_EXPORTS
+#define FW_API __declspec(dllexport)
+#else
+#define FW_API __declspec(dllimport)
+#endif
+
+// ! Records the timed scopes of every thread into a fixed ring buffer and writes them out as a
+// ! Chrome trace (chrome://tracing or Perfetto), with the p50/p95/p99 duration of each stage. A
+// ! scope takes a slot with one atomic increment and never waits, so the render and solver threads
+// ! can record at the same time. The writer of a slot publishes it through its sequence number, and
+// ! slots being written or already overwritten while the trace is written are skipped.
+// ! Stages that queue device work are timed on the host, where they only take as long as the
+// ! launches unless device synchronization is switched on, at the cost of some overlap.
+class FW_API FrameProfiler
+{
+    // ! The fields are atomic, although only accessed relaxed, because the trace may read a slot
+    // ! while it is being overwritten. The sequence number tells such reads apart afterwards.
+    struct TraceSlot
+    {
+        std::atomic<unsigned long long> sequence;
+        std::atomic<const char*> name;
+        std::atomic<unsigned int> thread;
+        std::atomic<long long> start;
+        std::atomic<long long> duration;
+    };
+    TraceSlot* m_slots;
+    std::atomic<unsigned long long> m_next;
+    std::atomic<bool> m_isEnabled;
+    std::atomic<bool> m_isDeviceSync;
+    std::function<void()> m_deviceSync;
+    FrameProfiler();
+    ~FrameProfiler();
+public:
+    static FrameProfiler& Instance();
+    bool IsEnabled();
+    void SetEnabled(const bool isEnabled);
+    bool IsDeviceSync();
+    void SetDeviceSync(const bool isDeviceSync);
+    void SetDeviceSyncFunction(const std::function<void()> &deviceSync);
+    void SyncDevice();
+    long long Now();
+    void Record(const char* name, const long long start, const long long end);
+    bool WriteChromeTrace(const std::string &path);
+};
+
+// ! Records the time between its construction and destruction under name, which has to outlive
+// ! the profiler, e.g. a string literal. A device stage waits for the calling thread's stream
+// ! before it stops the clock, if the profiler synchronizes device work.
+class FW_API ScopedTimer
+{
+    const char* m_name;
+    long long m_start;
+    bool m_isDeviceStage;
+public:
+    ScopedTimer(const char* name, const bool isDeviceStage = false);
+    ~ScopedTimer();
+};
@@ -0,0 +1,475 @@
+#include "CpuLbm.h"
+#include "Domain.h"
+#include "NodeLists.h"
+#include "ActiveTiles.h"
+#include "ObstructionGeometry.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Alignment of the solver arrays, so that the first touch of a row band places whole pages
+static const size_t HOST_PAGE_SIZE = 4096;
+
+CpuLbm::CpuLbm()
+{
+    m_domain = new Domain;
+    Initialize();
+}
+
+// ! The lattice arrays are sized for maxX x maxY nodes instead of the MAX_XDIM x MAX_YDIM default
+CpuLbm::CpuLbm(const int maxX, const int maxY)
+{
+    m_domain = new Domain(maxX, maxY);
+    Initialize();
+}
+
+void CpuLbm::Initialize()
+{
+    m_nodeLists = new NodeLists(m_domain->GetMaxYDim());
+    m_activeTiles = new ActiveTiles(m_domain->GetMaxXDim(), m_domain->GetMaxYDim());
+    m_fA = NULL;
+    m_fB = NULL;
+    m_packedFA = NULL;
+    m_packedFB = NULL;
+    m_Im = NULL;
+    m_obstIdMap = NULL;
+    m_residualPrev = NULL;
+    m_inletVelocity = INITIAL_UMAX;
+    m_omega = 1.9f;
+    m_isPaused = false;
+    m_timeStepsPerFrame = TIMESTEPS_PER_FRAME / 2;
+    m_numThreads = 0;
+    m_isThreadPinning = false;
+    m_threadPool = NULL;
+    m_simdIsa = DetectSimdIsa();
+    m_streamingMode = StreamingMode::TWO_BUFFER;
+    m_temporalBlockingDepth = 0;
+    m_latticeStorage = STORAGE_FP32;
+    m_collisionModel = COLLISION_MRT_SMAGORINSKY;
+}
+
+CpuLbm::~CpuLbm()
+{
+    DeallocateHostMemory();
+    delete m_threadPool;
+    delete m_nodeLists;
+    delete m_activeTiles;
+    delete m_domain;
+}
+
+Domain* CpuLbm::GetDomain()
+{
+    return m_domain;
+}
+
+// ! Fluid runs and boundary node lists of the node image, kept current by UpdateHostImage
+NodeLists* CpuLbm::GetNodeLists()
+{
+    return m_nodeLists;
+}
+
+// ! Tiles of the lattice that are stepped, also kept current by UpdateHostImage
+ActiveTiles* CpuLbm::GetActiveTiles()
+{
+    return m_activeTiles;
+}
+
+float* CpuLbm::GetFA()
+{
+    return m_fA;
+}
+
+float* CpuLbm::GetFB()
+{
+    return m_fB;
+}
+
+// ! Distributions packed to 16 bits, NULL for STORAGE_FP32 where GetFA and GetFB are used instead
+unsigned short* CpuLbm::GetPackedFA()
+{
+    return m_packedFA;
+}
+
+unsigned short* CpuLbm::GetPackedFB()
+{
+    return m_packedFB;
+}
+
+int* CpuLbm::GetImage()
+{
+    return m_Im;
+}
+
+int* CpuLbm::GetObstIdMap()
+{
+    return m_obstIdMap;
+}
+
+// ! Scaled copy of the host obstructions under the same ids. Its dense order is the one the node
+// ! image refers to.
+ObstructionStore* CpuLbm::GetSolverObst()
+{
+    return &m_obst;
+}
+
+ObstructionStore* CpuLbm::GetHostObst()
+{
+    return &m_obst_h;
+}
+
+ResidualMonitor* CpuLbm::GetResidualMonitor()
+{
+    return &m_residualMonitor;
+}
+
+// ! rho, u and v planes of the solution at the last residual sample
+float* CpuLbm::GetResidualPrev()
+{
+    return m_residualPrev;
+}
+
+float CpuLbm::GetInletVelocity()
+{
+    return m_inletVelocity;
+}
+
+float CpuLbm::GetOmega()
+{
+    return m_omega;
+}
+
+// ! Like CudaLbm, a different velocity or viscosity starts the residual monitor over
+void CpuLbm::SetInletVelocity(const float velocity)
+{
+    if (velocity != m_inletVelocity)
+        m_residualMonitor.Reset();
+    m_inletVelocity = velocity;
+}
+
+void CpuLbm::SetOmega(const float omega)
+{
+    if (omega != m_omega)
+        m_residualMonitor.Reset();
+    m_omega = omega;
+}
+
+void CpuLbm::TogglePausedState()
+{
+    m_isPaused = !m_isPaused;
+}
+
+void CpuLbm::SetPausedState(const bool isPaused)
+{
+    m_isPaused = isPaused;
+}
+
+bool CpuLbm::IsPaused()
+{
+    return m_isPaused;
+}
+
+int CpuLbm::GetTimeStepsPerFrame()
+{
+    return m_timeStepsPerFrame;
+}
+
+void CpuLbm::SetTimeStepsPerFrame(const int timeSteps)
+{
+    m_timeStepsPerFrame = timeSteps;
+}
+
+// ! Zero uses one thread per logical core
+int CpuLbm::GetNumberOfThreads()
+{
+    return m_numThreads;
+}
+
+void CpuLbm::SetNumberOfThreads(const int numThreads)
+{
+    m_numThreads = std::max(0, numThreads);
+}
+
+bool CpuLbm::IsThreadPinning()
+{
+    return m_isThreadPinning;
+}
+
+// ! Pins each solver thread to its own core, so the rows it steps stay in that core's caches
+void CpuLbm::SetThreadPinning(const bool isPinning)
+{
+    m_isThreadPinning = isPinning;
+}
+
+// ! Threads that step the lattice. The pool is created on first use, on the calling thread, and
+// ! recreated when the thread count or pinning has changed since.
+ThreadPool* CpuLbm::GetThreadPool()
+{
+    int numThreads = m_numThreads > 0 ? m_numThreads : GetHardwareThreadCount();
+    if (m_threadPool != NULL && (m_threadPool->GetThreadCount() != numThreads ||
+        m_threadPool->IsPinned() != m_isThreadPinning))
+    {
+        delete m_threadPool;
+        m_threadPool = NULL;
+    }
+    if (m_threadPool == NULL)
+        m_threadPool = new ThreadPool(numThreads, m_isThreadPinning);
+    return m_threadPool;
+}
+
+SimdIsa CpuLbm::GetSimdIsa()
+{
+    return m_simdIsa;
+}
+
+// ! Requests wider than the CPU supports fall back to the widest supported instruction set
+void CpuLbm::SetSimdIsa(const SimdIsa isa)
+{
+    m_simdIsa = std::min(isa, DetectSimdIsa());
+}
+
+StreamingMode CpuLbm::GetStreamingMode()
+{
+    return m_streamingMode;
+}
+
+// ! Must be called before AllocateHostMemory. In IN_PLACE mode fB is never allocated and GetFB
+// ! returns NULL.
+void CpuLbm::SetStreamingMode(const StreamingMode mode)
+{
+    m_streamingMode = mode;
+}
+
+// ! Number of time steps each tile is advanced while it is in cache, zero for plain sweeps
+int CpuLbm::GetTemporalBlockingDepth()
+{
+    return m_temporalBlockingDepth;
+}
+
+// ! Rounded up to an even depth since MarchSolution steps in pairs. Only used with TWO_BUFFER
+// ! streaming.
+void CpuLbm::SetTemporalBlockingDepth(const int depth)
+{
+    m_temporalBlockingDepth = std::max(0, (depth + 1) / 2 * 2);
+}
+
+void CpuLbm::SwapLattices()
+{
+    std::swap(m_fA, m_fB);
+    std::swap(m_packedFA, m_packedFB);
+}
+
+LatticeStorage CpuLbm::GetLatticeStorage()
+{
+    return m_latticeStorage;
+}
+
+// ! Must be called before AllocateHostMemory. The 16 bit formats hold the lattice in GetPackedFA
+// ! and GetPackedFB and leave GetFA and GetFB NULL. IN_PLACE streaming always stores STORAGE_FP32.
+void CpuLbm::SetLatticeStorage(const LatticeStorage format)
+{
+    m_latticeStorage = format;
+}
+
+CollisionModel CpuLbm::GetCollisionModel()
+{
+    return m_collisionModel;
+}
+
+// ! Selects which instantiation of the row collide MarchSolution uses
+void CpuLbm::SetCollisionModel(const CollisionModel model)
+{
+    m_collisionModel = model;
+}
+
+// ! Page aligned allocation for the solver arrays. Nothing is written here, so no page is placed on
+// ! a NUMA node until it is first touched. Throws std::bad_alloc like new when the memory is not
+// ! available, as the arrays are filled right after. What was allocated before is freed by
+// ! DeallocateHostMemory.
+template <typename T>
+T* AllocatePages(const int count)
+{
+    size_t size = (count*sizeof(T) + HOST_PAGE_SIZE - 1) / HOST_PAGE_SIZE * HOST_PAGE_SIZE;
+#ifdef _MSC_VER
+    void* data = _aligned_malloc(size, HOST_PAGE_SIZE);
+#else
+    void* data = NULL;
+    if (posix_memalign(&data, HOST_PAGE_SIZE, size) != 0)
+        data = NULL;
+#endif
+    if (data == NULL)
+        throw std::bad_alloc();
+    return static_cast<T*>(data);
+}
+
+void FreePages(void* data)
+{
+#ifdef _MSC_VER
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+// ! Sets rows [0, maxYDim) of planeCount planes of data to value on the solver's thread pool. Rows
+// ! [0, yDim) are split into the same bands as the stepping sweeps of MarchSolution, so when this
+// ! is the first write to the array, each band's pages are placed on the NUMA node of the thread
+// ! that will step it. The rows past yDim follow as a range of their own.
+template <typename T>
+void FillRowBands(ThreadPool* threadPool, T* data, const int planeCount, Domain &simDomain,
+    const T value)
+{
+    int pitch = simDomain.GetMaxXDim();
+    int planeSize = simDomain.GetPlaneSize();
+    int yDim = std::min(simDomain.GetYDim(), simDomain.GetMaxYDim());
+    BandFunction fillRows = [&](const int yBegin, const int yEnd, const int /*thread*/)
+    {
+        for (int plane = 0; plane < planeCount; plane++)
+        {
+            T* rows = &data[plane*planeSize + yBegin*pitch];
+            std::fill(rows, rows + (yEnd - yBegin)*pitch, value);
+        }
+    };
+    threadPool->ParallelFor(0, yDim, threadPool->GetBandSize(yDim), fillRows);
+    threadPool->ParallelFor(yDim, simDomain.GetMaxYDim(),
+        threadPool->GetBandSize(simDomain.GetMaxYDim() - yDim), fillRows);
+}
+
+// ! The arrays are first touched here, row band by row band, by the threads that step them. With
+// ! SetThreadPinning those threads stay on their cores, and so next to their bands' memory. The
+// ! domain size and thread settings should be final by now.
+void CpuLbm::AllocateHostMemory()
+{
+    int domainSize = m_domain->GetPlaneSize();
+    ThreadPool* threadPool = GetThreadPool();
+    if (m_streamingMode == StreamingMode::IN_PLACE)
+    {
+        m_latticeStorage = STORAGE_FP32;
+    }
+    if (m_latticeStorage != STORAGE_FP32)
+    {
+        m_packedFA = AllocatePages<unsigned short>(domainSize * 9);
+        m_packedFB = AllocatePages<unsigned short>(domainSize * 9);
+        FillRowBands<unsigned short>(threadPool, m_packedFA, 9, *m_domain, 0);
+        FillRowBands<unsigned short>(threadPool, m_packedFB, 9, *m_domain, 0);
+    }
+    else
+    {
+        m_fA = AllocatePages<float>(domainSize * 9);
+        FillRowBands(threadPool, m_fA, 9, *m_domain, 0.f);
+        if (m_streamingMode == StreamingMode::TWO_BUFFER)
+        {
+            m_fB = AllocatePages<float>(domainSize * 9);
+            FillRowBands(threadPool, m_fB, 9, *m_domain, 0.f);
+        }
+    }
+    m_Im = AllocatePages<int>(domainSize);
+    m_obstIdMap = AllocatePages<int>(domainSize);
+    FillRowBands(threadPool, m_Im, 1, *m_domain, 0);
+    FillRowBands(threadPool, m_obstIdMap, 1, *m_domain, -1);
+    m_residualPrev = AllocatePages<float>(domainSize * 3);
+    FillRowBands(threadPool, m_residualPrev, 3, *m_domain, 0.f);
+}
+
+void CpuLbm::DeallocateHostMemory()
+{
+    FreePages(m_fA);
+    FreePages(m_fB);
+    FreePages(m_packedFA);
+    FreePages(m_packedFB);
+    FreePages(m_Im);
+    FreePages(m_obstIdMap);
+    FreePages(m_residualPrev);
+    m_fA = NULL;
+    m_fB = NULL;
+    m_packedFA = NULL;
+    m_packedFB = NULL;
+    m_Im = NULL;
+    m_obstIdMap = NULL;
+    m_residualPrev = NULL;
+    m_residualMonitor.Reset();
+}
+
+void CpuLbm::InitializeHostMemory()
+{
+    ThreadPool* threadPool = GetThreadPool();
+    if (m_fA != NULL)
+    {
+        FillRowBands(threadPool, m_fA, 9, *m_domain, 0.f);
+    }
+    if (m_fB != NULL)
+    {
+        FillRowBands(threadPool, m_fB, 9, *m_domain, 0.f);
+    }
+    //a stored zero decodes to the lattice weight in every packed format
+    if (m_packedFA != NULL)
+    {
+        FillRowBands<unsigned short>(threadPool, m_packedFA, 9, *m_domain, 0);
+        FillRowBands<unsigned short>(threadPool, m_packedFB, 9, *m_domain, 0);
+    }
+
+    m_obst_h.Clear();
+    m_obst.Clear();
+    m_residualMonitor.Reset();
+
+    m_domain->MarkImageDirty(RectInt(0, 0, m_domain->GetMaxXDim(), m_domain->GetMaxYDim()));
+    UpdateHostImage();
+}
+
+// ! Rebuilds the part of the node image flagged on the domain from the domain boundaries, then
+// ! rasterizes the solid obstructions over their bounding boxes. Obstructions are visited from the
+// ! last dense entry to the first so overlaps resolve to the lowest index, like FindSolidObstruction.
+// ! The node lists of the rebuilt rows and the tiles around them are reclassified afterwards.
+void CpuLbm::UpdateHostImage()
+{
+    Domain* domain = GetDomain();
+    if (!domain->IsImageDirty())
+        return;
+    RectInt rect = domain->GetImageDirtyRect();
+    int pitch = domain->GetMaxXDim();
+    int xEnd = rect.m_x + rect.m_w;
+    int yEnd = rect.m_y + rect.m_h;
+    for (int y = rect.m_y; y < yEnd; y++)
+    {
+        for (int x = rect.m_x; x < xEnd; x++)
+        {
+            m_Im[x + y*pitch] = ImageFcn(x, y);
+            m_obstIdMap[x + y*pitch] = -1;
+        }
+    }
+
+    const Obstruction* obstructions = m_obst.GetData();
+    for (int i = m_obst.GetCount() - 1; i >= 0; i--)
+    {
+        const Obstruction &obst = obstructions[i];
+        if (!IsSolidObstruction(obst))
+            continue;
+        RectInt bounds = GetObstructionBounds(obst);
+        int xMin = std::max(rect.m_x, bounds.m_x);
+        int yMin = std::max(rect.m_y, bounds.m_y);
+        int xMax = std::min(xEnd, bounds.m_x + bounds.m_w);
+        int yMax = std::min(yEnd, bounds.m_y + bounds.m_h);
+        int nodeType = GetObstructionNodeType(obst);
+        for (int y = yMin; y < yMax; y++)
+        {
+            for (int x = xMin; x < xMax; x++)
+            {
+                if (IsInsideObstructionShape(x, y, obst))
+                {
+                    m_Im[x + y*pitch] = nodeType;
+                    m_obstIdMap[x + y*pitch] = i;
+                }
+            }
+        }
+    }
+    m_nodeLists->UpdateRows(m_Im, pitch, domain->GetXDim(), rect.m_y, yEnd);
+    m_activeTiles->Update(m_Im, pitch, domain->GetXDim(), domain->GetYDim(), rect);
+    domain->ClearImageDirtyRect();
+}
+
+int CpuLbm::ImageFcn(const int x, const int y){
+    return GetDomain()->ImageFcn(x, y);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "common.h"
+#include "CpuCollide.h"
+#include "LatticeStorage.h"
+#include "ObstructionStore.h"
+#include "ResidualMonitor.h"
+
+#ifdef LBM_GL_CPP_EXPORTS
+#define FW_API __declspec(dllexport)
+#else
+#define FW_API __declspec(dllimport)
+#endif
+
+class Domain;
+class NodeLists;
+class ActiveTiles;
+class ThreadPool;
+
+// ! Host counterpart of CudaLbm. Owns the lattice, node image and obstruction data in system
+// ! memory so the solver can be stepped on machines without a CUDA capable GPU.
+class FW_API CpuLbm
+{
+private:
+    Domain* m_domain;
+    NodeLists* m_nodeLists;
+    ActiveTiles* m_activeTiles;
+    float* m_fA;
+    float* m_fB;
+    unsigned short* m_packedFA;
+    unsigned short* m_packedFB;
+    int* m_Im;
+    int* m_obstIdMap;
+    ObstructionStore m_obst;
+    ObstructionStore m_obst_h;
+    ResidualMonitor m_residualMonitor;
+    float* m_residualPrev;
+    float m_inletVelocity;
+    float m_omega;
+    bool m_isPaused;
+    int m_timeStepsPerFrame;
+    int m_numThreads;
+    bool m_isThreadPinning;
+    ThreadPool* m_threadPool;
+    SimdIsa m_simdIsa;
+    StreamingMode m_streamingMode;
+    int m_temporalBlockingDepth;
+    LatticeStorage m_latticeStorage;
+    CollisionModel m_collisionModel;
+    void Initialize();
+public:
+    CpuLbm();
+    CpuLbm(const int maxX, const int maxY);
+    ~CpuLbm();
+    Domain* GetDomain();
+    NodeLists* GetNodeLists();
+    ActiveTiles* GetActiveTiles();
+    float* GetFA();
+    float* GetFB();
+    unsigned short* GetPackedFA();
+    unsigned short* GetPackedFB();
+    int* GetImage();
+    int* GetObstIdMap();
+    ObstructionStore* GetSolverObst();
+    ObstructionStore* GetHostObst();
+    ResidualMonitor* GetResidualMonitor();
+    float* GetResidualPrev();
+    float GetInletVelocity();
+    float GetOmega();
+    void SetInletVelocity(const float velocity);
+    void SetOmega(const float omega);
+    void TogglePausedState();
+    void SetPausedState(const bool isPaused);
+    bool IsPaused();
+    int GetTimeStepsPerFrame();
+    void SetTimeStepsPerFrame(const int timeSteps);
+    int GetNumberOfThreads();
+    void SetNumberOfThreads(const int numThreads);
+    bool IsThreadPinning();
+    void SetThreadPinning(const bool isPinning);
+    ThreadPool* GetThreadPool();
+    SimdIsa GetSimdIsa();
+    void SetSimdIsa(const SimdIsa isa);
+    StreamingMode GetStreamingMode();
+    void SetStreamingMode(const StreamingMode mode);
+    int GetTemporalBlockingDepth();
+    void SetTemporalBlockingDepth(const int depth);
+    void SwapLattices();
+    LatticeStorage GetLatticeStorage();
+    void SetLatticeStorage(const LatticeStorage format);
+    CollisionModel GetCollisionModel();
+    void SetCollisionModel(const CollisionModel model);
+
+    void AllocateHostMemory();
+    void InitializeHostMemory();
+    void DeallocateHostMemory();
+    void UpdateHostImage();
+    int ImageFcn(const int x, const int y);
+};
@@ -1,18 +1,100 @@
 #include "CudaLbm.h"
 #include "Domain.h"
 #include <algorithm>
+#include <vector>
 
 CudaLbm::CudaLbm()
 {
     m_domain = new Domain;
     m_isPaused = false;
     m_timeStepsPerFrame = TIMESTEPS_PER_FRAME / 2;
+    m_timeStep = 0;
+    m_streamingMode = StreamingMode::TWO_BUFFER;
+    m_collisionModel = COLLISION_MRT_SMAGORINSKY;
+    m_fB_d = NULL;
+    m_Im_h = NULL;
+    m_boundaryNodes_d = NULL;
+    std::fill(m_boundaryNodeOffsets, m_boundaryNodeOffsets + BOUNDARY_TYPE_COUNT + 1, 0);
+    m_nodeLists = new NodeLists(m_domain->GetMaxYDim());
+    m_activeTiles = new ActiveTiles(m_domain->GetMaxXDim(), m_domain->GetMaxYDim());
+    m_activeTiles_d = NULL;
+    m_activatedTiles_d = NULL;
+    m_activeTileCount = 0;
+    m_activatedTileCount = 0;
+    m_isSurfaceRefreshPending = true;
+    m_imageVersion = 0;
+    for (int slot = 0; slot < SNAPSHOT_SLOTS; slot++)
+    {
+        m_snapshots[slot].nodes_d = NULL;
+        m_snapshots[slot].activeTiles_d = NULL;
+        m_snapshots[slot].activeTileCount = 0;
+        m_snapshots[slot].imageVersion = -1;
+        m_snapshots[slot].hasStrainRate = false;
+    }
+    m_isSnapshotStrainRate = false;
+    m_obstGrid = new ObstructionGrid(std::max(m_domain->GetMaxXDim(), MAX_XDIM),
+        std::max(m_domain->GetMaxYDim(), MAX_YDIM));
+    m_obstGridCellStart_d = NULL;
+    m_obstGridIds_d = NULL;
+    m_obstGridIdCapacity = 0;
+    m_isObstGridDirty = true;
+    m_obst_d = NULL;
+    m_obstCapacity_d = 0;
+    m_obstDeltas_d = NULL;
+    m_obstDeltaCapacity_d = 0;
+    m_residualPrev_d = NULL;
+    m_residualSums_d = NULL;
+    m_residualSums_h = NULL;
+    m_inletVelocity = 0.f;
+    m_omega = 0.f;
 }
 
+// ! The lattice arrays are sized for maxX x maxY nodes. The floor buffer and the vertex buffers
+// ! drawn by GraphicsManager stay MAX_XDIM x MAX_YDIM, so only the default size can be rendered.
 CudaLbm::CudaLbm(const int maxX, const int maxY)
 {
-    m_maxX = maxX;
-    m_maxY = maxY;
+    m_domain = new Domain(maxX, maxY);
+    m_isPaused = false;
+    m_timeStepsPerFrame = TIMESTEPS_PER_FRAME / 2;
+    m_timeStep = 0;
+    m_streamingMode = StreamingMode::TWO_BUFFER;
+    m_collisionModel = COLLISION_MRT_SMAGORINSKY;
+    m_fB_d = NULL;
+    m_Im_h = NULL;
+    m_boundaryNodes_d = NULL;
+    std::fill(m_boundaryNodeOffsets, m_boundaryNodeOffsets + BOUNDARY_TYPE_COUNT + 1, 0);
+    m_nodeLists = new NodeLists(m_domain->GetMaxYDim());
+    m_activeTiles = new ActiveTiles(m_domain->GetMaxXDim(), m_domain->GetMaxYDim());
+    m_activeTiles_d = NULL;
+    m_activatedTiles_d = NULL;
+    m_activeTileCount = 0;
+    m_activatedTileCount = 0;
+    m_isSurfaceRefreshPending = true;
+    m_imageVersion = 0;
+    for (int slot = 0; slot < SNAPSHOT_SLOTS; slot++)
+    {
+        m_snapshots[slot].nodes_d = NULL;
+        m_snapshots[slot].activeTiles_d = NULL;
+        m_snapshots[slot].activeTileCount = 0;
+        m_snapshots[slot].imageVersion = -1;
+        m_snapshots[slot].hasStrainRate = false;
+    }
+    m_isSnapshotStrainRate = false;
+    m_obstGrid = new ObstructionGrid(std::max(m_domain->GetMaxXDim(), MAX_XDIM),
+        std::max(m_domain->GetMaxYDim(), MAX_YDIM));
+    m_obstGridCellStart_d = NULL;
+    m_obstGridIds_d = NULL;
+    m_obstGridIdCapacity = 0;
+    m_isObstGridDirty = true;
+    m_obst_d = NULL;
+    m_obstCapacity_d = 0;
+    m_obstDeltas_d = NULL;
+    m_obstDeltaCapacity_d = 0;
+    m_residualPrev_d = NULL;
+    m_residualSums_d = NULL;
+    m_residualSums_h = NULL;
+    m_inletVelocity = 0.f;
+    m_omega = 0.f;
 }
 
 Domain* CudaLbm::GetDomain()
@@ -35,6 +117,125 @@ int* CudaLbm::GetImage()
     return m_Im_d;
 }
 
+int* CudaLbm::GetObstIdMap()
+{
+    return m_obstIdMap_d;
+}
+
+// ! Device array of the node indices x + y*maxXDim of the boundary nodes of one type
+int* CudaLbm::GetBoundaryNodes(const BoundaryType type)
+{
+    return m_boundaryNodes_d + m_boundaryNodeOffsets[type];
+}
+
+int CudaLbm::GetBoundaryNodeCount(const BoundaryType type)
+{
+    return m_boundaryNodeOffsets[type + 1] - m_boundaryNodeOffsets[type];
+}
+
+// ! Device array of the indices tileX + tileY*GetTilesX() of the tiles that are stepped
+int* CudaLbm::GetActiveTiles()
+{
+    return m_activeTiles_d;
+}
+
+int CudaLbm::GetActiveTileCount()
+{
+    return m_activeTileCount;
+}
+
+// ! Device array of the tiles that became active with the last UpdateBoundaryNodes after being
+// ! skipped as walls. Their distributions are stale until reinitialized.
+int* CudaLbm::GetActivatedTiles()
+{
+    return m_activatedTiles_d;
+}
+
+int CudaLbm::GetActivatedTileCount()
+{
+    return m_activatedTileCount;
+}
+
+int CudaLbm::GetTilesX()
+{
+    return m_activeTiles->GetTilesX();
+}
+
+int CudaLbm::GetTileCount()
+{
+    return m_activeTiles->GetTilesX()*m_activeTiles->GetTilesY();
+}
+
+// ! The surface passes only redraw the active tiles. The rest of the surface is redrawn once after
+// ! the node image or the contour variable changes, so skipped tiles keep an up to date vertex.
+// ! Owned by the render thread, which raises it when a snapshot has a new image version.
+bool CudaLbm::IsSurfaceRefreshPending()
+{
+    return m_isSurfaceRefreshPending;
+}
+
+void CudaLbm::SetSurfaceRefreshPending(const bool isPending)
+{
+    m_isSurfaceRefreshPending = isPending;
+}
+
+// ! Counts the node image rebuilds, so a snapshot tells the render thread whether walls moved since
+// ! the one it last drew, even if the snapshots in between were never acquired
+int CudaLbm::GetImageVersion()
+{
+    return m_imageVersion;
+}
+
+// ! Snapshot slot the solver thread fills next. It is not read by the render thread until
+// ! PublishSnapshot.
+SolutionSnapshot* CudaLbm::GetSnapshotToWrite()
+{
+    return &m_snapshots[m_snapshotBuffer.GetWriteSlot()];
+}
+
+// ! The device writes into the slot must have completed
+void CudaLbm::PublishSnapshot()
+{
+    m_snapshotBuffer.Publish();
+}
+
+// ! Called by the render thread once per frame. Returns true if a snapshot newer than the one it
+// ! was rendering has been published, which GetRenderSnapshot then returns.
+bool CudaLbm::AcquireSnapshot()
+{
+    return m_snapshotBuffer.Acquire();
+}
+
+// ! Snapshot the render thread draws from, or NULL until the solver thread published one
+SolutionSnapshot* CudaLbm::GetRenderSnapshot()
+{
+    int slot = m_snapshotBuffer.GetReadSlot();
+    if (slot < 0)
+        return NULL;
+    return &m_snapshots[slot];
+}
+
+bool CudaLbm::IsSnapshotStrainRate()
+{
+    return m_isSnapshotStrainRate;
+}
+
+// ! The strain rate of snapshots is only computed while it is drawn, since it takes most of the
+// ! cost of taking one. Set under GetSolverMutex.
+void CudaLbm::SetSnapshotStrainRate(const bool isStrainRate)
+{
+    m_isSnapshotStrainRate = isStrainRate;
+}
+
+// ! Held by the solver thread while it queues a batch of steps, and by the render thread while it
+// ! changes solver inputs or launches kernels that read the obstructions, so the host side state
+// ! they share, from the obstruction mirror and delta queue to the dirty rect of the domain, only
+// ! changes between batches
+std::mutex &CudaLbm::GetSolverMutex()
+{
+    return m_solverMutex;
+}
+
 float* CudaLbm::GetFloorTemp()
 {
     return m_FloorTemp_d;
@@ -45,9 +246,114 @@ Obstruction* CudaLbm::GetDeviceObst()
     return m_obst_d;
 }
 
-Obstruction* CudaLbm::GetHostObst()
+ObstructionStore* CudaLbm::GetHostObst()
+{
+    return &m_obst_h;
+}
+
+// ! Host copy of what was last uploaded to the device obstruction array, under the host ids. The
+// ! device array holds its dense entries in the same order.
+ObstructionStore* CudaLbm::GetDeviceObstMirror()
+{
+    return &m_obstMirror_h;
+}
+
+// ! Grows the device obstruction array to hold at least count entries, keeping its contents so the
+// ! state changes made on the device survive
+void CudaLbm::ReserveDeviceObst(const int count)
+{
+    if (count <= m_obstCapacity_d)
+        return;
+    int capacity = std::max(count, 2*m_obstCapacity_d);
+    Obstruction* obst_d;
+    cudaMalloc((void **)&obst_d, capacity*sizeof(Obstruction));
+    cudaMemcpy(obst_d, m_obst_d, m_obstCapacity_d*sizeof(Obstruction), cudaMemcpyDeviceToDevice);
+    cudaFree(m_obst_d);
+    m_obst_d = obst_d;
+    m_obstCapacity_d = capacity;
+}
+
+// ! Mirror entries changed since the last ApplyDeviceObstructionDeltas
+ObstructionDeltaQueue* CudaLbm::GetObstDeltas()
+{
+    return &m_obstDeltas;
+}
+
+ObstructionDelta* CudaLbm::GetDeviceObstDeltas()
+{
+    return m_obstDeltas_d;
+}
+
+// ! Grows the device staging array for queued obstruction changes. Its contents are not kept.
+void CudaLbm::ReserveDeviceObstDeltas(const int count)
+{
+    if (count <= m_obstDeltaCapacity_d)
+        return;
+    cudaFree(m_obstDeltas_d);
+    m_obstDeltaCapacity_d = std::max(count, 2*m_obstDeltaCapacity_d);
+    cudaMalloc((void **)&m_obstDeltas_d, m_obstDeltaCapacity_d*sizeof(ObstructionDelta));
+}
+
+// ! Bucket index of the device obstructions for the query functions in ObstructionGeometry.h. It is
+// ! built from the mirror, so it is rebuilt and uploaded here after queued obstruction changes were
+// ! applied to the device array. The device may have retired removed obstructions since, which
+// ! queries still check.
+ObstructionGridView CudaLbm::GetObstructionGrid()
+{
+    if (m_isObstGridDirty)
+    {
+        m_obstGrid->Build(m_obstMirror_h.GetData(), m_obstMirror_h.GetCount());
+        const std::vector<int> &cellStart = m_obstGrid->GetCellStart();
+        const std::vector<int> &ids = m_obstGrid->GetIds();
+        int idCount = static_cast<int>(ids.size());
+        if (idCount > m_obstGridIdCapacity)
+        {
+            cudaFree(m_obstGridIds_d);
+            m_obstGridIdCapacity = std::max(idCount, 2*m_obstGridIdCapacity);
+            cudaMalloc((void **)&m_obstGridIds_d, m_obstGridIdCapacity*sizeof(int));
+        }
+        cudaMemcpy(m_obstGridCellStart_d, &cellStart[0], cellStart.size()*sizeof(int),
+            cudaMemcpyHostToDevice);
+        if (idCount > 0)
+        {
+            cudaMemcpy(m_obstGridIds_d, &ids[0], idCount*sizeof(int), cudaMemcpyHostToDevice);
+        }
+        m_isObstGridDirty = false;
+    }
+    ObstructionGridView view;
+    view.cellStart = m_obstGridCellStart_d;
+    view.ids = m_obstGridIds_d;
+    view.cellsX = m_obstGrid->GetCellsX();
+    view.cellsY = m_obstGrid->GetCellsY();
+    return view;
+}
+
+void CudaLbm::MarkObstructionGridDirty()
+{
+    m_isObstGridDirty = true;
+}
+
+ResidualMonitor* CudaLbm::GetResidualMonitor()
 {
-    return &m_obst_h[0];
+    return &m_residualMonitor;
+}
+
+// ! rho, u and v of every node at the last residual sample
+float4* CudaLbm::GetResidualPrev()
+{
+    return m_residualPrev_d;
+}
+
+// ! The four ResidualSums of the sample being reduced, on the device
+float* CudaLbm::GetResidualSums()
+{
+    return m_residualSums_d;
+}
+
+// ! Page-locked copy of GetResidualSums, so it can be read back without blocking the stream
+float* CudaLbm::GetHostResidualSums()
+{
+    return m_residualSums_h;
 }
 
 float CudaLbm::GetInletVelocity()
@@ -60,23 +366,32 @@ float CudaLbm::GetOmega()
     return m_omega;
 }
 
+// ! A different velocity changes the flow the solver is converging to, so the residual monitor
+// ! starts over
 void CudaLbm::SetInletVelocity(const float velocity)
 {
+    if (velocity != m_inletVelocity)
+        m_residualMonitor.Reset();
     m_inletVelocity = velocity;
 }
 
 void CudaLbm::SetOmega(const float omega)
 {
+    if (omega != m_omega)
+        m_residualMonitor.Reset();
     m_omega = omega;
 }
 
+// ! Takes the solver mutex, so the solver thread sees the change from its next batch on
 void CudaLbm::TogglePausedState()
 {
+    std::lock_guard<std::mutex> lock(m_solverMutex);
     m_isPaused = !m_isPaused;
 }
 
 void CudaLbm::SetPausedState(const bool isPaused)
 {
+    std::lock_guard<std::mutex> lock(m_solverMutex);
     m_isPaused = isPaused;
 }
 
@@ -95,45 +410,135 @@ void CudaLbm::SetTimeStepsPerFrame(const int timeSteps)
     m_timeStepsPerFrame = timeSteps;
 }
 
+// ! Steps taken since the flow was initialized or restored, which checkpoints carry on from
+long long CudaLbm::GetTimeStep()
+{
+    return m_timeStep;
+}
+
+void CudaLbm::SetTimeStep(const long long timeStep)
+{
+    m_timeStep = timeStep;
+}
+
+void CudaLbm::AddTimeSteps(const int steps)
+{
+    m_timeStep += steps;
+}
+
+StreamingMode CudaLbm::GetStreamingMode()
+{
+    return m_streamingMode;
+}
+
+// ! Must be called before AllocateDeviceMemory. In IN_PLACE mode fB is never allocated and GetFB
+// ! returns NULL.
+void CudaLbm::SetStreamingMode(const StreamingMode mode)
+{
+    m_streamingMode = mode;
+}
+
+CollisionModel CudaLbm::GetCollisionModel()
+{
+    return m_collisionModel;
+}
+
+// ! Selects which instantiation of the stepping kernels MarchSolution launches
+void CudaLbm::SetCollisionModel(const CollisionModel model)
+{
+    m_collisionModel = model;
+}
+
 
 
 void CudaLbm::AllocateDeviceMemory()
 {
-    size_t memsize_lbm, memsize_int, memsize_float, memsize_inputs;
+    size_t memsize_lbm, memsize_int, memsize_float;
 
-    int domainSize = ceil(MAX_XDIM / BLOCKSIZEX)*BLOCKSIZEX*ceil(MAX_YDIM / BLOCKSIZEY)*BLOCKSIZEY;
+    int domainSize = m_domain->GetPlaneSize();
     memsize_lbm = domainSize*sizeof(float)*9;
     memsize_int = domainSize*sizeof(int);
-    memsize_float = domainSize*sizeof(float);
-    memsize_inputs = sizeof(m_obst_h);
-
-    float* fA_h = new float[domainSize * 9];
-    float* fB_h = new float[domainSize * 9];
-    float* floor_h = new float[domainSize];
-    int* im_h = new int[domainSize];
+    memsize_float = MAX_XDIM*MAX_YDIM*sizeof(float);
 
     cudaMalloc((void **)&m_fA_d, memsize_lbm);
-    cudaMalloc((void **)&m_fB_d, memsize_lbm);
+    if (m_streamingMode == StreamingMode::TWO_BUFFER)
+    {
+        cudaMalloc((void **)&m_fB_d, memsize_lbm);
+    }
     cudaMalloc((void **)&m_FloorTemp_d, memsize_float);
     cudaMalloc((void **)&m_Im_d, memsize_int);
-    cudaMalloc((void **)&m_obst_d, memsize_inputs);
+    cudaMalloc((void **)&m_obstIdMap_d, memsize_int);
+    cudaMalloc((void **)&m_boundaryNodes_d, memsize_int);
+    cudaMalloc((void **)&m_activeTiles_d, GetTileCount()*sizeof(int));
+    cudaMalloc((void **)&m_activatedTiles_d, GetTileCount()*sizeof(int));
+    m_Im_h = new int[domainSize];
+    m_obstCapacity_d = OBST_INITIAL_CAPACITY;
+    cudaMalloc((void **)&m_obst_d, m_obstCapacity_d*sizeof(Obstruction));
+    cudaMalloc((void **)&m_obstGridCellStart_d, (m_obstGrid->GetCellCount() + 1)*sizeof(int));
+    for (int slot = 0; slot < SNAPSHOT_SLOTS; slot++)
+    {
+        cudaMalloc((void **)&m_snapshots[slot].nodes_d, domainSize*sizeof(MacroNode));
+        cudaMalloc((void **)&m_snapshots[slot].activeTiles_d, GetTileCount()*sizeof(int));
+    }
+    cudaMalloc((void **)&m_residualPrev_d, domainSize*sizeof(float4));
+    cudaMalloc((void **)&m_residualSums_d, 4*sizeof(float));
+    cudaMallocHost((void **)&m_residualSums_h, 4*sizeof(float));
 }
 
 void CudaLbm::DeallocateDeviceMemory()
 {
     cudaFree(m_fA_d);
     cudaFree(m_fB_d);
+    m_fB_d = NULL;
     cudaFree(m_Im_d);
+    cudaFree(m_obstIdMap_d);
+    cudaFree(m_boundaryNodes_d);
+    m_boundaryNodes_d = NULL;
+    cudaFree(m_activeTiles_d);
+    cudaFree(m_activatedTiles_d);
+    m_activeTiles_d = NULL;
+    m_activatedTiles_d = NULL;
+    delete[] m_Im_h;
+    m_Im_h = NULL;
     cudaFree(m_FloorTemp_d);
     cudaFree(m_obst_d);
+    m_obst_d = NULL;
+    m_obstCapacity_d = 0;
+    cudaFree(m_obstDeltas_d);
+    m_obstDeltas_d = NULL;
+    m_obstDeltaCapacity_d = 0;
+    cudaFree(m_obstGridCellStart_d);
+    cudaFree(m_obstGridIds_d);
+    m_obstGridCellStart_d = NULL;
+    m_obstGridIds_d = NULL;
+    m_obstGridIdCapacity = 0;
+    m_isObstGridDirty = true;
+    for (int slot = 0; slot < SNAPSHOT_SLOTS; slot++)
+    {
+        cudaFree(m_snapshots[slot].nodes_d);
+        cudaFree(m_snapshots[slot].activeTiles_d);
+        m_snapshots[slot].nodes_d = NULL;
+        m_snapshots[slot].activeTiles_d = NULL;
+        m_snapshots[slot].activeTileCount = 0;
+        m_snapshots[slot].imageVersion = -1;
+    }
+    m_snapshotBuffer.Reset();
+    cudaFree(m_residualPrev_d);
+    cudaFree(m_residualSums_d);
+    cudaFreeHost(m_residualSums_h);
+    m_residualPrev_d = NULL;
+    m_residualSums_d = NULL;
+    m_residualSums_h = NULL;
+    m_residualMonitor.Reset();
 }
 
 void CudaLbm::InitializeDeviceMemory()
 {
-    int domainSize = ceil(MAX_XDIM / BLOCKSIZEX)*BLOCKSIZEX*ceil(MAX_YDIM / BLOCKSIZEY)*BLOCKSIZEY;
-    size_t memsize_lbm, memsize_float, memsize_inputs;
+    int domainSize = m_domain->GetPlaneSize();
+    int floorSize = MAX_XDIM*MAX_YDIM;
+    size_t memsize_lbm, memsize_float;
     memsize_lbm = domainSize*sizeof(float)*9;
-    memsize_float = domainSize*sizeof(float);
+    memsize_float = floorSize*sizeof(float);
 
     float* f_h = new float[domainSize*9];
     for (int i = 0; i < domainSize * 9; i++)
@@ -141,71 +546,90 @@ void CudaLbm::InitializeDeviceMemory()
         f_h[i] = 0;
     }
     cudaMemcpy(m_fA_d, f_h, memsize_lbm, cudaMemcpyHostToDevice);
-    cudaMemcpy(m_fB_d, f_h, memsize_lbm, cudaMemcpyHostToDevice);
+    if (m_fB_d != NULL)
+    {
+        cudaMemcpy(m_fB_d, f_h, memsize_lbm, cudaMemcpyHostToDevice);
+    }
     delete[] f_h;
-    float* floor_h = new float[domainSize];
-    for (int i = 0; i < domainSize; i++)
+    float* floor_h = new float[floorSize];
+    for (int i = 0; i < floorSize; i++)
     {
         floor_h[i] = 0;
     }
     cudaMemcpy(m_FloorTemp_d, floor_h, memsize_float, cudaMemcpyHostToDevice);
     delete[] floor_h;
 
-    UpdateDeviceImage();
+    m_obst_h.Clear();
+    Obstruction obst;
+    obst.r1 = 15.0;
+    obst.r2 = 0;
+    obst.x = 150;// g_xDim*0.2f;
+    obst.y = 250;// g_yDim*0.3f;
+    obst.u = 0;// g_yDim*0.3f;
+    obst.v = 0;// g_yDim*0.3f;
+    obst.shape = Shape::VERTICAL_LINE;
+    obst.state = State::NEW;
+    m_obst_h.Add(obst);
+
+    obst.r1 = 12.0;
+    obst.x = 200;// g_xDim*0.2f;
+    obst.y = 180;// g_yDim*0.3f;
+    obst.shape = Shape::SQUARE;
+    m_obst_h.Add(obst);
+
+    m_obstMirror_h = m_obst_h;
+    m_obstDeltas.Clear();
+    ReserveDeviceObst(m_obstMirror_h.GetCount());
+    cudaMemcpy(m_obst_d, m_obstMirror_h.GetData(), m_obstMirror_h.GetCount()*sizeof(Obstruction),
+        cudaMemcpyHostToDevice);
+    m_isObstGridDirty = true;
+    m_domain->MarkImageDirty(RectInt(0, 0, m_domain->GetMaxXDim(), m_domain->GetMaxYDim()));
+    m_snapshotBuffer.Reset();
+    m_residualMonitor.Reset();
+}
+
+// ! Reclassifies the rows of rect from the device node image, along with the tiles around it, and
+// ! uploads the boundary node lists of all types and the active tiles. Only called when the image
+// ! was rebuilt, so the copies stay off the stepping path.
+void CudaLbm::UpdateBoundaryNodes(const RectInt &rect)
+{
+    int pitch = m_domain->GetMaxXDim();
+    int yBegin = rect.m_y;
+    int rowEnd = std::min(rect.m_y + rect.m_h, m_domain->GetMaxYDim());
+    if (yBegin >= rowEnd)
+        return;
+    cudaMemcpy(&m_Im_h[yBegin*pitch], &m_Im_d[yBegin*pitch], (rowEnd - yBegin)*pitch*sizeof(int),
+        cudaMemcpyDeviceToHost);
+    m_nodeLists->UpdateRows(m_Im_h, pitch, m_domain->GetXDim(), yBegin, rowEnd);
+    m_activeTiles->Update(m_Im_h, pitch, m_domain->GetXDim(), m_domain->GetYDim(), rect);
+
+    std::vector<int> nodes;
+    m_nodeLists->GetBoundaryNodes(nodes, m_boundaryNodeOffsets, pitch, m_domain->GetYDim(),
+        *m_activeTiles);
+    if (!nodes.empty())
+    {
+        cudaMemcpy(m_boundaryNodes_d, &nodes[0], nodes.size()*sizeof(int),
+            cudaMemcpyHostToDevice);
+    }
 
-    for (int i = 0; i < MAXOBSTS; i++)
+    const std::vector<int> &activeTiles = m_activeTiles->GetActiveTiles();
+    m_activeTileCount = static_cast<int>(activeTiles.size());
+    if (m_activeTileCount > 0)
     {
-        m_obst_h[i].r1 = 0;
-        m_obst_h[i].x = 0;
-        m_obst_h[i].y = -1000;
-        m_obst_h[i].state = State::REMOVED;
-    }	
-    m_obst_h[0].r1 = 15.0;
-    m_obst_h[0].x = 150;// g_xDim*0.2f;
-    m_obst_h[0].y = 250;// g_yDim*0.3f;
-    m_obst_h[0].u = 0;// g_yDim*0.3f;
-    m_obst_h[0].v = 0;// g_yDim*0.3f;
-    m_obst_h[0].shape = Shape::VERTICAL_LINE;
-    m_obst_h[0].state = State::NEW;
-
-    m_obst_h[1].r1 = 12.0;
-    m_obst_h[1].x = 200;// g_xDim*0.2f;
-    m_obst_h[1].y = 180;// g_yDim*0.3f;
-    m_obst_h[1].u = 0;// g_yDim*0.3f;
-    m_obst_h[1].v = 0;// g_yDim*0.3f;
-    m_obst_h[1].shape = Shape::SQUARE;
-    m_obst_h[1].state = State::NEW;
-
-    memsize_inputs = sizeof(m_obst_h);
-    cudaMemcpy(m_obst_d, m_obst_h, memsize_inputs, cudaMemcpyHostToDevice);
-}
-
-void CudaLbm::UpdateDeviceImage()
-{
-    int domainSize = ceil(MAX_XDIM / BLOCKSIZEX)*BLOCKSIZEX*ceil(MAX_YDIM / BLOCKSIZEY)*BLOCKSIZEY;
-    int* im_h = new int[domainSize];
-    for (int i = 0; i < domainSize; i++)
+        cudaMemcpy(m_activeTiles_d, &activeTiles[0], m_activeTileCount*sizeof(int),
+            cudaMemcpyHostToDevice);
+    }
+    const std::vector<int> &activatedTiles = m_activeTiles->GetActivatedTiles();
+    m_activatedTileCount = static_cast<int>(activatedTiles.size());
+    if (m_activatedTileCount > 0)
     {
-        int x = i%MAX_XDIM;
-        int y = i/MAX_XDIM;
-        im_h[i] = ImageFcn(x, y);
+        cudaMemcpy(m_activatedTiles_d, &activatedTiles[0], m_activatedTileCount*sizeof(int),
+            cudaMemcpyHostToDevice);
     }
-    size_t memsize_int = domainSize*sizeof(int);
-    cudaMemcpy(m_Im_d, im_h, memsize_int, cudaMemcpyHostToDevice);
-    delete[] im_h;
+    m_activeTiles->ClearActivatedTiles();
+    m_imageVersion++;
 }
 
 int CudaLbm::ImageFcn(const int x, const int y){
-    int xDim = GetDomain()->GetXDim();
-    int yDim = GetDomain()->GetYDim();
-    if (x < 0.1f)
-        return 3;//west
-    else if ((xDim - x) < 1.1f)
-        return 2;//east
-    else if ((yDim - y) < 1.1f)
-        return 11;//11;//xsymmetry top
-    else if (y < 0.1f)
-        return 12;//12;//xsymmetry bottom
-    return 0;
+    return GetDomain()->ImageFcn(x, y);
 }
-
@@ -1,6 +1,16 @@
 #pragma once
 #include "common.h"
+#include "CollisionModels.h"
+#include "NodeLists.h"
+#include "ActiveTiles.h"
+#include "ObstructionGrid.h"
+#include "ObstructionStore.h"
+#include "ObstructionDeltaQueue.h"
+#include "SnapshotTripleBuffer.h"
+#include "ResidualMonitor.h"
+#include "Domain.h"
 #include "cuda_runtime.h"
+#include <mutex>
 
 #ifdef LBM_GL_CPP_EXPORTS  
 #define FW_API __declspec(dllexport)   
@@ -8,24 +18,78 @@
 #define FW_API __declspec(dllimport)   
 #endif  
 
-class Domain;
+// ! Macroscopic fields of one node in a solution snapshot. im is the node image code, which the
+// ! surface pass colors walls with.
+struct MacroNode
+{
+    float rho;
+    float u;
+    float v;
+    float strainRate;
+    int im;
+};
+
+// ! Solution published by the solver thread for rendering: the macro fields of every node, with
+// ! the pitch of the lattice, and copies of the active tiles and the domain they were computed with.
+// ! imageVersion changes whenever the node image was rebuilt before the snapshot was taken.
+// ! hasStrainRate is false if only rho, u and v were computed.
+struct SolutionSnapshot
+{
+    MacroNode* nodes_d;
+    int* activeTiles_d;
+    int activeTileCount;
+    int imageVersion;
+    bool hasStrainRate;
+    Domain domain;
+};
 
 class FW_API CudaLbm
 {
 private:
-    int m_maxX;
-    int m_maxY;
     Domain* m_domain;
     float* m_fA_d;
     float* m_fB_d;
     int* m_Im_d;
+    int* m_obstIdMap_d;
+    int* m_Im_h;
+    int* m_boundaryNodes_d;
+    int m_boundaryNodeOffsets[BOUNDARY_TYPE_COUNT + 1];
+    NodeLists* m_nodeLists;
+    ActiveTiles* m_activeTiles;
+    int* m_activeTiles_d;
+    int* m_activatedTiles_d;
+    int m_activeTileCount;
+    int m_activatedTileCount;
+    bool m_isSurfaceRefreshPending;
+    int m_imageVersion;
+    SolutionSnapshot m_snapshots[SNAPSHOT_SLOTS];
+    SnapshotTripleBuffer m_snapshotBuffer;
+    bool m_isSnapshotStrainRate;
+    std::mutex m_solverMutex;
     float* m_FloorTemp_d;
     Obstruction* m_obst_d;
-    Obstruction m_obst_h[MAXOBSTS];
+    int m_obstCapacity_d;
+    ObstructionStore m_obst_h;
+    ObstructionStore m_obstMirror_h;
+    ObstructionDeltaQueue m_obstDeltas;
+    ObstructionDelta* m_obstDeltas_d;
+    int m_obstDeltaCapacity_d;
+    ObstructionGrid* m_obstGrid;
+    int* m_obstGridCellStart_d;
+    int* m_obstGridIds_d;
+    int m_obstGridIdCapacity;
+    bool m_isObstGridDirty;
+    ResidualMonitor m_residualMonitor;
+    float4* m_residualPrev_d;
+    float* m_residualSums_d;
+    float* m_residualSums_h;
     float m_inletVelocity;
     float m_omega;
     bool m_isPaused;
     int m_timeStepsPerFrame;
+    long long m_timeStep;
+    StreamingMode m_streamingMode;
+    CollisionModel m_collisionModel;
 public:
     CudaLbm();
     CudaLbm(const int maxX, const int maxY);
@@ -33,9 +97,39 @@ public:
     float* GetFA();
     float* GetFB();
     int* GetImage();
+    int* GetObstIdMap();
+    int* GetBoundaryNodes(const BoundaryType type);
+    int GetBoundaryNodeCount(const BoundaryType type);
+    int* GetActiveTiles();
+    int GetActiveTileCount();
+    int* GetActivatedTiles();
+    int GetActivatedTileCount();
+    int GetTilesX();
+    int GetTileCount();
+    bool IsSurfaceRefreshPending();
+    void SetSurfaceRefreshPending(const bool isPending);
+    int GetImageVersion();
+    SolutionSnapshot* GetSnapshotToWrite();
+    void PublishSnapshot();
+    bool AcquireSnapshot();
+    SolutionSnapshot* GetRenderSnapshot();
+    bool IsSnapshotStrainRate();
+    void SetSnapshotStrainRate(const bool isStrainRate);
+    std::mutex &GetSolverMutex();
     float* GetFloorTemp();
     Obstruction* GetDeviceObst();
-    Obstruction* GetHostObst();
+    ObstructionStore* GetHostObst();
+    ObstructionStore* GetDeviceObstMirror();
+    void ReserveDeviceObst(const int count);
+    ObstructionDeltaQueue* GetObstDeltas();
+    ObstructionDelta* GetDeviceObstDeltas();
+    void ReserveDeviceObstDeltas(const int count);
+    ObstructionGridView GetObstructionGrid();
+    void MarkObstructionGridDirty();
+    ResidualMonitor* GetResidualMonitor();
+    float4* GetResidualPrev();
+    float* GetResidualSums();
+    float* GetHostResidualSums();
     float GetInletVelocity();
     float GetOmega();
     void SetInletVelocity(const float velocity);
@@ -45,11 +139,18 @@ public:
     bool IsPaused();
     int GetTimeStepsPerFrame();
     void SetTimeStepsPerFrame(const int timeSteps);
+    long long GetTimeStep();
+    void SetTimeStep(const long long timeStep);
+    void AddTimeSteps(const int steps);
+    StreamingMode GetStreamingMode();
+    void SetStreamingMode(const StreamingMode mode);
+    CollisionModel GetCollisionModel();
+    void SetCollisionModel(const CollisionModel model);
 
     void AllocateDeviceMemory();
     void InitializeDeviceMemory();
     void DeallocateDeviceMemory();
-    void UpdateDeviceImage();
+    void UpdateBoundaryNodes(const RectInt &rect);
     int ImageFcn(const int x, const int y);
 
    
@@ -1,6 +1,7 @@
 #include "GraphicsManager.h"
 #include "ShaderManager.h"
 #include "CudaLbm.h"
+#include "SolverThread.h"
 #include "Shader.h"
 #include "Panel/Slider.h"
 #include "Panel/SliderBar.h"
@@ -8,6 +9,7 @@
 #include "Layout.h"
 #include "kernel.h"
 #include "Domain.h"
+#include "FrameProfiler.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
@@ -23,6 +25,7 @@ GraphicsManager::GraphicsManager(Panel* panel)
     m_obstructions = m_graphics->GetCudaLbm()->GetHostObst();
     m_rotate = { 45.f, 0.f, 45.f };
     m_translate = { 0.f, 0.f, 0.0f };
+    m_solverThread = NULL;
 }
 
 void GraphicsManager::UseCuda(bool useCuda)
@@ -87,6 +90,10 @@ ContourVariable GraphicsManager::GetContourVar()
 
 void GraphicsManager::SetContourVar(const ContourVariable contourVar)
 {
+    if (contourVar != m_contourVar)
+    {
+        GetCudaLbm()->SetSurfaceRefreshPending(true);
+    }
     m_contourVar = contourVar;
 }
 
@@ -96,7 +103,7 @@ Shape GraphicsManager::GetCurrentObstShape()
     return m_currentObstShape;
 }
 
-void GraphicsManager::SetObstructionsPointer(Obstruction* obst)
+void GraphicsManager::SetObstructionsPointer(ObstructionStore* obst)
 {
     m_obstructions = m_graphics->GetCudaLbm()->GetHostObst();
 }
@@ -111,6 +118,107 @@ void GraphicsManager::SetScaleFactor(const float scaleFactor)
     m_scaleFactor = scaleFactor;
 }
 
+float GraphicsManager::GetTargetFrameTime()
+{
+    return m_targetFrameTime;
+}
+
+// ! Time in milliseconds the CUDA solver sizes each batch of steps to. Shorter targets apply input
+// ! and publish snapshots more often; longer ones leave more of the GPU to the steps themselves.
+void GraphicsManager::SetTargetFrameTime(const float milliseconds)
+{
+    m_targetFrameTime = milliseconds;
+    if (m_solverThread != NULL)
+    {
+        m_solverThread->SetTargetFrameTime(milliseconds);
+    }
+}
+
+// ! Smoothed time the CUDA solver takes per step pair, or 0 until it has timed a batch
+float GraphicsManager::GetSolverMsPerStep()
+{
+    if (m_solverThread == NULL)
+        return 0.f;
+    return m_solverThread->GetMsPerStep();
+}
+
+// ! Time steps the solver takes per second at the moment. The CUDA solver steps on its own thread,
+// ! so its rate follows from the time it measures per batch rather than from the frame rate, and is
+// ! 0 while it is paused or the flow is steady. The compute shader path steps once per frame.
+float GraphicsManager::GetSolverStepsPerSecond(const float fps)
+{
+    if (!m_useCuda)
+        return 2.f*COMPUTE_SHADER_STEP_PAIRS*fps;
+    float msPerStep = GetSolverMsPerStep();
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    if (msPerStep <= 0.f || cudaLbm->IsPaused() || cudaLbm->GetResidualMonitor()->IsConverged())
+        return 0.f;
+    return 2000.f / msPerStep;
+}
+
+// ! Stops stepping the CUDA solver once the change of the flow per step falls below threshold,
+// ! until an obstruction, the inlet velocity or the viscosity changes. 0 keeps it stepping.
+void GraphicsManager::SetSteadyStateThreshold(const float threshold)
+{
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    ResidualMonitor* residualMonitor = cudaLbm->GetResidualMonitor();
+    if (threshold > 0.f)
+        residualMonitor->SetThreshold(threshold);
+    residualMonitor->SetEnabled(threshold > 0.f);
+}
+
+bool GraphicsManager::IsSteadyState()
+{
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    return cudaLbm->GetResidualMonitor()->IsConverged();
+}
+
+// ! Version of the solution that will include an obstruction moved from now on. The CUDA solver
+// ! counts its node image rebuilds, and the first rebuild after the move includes it. The compute
+// ! shader applies moves in the next frame, so every frame includes them.
+int GraphicsManager::GetNextObstructionVersion()
+{
+    if (!m_useCuda)
+        return 0;
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    return cudaLbm->GetImageVersion() + 1;
+}
+
+// ! Saves the flow and obstructions of the CUDA solver, which the compute shader path has no
+// ! access to
+CheckpointStatus GraphicsManager::SaveCheckpoint(const std::string &path)
+{
+    if (!m_useCuda)
+        return CHECKPOINT_IO_ERROR;
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    return ::SaveCheckpoint(cudaLbm, path);
+}
+
+// ! Replaces the flow and obstructions with those of a checkpoint. Obstructions still fading out
+// ! belong to the replaced scene and are dropped.
+CheckpointStatus GraphicsManager::LoadCheckpoint(const std::string &path)
+{
+    if (!m_useCuda)
+        return CHECKPOINT_IO_ERROR;
+    CudaLbm* cudaLbm = GetCudaLbm();
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    CheckpointStatus status = ::LoadCheckpoint(cudaLbm, path);
+    if (status == CHECKPOINT_OK)
+        m_retiringObstructions.clear();
+    return status;
+}
+
+// ! Version of the solution drawn in the current frame, as counted by GetNextObstructionVersion
+int GraphicsManager::GetPresentedObstructionVersion()
+{
+    return m_useCuda ? m_surfaceImageVersion : 0;
+}
+
 CudaLbm* GraphicsManager::GetCudaLbm()
 {
     return m_graphics->GetCudaLbm();
@@ -204,26 +312,25 @@ void GraphicsManager::SetUpCuda()
     cudaGraphicsResourceGetMappedPointer((void **)&dptr, &num_bytes, cudaSolutionField);
 
     Domain* domain = cudaLbm->GetDomain();
-    InitializeDomain(dptr, fA_d, im_d, u, *domain);
-    InitializeDomain(dptr, fB_d, im_d, u, *domain);
+    InitializeDomain(dptr, fA_d, im_d, u, cudaLbm->GetStreamingMode(), *domain);
+    if (fB_d != NULL)
+    {
+        InitializeDomain(dptr, fB_d, im_d, u, cudaLbm->GetStreamingMode(), *domain);
+    }
 
     InitializeFloor(dptr, floor_d, *domain);
 
     cudaGraphicsUnmapResources(1, &cudaSolutionField, 0);
-}
 
-int TimeStepSelector(const int nodes)
-{
-    if (nodes < 100000)
+    FrameProfiler::Instance().SetDeviceSyncFunction([]()
     {
-        return std::min(60.f, 60 - 40 * (float)(nodes - 10000)/100000);
-    }
-    else
-    {
-        return std::max(10.f, 20 - 20 * (float)(nodes - 100000)/150000);
-    }
+        cudaStreamSynchronize(cudaStreamPerThread);
+    });
 }
 
+// ! Draws the newest solution the solver thread published, starting the thread on the first call.
+// ! The solver inputs are handed over under the solver mutex, which is also held while the lighting
+// ! kernels that read the obstructions are queued, but the frame never waits for a batch of steps.
 void GraphicsManager::RunCuda()
 {
     // map OpenGL buffer object for writing from CUDA
@@ -245,28 +352,51 @@ void GraphicsManager::RunCuda()
 
 
     UpdateLbmInputs();
-    float u = cudaLbm->GetInletVelocity();
-    float omega = cudaLbm->GetOmega();
-
-    float* floorTemp_d = cudaLbm->GetFloorTemp();
-    Obstruction* obst_d = cudaLbm->GetDeviceObst();
-    Obstruction* obst_h = cudaLbm->GetHostObst();
+    {
+        std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+        cudaLbm->SetSnapshotStrainRate(m_contourVar == ContourVariable::STRAIN_RATE);
+    }
+    if (m_solverThread == NULL)
+    {
+        m_solverThread = new SolverThread(cudaLbm);
+        m_solverThread->SetTargetFrameTime(m_targetFrameTime);
+        m_solverThread->Start();
+    }
 
-    Domain* domain = cudaLbm->GetDomain();
-    cudaLbm->SetTimeStepsPerFrame(TimeStepSelector(domain->GetXDim()*domain->GetYDim()));
-    //printf("scalef: %i\n", TimeStepSelector(domain->GetXDim()*domain->GetYDim()));
-    MarchSolution(cudaLbm);
-    UpdateSolutionVbo(dptr, cudaLbm, m_contourVar, m_contourMinValue, m_contourMaxValue, m_viewMode);
- 
-    SetObstructionVelocitiesToZero(obst_h, obst_d, m_scaleFactor);
+    if (cudaLbm->AcquireSnapshot() &&
+        cudaLbm->GetRenderSnapshot()->imageVersion != m_surfaceImageVersion)
+    {
+        m_surfaceImageVersion = cudaLbm->GetRenderSnapshot()->imageVersion;
+        cudaLbm->SetSurfaceRefreshPending(true);
+    }
+    SolutionSnapshot* snapshot = cudaLbm->GetRenderSnapshot();
     float3 cameraPosition = { m_translate.x, m_translate.y, - m_translate.z };
+    float* floorTemp_d = cudaLbm->GetFloorTemp();
 
-    if (ShouldRenderFloor() && !ShouldRefractSurface())
+    std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+    Domain domain = *cudaLbm->GetDomain();
+    if (snapshot != NULL)
+    {
+        {
+            ScopedTimer timer("UpdateSolutionVbo", true);
+            UpdateSolutionVbo(dptr, cudaLbm, *snapshot, m_contourVar, m_contourMinValue,
+                m_contourMaxValue, m_viewMode);
+        }
+        if (ShouldRenderFloor() && !ShouldRefractSurface())
+        {
+            ScopedTimer timer("LightSurface", true);
+            LightSurface(dptr, cudaLbm, *snapshot, cameraPosition);
+        }
+    }
+    {
+        ScopedTimer timer("LightFloor", true);
+        LightFloor(dptr, floorTemp_d, cudaLbm->GetDeviceObst(), cudaLbm->GetObstructionGrid(),
+            cameraPosition, domain);
+    }
     {
-        LightSurface(dptr, obst_d, cameraPosition, *domain);
+        ScopedTimer timer("CleanUpDeviceVBO", true);
+        CleanUpDeviceVBO(dptr, domain);
     }
-    LightFloor(dptr, floorTemp_d, obst_d, cameraPosition, *domain);
-    CleanUpDeviceVBO(dptr, *domain);
 
     // unmap buffer object
     cudaGraphicsUnmapResources(1, &vbo_resource, 0);
@@ -320,22 +450,32 @@ void GraphicsManager::RunSurfaceRefraction()
             cameraPos = m_cameraPosition;
         }
 
-        RefractSurface(dptr, floorLightTexture, envTexture, obst_d, cameraPos, *domain);
+        SolutionSnapshot* snapshot = cudaLbm->GetRenderSnapshot();
+        if (snapshot != NULL)
+        {
+            std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+            ScopedTimer timer("RefractSurface", true);
+            RefractSurface(dptr, floorLightTexture, envTexture, cudaLbm, *snapshot, cameraPos);
+        }
 
         // unmap buffer object
         cudaGraphicsUnmapResources(1, &vbo_resource, 0);
         cudaGraphicsUnmapResources(1, &floorLightTextureResource, 0);
         cudaGraphicsUnmapResources(1, &envTextureResource, 0);
     }
+    // every surface pass of this frame has run, so the tiles skipped from here on are up to date
+    GetCudaLbm()->SetSurfaceRefreshPending(false);
 }
 
 void GraphicsManager::RunComputeShader()
 {
+    GetGraphics()->UpdateObstructionsUsingComputeShader();
     GetGraphics()->RunComputeShader(m_translate, m_contourVar, m_contourMinValue, m_contourMaxValue);
 }
 
 void GraphicsManager::RunSimulation()
 {
+    RetireRemovedObstructions();
     if (m_useCuda)
     {
         RunCuda();
@@ -462,10 +602,13 @@ int GraphicsManager::GetSimCoordFrom3DMouseClickOnObstruction(int &xOut, int &yO
         size_t num_bytes;
         cudaGraphicsResourceGetMappedPointer((void **)&dptr, &num_bytes, cudaSolutionField);
 
-        Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
-        Domain* domain = GetCudaLbm()->GetDomain();
-        rayCastResult = RayCastMouseClick(selectedCoordF, dptr, m_rayCastIntersect_d, 
-            rayOrigin, rayDir, obst_d, *domain);
+        {
+            std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
+            Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
+            Domain* domain = GetCudaLbm()->GetDomain();
+            rayCastResult = RayCastMouseClick(selectedCoordF, dptr, m_rayCastIntersect_d,
+                rayOrigin, rayDir, obst_d, GetCudaLbm()->GetObstructionGrid(), *domain);
+        }
         cudaGraphicsUnmapResources(1, &cudaSolutionField, 0);
     }
     else
@@ -563,7 +706,7 @@ void GraphicsManager::MoveObstruction(int obstId, const float mouseXf, const flo
     dyi = dyf*static_cast<float>(windowHeight) / 2.f;
     GetSimCoordFromMouseRay(simX1, simY1, xi-dxi, yi-dyi);
     GetSimCoordFromMouseRay(simX2, simY2, xi, yi);
-    Obstruction obst = m_obstructions[obstId];
+    Obstruction obst = m_obstructions->Get(obstId);
     obst.x = simX2*m_scaleFactor;
     obst.y = simY2*m_scaleFactor;
     float u = std::max(-0.1f,std::min(0.1f,static_cast<float>(simX2-simX1) / (TIMESTEPS_PER_FRAME)));
@@ -571,15 +714,15 @@ void GraphicsManager::MoveObstruction(int obstId, const float mouseXf, const flo
     obst.u = u;
     obst.v = v;
     obst.state = State::ACTIVE;
-    m_obstructions[obstId] = obst;
+    std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
+    m_obstructions->Get(obstId) = obst;
     if (m_useCuda)
     {
-        Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
-        UpdateDeviceObstructions(obst_d, obstId, obst, m_scaleFactor);  
+        UpdateDeviceObstructions(GetCudaLbm(), obstId, obst, m_scaleFactor);
     }
     else
     {
-        GetGraphics()->UpdateObstructionsUsingComputeShader(obstId, obst, m_scaleFactor);
+        GetGraphics()->GetObstDeltas()->Push(m_obstructions->GetIndex(obstId));
     }
 }
 
@@ -598,13 +741,12 @@ void GraphicsManager::Zoom(const int dir, const float mag)
 void GraphicsManager::AddObstruction(const int simX, const int simY)
 {
     Obstruction obst = { m_currentObstShape, simX*m_scaleFactor, simY*m_scaleFactor, m_currentObstSize, 0, 0, 0, State::NEW  };
-    int obstId = FindUnusedObstructionId();
-    m_obstructions[obstId] = obst;
-    Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
+    std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
+    int obstId = m_obstructions->Add(obst);
     if (m_useCuda)
-        UpdateDeviceObstructions(obst_d, obstId, obst, m_scaleFactor);
+        UpdateDeviceObstructions(GetCudaLbm(), obstId, obst, m_scaleFactor);
     else
-        GetGraphics()->UpdateObstructionsUsingComputeShader(obstId, obst, m_scaleFactor);
+        GetGraphics()->GetObstDeltas()->Push(m_obstructions->GetIndex(obstId));
 }
 
 void GraphicsManager::RemoveObstruction(const int simX, const int simY)
@@ -617,49 +759,65 @@ void GraphicsManager::RemoveSpecifiedObstruction(const int obstId)
 {
     if (obstId >= 0)
     {
-        m_obstructions[obstId].state = State::REMOVED;
-        Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
+        std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
+        Obstruction &obst = m_obstructions->Get(obstId);
+        obst.state = State::REMOVED;
         if (m_useCuda)
-            UpdateDeviceObstructions(obst_d, obstId, m_obstructions[obstId], m_scaleFactor);
+            UpdateDeviceObstructions(GetCudaLbm(), obstId, obst, m_scaleFactor);
         else
-            GetGraphics()->UpdateObstructionsUsingComputeShader(obstId, m_obstructions[obstId], m_scaleFactor);
+            GetGraphics()->GetObstDeltas()->Push(m_obstructions->GetIndex(obstId));
+        RetiringObstruction retiring = { obstId, OBST_RETIRE_FRAMES };
+        m_retiringObstructions.push_back(retiring);
     }
 }
 
-
-void GraphicsManager::SetRayTracingPausedState(const bool state)
+// ! Removed obstructions are kept while their mesh sinks into the floor, which takes fewer than
+// ! OBST_RETIRE_FRAMES frames. After that they are dropped from the store and the solver copy, and
+// ! their ids are free for reuse.
+void GraphicsManager::RetireRemovedObstructions()
 {
-    m_rayTracingPaused = state;
-}
-
-int GraphicsManager::FindUnusedObstructionId()
-{
-    for (int i = 0; i < MAXOBSTS; i++)
+    std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
+    std::vector<RetiringObstruction>::iterator it = m_retiringObstructions.begin();
+    while (it != m_retiringObstructions.end())
     {
-        if (m_obstructions[i].state == State::REMOVED || 
-            m_obstructions[i].state == State::INACTIVE)
+        if (--it->framesLeft > 0)
         {
-            return i;
+            ++it;
+            continue;
         }
+        int obstId = it->id;
+        it = m_retiringObstructions.erase(it);
+        if (!m_obstructions->Contains(obstId) ||
+            m_obstructions->Get(obstId).state != State::REMOVED)
+            continue;
+        if (m_useCuda)
+            RemoveDeviceObstruction(GetCudaLbm(), obstId);
+        int movedIndex = m_obstructions->Remove(obstId);
+        if (!m_useCuda)
+            GetGraphics()->GetObstDeltas()->PushRemoval(movedIndex);
     }
-    printf("Object could not be added. You are currently using the maximum number of objects.");
-    return 0;
 }
 
 
+void GraphicsManager::SetRayTracingPausedState(const bool state)
+{
+    m_rayTracingPaused = state;
+}
+
 int GraphicsManager::FindClosestObstructionId(const int simX, const int simY)
 {
     float dist = 999999999999.f;
     int closestObstId = -1;
-    for (int i = 0; i < MAXOBSTS; i++)
+    Obstruction* obstructions = m_obstructions->GetData();
+    for (int i = 0; i < m_obstructions->GetCount(); i++)
     {
-        if (m_obstructions[i].state != State::REMOVED)
+        if (obstructions[i].state != State::REMOVED)
         {
-            float newDist = GetDistanceBetweenTwoPoints(simX, simY, m_obstructions[i].x/m_scaleFactor, m_obstructions[i].y/m_scaleFactor);
+            float newDist = GetDistanceBetweenTwoPoints(simX, simY, obstructions[i].x/m_scaleFactor, obstructions[i].y/m_scaleFactor);
             if (newDist < dist)
             {
                 dist = newDist;
-                closestObstId = i;
+                closestObstId = m_obstructions->GetId(i);
             }
         }
     }
@@ -671,16 +829,17 @@ int GraphicsManager::FindObstructionPointIsInside(const int simX, const int simY
 {
     float dist = 999999999999.f;
     int closestObstId = -1;
-    for (int i = 0; i < MAXOBSTS; i++)
+    Obstruction* obstructions = m_obstructions->GetData();
+    for (int i = 0; i < m_obstructions->GetCount(); i++)
     {
-        if (m_obstructions[i].state != State::REMOVED)
+        if (obstructions[i].state != State::REMOVED)
         {
-            float newDist = GetDistanceBetweenTwoPoints(simX, simY, m_obstructions[i].x/m_scaleFactor,
-                m_obstructions[i].y/m_scaleFactor);
-            if (newDist < dist && newDist < m_obstructions[i].r1/m_scaleFactor+tolerance)
+            float newDist = GetDistanceBetweenTwoPoints(simX, simY, obstructions[i].x/m_scaleFactor,
+                obstructions[i].y/m_scaleFactor);
+            if (newDist < dist && newDist < obstructions[i].r1/m_scaleFactor+tolerance)
             {
                 dist = newDist;
-                closestObstId = i;
+                closestObstId = m_obstructions->GetId(i);
             }
         }
     }
@@ -702,6 +861,7 @@ void GraphicsManager::UpdateGraphicsInputs()
     m_contourMaxValue = Layout::GetCurrentContourSliderValue(*rootPanel, 2);
     m_currentObstSize = Layout::GetCurrentSliderValue(*rootPanel, "Slider_Size");
     m_scaleFactor = Layout::GetCurrentSliderValue(*rootPanel, "Slider_Resolution");
+    std::lock_guard<std::mutex> lock(GetCudaLbm()->GetSolverMutex());
     UpdateDomainDimensions();
     UpdateObstructionScales();
 }
@@ -713,21 +873,20 @@ void GraphicsManager::UpdateDomainDimensions()
     cudaLbm->GetDomain()->SetYDimVisible(MAX_YDIM / m_scaleFactor);
 }
 
+// ! Only the CUDA path scales obstructions to the resolution. UpdateDeviceObstructions skips the
+// ! ones whose scaled copy is unchanged, so only rescaled obstructions are queued for upload. The
+// ! compute shader path uses the host data as is, and its changes are queued where they are made.
 void GraphicsManager::UpdateObstructionScales()
 {
-    for (int i = 0; i < MAXOBSTS; i++)
+    if (!m_useCuda)
+        return;
+    Obstruction* obstructions = m_obstructions->GetData();
+    for (int i = 0; i < m_obstructions->GetCount(); i++)
     {
-        if (m_obstructions[i].state != State::REMOVED)
+        if (obstructions[i].state != State::REMOVED)
         {
-            if (m_useCuda)
-            {
-                Obstruction* obst_d = GetCudaLbm()->GetDeviceObst();
-                UpdateDeviceObstructions(obst_d, i, m_obstructions[i], m_scaleFactor);  
-            }
-            else
-            {
-                GetGraphics()->UpdateObstructionsUsingComputeShader(i, m_obstructions[i], m_scaleFactor);
-            }
+            UpdateDeviceObstructions(GetCudaLbm(), m_obstructions->GetId(i), obstructions[i],
+                m_scaleFactor);
         }
     }
 }
@@ -739,8 +898,11 @@ void GraphicsManager::UpdateLbmInputs()
     float u = rootPanel->GetSlider("Slider_InletV")->m_sliderBar1->GetValue();
     float omega = rootPanel->GetSlider("Slider_Visc")->m_sliderBar1->GetValue();
     CudaLbm* cudaLbm = GetCudaLbm();
-    cudaLbm->SetInletVelocity(u);
-    cudaLbm->SetOmega(omega);
+    {
+        std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+        cudaLbm->SetInletVelocity(u);
+        cudaLbm->SetOmega(omega);
+    }
     ShaderManager* graphics = GetGraphics();
     graphics->UpdateLbmInputs(u, omega);
 }
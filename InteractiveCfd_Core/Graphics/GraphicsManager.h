@@ -1,5 +1,7 @@
 #pragma once
 #include "common.h"
+#include "StepBudgetController.h"
+#include "Checkpoint.h"
 #include "cuda_runtime.h"
 #include <GLEW/glew.h>
 #include <glm/glm.hpp>
@@ -13,9 +15,20 @@
 #define FW_API __declspec(dllimport)   
 #endif  
 
+#define OBST_RETIRE_FRAMES 10
+
 class Panel;
 class ShaderManager;
 class CudaLbm;
+class SolverThread;
+class ObstructionStore;
+
+// ! Obstruction that was removed but is kept until its mesh has sunk into the floor
+struct RetiringObstruction
+{
+    int id;
+    int framesLeft;
+};
 
 class FW_API GraphicsManager
 {
@@ -30,7 +43,8 @@ private:
     ViewMode m_viewMode;
     bool m_rayTracingPaused = false;
     glm::vec4 m_cameraPosition;
-    Obstruction* m_obstructions;
+    ObstructionStore* m_obstructions;
+    std::vector<RetiringObstruction> m_retiringObstructions;
     Panel* m_parent;
     float m_scaleFactor = 1.f;
     GLint m_viewport[4];
@@ -42,6 +56,9 @@ private:
     ShaderManager* m_graphics;
     bool m_useCuda = true;
     float4* m_rayCastIntersect_d;
+    SolverThread* m_solverThread;
+    float m_targetFrameTime = STEP_BUDGET_DEFAULT_TARGET_MS;
+    int m_surfaceImageVersion = -1;
 
 public:
     GraphicsManager(Panel* panel);
@@ -66,11 +83,22 @@ public:
     ContourVariable GetContourVar();
     void SetContourVar(const ContourVariable contourVar);
 
-    void SetObstructionsPointer(Obstruction* obst);
+    void SetObstructionsPointer(ObstructionStore* obst);
 
     float GetScaleFactor();
     void SetScaleFactor(const float scaleFactor);
 
+    float GetTargetFrameTime();
+    void SetTargetFrameTime(const float milliseconds);
+    float GetSolverMsPerStep();
+    float GetSolverStepsPerSecond(const float fps);
+    void SetSteadyStateThreshold(const float threshold);
+    bool IsSteadyState();
+    int GetNextObstructionVersion();
+    int GetPresentedObstructionVersion();
+    CheckpointStatus SaveCheckpoint(const std::string &path);
+    CheckpointStatus LoadCheckpoint(const std::string &path);
+
     CudaLbm* GetCudaLbm();
     ShaderManager* GetGraphics();
 
@@ -124,7 +152,7 @@ public:
     void AddObstruction(const int simX, const int simY);
     void RemoveObstruction(const int simX, const int simY);
     void RemoveSpecifiedObstruction(const int obstId);
-    int FindUnusedObstructionId();
+    void RetireRemovedObstructions();
     int FindClosestObstructionId(const int simX, const int simY);
     int FindObstructionPointIsInside(const int x, const int y, const float tolerance=0.f);
  
@@ -6,6 +6,9 @@
 #include <SOIL/SOIL.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <assert.h>
+#include <algorithm>
+#undef min
+#undef max
 
 ShaderManager::ShaderManager()
 {
@@ -13,6 +16,9 @@ ShaderManager::ShaderManager()
     m_lightingProgram = new ShaderProgram;
     m_obstProgram = new ShaderProgram;
     m_floorProgram = new ShaderProgram;
+    m_obstSsboCapacity = 0;
+    m_obstSsboCount = 0;
+    m_obstDeltaSsboCapacity = OBST_INITIAL_CAPACITY;
 }
 
 void ShaderManager::CreateCudaLbm()
@@ -190,7 +196,8 @@ void ShaderManager::AllocateStorageBuffers()
     CreateShaderStorageBuffer(GLfloat(0), MAX_XDIM*MAX_YDIM*9, "LbmA");
     CreateShaderStorageBuffer(GLfloat(0), MAX_XDIM*MAX_YDIM*9, "LbmB");
     CreateShaderStorageBuffer(GLint(0), MAX_XDIM*MAX_YDIM, "Floor");
-    CreateShaderStorageBuffer(Obstruction{}, MAXOBSTS, "Obstructions");
+    CreateShaderStorageBuffer(Obstruction{}, OBST_INITIAL_CAPACITY, "Obstructions");
+    CreateShaderStorageBuffer(ObstructionDelta{}, OBST_INITIAL_CAPACITY, "ObstructionDeltas");
     CreateShaderStorageBuffer(float4{0,0,0,1e6}, 1, "RayIntersection");
 }
 
@@ -285,15 +292,23 @@ void ShaderManager::SetUpTextures()
 
 }
 
+// ! Uploads the host obstructions in dense order, which is the order the shaders index. Called again
+// ! with room to spare whenever the buffer is outgrown, which also applies every queued change.
 void ShaderManager::InitializeObstSsbo()
 {
     const GLuint obstSsbo = GetShaderStorageBuffer("Obstructions");
     CudaLbm* cudaLbm = GetCudaLbm();
-    Obstruction* obst_h = cudaLbm->GetHostObst();
+    ObstructionStore* obst_h = cudaLbm->GetHostObst();
+    m_obstSsboCapacity = std::max(OBST_INITIAL_CAPACITY, 2*obst_h->GetCount());
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, obstSsbo);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, MAXOBSTS*sizeof(Obstruction), obst_h, GL_STATIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_obstSsboCapacity*sizeof(Obstruction), NULL,
+        GL_STATIC_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, obst_h->GetCount()*sizeof(Obstruction),
+        obst_h->GetData());
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, obstSsbo);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    m_obstSsboCount = obst_h->GetCount();
+    m_obstDeltas.Clear();
 }
 
 int ShaderManager::RayCastMouseClick(float3 &rayCastIntersection, const float3 rayOrigin,
@@ -313,7 +328,7 @@ int ShaderManager::RayCastMouseClick(float3 &rayCastIntersection, const float3 r
     GLuint shaderID = shader->GetId();
     SetUniform(shaderID, "maxXDim", MAX_XDIM);
     SetUniform(shaderID, "maxyDim", MAX_YDIM);
-    SetUniform(shaderID, "maxObsts", MAXOBSTS);
+    SetUniform(shaderID, "maxObsts", m_obstSsboCount);
     SetUniform(shaderID, "xDim", xDim);
     SetUniform(shaderID, "yDim", yDim);
     SetUniform(shaderID, "xDimVisible", domain.GetXDimVisible());
@@ -444,7 +459,7 @@ void ShaderManager::RunComputeShader(const float3 cameraPosition, const ContourV
     GLuint shaderID = shader->GetId();
     SetUniform(shaderID, "maxXDim", MAX_XDIM);
     SetUniform(shaderID, "maxyDim", MAX_YDIM);
-    SetUniform(shaderID, "maxObsts", MAXOBSTS);
+    SetUniform(shaderID, "maxObsts", m_obstSsboCount);
     SetUniform(shaderID, "xDim", xDim);
     SetUniform(shaderID, "yDim", yDim);
     SetUniform(shaderID, "xDimVisible", domain.GetXDimVisible());
@@ -456,7 +471,7 @@ void ShaderManager::RunComputeShader(const float3 cameraPosition, const ContourV
     SetUniform(shaderID, "contourMin", contMin);
     SetUniform(shaderID, "contourMax", contMax);
 
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < COMPUTE_SHADER_STEP_PAIRS; i++)
     {
         RunSubroutine(shaderID, "MarchLbm", int3{ xDim, yDim, 1 });
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo_lbmA);
@@ -482,25 +497,48 @@ void ShaderManager::RunComputeShader(const float3 cameraPosition, const ContourV
 
 
 
-void ShaderManager::UpdateObstructionsUsingComputeShader(const int obstId, Obstruction &newObst, const float scaleFactor)
+// ! Host store entries changed since the last UpdateObstructionsUsingComputeShader
+ObstructionDeltaQueue* ShaderManager::GetObstDeltas()
 {
+    return &m_obstDeltas;
+}
+
+// ! Writes the queued obstruction changes to the obstruction buffer with one upload and one
+// ! dispatch. Run once per frame before the surface shader, which only sees the obstructions
+// ! uploaded so far.
+void ShaderManager::UpdateObstructionsUsingComputeShader()
+{
+    if (m_obstDeltas.IsEmpty())
+        return;
+    ObstructionStore* obst_h = m_cudaLbm->GetHostObst();
+    if (obst_h->GetCount() > m_obstSsboCapacity)
+    {
+        InitializeObstSsbo();
+        return;
+    }
+    m_obstSsboCount = obst_h->GetCount();
+    const std::vector<ObstructionDelta> &deltas = m_obstDeltas.Pack(*obst_h);
+    int deltaCount = static_cast<int>(deltas.size());
+    if (deltaCount == 0)
+        return;
+    const GLuint ssbo_deltas = GetShaderStorageBuffer("ObstructionDeltas");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_deltas);
+    if (deltaCount > m_obstDeltaSsboCapacity)
+    {
+        m_obstDeltaSsboCapacity = std::max(deltaCount, 2*m_obstDeltaSsboCapacity);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_obstDeltaSsboCapacity*sizeof(ObstructionDelta),
+            NULL, GL_STATIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, deltaCount*sizeof(ObstructionDelta), &deltas[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo_deltas);
     const GLuint ssbo_obsts = GetShaderStorageBuffer("Obstructions");
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo_obsts);
     ShaderProgram* const shader = GetObstProgram();
     shader->Use();
 
     GLuint shaderId = shader->GetId();
-
-    SetUniform(shaderId, "targetObst.shape", newObst.shape);
-    SetUniform(shaderId, "targetObst.x", newObst.x);
-    SetUniform(shaderId, "targetObst.y", newObst.y);
-    SetUniform(shaderId, "targetObst.r1", newObst.r1);
-    SetUniform(shaderId, "targetObst.u", newObst.u);
-    SetUniform(shaderId, "targetObst.v", newObst.v);
-    SetUniform(shaderId, "targetObst.state", newObst.state);
-    SetUniform(shaderId, "targetObstId", obstId);
-
-    RunSubroutine(shader->GetId(), "UpdateObstruction", int3{ 1, 1, 1 });
+    SetUniform(shaderId, "deltaCount", deltaCount);
+    RunSubroutine(shaderId, "UpdateObstruction", int3{ deltaCount, 1, 1 });
 
     shader->Unset();
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
@@ -522,7 +560,7 @@ void ShaderManager::InitializeComputeShaderData()
     GLuint shaderId = shader->GetId();
     SetUniform(shaderId, "maxXDim", MAX_XDIM);
     SetUniform(shaderId, "maxYDim", MAX_YDIM);
-    SetUniform(shaderId, "maxObsts", MAXOBSTS);//
+    SetUniform(shaderId, "maxObsts", m_obstSsboCount);
     SetUniform(shaderId, "xDim", domain.GetXDim());
     SetUniform(shaderId, "yDim", domain.GetYDim());
     SetUniform(shaderId, "xDimVisible", domain.GetXDim());
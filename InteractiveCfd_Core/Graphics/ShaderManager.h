@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "ObstructionDeltaQueue.h"
 #include "cuda_runtime.h"
 #include <GLEW/glew.h>
 #include "cuda_gl_interop.h"  // needs GLEW
@@ -8,6 +9,8 @@
 #include <string>
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
+// ! Pairs of time steps the compute shader path takes each frame
+#define COMPUTE_SHADER_STEP_PAIRS 5
 
 #ifdef LBM_GL_CPP_EXPORTS  
 #define FW_API __declspec(dllexport)   
@@ -43,6 +46,10 @@ private:
     ShaderProgram* m_obstProgram;
     ShaderProgram* m_floorProgram;
     std::vector<Ssbo> m_ssbos;
+    int m_obstSsboCapacity;
+    int m_obstSsboCount;
+    int m_obstDeltaSsboCapacity;
+    ObstructionDeltaQueue m_obstDeltas;
     float m_omega;
     float m_inletVelocity;
 public:
@@ -85,7 +92,8 @@ public:
     void UpdateLbmInputs(const float u, const float omega);
     void RunComputeShader(const float3 cameraPosition, const ContourVariable contVar,
         const float contMin, const float contMax);
-    void UpdateObstructionsUsingComputeShader(const int obstId, Obstruction &newObst, const float scaleFactor);
+    ObstructionDeltaQueue* GetObstDeltas();
+    void UpdateObstructionsUsingComputeShader();
     int RayCastMouseClick(float3 &rayCastIntersection, const float3 rayOrigin,
         const float3 rayDir);
     void RenderFloorToTexture(Domain &domain);
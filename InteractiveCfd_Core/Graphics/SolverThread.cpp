@@ -0,0 +1,132 @@
+#include "SolverThread.h"
+#include "CudaLbm.h"
+#include "kernel.h"
+#include "FrameProfiler.h"
+#include <chrono>
+
+SolverThread::SolverThread(CudaLbm* cudaLbm)
+    : m_stepBudget(cudaLbm->GetTimeStepsPerFrame())
+{
+    m_cudaLbm = cudaLbm;
+    m_isStopping = false;
+}
+
+SolverThread::~SolverThread()
+{
+    Stop();
+}
+
+// ! The device memory of the CudaLbm must be allocated and initialized
+void SolverThread::Start()
+{
+    if (IsRunning())
+        return;
+    m_isStopping = false;
+    m_thread = std::thread(&SolverThread::Run, this);
+}
+
+// ! Waits for the batch being queued to finish, after which the render thread is the only one using
+// ! the CudaLbm again
+void SolverThread::Stop()
+{
+    if (!IsRunning())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+        m_isStopping = true;
+    }
+    m_thread.join();
+}
+
+bool SolverThread::IsRunning()
+{
+    return m_thread.joinable();
+}
+
+float SolverThread::GetTargetFrameTime()
+{
+    std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+    return m_stepBudget.GetTargetFrameTime();
+}
+
+// ! Each batch is sized to take about this long, from the next batch on
+void SolverThread::SetTargetFrameTime(const float milliseconds)
+{
+    std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+    m_stepBudget.SetTargetFrameTime(milliseconds);
+}
+
+// ! Smoothed time one step pair takes, or 0 before the first batch was timed
+float SolverThread::GetMsPerStep()
+{
+    std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+    return m_stepBudget.GetMsPerStep();
+}
+
+// ! The solver mutex is only held while a batch is queued, as the render thread takes it to change
+// ! inputs. The wait for the device happens outside of it, on this thread's own default stream, so
+// ! the kernels the render thread queues meanwhile are not held up behind the batch. A batch is
+// ! timed from queueing to publishing its snapshot, which is what the next one has to fit in. A
+// ! residual sample due after a batch is queued behind its snapshot and handed to the residual
+// ! monitor once the batch is done. Once the flow is steady, the thread idles as if paused.
+// ! Every batch is recorded into the frame profiler as SolverBatch, with its stages nested in it.
+void SolverThread::Run()
+{
+    int steps = 0;
+    float batchMs = 0.f;
+    ResidualMonitor* residualMonitor = m_cudaLbm->GetResidualMonitor();
+    while (true)
+    {
+        bool isIdle;
+        bool isSampling;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        {
+            ScopedTimer batchTimer("SolverBatch");
+            {
+                std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+                if (m_isStopping)
+                    return;
+                m_cudaLbm->SetTimeStepsPerFrame(m_stepBudget.Update(steps, batchMs));
+                bool isPaused = m_cudaLbm->IsPaused();
+                {
+                    ScopedTimer timer("MarchSolution", true);
+                    MarchSolution(m_cudaLbm);
+                }
+                isIdle = isPaused || residualMonitor->IsConverged();
+                steps = isIdle ? 0 : m_cudaLbm->GetTimeStepsPerFrame();
+                {
+                    ScopedTimer timer("SetObstructionVelocitiesToZero", true);
+                    SetObstructionVelocitiesToZero(m_cudaLbm);
+                }
+                {
+                    ScopedTimer timer("WriteSolutionSnapshot", true);
+                    WriteSolutionSnapshot(m_cudaLbm);
+                }
+                residualMonitor->AddSteps(2 * steps);
+                m_cudaLbm->AddTimeSteps(2 * steps);
+                isSampling = residualMonitor->BeginSample();
+                if (isSampling)
+                {
+                    ScopedTimer timer("SampleResidual", true);
+                    SampleResidual(m_cudaLbm);
+                }
+            }
+            {
+                ScopedTimer timer("SolverSync");
+                cudaStreamSynchronize(cudaStreamPerThread);
+            }
+            m_cudaLbm->PublishSnapshot();
+        }
+        batchMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() -
+            start).count();
+        if (isSampling)
+        {
+            std::lock_guard<std::mutex> lock(m_cudaLbm->GetSolverMutex());
+            FinishResidualSample(m_cudaLbm);
+        }
+        if (isIdle)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(SOLVER_PAUSED_SLEEP_MS));
+        }
+    }
+}
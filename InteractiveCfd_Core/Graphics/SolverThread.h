@@ -0,0 +1,39 @@
+#pragma once
+#include "StepBudgetController.h"
+#include <thread>
+
+#ifdef LBM_GL_CPP_EXPORTS  
+#define FW_API __declspec(dllexport)   
+#else  
+#define FW_API __declspec(dllimport)   
+#endif  
+
+// ! How long the solver thread waits between snapshots while the simulation is paused or steady
+#define SOLVER_PAUSED_SLEEP_MS 5
+
+class CudaLbm;
+
+// ! Steps a CudaLbm on a thread of its own, so the solver and the rendering of the previous solution
+// ! run at the same time. Every batch of GetTimeStepsPerFrame() step pairs ends with a snapshot of
+// ! the macro fields, which is published once the device has finished it. The render thread draws
+// ! the newest snapshot without waiting, and batches keep being queued however long it takes to
+// ! draw a frame. Batches are timed, and a StepBudgetController sizes each one to the target frame
+// ! time. While paused, or once the residual monitor of the CudaLbm finds the flow steady, the
+// ! thread still applies obstruction changes and takes snapshots, only less often.
+class FW_API SolverThread
+{
+    CudaLbm* m_cudaLbm;
+    std::thread m_thread;
+    bool m_isStopping;
+    StepBudgetController m_stepBudget;
+    void Run();
+public:
+    SolverThread(CudaLbm* cudaLbm);
+    ~SolverThread();
+    void Start();
+    void Stop();
+    bool IsRunning();
+    float GetTargetFrameTime();
+    void SetTargetFrameTime(const float milliseconds);
+    float GetMsPerStep();
+};
@@ -0,0 +1,200 @@
+#include "LatticeStorage.h"
+#include <math.h>
+#include <cstring>
+
+// D2Q9 lattice weights, the rest state of each direction
+static const float weights[9] = { 4.f/9.f, 1.f/9.f, 1.f/9.f, 1.f/9.f, 1.f/9.f,
+    1.f/36.f, 1.f/36.f, 1.f/36.f, 1.f/36.f };
+
+// ! IEEE binary16 with round to nearest even. Normal halves are rounded with integer adds on the
+// ! float bits, subnormal halves by a float addition that lines the mantissa up with the half
+// ! subnormal unit, which keeps the conversion short enough for the pack loops.
+unsigned short FloatToHalf(const float value)
+{
+    const unsigned int floatInfinity = 255u << 23;
+    const unsigned int halfOverflow = (127u + 16u) << 23;
+    const unsigned int smallestNormal = 113u << 23;
+    const unsigned int subnormalMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+    float subnormalMagic;
+    std::memcpy(&subnormalMagic, &subnormalMagicBits, sizeof(subnormalMagic));
+
+    unsigned int bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    unsigned int half;
+    if (bits >= halfOverflow)
+    {
+        half = bits > floatInfinity ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < smallestNormal)
+    {
+        float magnitude;
+        std::memcpy(&magnitude, &bits, sizeof(magnitude));
+        magnitude += subnormalMagic;
+        std::memcpy(&half, &magnitude, sizeof(half));
+        half -= subnormalMagicBits;
+    }
+    else
+    {
+        unsigned int mantissaOdd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xfff + mantissaOdd;
+        half = bits >> 13;
+    }
+    return static_cast<unsigned short>(half | (sign >> 16));
+}
+
+float HalfToFloat(const unsigned short value)
+{
+    const unsigned int exponentMask = 0x7c00u << 13;
+    const unsigned int magicBits = 113u << 23;
+    float magic;
+    std::memcpy(&magic, &magicBits, sizeof(magic));
+
+    unsigned int bits = (value & 0x7fffu) << 13;
+    unsigned int exponent = bits & exponentMask;
+    bits += (127u - 15u) << 23;
+    if (exponent == exponentMask)
+    {
+        bits += (128u - 16u) << 23;
+    }
+    else if (exponent == 0)
+    {
+        bits += 1u << 23;
+        float subnormal;
+        std::memcpy(&subnormal, &bits, sizeof(subnormal));
+        subnormal -= magic;
+        std::memcpy(&bits, &subnormal, sizeof(bits));
+    }
+    bits |= (value & 0x8000u) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// ! Upper half of a float with round to nearest even
+unsigned short FloatToBfloat16(const float value)
+{
+    unsigned int bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000)
+        return (bits >> 16) | 0x40;
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return bits >> 16;
+}
+
+float Bfloat16ToFloat(const unsigned short value)
+{
+    unsigned int bits = static_cast<unsigned int>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// ! Signed 16 bit multiple of FIXED16_SCALE, saturated at the ends of the range
+unsigned short FloatToFixed16(const float value)
+{
+    float scaled = floorf(value / FIXED16_SCALE + 0.5f);
+    scaled = scaled < -32768.f ? -32768.f : (scaled > 32767.f ? 32767.f : scaled);
+    return static_cast<unsigned short>(static_cast<short>(scaled));
+}
+
+float Fixed16ToFloat(const unsigned short value)
+{
+    return static_cast<short>(value)*FIXED16_SCALE;
+}
+
+struct HalfFormat
+{
+    static unsigned short Encode(const float value) { return FloatToHalf(value); }
+    static float Decode(const unsigned short value) { return HalfToFloat(value); }
+};
+
+struct Bfloat16Format
+{
+    static unsigned short Encode(const float value) { return FloatToBfloat16(value); }
+    static float Decode(const unsigned short value) { return Bfloat16ToFloat(value); }
+};
+
+struct Fixed16Format
+{
+    static unsigned short Encode(const float value) { return FloatToFixed16(value); }
+    static float Decode(const unsigned short value) { return Fixed16ToFloat(value); }
+};
+
+template <typename Format>
+void Unpack(float* dst, const unsigned short* src, const int count, const float weight)
+{
+    for (int n = 0; n < count; n++)
+    {
+        dst[n] = weight + Format::Decode(src[n]);
+    }
+}
+
+template <typename Format>
+void Pack(unsigned short* dst, const float* src, const int count, const float weight)
+{
+    for (int n = 0; n < count; n++)
+    {
+        dst[n] = Format::Encode(src[n] - weight);
+    }
+}
+
+void UnpackDistributions(float* dst, const unsigned short* src, const int count, const int i,
+    const LatticeStorage format)
+{
+    switch (format)
+    {
+    case STORAGE_FP16:
+        Unpack<HalfFormat>(dst, src, count, weights[i]);
+        break;
+    case STORAGE_BF16:
+        Unpack<Bfloat16Format>(dst, src, count, weights[i]);
+        break;
+    case STORAGE_FIXED16:
+        Unpack<Fixed16Format>(dst, src, count, weights[i]);
+        break;
+    default:
+        break;
+    }
+}
+
+void PackDistributions(unsigned short* dst, const float* src, const int count, const int i,
+    const LatticeStorage format)
+{
+    switch (format)
+    {
+    case STORAGE_FP16:
+        Pack<HalfFormat>(dst, src, count, weights[i]);
+        break;
+    case STORAGE_BF16:
+        Pack<Bfloat16Format>(dst, src, count, weights[i]);
+        break;
+    case STORAGE_FIXED16:
+        Pack<Fixed16Format>(dst, src, count, weights[i]);
+        break;
+    default:
+        break;
+    }
+}
+
+int GetBytesPerDistribution(const LatticeStorage format)
+{
+    return format == STORAGE_FP32 ? sizeof(float) : sizeof(unsigned short);
+}
+
+const char* GetLatticeStorageName(const LatticeStorage format)
+{
+    switch (format)
+    {
+    case STORAGE_FP16:
+        return "fp16";
+    case STORAGE_BF16:
+        return "bf16";
+    case STORAGE_FIXED16:
+        return "fixed16";
+    default:
+        return "fp32";
+    }
+}
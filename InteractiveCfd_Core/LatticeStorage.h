@@ -0,0 +1,25 @@
+#pragma once
+
+// ! Number format of the distributions held by CpuLbm. The 16 bit formats store the deviation
+// ! f_i - w_i from the lattice weight, which is small compared to f_i, and are converted to float
+// ! for streaming and collision.
+enum LatticeStorage{STORAGE_FP32, STORAGE_FP16, STORAGE_BF16, STORAGE_FIXED16};
+
+// Value of one unit of STORAGE_FIXED16, which covers deviations of +/-0.25
+#define FIXED16_SCALE (1.f/131072.f)
+
+unsigned short FloatToHalf(const float value);
+float HalfToFloat(const unsigned short value);
+unsigned short FloatToBfloat16(const float value);
+float Bfloat16ToFloat(const unsigned short value);
+unsigned short FloatToFixed16(const float value);
+float Fixed16ToFloat(const unsigned short value);
+
+// ! Converts count distributions of direction i between float and a 16 bit storage format
+void UnpackDistributions(float* dst, const unsigned short* src, const int count, const int i,
+    const LatticeStorage format);
+void PackDistributions(unsigned short* dst, const float* src, const int count, const int i,
+    const LatticeStorage format);
+
+int GetBytesPerDistribution(const LatticeStorage format);
+const char* GetLatticeStorageName(const LatticeStorage format);
@@ -315,7 +315,11 @@ void InitializeButtonCallBack(Panel &rootPanel)
 
     float u = rootPanel.GetSlider("Slider_InletV")->m_sliderBar1->GetValue();
     Domain* const domain = cudaLbm->GetDomain();
-    InitializeDomain(dptr, fA_d, im_d, u, *domain);
+    InitializeDomain(dptr, fA_d, im_d, u, cudaLbm->GetStreamingMode(), *domain);
+    {
+        std::lock_guard<std::mutex> lock(cudaLbm->GetSolverMutex());
+        cudaLbm->SetTimeStep(0);
+    }
     graphics->InitializeComputeShaderData();
 }
 
@@ -7,72 +7,106 @@ __host__ __device__ LbmNode::LbmNode()
 {
     for (int i = 0; i < 9; i++)
     {
-        m_f[9] = 0.f;
+        m_f[i] = 0.f;
     }
     m_xDim = MAX_XDIM;
     m_yDim = MAX_YDIM;
+    m_maxXDim = MAX_XDIM;
+    m_maxYDim = MAX_YDIM;
 }
 
-__device__ int LbmNode::GetXDim()
+__host__ __device__ int LbmNode::GetXDim()
 {
     return m_xDim;
 }
 
-__device__ int LbmNode::GetYDim()
+__host__ __device__ int LbmNode::GetYDim()
 {
     return m_yDim;
 }
 
-__device__ void LbmNode::SetXDim(int xDim)
+__host__ __device__ void LbmNode::SetXDim(int xDim)
 {
     m_xDim = xDim;
 }
 
-__device__ void LbmNode::SetYDim(int yDim)
+__host__ __device__ void LbmNode::SetYDim(int yDim)
 {
     m_yDim = yDim;
 }
 
-__device__ float LbmNode::ComputeRho()
+// ! Takes the pitch and plane size of the lattice arrays passed to the Read and Write methods
+__host__ __device__ void LbmNode::SetMemoryLayout(Domain &simDomain)
+{
+    m_maxXDim = simDomain.GetMaxXDim();
+    m_maxYDim = simDomain.GetMaxYDim();
+}
+
+__host__ __device__ void LbmNode::SetMemoryLayout(const int maxXDim, const int maxYDim)
+{
+    m_maxXDim = maxXDim;
+    m_maxYDim = maxYDim;
+}
+
+__host__ __device__ float LbmNode::GetDistribution(const int i)
+{
+    return m_f[i];
+}
+
+__host__ __device__ float LbmNode::ComputeRho()
 {
     return m_f[0] + m_f[1] + m_f[2] + m_f[3] + m_f[4] + m_f[5] + m_f[6] + m_f[7] + m_f[8];
 }
 
-__device__ float LbmNode::ComputeU()
+__host__ __device__ float LbmNode::ComputeU()
 {
     return m_f[1] - m_f[3] + m_f[5] - m_f[6] - m_f[7] + m_f[8];
 }
 
-__device__ float LbmNode::ComputeV()
+__host__ __device__ float LbmNode::ComputeV()
 {
     return m_f[2] - m_f[4] + m_f[5] + m_f[6] - m_f[7] - m_f[8];
 }
 
-__device__ void LbmNode::ReadIncomingDistributions(float* f, const int x, const int y)
+__host__ __device__ void LbmNode::ReadIncomingDistributions(float* f, const int x, const int y)
 {
-    int j = x + y*MAX_XDIM;
     int xDim = GetXDim();
     int yDim = GetYDim();
-    m_f[0] = f[j];
-    m_f[1] = f[f_mem(1, dmax(x - 1), y)];
-    m_f[3] = f[f_mem(3, dmin(x + 1, xDim), y)];
-    m_f[2] = f[f_mem(2, x, y - 1)];
-    m_f[5] = f[f_mem(5, dmax(x - 1), y - 1)];
-    m_f[6] = f[f_mem(6, dmin(x + 1, xDim), y - 1)];
-    m_f[4] = f[f_mem(4, x, y + 1)];
-    m_f[7] = f[f_mem(7, dmin(x + 1, xDim), y + 1)];
-    m_f[8] = f[f_mem(8, dmax(x - 1), dmin(y + 1, yDim))];
+    m_f[0] = f[f_mem(0, x, y, m_maxXDim, m_maxYDim)];
+    m_f[1] = f[f_mem(1, dmax(x - 1), y, m_maxXDim, m_maxYDim)];
+    m_f[3] = f[f_mem(3, dmin(x + 1, xDim), y, m_maxXDim, m_maxYDim)];
+    m_f[2] = f[f_mem(2, x, y - 1, m_maxXDim, m_maxYDim)];
+    m_f[5] = f[f_mem(5, dmax(x - 1), y - 1, m_maxXDim, m_maxYDim)];
+    m_f[6] = f[f_mem(6, dmin(x + 1, xDim), y - 1, m_maxXDim, m_maxYDim)];
+    m_f[4] = f[f_mem(4, x, y + 1, m_maxXDim, m_maxYDim)];
+    m_f[7] = f[f_mem(7, dmin(x + 1, xDim), y + 1, m_maxXDim, m_maxYDim)];
+    m_f[8] = f[f_mem(8, dmax(x - 1), dmin(y + 1, yDim), m_maxXDim, m_maxYDim)];
+}
+
+// ! ReadIncomingDistributions without the clamping at the domain edges, for nodes whose neighbors
+// ! are all inside the lattice
+__host__ __device__ void LbmNode::ReadInteriorDistributions(float* f, const int x, const int y)
+{
+    m_f[0] = f[f_mem(0, x, y, m_maxXDim, m_maxYDim)];
+    m_f[1] = f[f_mem(1, x - 1, y, m_maxXDim, m_maxYDim)];
+    m_f[3] = f[f_mem(3, x + 1, y, m_maxXDim, m_maxYDim)];
+    m_f[2] = f[f_mem(2, x, y - 1, m_maxXDim, m_maxYDim)];
+    m_f[5] = f[f_mem(5, x - 1, y - 1, m_maxXDim, m_maxYDim)];
+    m_f[6] = f[f_mem(6, x + 1, y - 1, m_maxXDim, m_maxYDim)];
+    m_f[4] = f[f_mem(4, x, y + 1, m_maxXDim, m_maxYDim)];
+    m_f[7] = f[f_mem(7, x + 1, y + 1, m_maxXDim, m_maxYDim)];
+    m_f[8] = f[f_mem(8, x - 1, y + 1, m_maxXDim, m_maxYDim)];
 }
 
-__device__ void LbmNode::ReadDistributions(float* f, const int x, const int y)
+__host__ __device__ void LbmNode::ReadDistributions(float* f, const int x, const int y)
 {
     for (int i = 0; i < 9; i++)
     {
-        m_f[i] = f[f_mem(i, x, y)];
+        m_f[i] = f[f_mem(i, x, y, m_maxXDim, m_maxYDim)];
     }
 }
 
-__device__ void LbmNode::Initialize(float* f, const float rho,
+__host__ __device__ void LbmNode::Initialize(float* f, const float rho,
     const float u, const float v)
 {
     float fEq[9];
@@ -83,15 +117,111 @@ __device__ void LbmNode::Initialize(float* f, const float rho,
     }
 }
 
-__device__ void LbmNode::WriteDistributions(float* f, const int x, const int y)
+__host__ __device__ void LbmNode::WriteDistributions(float* f, const int x, const int y)
 {
     for (int i = 0; i < 9; i++)
     {
-        f[f_mem(i, x, y)] = m_f[i];
+        f[f_mem(i, x, y, m_maxXDim, m_maxYDim)] = m_f[i];
     }
 }
 
-__device__ void LbmNode::ComputeFeqs(float* fOut, const float rho, const float u, const float v)
+// ! In-place (AA pattern) streaming keeps a single lattice. Even steps read a node's own slots
+// ! (ReadDistributions) and write the collided values back to the opposite slots of the same node.
+// ! Odd steps pull from the opposite slots of the upstream neighbors and push to the downstream
+// ! neighbors, after which every node holds its incoming distributions for the next even step in
+// ! its own slots. That is half a step on from the two-buffer lattice, which keeps the collided
+// ! values at each node, so the solution is read back with ReadInPlaceDistributions.
+__host__ __device__ void LbmNode::WriteEvenStepDistributions(float* f, const int x, const int y)
+{
+    f[f_mem(0, x, y, m_maxXDim, m_maxYDim)] = m_f[0];
+    f[f_mem(3, x, y, m_maxXDim, m_maxYDim)] = m_f[1];
+    f[f_mem(4, x, y, m_maxXDim, m_maxYDim)] = m_f[2];
+    f[f_mem(1, x, y, m_maxXDim, m_maxYDim)] = m_f[3];
+    f[f_mem(2, x, y, m_maxXDim, m_maxYDim)] = m_f[4];
+    f[f_mem(7, x, y, m_maxXDim, m_maxYDim)] = m_f[5];
+    f[f_mem(8, x, y, m_maxXDim, m_maxYDim)] = m_f[6];
+    f[f_mem(5, x, y, m_maxXDim, m_maxYDim)] = m_f[7];
+    f[f_mem(6, x, y, m_maxXDim, m_maxYDim)] = m_f[8];
+}
+
+// ! Neighbors outside the domain are clamped to the edge the same way ReadIncomingDistributions
+// ! does. Those values are overwritten by the boundary conditions.
+__host__ __device__ void LbmNode::ReadOddStepDistributions(float* f, const int x, const int y)
+{
+    int xDim = GetXDim();
+    int yDim = GetYDim();
+    m_f[0] = f[f_mem(0, x, y, m_maxXDim, m_maxYDim)];
+    m_f[1] = f[f_mem(3, dmax(x - 1), y, m_maxXDim, m_maxYDim)];
+    m_f[3] = f[f_mem(1, dmin(x + 1, xDim), y, m_maxXDim, m_maxYDim)];
+    m_f[2] = f[f_mem(4, x, dmax(y - 1), m_maxXDim, m_maxYDim)];
+    m_f[5] = f[f_mem(7, dmax(x - 1), dmax(y - 1), m_maxXDim, m_maxYDim)];
+    m_f[6] = f[f_mem(8, dmin(x + 1, xDim), dmax(y - 1), m_maxXDim, m_maxYDim)];
+    m_f[4] = f[f_mem(2, x, dmin(y + 1, yDim), m_maxXDim, m_maxYDim)];
+    m_f[7] = f[f_mem(5, dmin(x + 1, xDim), dmin(y + 1, yDim), m_maxXDim, m_maxYDim)];
+    m_f[8] = f[f_mem(6, dmax(x - 1), dmin(y + 1, yDim), m_maxXDim, m_maxYDim)];
+}
+
+// ! A distribution that would leave the domain is kept in the opposite slot of the node itself.
+// ! That slot would receive from outside the domain, so no other node writes it, and the boundary
+// ! condition of the edge node replaces its value on the next even step.
+__host__ __device__ void LbmNode::WriteOddStepDistributions(float* f, const int x, const int y)
+{
+    int xDim = GetXDim();
+    int yDim = GetYDim();
+    bool hasWest = x > 0;
+    bool hasEast = x < xDim - 1;
+    bool hasSouth = y > 0;
+    bool hasNorth = y < yDim - 1;
+    f[f_mem(0, x, y, m_maxXDim, m_maxYDim)] = m_f[0];
+    f[hasEast ? f_mem(1, x + 1, y, m_maxXDim, m_maxYDim) :
+        f_mem(3, x, y, m_maxXDim, m_maxYDim)] = m_f[1];
+    f[hasNorth ? f_mem(2, x, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(4, x, y, m_maxXDim, m_maxYDim)] = m_f[2];
+    f[hasWest ? f_mem(3, x - 1, y, m_maxXDim, m_maxYDim) :
+        f_mem(1, x, y, m_maxXDim, m_maxYDim)] = m_f[3];
+    f[hasSouth ? f_mem(4, x, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(2, x, y, m_maxXDim, m_maxYDim)] = m_f[4];
+    f[hasEast && hasNorth ? f_mem(5, x + 1, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(7, x, y, m_maxXDim, m_maxYDim)] = m_f[5];
+    f[hasWest && hasNorth ? f_mem(6, x - 1, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(8, x, y, m_maxXDim, m_maxYDim)] = m_f[6];
+    f[hasWest && hasSouth ? f_mem(7, x - 1, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(5, x, y, m_maxXDim, m_maxYDim)] = m_f[7];
+    f[hasEast && hasSouth ? f_mem(8, x + 1, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(6, x, y, m_maxXDim, m_maxYDim)] = m_f[8];
+}
+
+// ! Reads back what the last odd step wrote for node (x, y), which is what the two-buffer lattice
+// ! holds for the node after the same step: each distribution from the slot of the downstream
+// ! neighbor it was pushed to, or from the node's own opposite slot at the domain edges
+__host__ __device__ void LbmNode::ReadInPlaceDistributions(float* f, const int x, const int y)
+{
+    int xDim = GetXDim();
+    int yDim = GetYDim();
+    bool hasWest = x > 0;
+    bool hasEast = x < xDim - 1;
+    bool hasSouth = y > 0;
+    bool hasNorth = y < yDim - 1;
+    m_f[0] = f[f_mem(0, x, y, m_maxXDim, m_maxYDim)];
+    m_f[1] = f[hasEast ? f_mem(1, x + 1, y, m_maxXDim, m_maxYDim) :
+        f_mem(3, x, y, m_maxXDim, m_maxYDim)];
+    m_f[2] = f[hasNorth ? f_mem(2, x, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(4, x, y, m_maxXDim, m_maxYDim)];
+    m_f[3] = f[hasWest ? f_mem(3, x - 1, y, m_maxXDim, m_maxYDim) :
+        f_mem(1, x, y, m_maxXDim, m_maxYDim)];
+    m_f[4] = f[hasSouth ? f_mem(4, x, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(2, x, y, m_maxXDim, m_maxYDim)];
+    m_f[5] = f[hasEast && hasNorth ? f_mem(5, x + 1, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(7, x, y, m_maxXDim, m_maxYDim)];
+    m_f[6] = f[hasWest && hasNorth ? f_mem(6, x - 1, y + 1, m_maxXDim, m_maxYDim) :
+        f_mem(8, x, y, m_maxXDim, m_maxYDim)];
+    m_f[7] = f[hasWest && hasSouth ? f_mem(7, x - 1, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(5, x, y, m_maxXDim, m_maxYDim)];
+    m_f[8] = f[hasEast && hasSouth ? f_mem(8, x + 1, y - 1, m_maxXDim, m_maxYDim) :
+        f_mem(6, x, y, m_maxXDim, m_maxYDim)];
+}
+
+__host__ __device__ void LbmNode::ComputeFeqs(float* fOut, const float rho, const float u, const float v)
 {
     float usqr = u*u + v*v;
     fOut[0] = 0.4444444444f*(rho - 1.5f*usqr);
@@ -105,7 +235,7 @@ __device__ void LbmNode::ComputeFeqs(float* fOut, const float rho, const float u
     fOut[8] = 0.02777777778*(rho + 3.0f*(u - v) + 4.5f*(u - v)*(u - v) - 1.5f*usqr);   
 }
 
-__device__ void LbmNode::ComputeFeqs(float* fOut)
+__host__ __device__ void LbmNode::ComputeFeqs(float* fOut)
 {
     float rho = ComputeRho();
     float u = ComputeU();
@@ -114,7 +244,7 @@ __device__ void LbmNode::ComputeFeqs(float* fOut)
     ComputeFeqs(fOut, rho, u, v);
 }
 
-__device__ float LbmNode::ComputeStrainRateMagnitude()
+__host__ __device__ float LbmNode::ComputeStrainRateMagnitude()
 {
     float fEq[9];
     ComputeFeqs(fEq);
@@ -126,7 +256,7 @@ __device__ float LbmNode::ComputeStrainRateMagnitude()
     return sqrt(qxx*qxx + qxy*qxy * 2 + qyy*qyy);
 }
 
-__device__ void LbmNode::DirichletWest(const int y, const int xDim, const int yDim, const float uMax)
+__host__ __device__ void LbmNode::DirichletWest(const int y, const int xDim, const int yDim, const float uMax)
 {
     if (y == 0){
         m_f[2] = m_f[4];
@@ -144,7 +274,7 @@ __device__ void LbmNode::DirichletWest(const int y, const int xDim, const int yD
     m_f[8] = m_f[6] + 0.5f*(m_f[2] - m_f[4]) - v*0.5f + u*0.166666667f;
 }
 
-__device__ void LbmNode::NeumannEast(const int y, const int xDim, const int yDim)
+__host__ __device__ void LbmNode::NeumannEast(const int y, const int xDim, const int yDim)
 {
     if (y == 0){
         m_f[2] = m_f[4];
@@ -163,7 +293,21 @@ __device__ void LbmNode::NeumannEast(const int y, const int xDim, const int yDim
     m_f[6] = m_f[8] - 0.5f*(m_f[2] - m_f[4]) + v*0.5f - u*0.166666667f;
 }
 
-__device__ void LbmNode::ApplyBCs(const int y, const int im, const int xDim,
+__host__ __device__ void LbmNode::SymmetryTop()
+{
+    m_f[4] = m_f[2];
+    m_f[7] = m_f[6];
+    m_f[8] = m_f[5];
+}
+
+__host__ __device__ void LbmNode::SymmetryBottom()
+{
+    m_f[2] = m_f[4];
+    m_f[6] = m_f[7];
+    m_f[5] = m_f[8];
+}
+
+__host__ __device__ void LbmNode::ApplyBCs(const int y, const int im, const int xDim,
     const int yDim, const float uMax)
 {
     if (im == 2)//NeumannEast
@@ -176,19 +320,15 @@ __device__ void LbmNode::ApplyBCs(const int y, const int im, const int xDim,
     }
     else if (im == 11)//xsymmetry
     {
-        m_f[4] = m_f[2];
-        m_f[7] = m_f[6];
-        m_f[8] = m_f[5];
+        SymmetryTop();
     }
     else if (im == 12)//xsymmetry
     {
-        m_f[2] = m_f[4];
-        m_f[6] = m_f[7];
-        m_f[5] = m_f[8];
+        SymmetryBottom();
     }  
 }
 
-__device__ void LbmNode::MovingWall(const float rho, const float u, const float v)
+__host__ __device__ void LbmNode::MovingWall(const float rho, const float u, const float v)
 {
     float fEq[9];
     ComputeFeqs(fEq, rho, u, v);
@@ -198,7 +338,7 @@ __device__ void LbmNode::MovingWall(const float rho, const float u, const float
     }
 }
 
-__device__ void LbmNode::BounceBackWall()
+__host__ __device__ void LbmNode::BounceBackWall()
 {
     Swap(m_f[1], m_f[3]);
     Swap(m_f[2], m_f[4]);
@@ -206,38 +346,3 @@ __device__ void LbmNode::BounceBackWall()
     Swap(m_f[6], m_f[8]);
 }
 
-__device__ void LbmNode::Collide(const float omega)
-{
-    float Q = ComputeStrainRateMagnitude();
-    float tau0 = 1.f / omega;
-    float tau = 0.5f*tau0 + 0.5f*sqrt(tau0*tau0 + 18.f*SMAG_CONST*sqrt(2.f)*Q);
-    float omegaTurb = 1.f / tau;
-
-    float m1, m2, m4, m6, m7, m8;
-
-    float u = ComputeU();
-    float v = ComputeV();
-
-    m1 = -2.f*m_f[0] + m_f[1] + m_f[2] + m_f[3] + m_f[4] + 4.f*m_f[5] + 4.f*m_f[6] + 4.f*m_f[7]
-        + 4.f*m_f[8] - 3.0f*(u*u + v*v);
-    m2 = 3.f*m_f[0] - 3.f*m_f[1] - 3.f*m_f[2] - 3.f*m_f[3] - 3.f*m_f[4] + 3.0f*(u*u + v*v); //ep
-    m4 = -m_f[1] + m_f[3] + 2.f*m_f[5] - 2.f*m_f[6] - 2.f*m_f[7] + 2.f*m_f[8];;//qx_eq
-    m6 = -m_f[2] + m_f[4] + 2.f*m_f[5] + 2.f*m_f[6] - 2.f*m_f[7] - 2.f*m_f[8];;//qy_eq
-    m7 = m_f[1] - m_f[2] + m_f[3] - m_f[4] - (u*u - v*v);//pxx_eq
-    m8 = m_f[5] - m_f[6] + m_f[7] - m_f[8] - (u*v);//pxy_eq
-
-    m_f[0] = m_f[0] - (-m1 + m2)*0.11111111f;
-    m_f[1] = m_f[1] - (-m1*0.027777777f - 0.05555555556f*m2 - 0.16666666667f*m4 + m7*omegaTurb*0.25f);
-    m_f[2] = m_f[2] - (-m1*0.027777777f - 0.05555555556f*m2 - 0.16666666667f*m6 - m7*omegaTurb*0.25f);
-    m_f[3] = m_f[3] - (-m1*0.027777777f - 0.05555555556f*m2 + 0.16666666667f*m4 + m7*omegaTurb*0.25f);
-    m_f[4] = m_f[4] - (-m1*0.027777777f - 0.05555555556f*m2 + 0.16666666667f*m6 - m7*omegaTurb*0.25f);
-    m_f[5] = m_f[5] - (0.05555555556f*m1 + m2*0.027777777f + 0.08333333333f*m4 + 0.08333333333f*m6
-        + m8*omegaTurb*0.25f);
-    m_f[6] = m_f[6] - (0.05555555556f*m1 + m2*0.027777777f - 0.08333333333f*m4 + 0.08333333333f*m6
-        - m8*omegaTurb*0.25f);
-    m_f[7] = m_f[7] - (0.05555555556f*m1 + m2*0.027777777f - 0.08333333333f*m4 - 0.08333333333f*m6
-        + m8*omegaTurb*0.25f);
-    m_f[8] = m_f[8] - (0.05555555556f*m1 + m2*0.027777777f + 0.08333333333f*m4 - 0.08333333333f*m6
-        - m8*omegaTurb*0.25f);
-}
-
@@ -1,34 +1,53 @@
 #pragma once
-#include "cuda_runtime.h"
+#include "CudaCompat.h"
+#include "CollisionModels.h"
+
+class Domain;
 
 class LbmNode
 {
     float m_f[9];
     int m_xDim, m_yDim;
+    int m_maxXDim, m_maxYDim;
 public:
     __host__ __device__ LbmNode();
-    __device__ int GetXDim();
-    __device__ int GetYDim();
-    __device__ void SetXDim(const int xDim);
-    __device__ void SetYDim(const int yDim);
-    __device__ float ComputeRho();
-    __device__ float ComputeU();
-    __device__ float ComputeV();
-    __device__ void ReadIncomingDistributions(float* f, const int x, const int y);
-    __device__ void ReadDistributions(float* f, const int x, const int y);
-    __device__ void Initialize(float* f, const float rho, const float u, const float v);
-    __device__ void ComputeFeqs(float* fOut, const float rho, const float u,
+    __host__ __device__ int GetXDim();
+    __host__ __device__ int GetYDim();
+    __host__ __device__ void SetXDim(const int xDim);
+    __host__ __device__ void SetYDim(const int yDim);
+    __host__ __device__ void SetMemoryLayout(Domain &simDomain);
+    __host__ __device__ void SetMemoryLayout(const int maxXDim, const int maxYDim);
+    __host__ __device__ float GetDistribution(const int i);
+    __host__ __device__ float ComputeRho();
+    __host__ __device__ float ComputeU();
+    __host__ __device__ float ComputeV();
+    __host__ __device__ void ReadIncomingDistributions(float* f, const int x, const int y);
+    __host__ __device__ void ReadInteriorDistributions(float* f, const int x, const int y);
+    __host__ __device__ void ReadDistributions(float* f, const int x, const int y);
+    __host__ __device__ void Initialize(float* f, const float rho, const float u, const float v);
+    __host__ __device__ void ComputeFeqs(float* fOut, const float rho, const float u,
         const float v);
-    __device__ void ComputeFeqs(float* fOut);
-    __device__ float ComputeStrainRateMagnitude();
-    __device__ void DirichletWest(const int y, const int xDim, const int yDim,
+    __host__ __device__ void ComputeFeqs(float* fOut);
+    __host__ __device__ float ComputeStrainRateMagnitude();
+    __host__ __device__ void DirichletWest(const int y, const int xDim, const int yDim,
         const float uMax);
-    __device__ void NeumannEast(const int y, const int xDim, const int yDim);
-    __device__ void MovingWall(const float rho, const float u, const float v);
-    __device__ void BounceBackWall();
-    __device__ void ApplyBCs(const int y, const int im, const int xDim, const int yDim,
+    __host__ __device__ void NeumannEast(const int y, const int xDim, const int yDim);
+    __host__ __device__ void MovingWall(const float rho, const float u, const float v);
+    __host__ __device__ void BounceBackWall();
+    __host__ __device__ void SymmetryTop();
+    __host__ __device__ void SymmetryBottom();
+    __host__ __device__ void ApplyBCs(const int y, const int im, const int xDim, const int yDim,
         const float uMax);
-    __device__ void Collide(const float omega);
-    __device__ void WriteDistributions(float* f, const int x, const int y);
+    // Collision is one of the operators in CollisionModels.h
+    template <typename Collision>
+    __host__ __device__ void Collide(const float omega)
+    {
+        Collision::Collide(m_f, omega);
+    }
+    __host__ __device__ void WriteDistributions(float* f, const int x, const int y);
+    __host__ __device__ void WriteEvenStepDistributions(float* f, const int x, const int y);
+    __host__ __device__ void ReadOddStepDistributions(float* f, const int x, const int y);
+    __host__ __device__ void WriteOddStepDistributions(float* f, const int x, const int y);
+    __host__ __device__ void ReadInPlaceDistributions(float* f, const int x, const int y);
 };
 
@@ -0,0 +1,70 @@
+#include "NodeLists.h"
+#include <algorithm>
+
+NodeLists::NodeLists(const int maxYDim) : m_rows(maxYDim)
+{
+}
+
+// ! Reclassifies columns [0, xDim) of rows [yBegin, yEnd) from the node image
+void NodeLists::UpdateRows(const int* Im, const int pitch, const int xDim, const int yBegin,
+    const int yEnd)
+{
+    int rowEnd = std::min(yEnd, static_cast<int>(m_rows.size()));
+    for (int y = std::max(yBegin, 0); y < rowEnd; y++)
+    {
+        RowNodes &row = m_rows[y];
+        row.fluidRuns.clear();
+        for (int type = 0; type < BOUNDARY_TYPE_COUNT; type++)
+        {
+            row.boundaryNodes[type].clear();
+        }
+        const int* rowIm = &Im[y*pitch];
+        int x = 0;
+        while (x < xDim)
+        {
+            BoundaryType type = GetBoundaryType(rowIm[x]);
+            if (type != BOUNDARY_NONE)
+            {
+                row.boundaryNodes[type].push_back(x);
+                x++;
+                continue;
+            }
+            int runBegin = x;
+            while (x < xDim && GetBoundaryType(rowIm[x]) == BOUNDARY_NONE)
+            {
+                x++;
+            }
+            row.fluidRuns.push_back(runBegin);
+            row.fluidRuns.push_back(x);
+        }
+    }
+}
+
+const RowNodes &NodeLists::GetRow(const int y) const
+{
+    return m_rows[y];
+}
+
+// ! Node indices x + y*pitch of the boundary nodes in rows [0, yDim), grouped by type. The nodes
+// ! of type t are [offsets[t], offsets[t + 1]), so offsets needs BOUNDARY_TYPE_COUNT + 1 entries.
+// ! Walls in tiles that activeTiles skips are left out.
+void NodeLists::GetBoundaryNodes(std::vector<int> &nodes, int* offsets, const int pitch,
+    const int yDim, const ActiveTiles &activeTiles) const
+{
+    int rowEnd = std::min(yDim, static_cast<int>(m_rows.size()));
+    nodes.clear();
+    for (int type = 0; type < BOUNDARY_TYPE_COUNT; type++)
+    {
+        offsets[type] = static_cast<int>(nodes.size());
+        for (int y = 0; y < rowEnd; y++)
+        {
+            const std::vector<int> &rowNodes = m_rows[y].boundaryNodes[type];
+            for (size_t n = 0; n < rowNodes.size(); n++)
+            {
+                if (activeTiles.IsNodeActive(rowNodes[n], y))
+                    nodes.push_back(rowNodes[n] + y*pitch);
+            }
+        }
+    }
+    offsets[BOUNDARY_TYPE_COUNT] = static_cast<int>(nodes.size());
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "common.h"
+#include "CudaCompat.h"
+#include "LbmNode.h"
+#include "ActiveTiles.h"
+#include <vector>
+
+// ! Node types of the node image that need more than streaming and colliding. Every other node is
+// ! fluid. Fluid nodes are never on the domain edge, so they can be streamed without clamping.
+enum BoundaryType{BOUNDARY_NONE = -1, BOUNDARY_BOUNCE_BACK, BOUNDARY_MOVING_WALL,
+    BOUNDARY_INLET, BOUNDARY_OUTLET, BOUNDARY_SYMMETRY_TOP, BOUNDARY_SYMMETRY_BOTTOM,
+    BOUNDARY_TYPE_COUNT};
+
+inline __host__ __device__ BoundaryType GetBoundaryType(const int im)
+{
+    switch (im)
+    {
+    case 1:
+    case 10:
+        return BOUNDARY_BOUNCE_BACK;
+    case 20:
+        return BOUNDARY_MOVING_WALL;
+    case 3:
+        return BOUNDARY_INLET;
+    case 2:
+        return BOUNDARY_OUTLET;
+    case 11:
+        return BOUNDARY_SYMMETRY_TOP;
+    case 12:
+        return BOUNDARY_SYMMETRY_BOTTOM;
+    default:
+        return BOUNDARY_NONE;
+    }
+}
+
+// ! Boundary condition of one node type. Type is a BoundaryType known at compile time, so each
+// ! per type loop only contains its own condition. Walls are finished here and return false, open
+// ! boundaries return true and still have to be collided.
+template <int Type>
+inline __host__ __device__ bool ApplyBoundaryCondition(LbmNode &lbm, const int j, const int y,
+    const int xDim, const int yDim, const float uMax, const int* obstIdMap,
+    const Obstruction* obstructions)
+{
+    if (Type == BOUNDARY_BOUNCE_BACK)
+    {
+        lbm.BounceBackWall();
+        return false;
+    }
+    if (Type == BOUNDARY_MOVING_WALL)
+    {
+        const Obstruction &obst = obstructions[obstIdMap[j]];
+        lbm.MovingWall(1.f, obst.u, obst.v);
+        return false;
+    }
+    if (Type == BOUNDARY_INLET)
+        lbm.DirichletWest(y, xDim, yDim, uMax);
+    else if (Type == BOUNDARY_OUTLET)
+        lbm.NeumannEast(y, xDim, yDim);
+    else if (Type == BOUNDARY_SYMMETRY_TOP)
+        lbm.SymmetryTop();
+    else
+        lbm.SymmetryBottom();
+    return true;
+}
+
+// ! Nodes of one lattice row. fluidRuns holds [begin, end) pairs of x-adjacent fluid nodes, and
+// ! each boundary list the ascending x coordinates of the nodes of that type.
+struct RowNodes
+{
+    std::vector<int> fluidRuns;
+    std::vector<int> boundaryNodes[BOUNDARY_TYPE_COUNT];
+};
+
+// ! Node image split into fluid runs and per type boundary lists, row by row, so the steppers can
+// ! run the bulk without per node branches. Only rows whose part of the image changed are rebuilt.
+class NodeLists
+{
+    std::vector<RowNodes> m_rows;
+public:
+    NodeLists(const int maxYDim);
+    void UpdateRows(const int* Im, const int pitch, const int xDim, const int yBegin,
+        const int yEnd);
+    const RowNodes &GetRow(const int y) const;
+    void GetBoundaryNodes(std::vector<int> &nodes, int* offsets, const int pitch,
+        const int yDim, const ActiveTiles &activeTiles) const;
+};
@@ -0,0 +1,63 @@
+#include "ObstructionDeltaQueue.h"
+
+ObstructionDeltaQueue::ObstructionDeltaQueue()
+{
+    m_hasRemovals = false;
+}
+
+void ObstructionDeltaQueue::Push(const int index)
+{
+    if (index >= static_cast<int>(m_isQueued.size()))
+        m_isQueued.resize(index + 1, 0);
+    if (m_isQueued[index])
+        return;
+    m_isQueued[index] = 1;
+    m_indices.push_back(index);
+}
+
+// ! Records a removal from the store. movedIndex is what ObstructionStore::Remove returned: the
+// ! entry that was moved into the freed slot, if any, has to be copied again.
+void ObstructionDeltaQueue::PushRemoval(const int movedIndex)
+{
+    m_hasRemovals = true;
+    if (movedIndex >= 0)
+        Push(movedIndex);
+}
+
+// ! False while there are changes to apply, including removals that left no delta behind
+bool ObstructionDeltaQueue::IsEmpty() const
+{
+    return m_indices.empty() && !m_hasRemovals;
+}
+
+// ! Packs the current contents of the queued entries of store into one contiguous array, ready to
+// ! be uploaded in a single copy, and empties the queue
+const std::vector<ObstructionDelta> &ObstructionDeltaQueue::Pack(const ObstructionStore &store)
+{
+    m_deltas.clear();
+    const Obstruction* obstructions = store.GetData();
+    for (int i = 0; i < static_cast<int>(m_indices.size()); i++)
+    {
+        int index = m_indices[i];
+        m_isQueued[index] = 0;
+        if (index >= store.GetCount())
+            continue;
+        ObstructionDelta delta;
+        delta.index = index;
+        delta.obst = obstructions[index];
+        m_deltas.push_back(delta);
+    }
+    m_indices.clear();
+    m_hasRemovals = false;
+    return m_deltas;
+}
+
+void ObstructionDeltaQueue::Clear()
+{
+    for (int i = 0; i < static_cast<int>(m_indices.size()); i++)
+    {
+        m_isQueued[m_indices[i]] = 0;
+    }
+    m_indices.clear();
+    m_hasRemovals = false;
+}
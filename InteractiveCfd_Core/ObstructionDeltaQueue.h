@@ -0,0 +1,29 @@
+#pragma once
+#include "ObstructionStore.h"
+#include <vector>
+
+// ! Dense index and new contents of one entry of a solver's obstruction array
+struct ObstructionDelta
+{
+    int index;
+    Obstruction obst;
+};
+
+// ! Entries of a store that changed since they were last copied to a solver. Only dense indices are
+// ! queued, each at most once, and the contents are read when the queue is packed, so all the adds,
+// ! moves and rescales of an obstruction within a frame become one delta holding its latest state.
+// ! Indices left past the end of the store by a removal are dropped.
+class ObstructionDeltaQueue
+{
+    std::vector<int> m_indices;
+    std::vector<unsigned char> m_isQueued;
+    std::vector<ObstructionDelta> m_deltas;
+    bool m_hasRemovals;
+public:
+    ObstructionDeltaQueue();
+    void Push(const int index);
+    void PushRemoval(const int movedIndex);
+    bool IsEmpty() const;
+    const std::vector<ObstructionDelta> &Pack(const ObstructionStore &store);
+    void Clear();
+};
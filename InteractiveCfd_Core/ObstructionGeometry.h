@@ -0,0 +1,181 @@
+#pragma once
+#include "common.h"
+#include "CudaCompat.h"
+#include "RectInt.h"
+#include <math.h>
+
+#define OBST_GRID_CELL_SIZE 32
+
+// ! Uniform grid of OBST_GRID_CELL_SIZE square cells bucketing the obstructions, as built by
+// ! ObstructionGrid. The ids of the obstructions that can reach cell c are
+// ! ids[cellStart[c]] to ids[cellStart[c + 1] - 1], in ascending order.
+struct ObstructionGridView
+{
+    const int* cellStart;
+    const int* ids;
+    int cellsX;
+    int cellsY;
+};
+
+// ! Cell of the point. Points off the grid go to the nearest edge cell, where obstructions that
+// ! stick out of the grid are bucketed too.
+inline __host__ __device__ int GetObstructionGridCell(const float x, const float y,
+    const ObstructionGridView &grid)
+{
+    int cellX = static_cast<int>(floor(x / OBST_GRID_CELL_SIZE));
+    int cellY = static_cast<int>(floor(y / OBST_GRID_CELL_SIZE));
+    cellX = cellX < 0 ? 0 : (cellX >= grid.cellsX ? grid.cellsX - 1 : cellX);
+    cellY = cellY < 0 ? 0 : (cellY >= grid.cellsY ? grid.cellsY - 1 : cellY);
+    return cellX + cellY*grid.cellsX;
+}
+
+// ! Nodes around the obstruction center that a query can match it from: the point tests below with
+// ! up to a node of tolerance, and the r1*2.5 reach of the ray test in kernel.cu
+inline __host__ __device__ float GetObstructionReach(const Obstruction &obst)
+{
+    return 2.5f*obst.r1 + LINE_OBST_WIDTH + 1.f;
+}
+
+inline __host__ __device__ bool IsInsideObstruction(const float x, const float y,
+    const Obstruction &obst, const float tolerance)
+{
+    float r1 = obst.r1;
+    if (obst.shape == Shape::SQUARE){
+        if (abs(x - obst.x)<r1 + tolerance &&
+            abs(y - obst.y)<r1 + tolerance)
+            return true;
+    }
+    else if (obst.shape == Shape::CIRCLE){//shift by 0.5 cells for better looks
+        float distFromCenter = (x + 0.5f - obst.x)*(x + 0.5f - obst.x)
+            + (y + 0.5f - obst.y)*(y + 0.5f - obst.y);
+        if (distFromCenter<(r1+tolerance)*(r1+tolerance)+0.1f)
+            return true;
+    }
+    else if (obst.shape == Shape::HORIZONTAL_LINE){
+        if (abs(x - obst.x)<r1*2+tolerance &&
+            abs(y - obst.y)<LINE_OBST_WIDTH*0.501f+tolerance)
+            return true;
+    }
+    else if (obst.shape == Shape::VERTICAL_LINE){
+        if (abs(y - obst.y)<r1*2+tolerance &&
+            abs(x - obst.x)<LINE_OBST_WIDTH*0.501f+tolerance)
+            return true;
+    }
+    return false;
+}
+
+inline __host__ __device__ bool IsInsideObstruction(const float x, const float y,
+    Obstruction* obstructions, const ObstructionGridView &grid, const float tolerance = 0.f)
+{
+    int cell = GetObstructionGridCell(x, y, grid);
+    for (int n = grid.cellStart[cell]; n < grid.cellStart[cell + 1]; n++){
+        int i = grid.ids[n];
+        if (obstructions[i].state != State::INACTIVE &&
+            IsInsideObstruction(x, y, obstructions[i], tolerance))
+            return true;
+    }
+    return false;
+}
+
+// ! Unlike IsInsideObstruction, the tolerance is added to r1, so the lines grow twice as long
+inline __host__ __device__ bool IsOverlappingObstruction(const float x, const float y,
+    const Obstruction &obst, const float tolerance)
+{
+    float r1 = obst.r1 + tolerance;
+    if (obst.shape == Shape::SQUARE){
+        if (abs(x - obst.x)<r1 && abs(y - obst.y)<r1)
+            return true;
+    }
+    else if (obst.shape == Shape::CIRCLE){//shift by 0.5 cells for better looks
+        float distFromCenter = (x + 0.5f - obst.x)*(x + 0.5f - obst.x)
+            + (y + 0.5f - obst.y)*(y + 0.5f - obst.y);
+        if (distFromCenter<r1*r1+0.1f)
+            return true;
+    }
+    else if (obst.shape == Shape::HORIZONTAL_LINE){
+        if (abs(x - obst.x)<r1*2 &&
+            abs(y - obst.y)<LINE_OBST_WIDTH*0.501f+tolerance)
+            return true;
+    }
+    else if (obst.shape == Shape::VERTICAL_LINE){
+        if (abs(y - obst.y)<r1*2 &&
+            abs(x - obst.x)<LINE_OBST_WIDTH*0.501f+tolerance)
+            return true;
+    }
+    return false;
+}
+
+// ! Lowest id of the obstructions overlapping the point, or -1
+inline __host__ __device__ int FindOverlappingObstruction(const float x, const float y,
+    Obstruction* obstructions, const ObstructionGridView &grid, const float tolerance = 0.f)
+{
+    int cell = GetObstructionGridCell(x, y, grid);
+    for (int n = grid.cellStart[cell]; n < grid.cellStart[cell + 1]; n++){
+        int i = grid.ids[n];
+        if (obstructions[i].state != State::INACTIVE &&
+            IsOverlappingObstruction(x, y, obstructions[i], tolerance))
+            return i;
+    }
+    return -1;
+}
+
+// ! Point test against a single obstruction using the same shapes as FindOverlappingObstruction
+inline __host__ __device__ bool IsInsideObstructionShape(const float x, const float y,
+    const Obstruction &obst)
+{
+    float r1 = obst.r1;
+    if (obst.shape == Shape::SQUARE){
+        return abs(x - obst.x)<r1 && abs(y - obst.y)<r1;
+    }
+    else if (obst.shape == Shape::CIRCLE){//shift by 0.5 cells for better looks
+        float distFromCenter = (x + 0.5f - obst.x)*(x + 0.5f - obst.x)
+            + (y + 0.5f - obst.y)*(y + 0.5f - obst.y);
+        return distFromCenter<r1*r1+0.1f;
+    }
+    else if (obst.shape == Shape::HORIZONTAL_LINE){
+        return abs(x - obst.x)<r1*2 && abs(y - obst.y)<LINE_OBST_WIDTH*0.501f;
+    }
+    else if (obst.shape == Shape::VERTICAL_LINE){
+        return abs(y - obst.y)<r1*2 && abs(x - obst.x)<LINE_OBST_WIDTH*0.501f;
+    }
+    return false;
+}
+
+// ! Obstructions that are rasterized into the node image. Removed obstructions are left out so
+// ! the flow is released as soon as they are removed, while their mesh is still sinking.
+inline __host__ __device__ bool IsSolidObstruction(const Obstruction &obst)
+{
+    return obst.state != State::INACTIVE && obst.state != State::REMOVED;
+}
+
+inline __host__ __device__ int FindSolidObstruction(const float x, const float y,
+    Obstruction* obstructions, const ObstructionGridView &grid)
+{
+    int cell = GetObstructionGridCell(x, y, grid);
+    for (int n = grid.cellStart[cell]; n < grid.cellStart[cell + 1]; n++){
+        int i = grid.ids[n];
+        if (IsSolidObstruction(obstructions[i]) &&
+            IsInsideObstructionShape(x, y, obstructions[i]))
+            return i;
+    }
+    return -1;
+}
+
+// ! Node image code for nodes covered by the obstruction
+inline __host__ __device__ int GetObstructionNodeType(const Obstruction &obst)
+{
+    if (obst.u < 1e-5f && obst.v < 1e-5f)
+        return 1; //bounce back
+    return 20; //moving wall
+}
+
+// ! Nodes the obstruction can cover, with a node of margin on every side
+inline RectInt GetObstructionBounds(const Obstruction &obst)
+{
+    float extent = 2.f*obst.r1 + LINE_OBST_WIDTH + 1.f;
+    int xMin = static_cast<int>(floor(obst.x - extent));
+    int yMin = static_cast<int>(floor(obst.y - extent));
+    int xMax = static_cast<int>(ceil(obst.x + extent));
+    int yMax = static_cast<int>(ceil(obst.y + extent));
+    return RectInt(xMin, yMin, xMax - xMin + 1, yMax - yMin + 1);
+}
@@ -0,0 +1,98 @@
+#include "ObstructionGrid.h"
+#include <algorithm>
+
+ObstructionGrid::ObstructionGrid(const int maxXDim, const int maxYDim)
+{
+    m_cellsX = (maxXDim + OBST_GRID_CELL_SIZE - 1) / OBST_GRID_CELL_SIZE;
+    m_cellsY = (maxYDim + OBST_GRID_CELL_SIZE - 1) / OBST_GRID_CELL_SIZE;
+    m_cellStart.assign(GetCellCount() + 1, 0);
+}
+
+// ! Cells [cellXBegin, cellXEnd) x [cellYBegin, cellYEnd) within reach of the obstruction. Cells
+// ! off the grid are clamped to the edge cells, matching GetObstructionGridCell. Returns false
+// ! for inactive obstructions and for those that cannot reach the grid at all.
+bool ObstructionGrid::GetCellRange(const Obstruction &obst, int &cellXBegin, int &cellYBegin,
+    int &cellXEnd, int &cellYEnd) const
+{
+    if (obst.state == State::INACTIVE)
+        return false;
+    float reach = GetObstructionReach(obst);
+    float xMin = obst.x - reach;
+    float yMin = obst.y - reach;
+    float xMax = obst.x + reach;
+    float yMax = obst.y + reach;
+    if (xMax < 0.f || yMax < 0.f || xMin >= m_cellsX*OBST_GRID_CELL_SIZE ||
+        yMin >= m_cellsY*OBST_GRID_CELL_SIZE)
+        return false;
+    cellXBegin = std::max(static_cast<int>(floor(xMin / OBST_GRID_CELL_SIZE)), 0);
+    cellYBegin = std::max(static_cast<int>(floor(yMin / OBST_GRID_CELL_SIZE)), 0);
+    cellXEnd = std::min(static_cast<int>(floor(xMax / OBST_GRID_CELL_SIZE)) + 1, m_cellsX);
+    cellYEnd = std::min(static_cast<int>(floor(yMax / OBST_GRID_CELL_SIZE)) + 1, m_cellsY);
+    return true;
+}
+
+// ! Counts the entries of each cell, turns the counts into offsets and fills the ids in order,
+// ! so the ids of a cell stay ascending and queries still resolve overlaps to the lowest id.
+void ObstructionGrid::Build(const Obstruction* obstructions, const int obstCount)
+{
+    std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+    int cellXBegin, cellYBegin, cellXEnd, cellYEnd;
+    for (int i = 0; i < obstCount; i++)
+    {
+        if (!GetCellRange(obstructions[i], cellXBegin, cellYBegin, cellXEnd, cellYEnd))
+            continue;
+        for (int cellY = cellYBegin; cellY < cellYEnd; cellY++)
+        {
+            for (int cellX = cellXBegin; cellX < cellXEnd; cellX++)
+            {
+                m_cellStart[cellX + cellY*m_cellsX + 1]++;
+            }
+        }
+    }
+    for (int cell = 0; cell < GetCellCount(); cell++)
+    {
+        m_cellStart[cell + 1] += m_cellStart[cell];
+    }
+
+    m_ids.resize(m_cellStart[GetCellCount()]);
+    std::vector<int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i = 0; i < obstCount; i++)
+    {
+        if (!GetCellRange(obstructions[i], cellXBegin, cellYBegin, cellXEnd, cellYEnd))
+            continue;
+        for (int cellY = cellYBegin; cellY < cellYEnd; cellY++)
+        {
+            for (int cellX = cellXBegin; cellX < cellXEnd; cellX++)
+            {
+                m_ids[fill[cellX + cellY*m_cellsX]++] = i;
+            }
+        }
+    }
+}
+
+int ObstructionGrid::GetCellsX() const
+{
+    return m_cellsX;
+}
+
+int ObstructionGrid::GetCellsY() const
+{
+    return m_cellsY;
+}
+
+int ObstructionGrid::GetCellCount() const
+{
+    return m_cellsX*m_cellsY;
+}
+
+// ! GetCellCount() + 1 offsets into GetIds()
+const std::vector<int> &ObstructionGrid::GetCellStart() const
+{
+    return m_cellStart;
+}
+
+const std::vector<int> &ObstructionGrid::GetIds() const
+{
+    return m_ids;
+}
+
@@ -0,0 +1,25 @@
+#pragma once
+#include "ObstructionGeometry.h"
+#include <vector>
+
+// ! Host side of the obstruction bucket index. Each obstruction that is not inactive is listed in
+// ! every cell within GetObstructionReach of its center, so a point or ray query only has to test
+// ! the obstructions of the cells it touches. Rebuilt from scratch whenever an obstruction changes;
+// ! that is a single pass over the obstructions and cells.
+class ObstructionGrid
+{
+    int m_cellsX;
+    int m_cellsY;
+    std::vector<int> m_cellStart;
+    std::vector<int> m_ids;
+    bool GetCellRange(const Obstruction &obst, int &cellXBegin, int &cellYBegin,
+        int &cellXEnd, int &cellYEnd) const;
+public:
+    ObstructionGrid(const int maxXDim, const int maxYDim);
+    void Build(const Obstruction* obstructions, const int obstCount);
+    int GetCellsX() const;
+    int GetCellsY() const;
+    int GetCellCount() const;
+    const std::vector<int> &GetCellStart() const;
+    const std::vector<int> &GetIds() const;
+};
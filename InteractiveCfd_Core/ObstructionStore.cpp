@@ -0,0 +1,120 @@
+#include "ObstructionStore.h"
+#include <algorithm>
+
+// ! Stores obst under a free id, reusing removed ids first, and returns the id
+int ObstructionStore::Add(const Obstruction &obst)
+{
+    int id;
+    if (m_freeIds.empty())
+    {
+        id = static_cast<int>(m_indices.size());
+        m_indices.push_back(-1);
+    }
+    else
+    {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    m_indices[id] = static_cast<int>(m_obstructions.size());
+    m_obstructions.push_back(obst);
+    m_ids.push_back(id);
+    return id;
+}
+
+// ! Stores obst under the given id, adding it if the id is not in use. Used to keep a scaled copy
+// ! of another store under the same ids. Returns the dense index of the entry.
+int ObstructionStore::Set(const int id, const Obstruction &obst)
+{
+    if (Contains(id))
+    {
+        m_obstructions[m_indices[id]] = obst;
+        return m_indices[id];
+    }
+    if (id >= static_cast<int>(m_indices.size()))
+    {
+        for (int freeId = static_cast<int>(m_indices.size()); freeId < id; freeId++)
+        {
+            m_freeIds.push_back(freeId);
+        }
+        m_indices.resize(id + 1, -1);
+    }
+    else
+    {
+        m_freeIds.erase(std::find(m_freeIds.begin(), m_freeIds.end(), id));
+    }
+    m_indices[id] = static_cast<int>(m_obstructions.size());
+    m_obstructions.push_back(obst);
+    m_ids.push_back(id);
+    return m_indices[id];
+}
+
+// ! Frees the id. The last entry is moved into the freed slot, and its new dense index is returned
+// ! so that copies indexed by it can be patched. Returns -1 if no entry had to move.
+int ObstructionStore::Remove(const int id)
+{
+    if (!Contains(id))
+        return -1;
+    int index = m_indices[id];
+    int last = static_cast<int>(m_obstructions.size()) - 1;
+    m_indices[id] = -1;
+    m_freeIds.push_back(id);
+    if (index != last)
+    {
+        m_obstructions[index] = m_obstructions[last];
+        m_ids[index] = m_ids[last];
+        m_indices[m_ids[index]] = index;
+    }
+    m_obstructions.pop_back();
+    m_ids.pop_back();
+    return index != last ? index : -1;
+}
+
+void ObstructionStore::Clear()
+{
+    m_obstructions.clear();
+    m_ids.clear();
+    m_indices.clear();
+    m_freeIds.clear();
+}
+
+bool ObstructionStore::Contains(const int id) const
+{
+    return id >= 0 && id < static_cast<int>(m_indices.size()) && m_indices[id] >= 0;
+}
+
+int ObstructionStore::GetCount() const
+{
+    return static_cast<int>(m_obstructions.size());
+}
+
+// ! Dense index of the id, or -1 if it is not in use
+int ObstructionStore::GetIndex(const int id) const
+{
+    return Contains(id) ? m_indices[id] : -1;
+}
+
+int ObstructionStore::GetId(const int index) const
+{
+    return m_ids[index];
+}
+
+Obstruction &ObstructionStore::Get(const int id)
+{
+    return m_obstructions[m_indices[id]];
+}
+
+const Obstruction &ObstructionStore::Get(const int id) const
+{
+    return m_obstructions[m_indices[id]];
+}
+
+// ! The GetCount() live obstructions, in dense order
+Obstruction* ObstructionStore::GetData()
+{
+    return m_obstructions.empty() ? NULL : &m_obstructions[0];
+}
+
+const Obstruction* ObstructionStore::GetData() const
+{
+    return m_obstructions.empty() ? NULL : &m_obstructions[0];
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "common.h"
+#include <vector>
+
+// ! Growable obstruction storage. Obstructions are referred to by ids that stay valid until they
+// ! are removed, while the obstructions themselves are kept packed in a dense array, so loops over
+// ! them only visit live entries. Removing an obstruction moves the last entry into its place and
+// ! puts its id on a free list for the next Add. The dense order is what the solvers index.
+class ObstructionStore
+{
+    std::vector<Obstruction> m_obstructions;
+    std::vector<int> m_ids;
+    std::vector<int> m_indices;
+    std::vector<int> m_freeIds;
+public:
+    int Add(const Obstruction &obst);
+    int Set(const int id, const Obstruction &obst);
+    int Remove(const int id);
+    void Clear();
+    bool Contains(const int id) const;
+    int GetCount() const;
+    int GetIndex(const int id) const;
+    int GetId(const int index) const;
+    Obstruction &Get(const int id);
+    const Obstruction &Get(const int id) const;
+    Obstruction* GetData();
+    const Obstruction* GetData() const;
+};
@@ -0,0 +1,107 @@
+#include "ResidualMonitor.h"
+#include <algorithm>
+#include <math.h>
+
+ResidualMonitor::ResidualMonitor()
+{
+    m_isEnabled = false;
+    m_threshold = RESIDUAL_DEFAULT_THRESHOLD;
+    m_sampleSteps = RESIDUAL_DEFAULT_SAMPLE_STEPS;
+    Reset();
+}
+
+bool ResidualMonitor::IsEnabled()
+{
+    return m_isEnabled;
+}
+
+void ResidualMonitor::SetEnabled(const bool isEnabled)
+{
+    m_isEnabled = isEnabled;
+    Reset();
+}
+
+float ResidualMonitor::GetThreshold()
+{
+    return m_threshold;
+}
+
+void ResidualMonitor::SetThreshold(const float threshold)
+{
+    m_threshold = threshold;
+    Reset();
+}
+
+int ResidualMonitor::GetSampleSteps()
+{
+    return m_sampleSteps;
+}
+
+void ResidualMonitor::SetSampleSteps(const int steps)
+{
+    m_sampleSteps = std::max(1, steps);
+}
+
+// ! Counts the steps the solver took since the last call
+void ResidualMonitor::AddSteps(const int steps)
+{
+    m_stepsSinceSample += steps;
+}
+
+// ! True if the solver should reduce a sample now. The steps counted so far are attributed to it,
+// ! so steps taken while an asynchronous reduction is in flight count towards the next one.
+bool ResidualMonitor::BeginSample()
+{
+    if (!m_isEnabled || m_isConverged || m_isSamplePending || m_stepsSinceSample < m_sampleSteps)
+        return false;
+    m_sampledSteps = m_stepsSinceSample;
+    m_stepsSinceSample = 0;
+    m_isSamplePending = true;
+    return true;
+}
+
+// ! A sample begun before the last Reset is no longer pending, and its sums should be dropped
+bool ResidualMonitor::IsSamplePending()
+{
+    return m_isSamplePending;
+}
+
+// ! The first sample after a Reset only stores the fields the next one is measured against
+void ResidualMonitor::AddSample(const ResidualSums &sums)
+{
+    if (!m_isSamplePending)
+        return;
+    m_isSamplePending = false;
+    if (!m_hasBaseline)
+    {
+        m_hasBaseline = true;
+        return;
+    }
+    float velocityResidual = sqrt(sums.velocityChange / std::max(sums.velocity, 1e-20f));
+    float densityResidual = sqrt(sums.densityChange / std::max(sums.nodes, 1.f));
+    m_residual = std::max(velocityResidual, densityResidual) / std::max(m_sampledSteps, 1);
+    m_isConverged = m_residual < m_threshold;
+}
+
+// ! Residual per step of the last sample, or 0 before two samples were taken
+float ResidualMonitor::GetResidual()
+{
+    return m_residual;
+}
+
+bool ResidualMonitor::IsConverged()
+{
+    return m_isEnabled && m_isConverged;
+}
+
+// ! Starts over after an input changed. Stepping resumes, and the flow is only considered steady
+// ! again after two more samples.
+void ResidualMonitor::Reset()
+{
+    m_stepsSinceSample = 0;
+    m_sampledSteps = 0;
+    m_hasBaseline = false;
+    m_isSamplePending = false;
+    m_isConverged = false;
+    m_residual = 0.f;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// ! Change per step below which a flow counts as steady
+#define RESIDUAL_DEFAULT_THRESHOLD 1e-6f
+// ! Steps between two residual samples
+#define RESIDUAL_DEFAULT_SAMPLE_STEPS 200
+
+#ifdef LBM_GL_CPP_EXPORTS  
+#define FW_API __declspec(dllexport)   
+#else  
+#define FW_API __declspec(dllimport)   
+#endif  
+
+// ! Sums over the fluid nodes of a solver for one residual sample, taken against the macro fields
+// ! stored at the previous sample
+struct ResidualSums
+{
+    float velocityChange;
+    float velocity;
+    float densityChange;
+    float nodes;
+};
+
+// ! Decides when a flow has stopped changing, so the solver can stop stepping it. Every
+// ! GetSampleSteps() steps the solver reduces the squared change of u, v and rho since the last
+// ! sample, and the residual is the larger of the relative L2 change of the velocity and the RMS
+// ! change of the density, per step. Once it falls below the threshold the flow is converged until
+// ! Reset, which the solvers call whenever an input changes: obstructions, inlet velocity or
+// ! viscosity. Off unless enabled.
+class FW_API ResidualMonitor
+{
+    bool m_isEnabled;
+    float m_threshold;
+    int m_sampleSteps;
+    int m_stepsSinceSample;
+    int m_sampledSteps;
+    bool m_hasBaseline;
+    bool m_isSamplePending;
+    bool m_isConverged;
+    float m_residual;
+public:
+    ResidualMonitor();
+    bool IsEnabled();
+    void SetEnabled(const bool isEnabled);
+    float GetThreshold();
+    void SetThreshold(const float threshold);
+    int GetSampleSteps();
+    void SetSampleSteps(const int steps);
+    void AddSteps(const int steps);
+    bool BeginSample();
+    bool IsSamplePending();
+    void AddSample(const ResidualSums &sums);
+    float GetResidual();
+    bool IsConverged();
+    void Reset();
+};
@@ -16,23 +16,30 @@ layout(binding = 0) buffer ssbo_obsts
 	Obstruction obsts[];
 };
 
+struct ObstructionDelta
+{
+    int index;
+    Obstruction obst;
+};
+layout(std430, binding = 1) buffer ssbo_obstDeltas
+{
+	ObstructionDelta deltas[];
+};
+
 uniform int maxObsts;
-uniform int targetObstId;
-uniform Obstruction targetObst;
+uniform int deltaCount;
 
 subroutine void ObstUpdate_t();
 
 subroutine uniform ObstUpdate_t ObstUpdate;
 
+// one invocation per queued change
 subroutine(ObstUpdate_t) void UpdateObstruction()
 {
-	obsts[targetObstId].shape = targetObst.shape;
-    obsts[targetObstId].r1 = targetObst.r1;
-    obsts[targetObstId].x = targetObst.x;
-    obsts[targetObstId].y = targetObst.y;
-    obsts[targetObstId].u = targetObst.u;
-    obsts[targetObstId].v = targetObst.v;
-    obsts[targetObstId].state = targetObst.state;
+    int n = int(gl_GlobalInvocationID.x);
+    if (n >= deltaCount)
+        return;
+    obsts[deltas[n].index] = deltas[n].obst;
 }
 
 
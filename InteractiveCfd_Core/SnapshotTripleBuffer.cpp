@@ -0,0 +1,52 @@
+#include "SnapshotTripleBuffer.h"
+#include <algorithm>
+
+SnapshotTripleBuffer::SnapshotTripleBuffer()
+{
+    Reset();
+}
+
+// ! Forgets everything published so far. Neither thread may be using the buffer.
+void SnapshotTripleBuffer::Reset()
+{
+    m_writeSlot = 0;
+    m_readySlot = 1;
+    m_readSlot = 2;
+    m_isReadyFresh = false;
+    m_hasRead = false;
+}
+
+// ! Slot the producer fills next. Only the producer calls this, and the slot is its own until
+// ! Publish.
+int SnapshotTripleBuffer::GetWriteSlot() const
+{
+    return m_writeSlot;
+}
+
+// ! Makes the filled write slot the newest result, replacing one the consumer has not acquired
+// ! yet, and hands the producer the slot it replaced
+void SnapshotTripleBuffer::Publish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(m_writeSlot, m_readySlot);
+    m_isReadyFresh = true;
+}
+
+// ! Switches the consumer to the newest published slot. Returns false, keeping the current read
+// ! slot, if nothing was published since the last call.
+bool SnapshotTripleBuffer::Acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_isReadyFresh)
+        return false;
+    std::swap(m_readSlot, m_readySlot);
+    m_isReadyFresh = false;
+    m_hasRead = true;
+    return true;
+}
+
+// ! Slot the consumer reads, or -1 before the first successful Acquire
+int SnapshotTripleBuffer::GetReadSlot() const
+{
+    return m_hasRead ? m_readSlot : -1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <mutex>
+
+#define SNAPSHOT_SLOTS 3
+
+// ! Hands the latest of a stream of results from one producer thread to one consumer thread
+// ! through three slots. The producer fills GetWriteSlot() and publishes it, and the consumer reads
+// ! GetReadSlot() until its next Acquire. Neither side waits for the other: the producer always has
+// ! a slot the consumer is not reading, and results published faster than they are acquired are
+// ! overwritten, so the consumer only ever sees the newest one.
+class SnapshotTripleBuffer
+{
+    std::mutex m_mutex;
+    int m_writeSlot;
+    int m_readySlot;
+    int m_readSlot;
+    bool m_isReadyFresh;
+    bool m_hasRead;
+public:
+    SnapshotTripleBuffer();
+    void Reset();
+    int GetWriteSlot() const;
+    void Publish();
+    bool Acquire();
+    int GetReadSlot() const;
+};
@@ -0,0 +1,69 @@
+#include "StepBudgetController.h"
+#include <algorithm>
+#include <cmath>
+
+StepBudgetController::StepBudgetController(const int initialSteps)
+{
+    m_targetMs = STEP_BUDGET_DEFAULT_TARGET_MS;
+    m_minSteps = STEP_BUDGET_MIN_STEPS;
+    m_maxSteps = STEP_BUDGET_MAX_STEPS;
+    m_steps = std::max(m_minSteps, std::min(m_maxSteps, initialSteps));
+    m_msPerStep = 0.f;
+}
+
+float StepBudgetController::GetTargetFrameTime()
+{
+    return m_targetMs;
+}
+
+// ! Non-positive targets are ignored
+void StepBudgetController::SetTargetFrameTime(const float milliseconds)
+{
+    if (milliseconds > 0.f)
+    {
+        m_targetMs = milliseconds;
+    }
+}
+
+void StepBudgetController::SetStepRange(const int minSteps, const int maxSteps)
+{
+    m_minSteps = std::max(1, minSteps);
+    m_maxSteps = std::max(m_minSteps, maxSteps);
+    m_steps = std::max(m_minSteps, std::min(m_maxSteps, m_steps));
+}
+
+// ! Smoothed cost of one step, or 0 before the first batch was measured
+float StepBudgetController::GetMsPerStep()
+{
+    return m_msPerStep;
+}
+
+int StepBudgetController::GetSteps()
+{
+    return m_steps;
+}
+
+// ! Records that the last batch took milliseconds for steps steps and returns the size of the next
+// ! one. Batches that did no steps, e.g. while paused, are ignored.
+int StepBudgetController::Update(const int steps, const float milliseconds)
+{
+    if (steps <= 0 || milliseconds <= 0.f)
+        return m_steps;
+    float msPerStep = milliseconds / steps;
+    if (m_msPerStep <= 0.f || milliseconds > STEP_BUDGET_OVERRUN*m_targetMs)
+    {
+        m_msPerStep = msPerStep;
+    }
+    else
+    {
+        m_msPerStep += STEP_BUDGET_SMOOTHING*(msPerStep - m_msPerStep);
+    }
+    float idealSteps = m_targetMs / m_msPerStep;
+    idealSteps = std::max(static_cast<float>(m_minSteps),
+        std::min(static_cast<float>(m_maxSteps), idealSteps));
+    if (std::abs(idealSteps - m_steps) > STEP_BUDGET_HYSTERESIS*m_steps)
+    {
+        m_steps = static_cast<int>(idealSteps + 0.5f);
+    }
+    return m_steps;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// ! Frame time the controller sizes batches for by default, about one 60 Hz display frame
+#define STEP_BUDGET_DEFAULT_TARGET_MS 16.f
+// ! Weight of the newest batch in the smoothed cost per step
+#define STEP_BUDGET_SMOOTHING 0.2f
+// ! Relative change of the ideal batch size below which the batch size is left alone
+#define STEP_BUDGET_HYSTERESIS 0.15f
+// ! A batch running this many times over the target replaces the smoothed cost outright
+#define STEP_BUDGET_OVERRUN 2.f
+#define STEP_BUDGET_MIN_STEPS 1
+#define STEP_BUDGET_MAX_STEPS 500
+
+#ifdef LBM_GL_CPP_EXPORTS  
+#define FW_API __declspec(dllexport)   
+#else  
+#define FW_API __declspec(dllimport)   
+#endif  
+
+// ! Sizes each batch of steps to fill a target frame time, from the measured cost of the batches
+// ! before it. The cost per step is smoothed, so one slow batch does not halve the next, and the
+// ! batch size only changes once the ideal size has moved by more than the hysteresis band, so it
+// ! does not hunt between neighboring values. A short target keeps the solution and the response to
+// ! input fresh; a long one spends less of each frame on launches and snapshots and so gets more
+// ! steps done. Steps are counted in whatever unit the caller batches in, e.g. step pairs.
+class FW_API StepBudgetController
+{
+    float m_targetMs;
+    float m_msPerStep;
+    int m_steps;
+    int m_minSteps;
+    int m_maxSteps;
+public:
+    StepBudgetController(const int initialSteps);
+    float GetTargetFrameTime();
+    void SetTargetFrameTime(const float milliseconds);
+    void SetStepRange(const int minSteps, const int maxSteps);
+    float GetMsPerStep();
+    int GetSteps();
+    int Update(const int steps, const float milliseconds);
+};
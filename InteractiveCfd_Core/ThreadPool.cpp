@@ -0,0 +1,188 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+int GetHardwareThreadCount()
+{
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// ! Restricts the calling thread to one logical core. Cores past the number the OS reports wrap
+// ! around.
+void PinCurrentThread(const int core)
+{
+    int target = core % GetHardwareThreadCount();
+#ifdef _MSC_VER
+    DWORD_PTR mask = static_cast<DWORD_PTR>(1) << (target % (8 * sizeof(DWORD_PTR)));
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(target % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+#endif
+}
+
+// ! With pinThreads, thread t of the pool is pinned to core t. The calling thread is pinned to
+// ! core 0 here, so the pool should be created on the thread that calls ParallelFor.
+ThreadPool::ThreadPool(const int threadCount, const bool pinThreads)
+{
+    m_threadCount = std::max(1, threadCount);
+    m_isPinned = pinThreads;
+    m_body = NULL;
+    m_generation = 0;
+    m_workersRunning = 0;
+    m_isStopping = false;
+    for (int thread = 0; thread < m_threadCount; thread++)
+    {
+        m_queues.push_back(new BandQueue);
+    }
+    if (m_isPinned)
+        PinCurrentThread(0);
+    for (int thread = 1; thread < m_threadCount; thread++)
+    {
+        m_threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, thread));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_startCondition.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+    for (size_t i = 0; i < m_queues.size(); i++)
+    {
+        delete m_queues[i];
+    }
+}
+
+int ThreadPool::GetThreadCount() const
+{
+    return m_threadCount;
+}
+
+bool ThreadPool::IsPinned() const
+{
+    return m_isPinned;
+}
+
+// ! Band size for splitting count rows. Splitting the same count the same way every time keeps
+// ! each band on the thread that first touched its memory, apart from stolen bands.
+int ThreadPool::GetBandSize(const int count) const
+{
+    return std::max(1, count / (m_threadCount * BANDS_PER_THREAD));
+}
+
+void ThreadPool::WorkerLoop(const int thread)
+{
+    if (m_isPinned)
+        PinCurrentThread(thread);
+    int generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_generation == generation && !m_isStopping)
+            {
+                m_startCondition.wait(lock);
+            }
+            if (m_isStopping)
+                return;
+            generation = m_generation;
+        }
+        RunBands(thread);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_workersRunning == 0)
+            m_doneCondition.notify_one();
+    }
+}
+
+void ThreadPool::RunBands(const int thread)
+{
+    Band band;
+    while (PopBand(thread, band))
+    {
+        (*m_body)(band.begin, band.end, thread);
+    }
+}
+
+// ! Takes the next band of the thread's own share, in order, or else steals the last band of
+// ! another thread's share, where it is least likely to touch the rows that thread is working on.
+// ! Bands are only ever taken, so finding every queue empty means the range is done.
+bool ThreadPool::PopBand(const int thread, Band &band)
+{
+    for (int i = 0; i < m_threadCount; i++)
+    {
+        BandQueue &queue = *m_queues[(thread + i) % m_threadCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.bands.empty())
+            continue;
+        if (i == 0)
+        {
+            band = queue.bands.front();
+            queue.bands.pop_front();
+        }
+        else
+        {
+            band = queue.bands.back();
+            queue.bands.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+// ! Calls body on bands of bandSize rows covering [begin, end) and returns once all of them have
+// ! run. Thread t starts on the t-th contiguous share of the bands, so a range split the same way
+// ! twice mostly lands on the same threads. Not reentrant: body must not call ParallelFor.
+void ThreadPool::ParallelFor(const int begin, const int end, const int bandSize,
+    const BandFunction &body)
+{
+    if (begin >= end)
+        return;
+    int size = std::max(bandSize, 1);
+    int bandCount = (end - begin + size - 1) / size;
+    if (m_threadCount == 1 || bandCount == 1)
+    {
+        body(begin, end, 0);
+        return;
+    }
+    for (int thread = 0; thread < m_threadCount; thread++)
+    {
+        BandQueue &queue = *m_queues[thread];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        int first = bandCount * thread / m_threadCount;
+        int last = bandCount * (thread + 1) / m_threadCount;
+        for (int n = first; n < last; n++)
+        {
+            Band band = { begin + n*size, std::min(begin + (n + 1)*size, end) };
+            queue.bands.push_back(band);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_body = &body;
+        m_workersRunning = m_threadCount - 1;
+        m_generation++;
+    }
+    m_startCondition.notify_all();
+    RunBands(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_workersRunning > 0)
+    {
+        m_doneCondition.wait(lock);
+    }
+    m_body = NULL;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ! ParallelFor ranges are split into this many bands per thread by GetBandSize, leaving bands to
+// ! steal when some rows take longer than the rest
+#define BANDS_PER_THREAD 8
+
+// ! Called with [begin, end) of one band of a ParallelFor range and the index of the thread running
+// ! it, which is in [0, GetThreadCount()) and can be used to pick per-thread scratch buffers
+typedef std::function<void(const int begin, const int end, const int thread)> BandFunction;
+
+// ! Fixed set of threads that run ranges of rows or tiles split into bands. Each thread starts on a
+// ! contiguous share of the bands, kept in its own deque, and once that is done it steals bands
+// ! from the far end of the other deques. Threads that land on the cheap rows of a range therefore
+// ! help out with the rows around obstacles instead of idling at the end of the pass. The thread
+// ! calling ParallelFor runs as thread 0, so the pool starts GetThreadCount() - 1 workers.
+class ThreadPool
+{
+    struct Band
+    {
+        int begin;
+        int end;
+    };
+    struct BandQueue
+    {
+        std::deque<Band> bands;
+        std::mutex mutex;
+    };
+    int m_threadCount;
+    bool m_isPinned;
+    std::vector<std::thread> m_threads;
+    std::vector<BandQueue*> m_queues;
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+    const BandFunction* m_body;
+    int m_generation;
+    int m_workersRunning;
+    bool m_isStopping;
+    void WorkerLoop(const int thread);
+    void RunBands(const int thread);
+    bool PopBand(const int thread, Band &band);
+public:
+    ThreadPool(const int threadCount, const bool pinThreads);
+    ~ThreadPool();
+    int GetThreadCount() const;
+    bool IsPinned() const;
+    int GetBandSize(const int count) const;
+    void ParallelFor(const int begin, const int end, const int bandSize, const BandFunction &body);
+};
+
+int GetHardwareThreadCount();
+void PinCurrentThread(const int core);
@@ -1,5 +1,5 @@
 #pragma once
-#define MAXOBSTS 100
+#define OBST_INITIAL_CAPACITY 128
 #define MAX_XDIM 768
 #define MAX_YDIM 768
 
@@ -14,6 +14,7 @@
 
 enum ContourVariable{VEL_MAG,VEL_U,VEL_V,PRESSURE,STRAIN_RATE,WATER_RENDERING};
 enum ViewMode{TWO_DIMENSIONAL,THREE_DIMENSIONAL};
+enum StreamingMode{TWO_BUFFER,IN_PLACE};
 enum Shape{SQUARE=0,CIRCLE=1,HORIZONTAL_LINE=2,VERTICAL_LINE=3};
 enum State{ACTIVE=0,INACTIVE=1,NEW=2,REMOVED=3};
 
@@ -4,88 +4,25 @@
 
 #include "kernel.h"
 #include "LbmNode.h"
+#include "NodeLists.h"
+#include "ActiveTiles.h"
+#include "ObstructionGeometry.h"
 #include "Graphics/CudaLbm.h"
+#include "Checkpoint.h"
 
 /*----------------------------------------------------------------------------------------
  *	Device functions
  */
 
-__global__ void UpdateObstructions(Obstruction* obstructions, const int obstNumber,
-    const Obstruction newObst)
+__global__ void UpdateObstructions(Obstruction* obstructions, const ObstructionDelta* deltas,
+    const int deltaCount)
 {
-    obstructions[obstNumber].shape = newObst.shape;
-    obstructions[obstNumber].r1 = newObst.r1;
-    obstructions[obstNumber].x = newObst.x;
-    obstructions[obstNumber].y = newObst.y;
-    obstructions[obstNumber].u = newObst.u;
-    obstructions[obstNumber].v = newObst.v;
-    obstructions[obstNumber].state = newObst.state;
+    int n = threadIdx.x + blockIdx.x*blockDim.x;
+    if (n >= deltaCount)
+        return;
+    obstructions[deltas[n].index] = deltas[n].obst;
 }
 
-inline __device__ bool IsInsideObstruction(const float x, const float y,
-    Obstruction* obstructions, const float tolerance = 0.f)
-{
-    for (int i = 0; i < MAXOBSTS; i++){
-        if (obstructions[i].state != State::INACTIVE)
-        {
-            float r1 = obstructions[i].r1;
-            if (obstructions[i].shape == Shape::SQUARE){
-                if (abs(x - obstructions[i].x)<r1 + tolerance &&
-                    abs(y - obstructions[i].y)<r1 + tolerance)
-                    return true;
-            }
-            else if (obstructions[i].shape == Shape::CIRCLE){//shift by 0.5 cells for better looks
-                float distFromCenter = (x + 0.5f - obstructions[i].x)*(x + 0.5f - obstructions[i].x)
-                    + (y + 0.5f - obstructions[i].y)*(y + 0.5f - obstructions[i].y);
-                if (distFromCenter<(r1+tolerance)*(r1+tolerance)+0.1f)
-                    return true;
-            }
-            else if (obstructions[i].shape == Shape::HORIZONTAL_LINE){
-                if (abs(x - obstructions[i].x)<r1*2+tolerance &&
-                    abs(y - obstructions[i].y)<LINE_OBST_WIDTH*0.501f+tolerance)
-                    return true;
-            }
-            else if (obstructions[i].shape == Shape::VERTICAL_LINE){
-                if (abs(y - obstructions[i].y)<r1*2+tolerance &&
-                    abs(x - obstructions[i].x)<LINE_OBST_WIDTH*0.501f+tolerance)
-                    return true;
-            }
-        }
-    }
-    return false;
-}
-
-inline __device__ int FindOverlappingObstruction(const float x, const float y,
-    Obstruction* obstructions, const float tolerance = 0.f)
-{
-    for (int i = 0; i < MAXOBSTS; i++){
-        if (obstructions[i].state != State::INACTIVE)
-        {
-            float r1 = obstructions[i].r1 + tolerance;
-            if (obstructions[i].shape == Shape::SQUARE){
-                if (abs(x - obstructions[i].x)<r1 && abs(y - obstructions[i].y)<r1)
-                    return i;//10;
-            }
-            else if (obstructions[i].shape == Shape::CIRCLE){//shift by 0.5 cells for better looks
-                float distFromCenter = (x + 0.5f - obstructions[i].x)*(x + 0.5f - obstructions[i].x)
-                    + (y + 0.5f - obstructions[i].y)*(y + 0.5f - obstructions[i].y);
-                if (distFromCenter<r1*r1+0.1f)
-                    return i;//10;
-            }
-            else if (obstructions[i].shape == Shape::HORIZONTAL_LINE){
-                if (abs(x - obstructions[i].x)<r1*2 &&
-                    abs(y - obstructions[i].y)<LINE_OBST_WIDTH*0.501f+tolerance)
-                    return i;//10;
-            }
-            else if (obstructions[i].shape == Shape::VERTICAL_LINE){
-                if (abs(y - obstructions[i].y)<r1*2 &&
-                    abs(x - obstructions[i].x)<LINE_OBST_WIDTH*0.501f+tolerance)
-                    return i;//10;
-            }
-        }
-    }
-    return -1;
-}
 __device__ float3 operator+(const float3 &u, const float3 &v)
 {
     return make_float3(u.x + v.x, u.y + v.y, u.z + v.z);
@@ -320,86 +257,167 @@ __device__ bool IntersectLineSegmentWithRect(float3 &intersect, float3 lineOrigi
     return false;
 }
 
-__device__ bool GetCoordFromRayHitOnObst(float3 &intersect, const float3 rayOrigin, const float3 rayDest,
-    Obstruction* obstructions, float obstHeight, const float tolerance = 0.f)
+// ! Narrows [tBegin, tEnd] to the part of origin + t*delta that lies in [0, size]. Returns false
+// ! if nothing is left.
+__device__ bool ClipRayToRange(float &tBegin, float &tEnd, const float origin, const float delta,
+    const float size)
+{
+    if (delta == 0.f)
+        return origin >= 0.f && origin <= size;
+    float t0 = -origin / delta;
+    float t1 = (size - origin) / delta;
+    if (t0 > t1)
+    {
+        float temp = t0;
+        t0 = t1;
+        t1 = temp;
+    }
+    tBegin = dmax(tBegin, t0);
+    tEnd = dmin(tEnd, t1);
+    return tBegin <= tEnd;
+}
+
+// ! Tests the ray against one obstruction, moving intersect to the hit if it is closer to the
+// ! ray origin than the hit already there
+__device__ bool IntersectRayWithObstruction(float3 &intersect, const float3 rayOrigin,
+    const float3 rayDest, const Obstruction &obst, float obstHeight)
 {
     float3 rayDir = rayDest - rayOrigin;
     bool hit = false;
-    for (int i = 0; i < MAXOBSTS; i++){
-        if (obstructions[i].state != State::INACTIVE)
+    float3 obstLineP1 = { obst.x, obst.y, 0.f };
+    float3 obstLineP2 = { obst.x, obst.y, obstHeight };
+    float dist = GetDistanceBetweenTwoLineSegments(rayOrigin, rayDest, obstLineP1, obstLineP2);
+    if (dist < obst.r1*2.5f)
+    {
+        float x =  obst.x;
+        float y =  obst.y;
+        if (obst.shape == Shape::SQUARE)
+        {
+            float r1 = obst.r1;
+            float3 swt = { x - r1, y - r1, obstHeight };//-0.3f*80.f
+            float3 set = { x + r1, y - r1, obstHeight };//-0.3f*80.f
+            float3 nwt = { x - r1, y + r1, obstHeight };//-0.3f*80.f
+            float3 net = { x + r1, y + r1, obstHeight };//-0.3f*80.f
+            float3 swb = { x - (r1+0.5f), y - (r1+0.5f), 0.f };//-1.f*80.f
+            float3 seb = { x + (r1+0.5f), y - (r1+0.5f), 0.f };//-1.f*80.f
+            float3 nwb = { x - (r1+0.5f), y + (r1+0.5f), 0.f };//-1.f*80.f
+            float3 neb = { x + (r1+0.5f), y + (r1+0.5f), 0.f };//-1.f*80.f
+
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
+        }
+        else if (obst.shape == Shape::CIRCLE)
         {
-            float3 obstLineP1 = { obstructions[i].x, obstructions[i].y, 0.f };
-            float3 obstLineP2 = { obstructions[i].x, obstructions[i].y, obstHeight };
-            float dist = GetDistanceBetweenTwoLineSegments(rayOrigin, rayDest, obstLineP1, obstLineP2);
-            if (dist < obstructions[i].r1*2.5f)
+            if (dist < obst.r1)
             {
-                float x =  obstructions[i].x;
-                float y =  obstructions[i].y;
-                if (obstructions[i].shape == Shape::SQUARE)
+                float3 v = CrossProduct(rayDir, obstLineP1 - obstLineP2);
+                Normalize(v);
+                float3 temp = float3{ x, y, obstHeight*0.5f }+dist*v;
+                if (Distance(temp, rayOrigin) < Distance(intersect, rayOrigin))
                 {
-                    float r1 = obstructions[i].r1;
-                    float3 swt = { x - r1, y - r1, obstHeight };//-0.3f*80.f
-                    float3 set = { x + r1, y - r1, obstHeight };//-0.3f*80.f
-                    float3 nwt = { x - r1, y + r1, obstHeight };//-0.3f*80.f
-                    float3 net = { x + r1, y + r1, obstHeight };//-0.3f*80.f
-                    float3 swb = { x - (r1+0.5f), y - (r1+0.5f), 0.f };//-1.f*80.f
-                    float3 seb = { x + (r1+0.5f), y - (r1+0.5f), 0.f };//-1.f*80.f
-                    float3 nwb = { x - (r1+0.5f), y + (r1+0.5f), 0.f };//-1.f*80.f
-                    float3 neb = { x + (r1+0.5f), y + (r1+0.5f), 0.f };//-1.f*80.f
-
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
-                }
-                else if (obstructions[i].shape == Shape::CIRCLE)
-                {
-                    if (dist < obstructions[i].r1)
-                    {
-                        float3 v = CrossProduct(rayDir, obstLineP1 - obstLineP2);
-                        Normalize(v);
-                        intersect = float3{ x, y, obstHeight*0.5f }+dist*v;
-                        hit = true;
-                    }
-                }
-                else if (obstructions[i].shape == Shape::VERTICAL_LINE)
-                {
-                    float r1 = LINE_OBST_WIDTH*0.501f;
-                    float r2 = obstructions[i].r1*2.f;
-                    float3 swt = { x - r1, y - r2, obstHeight };
-                    float3 set = { x + r1, y - r2, obstHeight };
-                    float3 nwt = { x - r1, y + r2, obstHeight };
-                    float3 net = { x + r1, y + r2, obstHeight };
-                    float3 swb = { x - (r1), y - (r2), 0.f };
-                    float3 seb = { x + (r1), y - (r2), 0.f };
-                    float3 nwb = { x - (r1), y + (r2), 0.f };
-                    float3 neb = { x + (r1), y + (r2), 0.f };
-
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
-                }
-                else if (obstructions[i].shape == Shape::HORIZONTAL_LINE)
-                {
-                    float r1 = obstructions[i].r1*2.f;
-                    float r2 = LINE_OBST_WIDTH*0.501f;
-                    float3 swt = { x - r1, y - r2, obstHeight };
-                    float3 set = { x + r1, y - r2, obstHeight };
-                    float3 nwt = { x - r1, y + r2, obstHeight };
-                    float3 net = { x + r1, y + r2, obstHeight };
-                    float3 swb = { x - (r1), y - (r2), 0.f };
-                    float3 seb = { x + (r1), y - (r2), 0.f };
-                    float3 nwb = { x - (r1), y + (r2), 0.f };
-                    float3 neb = { x + (r1), y + (r2), 0.f };
-
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
-                    hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
+                    intersect = temp;
+                    hit = true;
                 }
             }
         }
+        else if (obst.shape == Shape::VERTICAL_LINE)
+        {
+            float r1 = LINE_OBST_WIDTH*0.501f;
+            float r2 = obst.r1*2.f;
+            float3 swt = { x - r1, y - r2, obstHeight };
+            float3 set = { x + r1, y - r2, obstHeight };
+            float3 nwt = { x - r1, y + r2, obstHeight };
+            float3 net = { x + r1, y + r2, obstHeight };
+            float3 swb = { x - (r1), y - (r2), 0.f };
+            float3 seb = { x + (r1), y - (r2), 0.f };
+            float3 nwb = { x - (r1), y + (r2), 0.f };
+            float3 neb = { x + (r1), y + (r2), 0.f };
+
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
+        }
+        else if (obst.shape == Shape::HORIZONTAL_LINE)
+        {
+            float r1 = obst.r1*2.f;
+            float r2 = LINE_OBST_WIDTH*0.501f;
+            float3 swt = { x - r1, y - r2, obstHeight };
+            float3 set = { x + r1, y - r2, obstHeight };
+            float3 nwt = { x - r1, y + r2, obstHeight };
+            float3 net = { x + r1, y + r2, obstHeight };
+            float3 swb = { x - (r1), y - (r2), 0.f };
+            float3 seb = { x + (r1), y - (r2), 0.f };
+            float3 nwb = { x - (r1), y + (r2), 0.f };
+            float3 neb = { x + (r1), y + (r2), 0.f };
+
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, nwt, swt, swb, nwb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, swt, set, seb, swb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, set, net, neb, seb);
+            hit = hit | IntersectLineSegmentWithRect(intersect, rayOrigin, rayDest, net, nwt, nwb, neb);
+        }
+    }
+    return hit;
+}
+
+// ! Only the obstructions in the grid cells under the ray are tested. The cells are walked from the
+// ! origin along the ray's projection onto the floor, clipped to the grid. An obstruction listed in
+// ! several of those cells is tested again, which is harmless since only closer hits are kept.
+__device__ bool GetCoordFromRayHitOnObst(float3 &intersect, const float3 rayOrigin, const float3 rayDest,
+    Obstruction* obstructions, const ObstructionGridView &grid, float obstHeight)
+{
+    float dx = rayDest.x - rayOrigin.x;
+    float dy = rayDest.y - rayOrigin.y;
+    float gridWidth = grid.cellsX*OBST_GRID_CELL_SIZE;
+    float gridHeight = grid.cellsY*OBST_GRID_CELL_SIZE;
+    float tBegin = 0.f;
+    float tEnd = 1.f;
+    if (!ClipRayToRange(tBegin, tEnd, rayOrigin.x, dx, gridWidth) ||
+        !ClipRayToRange(tBegin, tEnd, rayOrigin.y, dy, gridHeight))
+        return false;
+
+    int beginCell = GetObstructionGridCell(rayOrigin.x + tBegin*dx, rayOrigin.y + tBegin*dy, grid);
+    int cellX = beginCell % grid.cellsX;
+    int cellY = beginCell / grid.cellsX;
+    int endCell = GetObstructionGridCell(rayOrigin.x + tEnd*dx, rayOrigin.y + tEnd*dy, grid);
+    int stepX = dx > 0.f ? 1 : -1;
+    int stepY = dy > 0.f ? 1 : -1;
+    float tNextX = dx != 0.f ? ((cellX + (stepX > 0 ? 1 : 0))*OBST_GRID_CELL_SIZE - rayOrigin.x) / dx
+        : 2.f;
+    float tNextY = dy != 0.f ? ((cellY + (stepY > 0 ? 1 : 0))*OBST_GRID_CELL_SIZE - rayOrigin.y) / dy
+        : 2.f;
+    float tDeltaX = dx != 0.f ? OBST_GRID_CELL_SIZE / fabsf(dx) : 2.f;
+    float tDeltaY = dy != 0.f ? OBST_GRID_CELL_SIZE / fabsf(dy) : 2.f;
+
+    bool hit = false;
+    for (int steps = 0; steps < grid.cellsX + grid.cellsY; steps++)
+    {
+        int cell = cellX + cellY*grid.cellsX;
+        for (int n = grid.cellStart[cell]; n < grid.cellStart[cell + 1]; n++)
+        {
+            int i = grid.ids[n];
+            if (obstructions[i].state != State::INACTIVE)
+            {
+                hit = hit | IntersectRayWithObstruction(intersect, rayOrigin, rayDest,
+                    obstructions[i], obstHeight);
+            }
+        }
+        if (cell == endCell)
+            break;
+        if (tNextX < tNextY)
+        {
+            cellX += stepX;
+            tNextX += tDeltaX;
+        }
+        else
+        {
+            cellY += stepY;
+            tNextY += tDeltaY;
+        }
+        if (cellX < 0 || cellX >= grid.cellsX || cellY < 0 || cellY >= grid.cellsY)
+            break;
     }
     return hit;
 }
@@ -417,26 +435,51 @@ __device__	void ChangeCoordinatesToNDC(float &xcoord,float &ycoord,
 }
 
 __device__	void ChangeCoordinatesToScaledFloat(float &xcoord,float &ycoord,
-    const int xDimVisible, const int yDimVisible)
+    const int x, const int y, const int xDimVisible, const int yDimVisible)
 {
-    xcoord = threadIdx.x + blockDim.x*blockIdx.x;
-    ycoord = threadIdx.y + blockDim.y*blockIdx.y;
+    xcoord = x;
+    ycoord = y;
     xcoord /= xDimVisible *0.5f;
     ycoord /= xDimVisible *0.5f;//(float)(blockDim.y*gridDim.y);
     xcoord -= 1.0;// xdim / maxDim;
     ycoord -= 1.0;// ydim / maxDim;
 }
 
-// Initialize domain using constant velocity
-__global__ void InitializeLBM(float4* vbo, float *f, int *Im, float uMax,
+__device__	void ChangeCoordinatesToScaledFloat(float &xcoord,float &ycoord,
+    const int xDimVisible, const int yDimVisible)
+{
+    ChangeCoordinatesToScaledFloat(xcoord, ycoord, threadIdx.x + blockDim.x*blockIdx.x,
+        threadIdx.y + blockDim.y*blockIdx.y, xDimVisible, yDimVisible);
+}
+
+// Node of the calling thread in kernels launched with one ACTIVE_TILE_SIZE square block per entry
+// of tiles, or per tile of the whole lattice when tiles is NULL
+__device__ void GetTileNode(int &x, int &y, const int* tiles, const int tilesX)
+{
+    int tile = tiles == NULL ? blockIdx.x : tiles[blockIdx.x];
+    x = (tile % tilesX)*ACTIVE_TILE_SIZE + threadIdx.x;
+    y = (tile / tilesX)*ACTIVE_TILE_SIZE + threadIdx.y;
+}
+
+// Initialize domain using constant velocity. An in-place lattice is laid out as after an odd step,
+// so the nodes in the domain push their distributions to their neighbors the way that step does
+__global__ void InitializeLBM(float4* vbo, float *f, int *Im, float uMax, const bool isInPlace,
     Domain simDomain)
 {
     int x = threadIdx.x + blockIdx.x*blockDim.x;
     int y = threadIdx.y + blockIdx.y*blockDim.y;
 
     LbmNode lbm;
+    lbm.SetXDim(simDomain.GetXDim());
+    lbm.SetYDim(simDomain.GetYDim());
+    lbm.SetMemoryLayout(simDomain);
     lbm.Initialize(f, 1.f, uMax, 0.f);
-    lbm.WriteDistributions(f, x, y);
+    if (isInPlace && x < simDomain.GetXDim() && y < simDomain.GetYDim())
+        lbm.WriteOddStepDistributions(f, x, y);
+    else
+        lbm.WriteDistributions(f, x, y);
+    if (x >= MAX_XDIM || y >= MAX_YDIM)
+        return;
 
     float xcoord, ycoord, zcoord;
     int xDimVisible = simDomain.GetXDimVisible();
@@ -451,36 +494,60 @@ __global__ void InitializeLBM(float4* vbo, float *f, int *Im, float uMax,
     vbo[j] = make_float4(xcoord, ycoord, zcoord, color);
 }
 
-// main LBM function including streaming and colliding
-__global__ void MarchLBM(float* fA, float* fB, const float omega, int *Im,
-    Obstruction *obstructions, const float uMax, Domain simDomain)
+// Resets the listed tiles to fluid at rest. Used for tiles that are stepped again after being
+// skipped as walls, whose distributions are stale. In-place lattices get the rest state the way
+// an odd step writes it, like InitializeLBM
+__global__ void InitializeTiles(float* f, const int* tiles, const int tilesX, const bool isInPlace,
+    Domain simDomain)
 {
-    int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
-    int y = threadIdx.y + blockIdx.y*blockDim.y;
-    int j = x + y*MAX_XDIM;
-    int im = Im[j];
-    int obstId = FindOverlappingObstruction(x, y, obstructions);
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetMaxXDim() || y >= simDomain.GetMaxYDim())
+        return;
+
+    LbmNode lbm;
+    lbm.SetXDim(simDomain.GetXDim());
+    lbm.SetYDim(simDomain.GetYDim());
+    lbm.SetMemoryLayout(simDomain);
+    lbm.Initialize(f, 1.f, 0.f, 0.f);
+    if (isInPlace && x < simDomain.GetXDim() && y < simDomain.GetYDim())
+        lbm.WriteOddStepDistributions(f, x, y);
+    else
+        lbm.WriteDistributions(f, x, y);
+}
+
+// Rebuilds the node image inside rect from the domain boundaries and the solid obstructions.
+// Covered nodes also get the id of the obstruction so moving walls can look up its velocity
+__global__ void RasterizeObstructions(int *Im, int *obstIdMap, Obstruction *obstructions,
+    const ObstructionGridView obstGrid, const RectInt rect, Domain simDomain)
+{
+    int x = rect.m_x + threadIdx.x + blockIdx.x*blockDim.x;
+    int y = rect.m_y + threadIdx.y + blockIdx.y*blockDim.y;
+    if (x >= rect.m_x + rect.m_w || y >= rect.m_y + rect.m_h)
+        return;
+    int j = x + y*simDomain.GetMaxXDim();
+    int obstId = FindSolidObstruction(x, y, obstructions, obstGrid);
     if (obstId >= 0)
     {
-        if (obstructions[obstId].u < 1e-5f && obstructions[obstId].v < 1e-5f)
-        {
-            im = 1; //bounce back
-            Im[j] = im;
-        }
-        else
-        {
-            im = 20; //moving wall
-            Im[j] = im;
-        }
+        Im[j] = GetObstructionNodeType(obstructions[obstId]);
     }
+    else
+    {
+        Im[j] = simDomain.ImageFcn(x, y);
+    }
+    obstIdMap[j] = obstId;
+}
+
+// Applies obstruction and domain boundary conditions to the incoming distributions and collides
+template <typename Collision>
+__device__ void ApplyBCsAndCollide(LbmNode &lbm, const int x, const int y, const float omega,
+    int *Im, int *obstIdMap, Obstruction *obstructions, const float uMax, Domain &simDomain)
+{
+    int j = x + y*simDomain.GetMaxXDim();
+    int im = Im[j];
     int xDim = simDomain.GetXDim();
     int yDim = simDomain.GetYDim();
 
-    LbmNode lbm;
-    lbm.SetXDim(xDim);
-    lbm.SetYDim(yDim);
-    lbm.ReadIncomingDistributions(fA, x, y);
-
     if (im == 1 || im == 10){//bounce-back condition
         lbm.BounceBackWall();
     }
@@ -488,35 +555,190 @@ __global__ void MarchLBM(float* fA, float* fB, const float omega, int *Im,
     {
         float rho, u, v;
         rho = 1.0f;
-        u = obstructions[FindOverlappingObstruction(x, y, obstructions)].u;
-        v = obstructions[FindOverlappingObstruction(x, y, obstructions)].v;
+        u = obstructions[obstIdMap[j]].u;
+        v = obstructions[obstIdMap[j]].v;
         lbm.MovingWall(rho, u, v);
     }
     else{
         lbm.ApplyBCs(y, im, xDim, yDim, uMax);
-        lbm.Collide(omega);
+        lbm.Collide<Collision>(omega);
     }
-    lbm.WriteDistributions(fB, x, y);
 }
 
-// main LBM function including streaming and colliding
-__global__ void UpdateSurfaceVbo(float4* vbo, float* fA, int *Im,
-    const int contourVar, const float contMin, const float contMax,
-    const int viewMode, const float uMax, Domain simDomain)
+// Bulk of the two-buffer step, streaming and colliding the fluid nodes of the active tiles. Fluid
+// nodes are never on the domain edge, so their neighbors are read without clamping. Boundary nodes
+// are skipped here and stepped by MarchLBMBoundary
+template <typename Collision>
+__global__ void MarchLBMFluid(float* fA, float* fB, const float omega, int *Im,
+    const int* tiles, const int tilesX, Domain simDomain)
 {
-    int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
-    int y = threadIdx.y + blockIdx.y*blockDim.y;
-    int j = x + y*MAX_XDIM;
-    int im = Im[j];
-    float u, v, rho;
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetXDim() || y >= simDomain.GetYDim())
+        return;
+    if (GetBoundaryType(Im[x + y*simDomain.GetMaxXDim()]) != BOUNDARY_NONE)
+        return;
 
+    LbmNode lbm;
+    lbm.SetMemoryLayout(simDomain);
+    lbm.ReadInteriorDistributions(fA, x, y);
+    lbm.Collide<Collision>(omega);
+    lbm.WriteDistributions(fB, x, y);
+}
+
+// Two-buffer step of the boundary nodes of one type. nodes holds their indices x + y*maxXDim
+template <typename Collision, int Type>
+__global__ void MarchLBMBoundary(float* fA, float* fB, const float omega, const int* nodes,
+    const int nodeCount, int *obstIdMap, Obstruction *obstructions, const float uMax,
+    Domain simDomain)
+{
+    int n = threadIdx.x + blockIdx.x*blockDim.x;
+    if (n >= nodeCount)
+        return;
+    int j = nodes[n];
+    int x = j % simDomain.GetMaxXDim();
+    int y = j / simDomain.GetMaxXDim();
     int xDim = simDomain.GetXDim();
     int yDim = simDomain.GetYDim();
+
     LbmNode lbm;
-    lbm.ReadDistributions(fA, x, y);
-    rho = lbm.ComputeRho();
-    u = lbm.ComputeU();
-    v = lbm.ComputeV();
+    lbm.SetXDim(xDim);
+    lbm.SetYDim(yDim);
+    lbm.SetMemoryLayout(simDomain);
+    lbm.ReadIncomingDistributions(fA, x, y);
+    if (ApplyBoundaryCondition<Type>(lbm, j, y, xDim, yDim, uMax, obstIdMap, obstructions))
+        lbm.Collide<Collision>(omega);
+    lbm.WriteDistributions(fB, x, y);
+}
+
+// Single lattice variant of MarchLBM using the AA access pattern. Every slot is read and written
+// by one node only within a step, so no second buffer is needed. After an odd step the lattice
+// holds the next even step's incoming distributions, which ReadInPlaceDistributions reads back
+template <typename Collision>
+__global__ void MarchLBMInPlace(float* f, const bool isEvenStep, const float omega, int *Im,
+    int *obstIdMap, Obstruction *obstructions, const float uMax, const int* tiles,
+    const int tilesX, Domain simDomain)
+{
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetXDim() || y >= simDomain.GetYDim())
+        return;
+
+    LbmNode lbm;
+    lbm.SetXDim(simDomain.GetXDim());
+    lbm.SetYDim(simDomain.GetYDim());
+    lbm.SetMemoryLayout(simDomain);
+    if (isEvenStep)
+        lbm.ReadDistributions(f, x, y);
+    else
+        lbm.ReadOddStepDistributions(f, x, y);
+    ApplyBCsAndCollide<Collision>(lbm, x, y, omega, Im, obstIdMap, obstructions, uMax, simDomain);
+    if (isEvenStep)
+        lbm.WriteEvenStepDistributions(f, x, y);
+    else
+        lbm.WriteOddStepDistributions(f, x, y);
+}
+
+// ! Macro fields of one node for a solution snapshot. The strain rate is left at zero unless it is
+// ! asked for, as computing it costs more than the rest.
+__global__ void WriteMacroSnapshot(MacroNode* nodes, float* f, int *Im, const bool withStrainRate,
+    const bool isInPlace, const int* tiles, const int tilesX, Domain simDomain)
+{
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetMaxXDim() || y >= simDomain.GetMaxYDim())
+        return;
+    int j = x + y*simDomain.GetMaxXDim();
+    LbmNode lbm;
+    lbm.SetXDim(simDomain.GetXDim());
+    lbm.SetYDim(simDomain.GetYDim());
+    lbm.SetMemoryLayout(simDomain);
+    if (isInPlace && x < simDomain.GetXDim() && y < simDomain.GetYDim())
+        lbm.ReadInPlaceDistributions(f, x, y);
+    else
+        lbm.ReadDistributions(f, x, y);
+    MacroNode node;
+    node.rho = lbm.ComputeRho();
+    node.u = lbm.ComputeU();
+    node.v = lbm.ComputeV();
+    node.strainRate = withStrainRate ? lbm.ComputeStrainRateMagnitude() : 0.f;
+    node.im = Im[j];
+    nodes[j] = node;
+}
+
+// ! Sums, over the fluid nodes of each tile, the squared change of the macro fields since they were
+// ! stored in prev, which is updated, along with the squared velocity and the node count. Each tile
+// ! is reduced in shared memory and added to sums with one atomic per quantity.
+__global__ void ReduceResidual(float* sums, float4* prev, float* f, int *Im, const bool isInPlace,
+    const int* tiles, const int tilesX, Domain simDomain)
+{
+    __shared__ float partials[4][ACTIVE_TILE_SIZE*ACTIVE_TILE_SIZE];
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    int t = threadIdx.x + threadIdx.y*ACTIVE_TILE_SIZE;
+    float terms[4] = { 0.f, 0.f, 0.f, 0.f };
+    if (x < simDomain.GetXDim() && y < simDomain.GetYDim())
+    {
+        int j = x + y*simDomain.GetMaxXDim();
+        int im = Im[j];
+        if (im != 1 && im != 10 && im != 20)
+        {
+            LbmNode lbm;
+            lbm.SetXDim(simDomain.GetXDim());
+            lbm.SetYDim(simDomain.GetYDim());
+            lbm.SetMemoryLayout(simDomain);
+            if (isInPlace)
+                lbm.ReadInPlaceDistributions(f, x, y);
+            else
+                lbm.ReadDistributions(f, x, y);
+            float rho = lbm.ComputeRho();
+            float u = lbm.ComputeU();
+            float v = lbm.ComputeV();
+            float4 last = prev[j];
+            terms[0] = (u - last.y)*(u - last.y) + (v - last.z)*(v - last.z);
+            terms[1] = u*u + v*v;
+            terms[2] = (rho - last.x)*(rho - last.x);
+            terms[3] = 1.f;
+            prev[j] = make_float4(rho, u, v, 0.f);
+        }
+    }
+    for (int n = 0; n < 4; n++)
+    {
+        partials[n][t] = terms[n];
+    }
+    __syncthreads();
+    for (int stride = ACTIVE_TILE_SIZE*ACTIVE_TILE_SIZE / 2; stride > 0; stride /= 2)
+    {
+        if (t < stride)
+        {
+            for (int n = 0; n < 4; n++)
+            {
+                partials[n][t] += partials[n][t + stride];
+            }
+        }
+        __syncthreads();
+    }
+    if (t < 4 && partials[3][0] > 0.f)
+        atomicAdd(&sums[t], partials[t][0]);
+}
+
+// ! Surface vertex of one node from a solution snapshot, which keeps the lattice pitch
+__global__ void UpdateSurfaceVbo(float4* vbo, const MacroNode* nodes,
+    const int contourVar, const float contMin, const float contMax,
+    const int viewMode, const float uMax, const int* tiles, const int tilesX, Domain simDomain)
+{
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= MAX_XDIM || y >= MAX_YDIM)
+        return;
+    if (x >= simDomain.GetXDimVisible() || y >= simDomain.GetYDimVisible())
+        return;
+    int j = x + y*MAX_XDIM;//index in the vbo, which keeps the default pitch
+    MacroNode node = nodes[x + y*simDomain.GetMaxXDim()];
+    int im = node.im;
+    float u = node.u;
+    float v = node.v;
+    float rho = node.rho;
 
     //Prepare data for visualization
 
@@ -524,7 +746,7 @@ __global__ void UpdateSurfaceVbo(float4* vbo, float* fA, int *Im,
     float xcoord, ycoord, zcoord;
     int xDimVisible = simDomain.GetXDimVisible();
     int yDimVisible = simDomain.GetYDimVisible();
-    ChangeCoordinatesToScaledFloat(xcoord, ycoord, xDimVisible, yDimVisible);
+    ChangeCoordinatesToScaledFloat(xcoord, ycoord, x, y, xDimVisible, yDimVisible);
 
     if (im == 1) rho = 1.0;
     zcoord =  (-1.f+WATER_DEPTH_NORMALIZED) + 1.5f*(rho - 1.0f);
@@ -532,8 +754,6 @@ __global__ void UpdateSurfaceVbo(float4* vbo, float* fA, int *Im,
     //for color, need to convert 4 bytes (RGBA) to float
     float variableValue = 0.f;
 
-    float strainRate;
-
     //change min/max contour values based on contour variable
     if (contourVar == ContourVariable::VEL_MAG)
     {
@@ -553,8 +773,7 @@ __global__ void UpdateSurfaceVbo(float4* vbo, float* fA, int *Im,
     }
     else if (contourVar == ContourVariable::STRAIN_RATE)
     {
-        strainRate = lbm.ComputeStrainRateMagnitude();
-        variableValue = strainRate;
+        variableValue = node.strainRate;
     }
 
     ////Blue to white color scheme
@@ -608,10 +827,12 @@ __global__ void CleanUpVBO(float4* vbo, Domain simDomain)
 }
 
 __global__ void PhongLighting(float4* vbo, Obstruction *obstructions, 
-    float3 cameraPosition, Domain simDomain)
+    float3 cameraPosition, const int* tiles, const int tilesX, Domain simDomain)
 {
-    int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
-    int y = threadIdx.y + blockIdx.y*blockDim.y;
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetXDimVisible() || y >= simDomain.GetYDimVisible())
+        return;
     int j = x + y*MAX_XDIM;//index on padded mem (pitch in elements)
     unsigned char color[4];
     std::memcpy(color, &(vbo[j].w), sizeof(color));
@@ -770,7 +991,7 @@ __device__ float ComputeAreaFrom4Points(const float2 &nw, const float2 &ne,
 }
 
 __global__ void DeformFloorMeshUsingCausticRay(float4* vbo, float3 incidentLight, 
-    Obstruction* obstructions, Domain simDomain)
+    Obstruction* obstructions, const ObstructionGridView obstGrid, Domain simDomain)
 {
     int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
     int y = threadIdx.y + blockIdx.y*blockDim.y;
@@ -781,7 +1002,7 @@ __global__ void DeformFloorMeshUsingCausticRay(float4* vbo, float3 incidentLight
     if (x < xDimVisible && y < yDimVisible)
     {
         float2 lightPositionOnFloor;
-        if (IsInsideObstruction(x, y, obstructions,1.f))
+        if (IsInsideObstruction(x, y, obstructions, obstGrid, 1.f))
         {
             lightPositionOnFloor = make_float2(x, y);
         }
@@ -823,7 +1044,7 @@ __global__ void ComputeFloorLightIntensitiesFromMeshDeformation(float4* vbo, flo
 }
 
 __global__ void ApplyCausticLightingToFloor(float4* vbo, float* floor_d, 
-    Obstruction* obstructions, Domain simDomain)
+    Obstruction* obstructions, const ObstructionGridView obstGrid, Domain simDomain)
 {
     int x = threadIdx.x + blockIdx.x*blockDim.x;
     int y = threadIdx.y + blockIdx.y*blockDim.y;
@@ -842,9 +1063,9 @@ __global__ void ApplyCausticLightingToFloor(float4* vbo, float* floor_d,
     unsigned char B = 220.0f;
     unsigned char A = 255.f;
 
-    if (IsInsideObstruction(x, y, obstructions, 0.99f))
+    if (IsInsideObstruction(x, y, obstructions, obstGrid, 0.99f))
     {
-        int obstID = FindOverlappingObstruction(x, y, obstructions,0.f);
+        int obstID = FindOverlappingObstruction(x, y, obstructions, obstGrid, 0.f);
         if (obstID >= 0)
         {
             float fullObstHeight = -1.f+OBST_HEIGHT;
@@ -894,7 +1115,8 @@ __global__ void ApplyCausticLightingToFloor(float4* vbo, float* floor_d,
     vbo[j].w = color;
 }
 
-__global__ void UpdateObstructionTransientStates(float4* vbo, Obstruction* obstructions)
+__global__ void UpdateObstructionTransientStates(float4* vbo, Obstruction* obstructions,
+    const ObstructionGridView obstGrid)
 {
     int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
     int y = threadIdx.y + blockIdx.y*blockDim.y;
@@ -903,9 +1125,9 @@ __global__ void UpdateObstructionTransientStates(float4* vbo, Obstruction* obstr
 
     zcoord = vbo[j].z;
 
-    if (IsInsideObstruction(x, y, obstructions, 1.f))
+    if (IsInsideObstruction(x, y, obstructions, obstGrid, 1.f))
     {
-        int obstID = FindOverlappingObstruction(x, y, obstructions);
+        int obstID = FindOverlappingObstruction(x, y, obstructions, obstGrid);
         if (obstID >= 0)
         {
             if (zcoord > -1.f+OBST_HEIGHT-0.1f)
@@ -921,7 +1143,7 @@ __global__ void UpdateObstructionTransientStates(float4* vbo, Obstruction* obstr
 }
 
 __global__ void RayCast(float4* vbo, float4* rayCastIntersect, float3 rayOrigin,
-    float3 rayDir, Obstruction* obstructions, Domain simDomain)
+    float3 rayDir, Obstruction* obstructions, const ObstructionGridView obstGrid, Domain simDomain)
 {
     int x = threadIdx.x + blockIdx.x*blockDim.x;
     int y = threadIdx.y + blockIdx.y*blockDim.y;
@@ -933,7 +1155,7 @@ __global__ void RayCast(float4* vbo, float4* rayCastIntersect, float3 rayOrigin,
 
     if (x > 1 && y > 1 && x < xDimVisible - 1 && y < yDimVisible - 1)
     {
-        if (IsInsideObstruction(x, y, obstructions, 1.f))
+        if (IsInsideObstruction(x, y, obstructions, obstGrid, 1.f))
         {
             float3 nw{ vbo[j+MAX_XDIM].x, vbo[j+MAX_XDIM].y, vbo[j+MAX_XDIM].z };
             float3 ne{ vbo[j+MAX_XDIM+1].x, vbo[j+MAX_XDIM+1].y, vbo[j+MAX_XDIM+1].z };
@@ -1120,10 +1342,12 @@ texture<float4, 2, cudaReadModeElementType> floorTex;
 texture<float4, 2, cudaReadModeElementType> envTex;
 
 __global__ void SurfaceRefraction(float4* vbo, Obstruction *obstructions,
-    float3 cameraPosition, Domain simDomain)
+    const ObstructionGridView obstGrid, float3 cameraPosition, const int* tiles, const int tilesX, Domain simDomain)
 {
-    int x = threadIdx.x + blockIdx.x*blockDim.x;//coord in linear mem
-    int y = threadIdx.y + blockIdx.y*blockDim.y;
+    int x, y;
+    GetTileNode(x, y, tiles, tilesX);
+    if (x >= simDomain.GetXDimVisible() || y >= simDomain.GetYDimVisible())
+        return;
     int j = x + y*MAX_XDIM;//index on padded mem (pitch in elements)
 
     int xDimVisible = simDomain.GetXDimVisible();
@@ -1218,7 +1442,7 @@ __global__ void SurfaceRefraction(float4* vbo, Obstruction *obstructions,
     else
     {
         unsigned char refractedColor[4];
-        if (GetCoordFromRayHitOnObst(refractionIntersect, elementPosition, refractedRayDest, obstructions, OBST_HEIGHT / 2.f*xDimVisible))
+        if (GetCoordFromRayHitOnObst(refractionIntersect, elementPosition, refractedRayDest, obstructions, obstGrid, OBST_HEIGHT / 2.f*xDimVisible))
         {
             std::memcpy(refractedColor, &(vbo[(int)(refractionIntersect.x+0.5f) + (int)(refractionIntersect.y+0.5f)*MAX_XDIM + MAX_XDIM * MAX_YDIM].w),
                 sizeof(refractedColor));
@@ -1233,7 +1457,7 @@ __global__ void SurfaceRefraction(float4* vbo, Obstruction *obstructions,
 
         unsigned char reflectedColor[4];
         float3 reflectedRayDest = elementPosition + xDimVisible*reflectedRay;
-        if (GetCoordFromRayHitOnObst(reflectionIntersect, elementPosition, reflectedRayDest, obstructions, OBST_HEIGHT / 2.f*xDimVisible))
+        if (GetCoordFromRayHitOnObst(reflectionIntersect, elementPosition, reflectedRayDest, obstructions, obstGrid, OBST_HEIGHT / 2.f*xDimVisible))
         {
             std::memcpy(reflectedColor, &(vbo[(int)(reflectionIntersect.x+0.5f) + (int)(reflectionIntersect.y+0.5f)*MAX_XDIM + MAX_XDIM * MAX_YDIM].w),
                 sizeof(reflectedColor));
@@ -1262,76 +1486,265 @@ __global__ void SurfaceRefraction(float4* vbo, Obstruction *obstructions,
 
 
 void InitializeDomain(float4* vis, float* f_d, int* im_d, const float uMax,
-    Domain &simDomain)
+    const StreamingMode streamingMode, Domain &simDomain)
 {
     dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
-    dim3 grid(ceil(static_cast<float>(MAX_XDIM) / BLOCKSIZEX), MAX_YDIM / BLOCKSIZEY);
-    InitializeLBM << <grid, threads >> >(vis, f_d, im_d, uMax, simDomain);
+    dim3 grid(simDomain.GetMaxXDim() / BLOCKSIZEX, simDomain.GetMaxYDim() / BLOCKSIZEY);
+    InitializeLBM << <grid, threads >> >(vis, f_d, im_d, uMax,
+        streamingMode == StreamingMode::IN_PLACE, simDomain);
 }
 
-void SetObstructionVelocitiesToZero(Obstruction* obst_h, Obstruction* obst_d, const float scaleFactor)
+// ! Stops the obstructions that moved during the last batch of steps. Called by the solver thread,
+// ! so only the mirror is changed and the host obstructions keep their velocities, which are queued
+// ! again when the next frame rescales them, as long as the obstructions are still being dragged.
+void SetObstructionVelocitiesToZero(CudaLbm* cudaLbm)
 {
-    for (int i = 0; i < MAXOBSTS; i++)
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    Obstruction* obst = obstMirror->GetData();
+    Domain* simDomain = cudaLbm->GetDomain();
+    for (int i = 0; i < obstMirror->GetCount(); i++)
     {
-        if ((abs(obst_h[i].u) > 0.f || abs(obst_h[i].v) > 0.f) &&
-            obst_h[i].state != State::REMOVED && obst_h[i].state != State::INACTIVE)
+        if ((abs(obst[i].u) > 0.f || abs(obst[i].v) > 0.f) &&
+            obst[i].state != State::REMOVED && obst[i].state != State::INACTIVE)
         {
-            Obstruction obst = obst_h[i];
-            obst.x /= scaleFactor;
-            obst.y /= scaleFactor;
-            obst.r1 /= scaleFactor;
-            obst.r2 /= scaleFactor;
-            obst.u = 0.f;
-            obst.v = 0.f;
-            UpdateObstructions << <1, 1 >> >(obst_d,i,obst);
+            obst[i].u = 0.f;
+            obst[i].v = 0.f;
+            simDomain->MarkImageDirty(GetObstructionBounds(obst[i]));
+            cudaLbm->GetObstDeltas()->Push(i);
         }
     }
 }
 
+// ! Only the region flagged on the domain is rebuilt, along with the boundary node lists of its rows
+// ! and the active tiles around it. Tiles that are stepped again after being skipped as walls are
+// ! reset to fluid at rest.
+void UpdateDeviceImage(CudaLbm* cudaLbm)
+{
+    Domain* simDomain = cudaLbm->GetDomain();
+    if (!simDomain->IsImageDirty())
+        return;
+    RectInt rect = simDomain->GetImageDirtyRect();
+    dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
+    dim3 grid(ceil(static_cast<float>(rect.m_w) / BLOCKSIZEX), rect.m_h / BLOCKSIZEY);
+    RasterizeObstructions << <grid, threads >> >(cudaLbm->GetImage(), cudaLbm->GetObstIdMap(),
+        cudaLbm->GetDeviceObst(), cudaLbm->GetObstructionGrid(), rect, *simDomain);
+    cudaLbm->UpdateBoundaryNodes(rect);
+    if (cudaLbm->GetActivatedTileCount() > 0)
+    {
+        dim3 tileThreads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+        InitializeTiles << <cudaLbm->GetActivatedTileCount(), tileThreads >> >(cudaLbm->GetFA(),
+            cudaLbm->GetActivatedTiles(), cudaLbm->GetTilesX(),
+            cudaLbm->GetStreamingMode() == StreamingMode::IN_PLACE, *simDomain);
+    }
+    simDomain->ClearImageDirtyRect();
+}
+
+template <typename Collision, int Type>
+void MarchBoundaryNodes(CudaLbm* cudaLbm, float* fA_d, float* fB_d)
+{
+    int nodeCount = cudaLbm->GetBoundaryNodeCount(static_cast<BoundaryType>(Type));
+    if (nodeCount == 0)
+        return;
+    int threads = BLOCKSIZEX;
+    int blocks = (nodeCount + threads - 1) / threads;
+    MarchLBMBoundary<Collision, Type> << <blocks, threads >> >(fA_d, fB_d, cudaLbm->GetOmega(),
+        cudaLbm->GetBoundaryNodes(static_cast<BoundaryType>(Type)), nodeCount,
+        cudaLbm->GetObstIdMap(), cudaLbm->GetDeviceObst(), cudaLbm->GetInletVelocity(),
+        *cudaLbm->GetDomain());
+}
+
+// ! One two-buffer time step from fA_d to fB_d: the fluid bulk with one block per active tile,
+// ! then one launch per boundary type over its node list
+template <typename Collision>
+void MarchLBM(CudaLbm* cudaLbm, float* fA_d, float* fB_d)
+{
+    if (cudaLbm->GetActiveTileCount() == 0)
+        return;
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    MarchLBMFluid<Collision> << <cudaLbm->GetActiveTileCount(), threads >> >(fA_d, fB_d,
+        cudaLbm->GetOmega(), cudaLbm->GetImage(), cudaLbm->GetActiveTiles(),
+        cudaLbm->GetTilesX(), *cudaLbm->GetDomain());
+    MarchBoundaryNodes<Collision, BOUNDARY_BOUNCE_BACK>(cudaLbm, fA_d, fB_d);
+    MarchBoundaryNodes<Collision, BOUNDARY_MOVING_WALL>(cudaLbm, fA_d, fB_d);
+    MarchBoundaryNodes<Collision, BOUNDARY_INLET>(cudaLbm, fA_d, fB_d);
+    MarchBoundaryNodes<Collision, BOUNDARY_OUTLET>(cudaLbm, fA_d, fB_d);
+    MarchBoundaryNodes<Collision, BOUNDARY_SYMMETRY_TOP>(cudaLbm, fA_d, fB_d);
+    MarchBoundaryNodes<Collision, BOUNDARY_SYMMETRY_BOTTOM>(cudaLbm, fA_d, fB_d);
+}
+
+// ! Steps the lattice with the kernels instantiated for one collision operator
+template <typename Collision>
 void MarchSolution(CudaLbm* cudaLbm)
 {
     Domain* simDomain = cudaLbm->GetDomain();
-    int xDim = simDomain->GetXDim();
-    int yDim = simDomain->GetYDim();
     int tStep = cudaLbm->GetTimeStepsPerFrame();
     float* fA_d = cudaLbm->GetFA();
     float* fB_d = cudaLbm->GetFB();
     int* im_d = cudaLbm->GetImage();
+    int* obstIdMap_d = cudaLbm->GetObstIdMap();
     Obstruction* obst_d = cudaLbm->GetDeviceObst();
     float u = cudaLbm->GetInletVelocity();
     float omega = cudaLbm->GetOmega();
+    int* tiles_d = cudaLbm->GetActiveTiles();
+    int tilesX = cudaLbm->GetTilesX();
 
-    dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
-    dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    int blocks = cudaLbm->GetActiveTileCount();
+    if (cudaLbm->GetStreamingMode() == StreamingMode::IN_PLACE)
+    {
+        // stepping in even/odd pairs leaves fA as after an odd step, see MarchLBMInPlace
+        for (int i = 0; i < tStep && blocks > 0; i++)
+        {
+            if (cudaLbm->IsPaused())
+                return;
+            MarchLBMInPlace<Collision> << <blocks, threads >> >(fA_d, true, omega, im_d,
+                obstIdMap_d, obst_d, u, tiles_d, tilesX, *simDomain);
+            MarchLBMInPlace<Collision> << <blocks, threads >> >(fA_d, false, omega, im_d,
+                obstIdMap_d, obst_d, u, tiles_d, tilesX, *simDomain);
+        }
+        return;
+    }
+    // pausing between the two steps of a pair would leave the newest solution in fB
     for (int i = 0; i < tStep; i++)
     {
-        MarchLBM << <grid, threads >> >(fA_d, fB_d, omega, im_d, obst_d, u, *simDomain);
         if (cudaLbm->IsPaused())
             return;
-        MarchLBM << <grid, threads >> >(fB_d, fA_d, omega, im_d, obst_d, u, *simDomain);
+        MarchLBM<Collision>(cudaLbm, fA_d, fB_d);
+        MarchLBM<Collision>(cudaLbm, fB_d, fA_d);
+    }
+}
+
+// ! Once the residual monitor finds the flow steady, only input changes are applied, which reset
+// ! the monitor and let the next call step again
+void MarchSolution(CudaLbm* cudaLbm)
+{
+    ApplyDeviceObstructionDeltas(cudaLbm);
+    UpdateDeviceImage(cudaLbm);
+    if (cudaLbm->GetResidualMonitor()->IsConverged())
+        return;
+    switch (cudaLbm->GetCollisionModel())
+    {
+    case COLLISION_BGK:
+        MarchSolution<BgkCollision>(cudaLbm);
+        break;
+    case COLLISION_TRT:
+        MarchSolution<TrtCollision>(cudaLbm);
+        break;
+    case COLLISION_MRT:
+        MarchSolution<MrtCollision>(cudaLbm);
+        break;
+    default:
+        MarchSolution<MrtSmagorinskyCollision>(cudaLbm);
+        break;
     }
 }
 
-void UpdateSolutionVbo(float4* vis, CudaLbm* cudaLbm, const ContourVariable contVar,
-    const float contMin, const float contMax, const ViewMode viewMode)
+// ! Fills the slot GetSnapshotToWrite returns from the lattice. Only the active tiles are recomputed
+// ! unless the node image was rebuilt or the strain rate switched on or off since the slot was last
+// ! written, as the other tiles hold walls that are not stepped. The work is queued on the calling
+// ! thread's stream, which has to be synchronized before the slot is published.
+void WriteSolutionSnapshot(CudaLbm* cudaLbm)
 {
+    SolutionSnapshot* snapshot = cudaLbm->GetSnapshotToWrite();
     Domain* simDomain = cudaLbm->GetDomain();
-    int xDim = simDomain->GetXDim();
-    int yDim = simDomain->GetYDim();
-    float* f_d = cudaLbm->GetFA();
-    int* im_d = cudaLbm->GetImage();
+    bool withStrainRate = cudaLbm->IsSnapshotStrainRate();
+    int* tiles_d = cudaLbm->GetActiveTiles();
+    int blocks = cudaLbm->GetActiveTileCount();
+    if (snapshot->imageVersion != cudaLbm->GetImageVersion() ||
+        snapshot->hasStrainRate != withStrainRate)
+    {
+        tiles_d = NULL;
+        blocks = cudaLbm->GetTileCount();
+        snapshot->activeTileCount = cudaLbm->GetActiveTileCount();
+        if (snapshot->activeTileCount > 0)
+        {
+            cudaMemcpyAsync(snapshot->activeTiles_d, cudaLbm->GetActiveTiles(),
+                snapshot->activeTileCount*sizeof(int), cudaMemcpyDeviceToDevice);
+        }
+        snapshot->imageVersion = cudaLbm->GetImageVersion();
+        snapshot->hasStrainRate = withStrainRate;
+    }
+    snapshot->domain = *simDomain;
+    if (blocks == 0)
+        return;
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    WriteMacroSnapshot << <blocks, threads >> >(snapshot->nodes_d, cudaLbm->GetFA(),
+        cudaLbm->GetImage(), withStrainRate,
+        cudaLbm->GetStreamingMode() == StreamingMode::IN_PLACE, tiles_d, cudaLbm->GetTilesX(),
+        *simDomain);
+}
+
+// ! Queues the reduction of a residual sample over the active tiles and its copy to the host, on
+// ! the calling thread's stream. The sums can be read with FinishResidualSample once the stream was
+// ! synchronized.
+void SampleResidual(CudaLbm* cudaLbm)
+{
+    float* sums_d = cudaLbm->GetResidualSums();
+    cudaMemsetAsync(sums_d, 0, 4*sizeof(float));
+    int blocks = cudaLbm->GetActiveTileCount();
+    if (blocks > 0)
+    {
+        dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+        ReduceResidual << <blocks, threads >> >(sums_d, cudaLbm->GetResidualPrev(),
+            cudaLbm->GetFA(), cudaLbm->GetImage(),
+            cudaLbm->GetStreamingMode() == StreamingMode::IN_PLACE, cudaLbm->GetActiveTiles(),
+            cudaLbm->GetTilesX(), *cudaLbm->GetDomain());
+    }
+    cudaMemcpyAsync(cudaLbm->GetHostResidualSums(), sums_d, 4*sizeof(float),
+        cudaMemcpyDeviceToHost);
+}
+
+// ! Hands the sums of the sample queued by SampleResidual to the residual monitor, unless an input
+// ! changed and reset the monitor in the meantime
+void FinishResidualSample(CudaLbm* cudaLbm)
+{
+    ResidualMonitor* monitor = cudaLbm->GetResidualMonitor();
+    if (!monitor->IsSamplePending())
+        return;
+    float* sums_h = cudaLbm->GetHostResidualSums();
+    ResidualSums sums;
+    sums.velocityChange = sums_h[0];
+    sums.velocity = sums_h[1];
+    sums.densityChange = sums_h[2];
+    sums.nodes = sums_h[3];
+    monitor->AddSample(sums);
+}
+
+// ! Tiles the surface passes run over: the active tiles of the snapshot, or every tile while a
+// ! surface refresh is pending, in which case tiles is NULL
+int GetSurfaceTiles(CudaLbm* cudaLbm, const SolutionSnapshot &snapshot, int* &tiles)
+{
+    if (cudaLbm->IsSurfaceRefreshPending())
+    {
+        tiles = NULL;
+        return cudaLbm->GetTileCount();
+    }
+    tiles = snapshot.activeTiles_d;
+    return snapshot.activeTileCount;
+}
+
+void UpdateSolutionVbo(float4* vis, CudaLbm* cudaLbm, const SolutionSnapshot &snapshot,
+    const ContourVariable contVar, const float contMin, const float contMax,
+    const ViewMode viewMode)
+{
     float u = cudaLbm->GetInletVelocity();
 
-    dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
-    dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
-    UpdateSurfaceVbo << <grid, threads >> > (vis, f_d, im_d, contVar, contMin, contMax,
-        viewMode, u, *simDomain);
+    int* tiles_d;
+    int blocks = GetSurfaceTiles(cudaLbm, snapshot, tiles_d);
+    if (blocks == 0)
+        return;
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    UpdateSurfaceVbo << <blocks, threads >> > (vis, snapshot.nodes_d, contVar, contMin, contMax,
+        viewMode, u, tiles_d, cudaLbm->GetTilesX(), snapshot.domain);
 }
 
 // ! In order to maintain the same relative positions/sizes of obstructions when the simulation resolution
 // ! is changed, host obstruction data is stored relative to the max resolution. When host data is passed
 // ! to GPU, the positions and sizes are scaled down based on the current resolution's scaling factor.
-void UpdateDeviceObstructions(Obstruction* obst_d, const int targetObstID,
+// ! Obstructions that are unchanged since the last upload are skipped. Otherwise the nodes under the
+// ! old and new footprint are flagged for the next node image rebuild, and the change is queued for
+// ! ApplyDeviceObstructionDeltas. Ids the device has not seen yet are appended to the mirror.
+void UpdateDeviceObstructions(CudaLbm* cudaLbm, const int targetObstID,
     const Obstruction &newObst, const float scaleFactor)
 {
     Obstruction obst = newObst;
@@ -1339,7 +1752,138 @@ void UpdateDeviceObstructions(Obstruction* obst_d, const int targetObstID,
     obst.y /= scaleFactor;
     obst.r1 /= scaleFactor;
     obst.r2 /= scaleFactor;
-    UpdateObstructions << <1, 1 >> >(obst_d,targetObstID,obst);
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    Domain* simDomain = cudaLbm->GetDomain();
+    if (obstMirror->Contains(targetObstID))
+    {
+        if (std::memcmp(&obstMirror->Get(targetObstID), &obst, sizeof(Obstruction)) == 0)
+            return;
+        simDomain->MarkImageDirty(GetObstructionBounds(obstMirror->Get(targetObstID)));
+    }
+    simDomain->MarkImageDirty(GetObstructionBounds(obst));
+    cudaLbm->GetObstDeltas()->Push(obstMirror->Set(targetObstID, obst));
+}
+
+// ! Drops the obstruction from the mirror by moving the last entry into its slot. The moved
+// ! obstruction changes index, so its footprint is flagged too and the id map is rebuilt under it.
+void RemoveDeviceObstruction(CudaLbm* cudaLbm, const int targetObstID)
+{
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    if (!obstMirror->Contains(targetObstID))
+        return;
+    Domain* simDomain = cudaLbm->GetDomain();
+    simDomain->MarkImageDirty(GetObstructionBounds(obstMirror->Get(targetObstID)));
+    int movedIndex = obstMirror->Remove(targetObstID);
+    if (movedIndex >= 0)
+    {
+        simDomain->MarkImageDirty(GetObstructionBounds(obstMirror->GetData()[movedIndex]));
+    }
+    cudaLbm->GetObstDeltas()->PushRemoval(movedIndex);
+}
+
+// ! Copies the mirror entries changed since the last call to the device array with one upload and
+// ! one launch, however many obstructions changed. Called at the start of MarchSolution, so the
+// ! array, the bucket grid built from the mirror and the node image rebuilt from both all change
+// ! together at a step boundary.
+void ApplyDeviceObstructionDeltas(CudaLbm* cudaLbm)
+{
+    ObstructionDeltaQueue* obstDeltas = cudaLbm->GetObstDeltas();
+    if (obstDeltas->IsEmpty())
+        return;
+    cudaLbm->GetResidualMonitor()->Reset();
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    const std::vector<ObstructionDelta> &deltas = obstDeltas->Pack(*obstMirror);
+    cudaLbm->MarkObstructionGridDirty();
+    int deltaCount = static_cast<int>(deltas.size());
+    if (deltaCount == 0)
+        return;
+    cudaLbm->ReserveDeviceObst(obstMirror->GetCount());
+    cudaLbm->ReserveDeviceObstDeltas(deltaCount);
+    cudaMemcpy(cudaLbm->GetDeviceObstDeltas(), &deltas[0], deltaCount*sizeof(ObstructionDelta),
+        cudaMemcpyHostToDevice);
+    int threads = 64;
+    UpdateObstructions << <(deltaCount + threads - 1) / threads, threads >> >(
+        cudaLbm->GetDeviceObst(), cudaLbm->GetDeviceObstDeltas(), deltaCount);
+}
+
+// ! Writes the lattice, node image and obstructions of the CUDA solver in the format of the CPU
+// ! solver's fp32 checkpoints, so either solver can continue the other's flow. Pending obstruction
+// ! changes are applied first, so the image matches the obstructions, and the device is synchronized
+// ! as the solver thread may still be running a batch. Called under the solver mutex.
+CheckpointStatus SaveCheckpoint(CudaLbm* cudaLbm, const std::string &path)
+{
+    ApplyDeviceObstructionDeltas(cudaLbm);
+    UpdateDeviceImage(cudaLbm);
+    Domain* domain = cudaLbm->GetDomain();
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    ObstructionStore* hostObst = cudaLbm->GetHostObst();
+    CheckpointHeader header = MakeCheckpointHeader(*domain, STORAGE_FP32,
+        cudaLbm->GetStreamingMode(), cudaLbm->GetCollisionModel(), cudaLbm->GetOmega(),
+        cudaLbm->GetInletVelocity(), cudaLbm->GetTimeStep(), obstMirror->GetCount(),
+        hostObst->GetCount());
+    const CheckpointSection &last = header.sections[CHECKPOINT_SECTION_COUNT - 1];
+    MappedFile file;
+    if (!file.Create(path, last.offset + last.size))
+        return CHECKPOINT_IO_ERROR;
+    char* data = file.GetData();
+    cudaDeviceSynchronize();
+    const CheckpointSection* sections = header.sections;
+    cudaMemcpy(data + sections[CHECKPOINT_DISTRIBUTIONS].offset, cudaLbm->GetFA(),
+        sections[CHECKPOINT_DISTRIBUTIONS].size, cudaMemcpyDeviceToHost);
+    cudaMemcpy(data + sections[CHECKPOINT_IMAGE].offset, cudaLbm->GetImage(),
+        sections[CHECKPOINT_IMAGE].size, cudaMemcpyDeviceToHost);
+    cudaMemcpy(data + sections[CHECKPOINT_OBST_ID_MAP].offset, cudaLbm->GetObstIdMap(),
+        sections[CHECKPOINT_OBST_ID_MAP].size, cudaMemcpyDeviceToHost);
+    WriteCheckpointObstructions(data, header, *obstMirror, *hostObst);
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    std::memcpy(data, &header, sizeof(header));
+    file.Close();
+    return CHECKPOINT_OK;
+}
+
+// ! Replaces the obstructions through the delta queue and rebuilds the node image, boundary nodes
+// ! and active tiles from them before the distributions are uploaded, so tiles the rebuild resets
+// ! to rest still end up with the restored flow. Needs an fp32 checkpoint of the same lattice pitch
+// ! and streaming mode. Inlet velocity and omega stay with the sliders, and the step count carries
+// ! on from the checkpoint. Called under the solver mutex.
+CheckpointStatus LoadCheckpoint(CudaLbm* cudaLbm, const std::string &path)
+{
+    MappedFile file;
+    CheckpointHeader header;
+    CheckpointStatus status = OpenCheckpoint(file, path, header);
+    if (status != CHECKPOINT_OK)
+        return status;
+    Domain* domain = cudaLbm->GetDomain();
+    if (header.maxXDim != domain->GetMaxXDim() || header.maxYDim != domain->GetMaxYDim() ||
+        header.latticeStorage != STORAGE_FP32 ||
+        header.streamingMode != cudaLbm->GetStreamingMode())
+        return CHECKPOINT_LATTICE_MISMATCH;
+
+    const char* data = file.GetData();
+    ObstructionStore* obstMirror = cudaLbm->GetDeviceObstMirror();
+    while (obstMirror->GetCount() > 0)
+    {
+        RemoveDeviceObstruction(cudaLbm, obstMirror->GetId(obstMirror->GetCount() - 1));
+    }
+    ObstructionStore solverObst;
+    ReadCheckpointObstructions(data, header, solverObst, *cudaLbm->GetHostObst());
+    for (int i = 0; i < solverObst.GetCount(); i++)
+    {
+        UpdateDeviceObstructions(cudaLbm, solverObst.GetId(i), solverObst.GetData()[i], 1.f);
+    }
+    RestoreCheckpointDomain(header, *domain);
+    domain->MarkImageDirty(RectInt(0, 0, domain->GetMaxXDim(), domain->GetMaxYDim()));
+    ApplyDeviceObstructionDeltas(cudaLbm);
+    UpdateDeviceImage(cudaLbm);
+    cudaDeviceSynchronize();
+
+    const CheckpointSection &distributions = header.sections[CHECKPOINT_DISTRIBUTIONS];
+    cudaMemcpy(cudaLbm->GetFA(), data + distributions.offset, distributions.size,
+        cudaMemcpyHostToDevice);
+    cudaLbm->SetCollisionModel(static_cast<CollisionModel>(header.collisionModel));
+    cudaLbm->SetTimeStep(header.timeStep);
+    cudaLbm->GetResidualMonitor()->Reset();
+    return CHECKPOINT_OK;
 }
 
 void CleanUpDeviceVBO(float4* vis, Domain &simDomain)
@@ -1349,14 +1893,16 @@ void CleanUpDeviceVBO(float4* vis, Domain &simDomain)
     CleanUpVBO << <grid, threads>> >(vis, simDomain);
 }
 
-void LightSurface(float4* vis, Obstruction* obst_d, const float3 cameraPosition,
-    Domain &simDomain)
+void LightSurface(float4* vis, CudaLbm* cudaLbm, const SolutionSnapshot &snapshot,
+    const float3 cameraPosition)
 {
-    int xDim = simDomain.GetXDim();
-    int yDim = simDomain.GetYDim();
-    dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
-    dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
-    PhongLighting << <grid, threads>> >(vis, obst_d, cameraPosition, simDomain);
+    int* tiles_d;
+    int blocks = GetSurfaceTiles(cudaLbm, snapshot, tiles_d);
+    if (blocks == 0)
+        return;
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    PhongLighting << <blocks, threads>> >(vis, cudaLbm->GetDeviceObst(), cameraPosition,
+        tiles_d, cudaLbm->GetTilesX(), snapshot.domain);
 }
 
 void InitializeFloor(float4* vis, float* floor_d, Domain &simDomain)
@@ -1369,7 +1915,7 @@ void InitializeFloor(float4* vis, float* floor_d, Domain &simDomain)
 }
 
 void LightFloor(float4* vis, float* floor_d, Obstruction* obst_d,
-    const float3 cameraPosition, Domain &simDomain)
+    const ObstructionGridView &obstGrid, const float3 cameraPosition, Domain &simDomain)
 {
     int xDim = simDomain.GetXDim();
     int yDim = simDomain.GetYDim();
@@ -1377,20 +1923,24 @@ void LightFloor(float4* vis, float* floor_d, Obstruction* obst_d,
     dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
     float3 incidentLight1 = { -0.25f, -0.25f, -1.f };
     DeformFloorMeshUsingCausticRay << <grid, threads >> >
-        (vis, incidentLight1, obst_d, simDomain);
+        (vis, incidentLight1, obst_d, obstGrid, simDomain);
     ComputeFloorLightIntensitiesFromMeshDeformation << <grid, threads >> >
         (vis, floor_d, obst_d, simDomain);
 
-    ApplyCausticLightingToFloor << <grid, threads >> >(vis, floor_d, obst_d, simDomain);
-    UpdateObstructionTransientStates <<<grid,threads>>> (vis, obst_d);
+    ApplyCausticLightingToFloor << <grid, threads >> >(vis, floor_d, obst_d, obstGrid, simDomain);
+    UpdateObstructionTransientStates <<<grid,threads>>> (vis, obst_d, obstGrid);
 
     //phong lighting on floor mesh to shade obstructions
-    PhongLighting << <grid, threads>> >(&vis[MAX_XDIM*MAX_YDIM], obst_d, cameraPosition,
-        simDomain);
+    dim3 tileThreads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
+    int tilesX = (MAX_XDIM + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    int tilesY = (MAX_YDIM + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE;
+    PhongLighting << <tilesX*tilesY, tileThreads>> >(&vis[MAX_XDIM*MAX_YDIM], obst_d,
+        cameraPosition, NULL, tilesX, simDomain);
 }
 
 int RayCastMouseClick(float3 &rayCastIntersectCoord, float4* vis, float4* rayCastIntersect_d, 
-    const float3 &rayOrigin, const float3 &rayDir, Obstruction* obst_d, Domain &simDomain)
+    const float3 &rayOrigin, const float3 &rayDir, Obstruction* obst_d,
+    const ObstructionGridView &obstGrid, Domain &simDomain)
 {
     int xDim = simDomain.GetXDim();
     int yDim = simDomain.GetYDim();
@@ -1398,7 +1948,7 @@ int RayCastMouseClick(float3 &rayCastIntersectCoord, float4* vis, float4* rayCas
     dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
     dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
     RayCast << <grid, threads >> >(vis, rayCastIntersect_d, rayOrigin, rayDir,
-        obst_d, simDomain);
+        obst_d, obstGrid, simDomain);
     cudaMemcpy(&intersectionCoord, rayCastIntersect_d, sizeof(float4),
         cudaMemcpyDeviceToHost); 
     if (intersectionCoord.w > 1e5) //ray did not intersect with any objects
@@ -1420,16 +1970,19 @@ int RayCastMouseClick(float3 &rayCastIntersectCoord, float4* vis, float4* rayCas
     }
 }
 
-void RefractSurface(float4* vis, cudaArray* floorLightTexture, cudaArray* envTexture, Obstruction* obst_d, const glm::vec4 cameraPos,
-    Domain &simDomain)
+void RefractSurface(float4* vis, cudaArray* floorLightTexture, cudaArray* envTexture, CudaLbm* cudaLbm,
+    const SolutionSnapshot &snapshot, const glm::vec4 cameraPos)
 {
-    int xDim = simDomain.GetXDim();
-    int yDim = simDomain.GetYDim();
-    dim3 threads(BLOCKSIZEX, BLOCKSIZEY);
-    dim3 grid(ceil(static_cast<float>(xDim) / BLOCKSIZEX), yDim / BLOCKSIZEY);
+    int* tiles_d;
+    int blocks = GetSurfaceTiles(cudaLbm, snapshot, tiles_d);
+    if (blocks == 0)
+        return;
+    dim3 threads(ACTIVE_TILE_SIZE, ACTIVE_TILE_SIZE);
     cudaBindTextureToArray(floorTex, floorLightTexture);
     cudaBindTextureToArray(envTex, envTexture);
     float3 f3CameraPos = make_float3(cameraPos.x, cameraPos.y, cameraPos.z);
-    SurfaceRefraction << <grid, threads>> >(vis, obst_d, f3CameraPos, simDomain);
+    SurfaceRefraction << <blocks, threads>> >(vis, cudaLbm->GetDeviceObst(),
+        cudaLbm->GetObstructionGrid(), f3CameraPos,
+        tiles_d, cudaLbm->GetTilesX(), snapshot.domain);
 }
 
@@ -2,38 +2,57 @@
 #include "Graphics/GraphicsManager.h"
 #include "Domain.h"
 #include "common.h"
+#include "ObstructionGeometry.h"
+#include "Checkpoint.h"
 #include "cuda_runtime.h"
 #include "cuda.h"
 
 class CudaLbm;
+struct SolutionSnapshot;
 
 void InitializeDomain(float4* vis, float* f_d, int* im_d, const float uMax,
-    Domain &simDomain);
+    const StreamingMode streamingMode, Domain &simDomain);
 
-void SetObstructionVelocitiesToZero(Obstruction* obst_h, Obstruction* obst_d, const float scaleFactor);
+void SetObstructionVelocitiesToZero(CudaLbm* cudaLbm);
+
+void UpdateDeviceImage(CudaLbm* cudaLbm);
 
 void MarchSolution(CudaLbm* cudaLbm);
 
-void UpdateSolutionVbo(float4* vis, CudaLbm* cudaLbm, 
+void WriteSolutionSnapshot(CudaLbm* cudaLbm);
+
+void SampleResidual(CudaLbm* cudaLbm);
+
+void FinishResidualSample(CudaLbm* cudaLbm);
+
+void UpdateSolutionVbo(float4* vis, CudaLbm* cudaLbm, const SolutionSnapshot &snapshot,
     const ContourVariable contVar, const float contMin, const float contMax,
     const ViewMode viewMode);
 
-void UpdateDeviceObstructions(Obstruction* obst_d, const int targetObstID,
+void UpdateDeviceObstructions(CudaLbm* cudaLbm, const int targetObstID,
     const Obstruction &newObst, const float scaleFactor);
 
+void RemoveDeviceObstruction(CudaLbm* cudaLbm, const int targetObstID);
+
+void ApplyDeviceObstructionDeltas(CudaLbm* cudaLbm);
+
+CheckpointStatus SaveCheckpoint(CudaLbm* cudaLbm, const std::string &path);
+
+CheckpointStatus LoadCheckpoint(CudaLbm* cudaLbm, const std::string &path);
+
 void CleanUpDeviceVBO(float4* vis, Domain &simDomain);
 
-void LightSurface(float4* vis, Obstruction* obst_d, const float3 cameraPosition, 
-    Domain &simDomain);
+void LightSurface(float4* vis, CudaLbm* cudaLbm, const SolutionSnapshot &snapshot,
+    const float3 cameraPosition);
 
 void InitializeFloor(float4* vis, float* floor_d, Domain &simDomain);
 
 void LightFloor(float4* vis, float* floor_d, Obstruction* obst_d,
-    const float3 cameraPosition, Domain &simDomain);
+    const ObstructionGridView &obstGrid, const float3 cameraPosition, Domain &simDomain);
 
 int RayCastMouseClick(float3 &selectedElementCoord, float4* vis,
     float4* rayCastIntersect_d, const float3 &rayOrigin, const float3 &rayDir,
-    Obstruction* obst_d, Domain &simDomain);
+    Obstruction* obst_d, const ObstructionGridView &obstGrid, Domain &simDomain);
 
-void RefractSurface(float4* vis, cudaArray* floorTexture, cudaArray* envTexture, Obstruction* obst_d, const glm::vec4 cameraPos,
-    Domain &simDomain);
+void RefractSurface(float4* vis, cudaArray* floorTexture, cudaArray* envTexture, CudaLbm* cudaLbm,
+    const SolutionSnapshot &snapshot, const glm::vec4 cameraPos);
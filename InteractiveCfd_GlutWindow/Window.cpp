@@ -8,6 +8,7 @@
 #include "Domain.h"
 #include <GLUT/freeglut.h>
 #include <typeinfo>
+#include <iostream>
 
 void ResizeWrapper(const int x, const int y)
 {
@@ -52,7 +53,10 @@ Window::Window() :
     m_addObstruction(AddObstruction(*m_windowPanel)),
     m_removeObstruction(RemoveObstruction(*m_windowPanel)),
     m_moveObstruction(MoveObstruction(*m_windowPanel)),
-    m_pauseSimulation(PauseSimulation(*m_windowPanel))
+    m_pauseSimulation(PauseSimulation(*m_windowPanel)),
+    m_frameCount(0),
+    m_traceFrame(-1),
+    m_isFrameStatsVisible(false)
 {
 }
 
@@ -190,7 +194,17 @@ void Window::MouseMotion(const int x, const int y)
     {
         m_pan.Track(xf, yf);
         m_rotate.Track(xf, yf);
-        m_moveObstruction.Track(xf, yf);
+        if (m_moveObstruction.IsActive())
+        {
+            // taken before the move, so a rebuild racing it cannot be counted as the one showing it
+            int version = m_currentPanel->GetGraphicsManager()->GetNextObstructionVersion();
+            m_moveObstruction.Track(xf, yf);
+            m_fpsTracker.MarkInput(version);
+        }
+        else
+        {
+            m_moveObstruction.Track(xf, yf);
+        }
     }
     else
     {
@@ -215,6 +229,23 @@ void Window::Keyboard(const unsigned char key,
             m_windowPanel->GetButton("Pause Simulation")->SetHighlight(true);
         }
     }
+    else if (key == 't')
+    {
+        WriteFrameTrace();
+    }
+    else if (key == 'f')
+    {
+        SetFrameStatsVisible(!m_isFrameStatsVisible);
+    }
+    else if (key == 'c' || key == 'l')
+    {
+        GraphicsManager* graphicsManager =
+            m_windowPanel->GetPanel("Graphics")->GetGraphicsManager();
+        CheckpointStatus status = key == 'c' ? graphicsManager->SaveCheckpoint(CHECKPOINT_FILE) :
+            graphicsManager->LoadCheckpoint(CHECKPOINT_FILE);
+        std::cout << (key == 'c' ? "Save " : "Load ") << CHECKPOINT_FILE << ": "
+            << GetCheckpointStatusName(status) << std::endl;
+    }
 }
 void Window::MouseWheel(const int button, const int direction,
     const int x, const int y)
@@ -228,48 +259,174 @@ void Window::MouseWheel(const int button, const int direction,
     }
 }
 
-void Window::UpdateWindowTitle(const float fps, Domain &domain, const int tSteps)
+// ! tSteps is the size of the solver's current batch, and stepsPerSecond the rate it actually
+// ! steps at, which is not tied to the frame rate
+void Window::UpdateWindowTitle(const float fps, Domain &domain, const int tSteps,
+    const float stepsPerSecond)
 {
     char fpsReport[256];
     int xDim = domain.GetXDim();
     int yDim = domain.GetYDim();
     sprintf_s(fpsReport, 
-        "Interactive CFD running at: %i timesteps/frame at %3.1f fps = %3.1f timesteps/second on %ix%i mesh",
-        tSteps, fps, TIMESTEPS_PER_FRAME*fps, xDim, yDim);
+        "Interactive CFD running at: %i timesteps/batch, %3.1f fps, %3.1f timesteps/second = %3.1f MLUPS on %ix%i mesh",
+        tSteps, fps, stepsPerSecond, stepsPerSecond*xDim*yDim*1e-6f, xDim, yDim);
     glutSetWindowTitle(fpsReport);
 }
 
-void Window::DrawLoop()
+// ! Writes the stages recorded by the frame profiler to FRAME_TRACE_FILE, and their percentiles
+// ! to stdout
+void Window::WriteFrameTrace()
 {
-    m_fpsTracker.Tick();
-    GraphicsManager* graphicsManager = m_windowPanel->GetPanel("Graphics")->GetGraphicsManager();
-    graphicsManager->UpdateGraphicsInputs();
-    graphicsManager->GetCudaLbm()->UpdateDeviceImage();
+    if (FrameProfiler::Instance().WriteChromeTrace(FRAME_TRACE_FILE))
+    {
+        std::cout << "Frame trace written to " << FRAME_TRACE_FILE << std::endl;
+    }
+    else
+    {
+        std::cerr << "Cannot write " << FRAME_TRACE_FILE << std::endl;
+    }
+}
 
-    graphicsManager->RunSimulation();
+// ! The trace is written once frame frames have been drawn, or never for a negative frame
+void Window::SetTraceFrame(const int frame)
+{
+    m_traceFrame = frame;
+}
 
-    // render caustic floor to texture
-    graphicsManager->RenderFloorToTexture();
+void DrawString(const float x, const float y, const char* text)
+{
+    glRasterPos2f(x, y);
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+    }
+}
 
-    graphicsManager->RunSurfaceRefraction();
+FpsTracker* Window::GetFpsTracker()
+{
+    return &m_fpsTracker;
+}
 
-    ResizeWrapper(m_windowPanel->GetWidth(), m_windowPanel->GetHeight());
+void Window::SetFrameStatsVisible(const bool isVisible)
+{
+    m_isFrameStatsVisible = isVisible;
+}
 
-    graphicsManager->CenterGraphicsViewToGraphicsPanel(m_leftPanelWidth);
-    graphicsManager->UpdateViewTransformations();
+// ! Draws the frame time, drag latency and solver rate percentiles over the last
+// ! FRAME_STATS_WINDOW samples in the top left corner of the graphics panel, above a histogram of
+// ! the frame times
+void Window::DrawFrameStats()
+{
+    RectFloat graphicsRect = m_windowPanel->GetPanel("Graphics")->GetRectFloatAbs();
+    const float lineHeight = 14.f / m_windowPanel->GetHeight()*2.f;
+    const float x = graphicsRect.m_x + 8.f / m_windowPanel->GetWidth()*2.f;
+    float y = graphicsRect.m_y + graphicsRect.m_h - lineHeight;
+    char line[256];
+
+    glColor3f(1.f, 1.f, 1.f);
+    FrameStats frame = m_fpsTracker.GetFrameTimeStats();
+    sprintf_s(line, "frame ms    p50 %5.1f  p95 %5.1f  p99 %5.1f  max %5.1f  (%i)",
+        frame.p50, frame.p95, frame.p99, frame.max, frame.count);
+    DrawString(x, y, line);
+    y -= lineHeight;
+    FrameStats latency = m_fpsTracker.GetInputLatencyStats();
+    sprintf_s(line, "drag ms     p50 %5.1f  p95 %5.1f  p99 %5.1f  max %5.1f  (%i)",
+        latency.p50, latency.p95, latency.p99, latency.max, latency.count);
+    DrawString(x, y, line);
+    y -= lineHeight;
+    FrameStats steps = m_fpsTracker.GetStepsPerSecondStats();
+    sprintf_s(line, "steps/s     p50 %5.0f  min %5.0f  mean %5.0f  (%i)",
+        steps.p50, steps.min, steps.mean, steps.count);
+    DrawString(x, y, line);
+    y -= lineHeight;
+
+    int counts[FRAME_HISTOGRAM_BUCKETS];
+    m_fpsTracker.GetFrameTimeHistogram(counts);
+    const float* edges = FpsTracker::GetFrameHistogramEdges();
+    const float labelWidth = 70.f / m_windowPanel->GetWidth()*2.f;
+    const float maxBarWidth = 200.f / m_windowPanel->GetWidth()*2.f;
+    for (int bucket = 0; bucket < FRAME_HISTOGRAM_BUCKETS; bucket++, y -= lineHeight)
+    {
+        if (bucket < FRAME_HISTOGRAM_BUCKETS - 1)
+            sprintf_s(line, "<= %2.0f ms", edges[bucket]);
+        else
+            sprintf_s(line, " > %2.0f ms", edges[bucket - 1]);
+        glColor3f(1.f, 1.f, 1.f);
+        DrawString(x, y, line);
+        float barWidth = frame.count > 0 ? maxBarWidth*counts[bucket] / frame.count : 0.f;
+        glColor3f(0.4f, 0.8f, 0.4f);
+        glBegin(GL_QUADS);
+        glVertex2f(x + labelWidth, y);
+        glVertex2f(x + labelWidth + barWidth, y);
+        glVertex2f(x + labelWidth + barWidth, y + lineHeight*0.7f);
+        glVertex2f(x + labelWidth, y + lineHeight*0.7f);
+        glEnd();
+    }
+}
 
-    graphicsManager->RenderVbo();
+// ! Each stage is timed into the frame profiler. Stages that queue CUDA or GL work are timed on
+// ! the host, so they only show the time the work took with device synchronization on.
+void Window::DrawLoop()
+{
+    m_fpsTracker.Tick();
+    GraphicsManager* graphicsManager = m_windowPanel->GetPanel("Graphics")->GetGraphicsManager();
+    {
+        ScopedTimer frameTimer("Frame");
+        {
+            ScopedTimer timer("UpdateGraphicsInputs");
+            graphicsManager->UpdateGraphicsInputs();
+        }
+        {
+            ScopedTimer timer("RunSimulation");
+            graphicsManager->RunSimulation();
+        }
+        {
+            // render caustic floor to texture
+            ScopedTimer timer("RenderFloorToTexture");
+            graphicsManager->RenderFloorToTexture();
+        }
+        {
+            ScopedTimer timer("RunSurfaceRefraction");
+            graphicsManager->RunSurfaceRefraction();
+        }
 
-    Layout::Draw2D(*m_windowPanel);
+        ResizeWrapper(m_windowPanel->GetWidth(), m_windowPanel->GetHeight());
 
+        graphicsManager->CenterGraphicsViewToGraphicsPanel(m_leftPanelWidth);
+        graphicsManager->UpdateViewTransformations();
 
-    glutSwapBuffers();
+        {
+            ScopedTimer timer("RenderVbo");
+            graphicsManager->RenderVbo();
+        }
+        {
+            ScopedTimer timer("Draw2D");
+            Layout::Draw2D(*m_windowPanel);
+            if (m_isFrameStatsVisible)
+            {
+                glDisable(GL_DEPTH_TEST);
+                DrawFrameStats();
+                glEnable(GL_DEPTH_TEST);
+            }
+        }
+        {
+            ScopedTimer timer("SwapBuffers");
+            glutSwapBuffers();
+        }
+    }
     m_fpsTracker.Tock();
+    m_fpsTracker.Present(graphicsManager->GetPresentedObstructionVersion());
+    if (++m_frameCount == m_traceFrame)
+    {
+        WriteFrameTrace();
+    }
 
     CudaLbm* cudaLbm = graphicsManager->GetCudaLbm();
     Domain domain = *cudaLbm->GetDomain();
     const int tStepsPerFrame = graphicsManager->GetCudaLbm()->GetTimeStepsPerFrame();
-    UpdateWindowTitle(m_fpsTracker.GetFps(), domain, tStepsPerFrame);
+    const float stepsPerSecond = graphicsManager->GetSolverStepsPerSecond(m_fpsTracker.GetFps());
+    m_fpsTracker.AddStepsPerSecond(stepsPerSecond);
+    UpdateWindowTitle(m_fpsTracker.GetFps(), domain, 2 * tStepsPerFrame, stepsPerSecond);
 }
 
 void Window::InitializeGLUT(int argc, char **argv)
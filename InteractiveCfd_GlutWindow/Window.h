@@ -9,6 +9,7 @@
 #include "Command/MoveObstruction.h"
 #include "Command/PauseSimulation.h"
 #include "FpsTracker.h"
+#include "FrameProfiler.h"
 
 class Domain;
 
@@ -29,6 +30,9 @@ private:
     int m_leftPanelWidth;
     int m_leftPanelHeight;
     FpsTracker m_fpsTracker;
+    int m_frameCount;
+    int m_traceFrame;
+    bool m_isFrameStatsVisible;
 public:
     Window();
     Panel* GetWindowPanel();
@@ -43,7 +47,13 @@ public:
         const int /*x*/, const int /*y*/);
     void MouseWheel(const int button, const int direction,
         const int x, const int y);
-    void UpdateWindowTitle(const float fps, Domain &domain, const int tSteps);
+    void UpdateWindowTitle(const float fps, Domain &domain, const int tSteps,
+        const float stepsPerSecond);
+    void WriteFrameTrace();
+    void SetTraceFrame(const int frame);
+    FpsTracker* GetFpsTracker();
+    void SetFrameStatsVisible(const bool isVisible);
+    void DrawFrameStats();
     void DrawLoop();
     void InitializeGLUT(int argc, char **argv);
     void Display();
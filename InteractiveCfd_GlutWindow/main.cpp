@@ -2,7 +2,19 @@
 #include "Layout.h"
 #include "Panel/Panel.h"
 #include "Graphics/GraphicsManager.h"
+#include "FrameProfiler.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
+// ! --frame-ms <ms> sets the time each batch of solver steps is sized to: lower for snappier
+// ! interaction, higher for more steps per second. --steady <r> stops stepping once the change of
+// ! the flow per step falls below r, until the obstructions or sliders change. --trace <frames>
+// ! writes the frame trace once that many frames were drawn, as the t key does at any time, and
+// ! --trace-sync waits for the device at the end of each device stage, so the trace shows how long
+// ! the kernels took rather than how long they took to queue. --stats shows the frame statistics
+// ! overlay from the start, as the f key does. --load <file> starts from a checkpoint, like the
+// ! c and l keys save to and restore from checkpoint.icfd.
 int main(int argc, char **argv)
 {
     Panel* windowPanel = Window::Instance().GetWindowPanel();
@@ -13,10 +25,49 @@ int main(int argc, char **argv)
     Window::Instance().InitializeGLUT(argc, argv);
     Window::Instance().InitializeGL();
 
+    const char* checkpointPath = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frame-ms") == 0 && hasValue)
+        {
+            graphicsManager->SetTargetFrameTime(static_cast<float>(std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--steady") == 0 && hasValue)
+        {
+            graphicsManager->SetSteadyStateThreshold(static_cast<float>(std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && hasValue)
+        {
+            Window::Instance().SetTraceFrame(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--trace-sync") == 0)
+        {
+            FrameProfiler::Instance().SetDeviceSync(true);
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            Window::Instance().SetFrameStatsVisible(true);
+        }
+        else if (std::strcmp(argv[i], "--load") == 0 && hasValue)
+        {
+            checkpointPath = argv[++i];
+        }
+    }
+
     //graphicsManager->UseCuda(false);
     graphicsManager->SetUpGLInterop();
     graphicsManager->SetUpCuda();
     graphicsManager->SetUpShaders();
+    if (checkpointPath != NULL)
+    {
+        CheckpointStatus status = graphicsManager->LoadCheckpoint(checkpointPath);
+        if (status != CHECKPOINT_OK)
+        {
+            std::cerr << "Cannot load " << checkpointPath << ": "
+                << GetCheckpointStatusName(status) << std::endl;
+        }
+    }
 
     Window::Instance().Display();
 
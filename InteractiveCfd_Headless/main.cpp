@@ -0,0 +1,593 @@
+#include "Graphics/CpuLbm.h"
+#include "CpuKernel.h"
+#include "LbmNode.h"
+#include "Domain.h"
+#include "ThreadPool.h"
+#include "Checkpoint.h"
+#include "FieldWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+
+struct HeadlessOptions
+{
+    int xDim;
+    int yDim;
+    float inletVelocity;
+    float omega;
+    int timeSteps;
+    int outputCadence;
+    int numThreads;
+    bool isThreadPinning;
+    SimdIsa simdIsa;
+    StreamingMode streamingMode;
+    int temporalBlockingDepth;
+    LatticeStorage latticeStorage;
+    CollisionModel collisionModel;
+    float steadyThreshold;
+    std::string loadPath;
+    std::string savePath;
+    std::string fieldPrefix;
+    int fieldSteps;
+    int fieldVariables;
+    int fieldBuffers;
+    FieldDropPolicy fieldDropPolicy;
+    std::vector<Obstruction> obstructions;
+    bool isHelp;
+};
+
+void PrintUsage(const char* executable)
+{
+    std::cout << "Usage: " << executable << " [options]" << std::endl
+        << "  --xdim <n>              lattice width (default 384)" << std::endl
+        << "  --ydim <n>              lattice height (default 384)" << std::endl
+        << "  --inlet <u>             inlet velocity in lattice units (default "
+        << INITIAL_UMAX << ")" << std::endl
+        << "  --omega <w>             relaxation parameter (default 1.9)" << std::endl
+        << "  --obst <shape:x:y:r>    add an obstruction, shape is square, circle, hline or vline."
+        << " May be repeated" << std::endl
+        << "  --steps <n>             number of time steps (default 10000)" << std::endl
+        << "  --cadence <n>           steps between progress reports, 0 for none (default 1000)"
+        << std::endl
+        << "  --threads <n>           solver threads, 0 for all cores (default 0)" << std::endl
+        << "  --pin <0|1>             pin solver thread t to core t (default 0)" << std::endl
+        << "  --isa <name>            collide instruction set, scalar, avx2 or avx512. Capped to"
+        << " what the CPU supports (default widest available)" << std::endl
+        << "  --streaming <mode>      twobuffer or inplace, inplace keeps a single lattice"
+        << " (default twobuffer)" << std::endl
+        << "  --tblock <n>            advance cache-sized tiles n steps at a time, 0 for full"
+        << " sweeps. Even, since steps are taken in pairs. Twobuffer streaming only (default 0)"
+        << std::endl
+        << "  --storage <format>      distribution storage, fp32, fp16, bf16 or fixed16. The 16 bit"
+        << " formats need twobuffer streaming (default fp32)" << std::endl
+        << "  --collision <model>     collision operator, bgk, trt, mrt or smagorinsky"
+        << " (default smagorinsky)" << std::endl
+        << "  --steady <r>            stop once the change per step of the flow falls below r, 0"
+        << " to always run all steps (default 0)" << std::endl
+        << "  --load <file>           continue from a checkpoint. Its lattice size, storage, streaming"
+        << " mode, inlet velocity, omega, collision model and obstructions replace the options"
+        << " above, and --obst adds to its obstructions" << std::endl
+        << "  --save <file>           write a checkpoint at the end of the run" << std::endl
+        << "  --fields <prefix>       write macro fields to <prefix>_<step>.bin on a background"
+        << " thread, indexed by <prefix>.xmf" << std::endl
+        << "  --field-steps <n>       steps between field frames (default 1000)" << std::endl
+        << "  --field-vars <list>     comma separated fields to write, rho, u, v or strain"
+        << " (default rho,u,v,strain)" << std::endl
+        << "  --field-buffers <n>     frames buffered for the writer, at least 2 (default "
+        << FIELD_WRITER_DEFAULT_BUFFERS << ")" << std::endl
+        << "  --field-drop <policy>   when the writer falls behind, newest skips the new frame,"
+        << " oldest replaces the oldest queued one and wait stalls the solver (default newest)"
+        << std::endl;
+}
+
+bool ParseStreamingMode(const std::string &name, StreamingMode &mode)
+{
+    if (name == "twobuffer")
+        mode = StreamingMode::TWO_BUFFER;
+    else if (name == "inplace")
+        mode = StreamingMode::IN_PLACE;
+    else
+        return false;
+    return true;
+}
+
+bool ParseLatticeStorage(const std::string &name, LatticeStorage &format)
+{
+    if (name == "fp32")
+        format = STORAGE_FP32;
+    else if (name == "fp16")
+        format = STORAGE_FP16;
+    else if (name == "bf16")
+        format = STORAGE_BF16;
+    else if (name == "fixed16")
+        format = STORAGE_FIXED16;
+    else
+        return false;
+    return true;
+}
+
+bool ParseCollisionModel(const std::string &name, CollisionModel &model)
+{
+    if (name == "bgk")
+        model = COLLISION_BGK;
+    else if (name == "trt")
+        model = COLLISION_TRT;
+    else if (name == "mrt")
+        model = COLLISION_MRT;
+    else if (name == "smagorinsky")
+        model = COLLISION_MRT_SMAGORINSKY;
+    else
+        return false;
+    return true;
+}
+
+bool ParseFieldVariables(const std::string &list, int &variables)
+{
+    variables = 0;
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ','))
+    {
+        if (name == "rho")
+            variables |= FIELD_RHO;
+        else if (name == "u")
+            variables |= FIELD_U;
+        else if (name == "v")
+            variables |= FIELD_V;
+        else if (name == "strain")
+            variables |= FIELD_STRAIN_RATE;
+        else
+            return false;
+    }
+    return variables != 0;
+}
+
+bool ParseFieldDropPolicy(const std::string &name, FieldDropPolicy &policy)
+{
+    if (name == "newest")
+        policy = FIELD_DROP_NEWEST;
+    else if (name == "oldest")
+        policy = FIELD_DROP_OLDEST;
+    else if (name == "wait")
+        policy = FIELD_WAIT;
+    else
+        return false;
+    return true;
+}
+
+bool ParseSimdIsa(const std::string &name, SimdIsa &isa)
+{
+    if (name == "scalar")
+        isa = SIMD_SCALAR;
+    else if (name == "avx2")
+        isa = SIMD_AVX2;
+    else if (name == "avx512")
+        isa = SIMD_AVX512;
+    else
+        return false;
+    return true;
+}
+
+bool ParseShape(const std::string &name, int &shape)
+{
+    if (name == "square")
+        shape = Shape::SQUARE;
+    else if (name == "circle")
+        shape = Shape::CIRCLE;
+    else if (name == "hline")
+        shape = Shape::HORIZONTAL_LINE;
+    else if (name == "vline")
+        shape = Shape::VERTICAL_LINE;
+    else
+        return false;
+    return true;
+}
+
+bool ParseObstruction(const std::string &arg, Obstruction &obst)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(arg);
+    std::string field;
+    while (std::getline(stream, field, ':'))
+    {
+        fields.push_back(field);
+    }
+    if (fields.size() != 4 || !ParseShape(fields[0], obst.shape))
+        return false;
+    obst.x = std::stof(fields[1]);
+    obst.y = std::stof(fields[2]);
+    obst.r1 = std::stof(fields[3]);
+    obst.r2 = 0.f;
+    obst.u = 0.f;
+    obst.v = 0.f;
+    obst.state = State::ACTIVE;
+    return true;
+}
+
+bool ParseArguments(int argc, char **argv, HeadlessOptions &options)
+{
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg(argv[i]);
+            if (arg == "--help" || arg == "-h")
+            {
+                options.isHelp = true;
+                return false;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            const std::string value(argv[++i]);
+            if (arg == "--xdim")
+                options.xDim = std::stoi(value);
+            else if (arg == "--ydim")
+                options.yDim = std::stoi(value);
+            else if (arg == "--inlet")
+                options.inletVelocity = std::stof(value);
+            else if (arg == "--omega")
+                options.omega = std::stof(value);
+            else if (arg == "--steps")
+                options.timeSteps = std::stoi(value);
+            else if (arg == "--cadence")
+                options.outputCadence = std::stoi(value);
+            else if (arg == "--threads")
+                options.numThreads = std::stoi(value);
+            else if (arg == "--pin")
+                options.isThreadPinning = std::stoi(value) != 0;
+            else if (arg == "--steady")
+                options.steadyThreshold = std::stof(value);
+            else if (arg == "--tblock")
+                options.temporalBlockingDepth = std::stoi(value);
+            else if (arg == "--load")
+                options.loadPath = value;
+            else if (arg == "--save")
+                options.savePath = value;
+            else if (arg == "--fields")
+                options.fieldPrefix = value;
+            else if (arg == "--field-steps")
+                options.fieldSteps = std::stoi(value);
+            else if (arg == "--field-buffers")
+                options.fieldBuffers = std::stoi(value);
+            else if (arg == "--field-vars")
+            {
+                if (!ParseFieldVariables(value, options.fieldVariables))
+                {
+                    std::cerr << "Unknown fields '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--field-drop")
+            {
+                if (!ParseFieldDropPolicy(value, options.fieldDropPolicy))
+                {
+                    std::cerr << "Unknown drop policy '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--isa")
+            {
+                if (!ParseSimdIsa(value, options.simdIsa))
+                {
+                    std::cerr << "Unknown instruction set '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--streaming")
+            {
+                if (!ParseStreamingMode(value, options.streamingMode))
+                {
+                    std::cerr << "Unknown streaming mode '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--storage")
+            {
+                if (!ParseLatticeStorage(value, options.latticeStorage))
+                {
+                    std::cerr << "Unknown storage format '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--collision")
+            {
+                if (!ParseCollisionModel(value, options.collisionModel))
+                {
+                    std::cerr << "Unknown collision model '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--obst")
+            {
+                Obstruction obst;
+                if (!ParseObstruction(value, obst))
+                {
+                    std::cerr << "Invalid obstruction '" << value << "'" << std::endl;
+                    return false;
+                }
+                options.obstructions.push_back(obst);
+            }
+            else
+            {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid numeric argument" << std::endl;
+        return false;
+    }
+    if (options.xDim < 4 || options.yDim < 4 || options.timeSteps < 0 ||
+        options.outputCadence < 0 || options.numThreads < 0 || options.temporalBlockingDepth < 0 ||
+        options.steadyThreshold < 0.f || options.fieldSteps <= 0 || options.fieldBuffers < 2)
+    {
+        std::cerr << "Arguments out of range" << std::endl;
+        return false;
+    }
+    if (options.temporalBlockingDepth % 2 != 0)
+    {
+        std::cerr << "--tblock must be even" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ! Macroscopic summary of the current solution. Rows are reduced in bands on the solver's thread
+// ! pool into per-thread partial sums, which are combined in thread order. The rate is taken over
+// ! the stepsRun steps of this run, which may have started at a checkpoint.
+void ReportStatus(CpuLbm &lbm, const long long timeStep, const int stepsRun, const double seconds)
+{
+    Domain* domain = lbm.GetDomain();
+    int xDim = domain->GetXDim();
+    int yDim = domain->GetYDim();
+    int* im = lbm.GetImage();
+    ThreadPool* threadPool = lbm.GetThreadPool();
+    int numThreads = threadPool->GetThreadCount();
+    std::vector<double> threadRhoSums(numThreads, 0.0);
+    std::vector<float> threadMaxSpeeds(numThreads, 0.f);
+    std::vector<int> threadFluidNodes(numThreads, 0);
+    threadPool->ParallelFor(0, yDim, threadPool->GetBandSize(yDim),
+        [&](const int yBegin, const int yEnd, const int thread)
+    {
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            for (int x = 0; x < xDim; x++)
+            {
+                if (im[x + y*domain->GetMaxXDim()] != 0)
+                    continue;
+                LbmNode lbmNode;
+                ReadNodeDistributions(&lbm, lbmNode, x, y);
+                float u = lbmNode.ComputeU();
+                float v = lbmNode.ComputeV();
+                threadRhoSums[thread] += lbmNode.ComputeRho();
+                threadMaxSpeeds[thread] = std::max(threadMaxSpeeds[thread], sqrt(u*u + v*v));
+                threadFluidNodes[thread]++;
+            }
+        }
+    });
+    double rhoSum = 0.0;
+    float maxSpeed = 0.f;
+    int fluidNodes = 0;
+    for (int thread = 0; thread < numThreads; thread++)
+    {
+        rhoSum += threadRhoSums[thread];
+        maxSpeed = std::max(maxSpeed, threadMaxSpeeds[thread]);
+        fluidNodes += threadFluidNodes[thread];
+    }
+    double mlups = seconds > 0.0 ? static_cast<double>(xDim)*yDim*stepsRun / seconds*1e-6 : 0.0;
+    std::cout << "step " << timeStep
+        << "  mean rho " << (fluidNodes > 0 ? rhoSum / fluidNodes : 0.0)
+        << "  max |u| " << maxSpeed;
+    if (lbm.GetResidualMonitor()->IsEnabled())
+        std::cout << "  residual " << lbm.GetResidualMonitor()->GetResidual();
+    std::cout << "  " << mlups << " MLUPS" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    HeadlessOptions options;
+    options.xDim = 384;
+    options.yDim = 384;
+    options.inletVelocity = INITIAL_UMAX;
+    options.omega = 1.9f;
+    options.timeSteps = 10000;
+    options.outputCadence = 1000;
+    options.numThreads = 0;
+    options.isThreadPinning = false;
+    options.simdIsa = DetectSimdIsa();
+    options.streamingMode = StreamingMode::TWO_BUFFER;
+    options.temporalBlockingDepth = 0;
+    options.latticeStorage = STORAGE_FP32;
+    options.collisionModel = COLLISION_MRT_SMAGORINSKY;
+    options.steadyThreshold = 0.f;
+    options.fieldSteps = 1000;
+    options.fieldVariables = FIELD_ALL_VARIABLES;
+    options.fieldBuffers = FIELD_WRITER_DEFAULT_BUFFERS;
+    options.fieldDropPolicy = FIELD_DROP_NEWEST;
+    options.isHelp = false;
+    if (!ParseArguments(argc, argv, options))
+    {
+        // an explicit --help is not an error, bad arguments are
+        PrintUsage(argv[0]);
+        return options.isHelp ? 0 : 1;
+    }
+
+    // a checkpoint is loaded into a lattice of its own pitch, which it was already rounded to
+    CheckpointHeader checkpoint;
+    const bool isRestart = !options.loadPath.empty();
+    if (isRestart)
+    {
+        CheckpointStatus status = ReadCheckpointHeader(options.loadPath, checkpoint);
+        if (status != CHECKPOINT_OK)
+        {
+            std::cerr << "Cannot load " << options.loadPath << ": "
+                << GetCheckpointStatusName(status) << std::endl;
+            return 1;
+        }
+        options.xDim = checkpoint.maxXDim;
+        options.yDim = checkpoint.maxYDim;
+        options.latticeStorage = static_cast<LatticeStorage>(checkpoint.latticeStorage);
+        options.streamingMode = static_cast<StreamingMode>(checkpoint.streamingMode);
+    }
+
+    // the lattice is allocated for exactly the requested size, rounded up to whole blocks
+    CpuLbm lbm(options.xDim, options.yDim);
+    Domain* domain = lbm.GetDomain();
+    domain->SetXDimVisible(options.xDim);
+    domain->SetYDimVisible(options.yDim);
+    lbm.SetInletVelocity(options.inletVelocity);
+    lbm.SetOmega(options.omega);
+    lbm.SetNumberOfThreads(options.numThreads);
+    lbm.SetThreadPinning(options.isThreadPinning);
+    lbm.SetSimdIsa(options.simdIsa);
+    lbm.SetStreamingMode(options.streamingMode);
+    lbm.SetTemporalBlockingDepth(options.temporalBlockingDepth);
+    lbm.SetLatticeStorage(options.latticeStorage);
+    lbm.SetCollisionModel(options.collisionModel);
+    ResidualMonitor* residualMonitor = lbm.GetResidualMonitor();
+    if (options.steadyThreshold > 0.f)
+    {
+        residualMonitor->SetThreshold(options.steadyThreshold);
+        residualMonitor->SetEnabled(true);
+    }
+    try
+    {
+        lbm.AllocateHostMemory();
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Not enough memory for a " << domain->GetMaxXDim() << "x"
+            << domain->GetMaxYDim() << " lattice" << std::endl;
+        return 1;
+    }
+    lbm.InitializeHostMemory();
+    long long firstStep = 0;
+    if (isRestart)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        CheckpointStatus status = LoadCheckpoint(&lbm, options.loadPath, firstStep);
+        if (status != CHECKPOINT_OK)
+        {
+            std::cerr << "Cannot load " << options.loadPath << ": "
+                << GetCheckpointStatusName(status) << std::endl;
+            return 1;
+        }
+        std::cout << "Restored step " << firstStep << " from " << options.loadPath << " in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+            start).count() << " ms" << std::endl;
+    }
+    for (size_t i = 0; i < options.obstructions.size(); i++)
+    {
+        int obstId = lbm.GetHostObst()->Add(options.obstructions[i]);
+        UpdateSolverObstructions(&lbm, obstId, options.obstructions[i], 1.f);
+    }
+    if (!isRestart)
+        InitializeDomain(&lbm);
+
+    std::cout << "Lattice " << domain->GetXDim() << "x" << domain->GetYDim()
+        << ", " << lbm.GetHostObst()->GetCount() << " obstructions, "
+        << GetCollisionModelName(lbm.GetCollisionModel()) << " "
+        << GetSimdIsaName(lbm.GetSimdIsa()) << " collide, "
+        << GetLatticeStorageName(lbm.GetLatticeStorage()) << " storage" << std::endl;
+
+    // the solver only fills a buffer per frame, the frame is written out on the writer's thread
+    FieldWriter fieldWriter;
+    const int fieldSteps = (options.fieldSteps + 1) / 2 * 2;
+    double fieldSeconds = 0.0;
+    if (!options.fieldPrefix.empty() && !fieldWriter.Start(options.fieldPrefix,
+        options.fieldVariables, domain->GetXDim(), domain->GetYDim(), options.fieldBuffers,
+        options.fieldDropPolicy))
+    {
+        std::cerr << "Cannot write fields to " << options.fieldPrefix << std::endl;
+        lbm.DeallocateHostMemory();
+        return 1;
+    }
+
+    // MarchSolution advances the lattice in pairs of time steps. While looking for a steady state,
+    // it is called once per residual sample so the run stops soon after the flow settles. Batches
+    // also end on every field frame.
+    const int totalSteps = (options.timeSteps + 1) / 2 * 2;
+    const int cadence = options.outputCadence > 0 ? (options.outputCadence + 1) / 2 * 2 : totalSteps;
+    const int chunk = residualMonitor->IsEnabled() ?
+        std::min(cadence, (residualMonitor->GetSampleSteps() + 1) / 2 * 2) : cadence;
+    int timeStep = 0;
+    double seconds = 0.0;
+    while (timeStep < totalSteps && !residualMonitor->IsConverged())
+    {
+        int steps = std::min(chunk, totalSteps - timeStep);
+        if (fieldWriter.IsRunning())
+            steps = std::min(steps, fieldSteps - timeStep % fieldSteps);
+        lbm.SetTimeStepsPerFrame(steps / 2);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        MarchSolution(&lbm);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        timeStep += steps;
+
+        if (fieldWriter.IsRunning() && timeStep % fieldSteps == 0)
+        {
+            start = std::chrono::steady_clock::now();
+            FieldFrame* frame = fieldWriter.AcquireFrame(firstStep + timeStep);
+            if (frame != NULL)
+            {
+                WriteFieldFrame(&lbm, frame);
+                fieldWriter.SubmitFrame(frame);
+            }
+            fieldSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                start).count();
+        }
+
+        if (options.outputCadence > 0 &&
+            (timeStep % cadence == 0 || timeStep == totalSteps || residualMonitor->IsConverged()))
+        {
+            ReportStatus(lbm, firstStep + timeStep, timeStep, seconds);
+        }
+    }
+
+    if (residualMonitor->IsConverged())
+    {
+        std::cout << "Steady after " << firstStep + timeStep << " steps, residual "
+            << residualMonitor->GetResidual() << std::endl;
+    }
+    const double nodeUpdates = static_cast<double>(domain->GetXDim())*domain->GetYDim()*timeStep;
+    std::cout << timeStep << " steps in " << seconds << " s, "
+        << (seconds > 0.0 ? nodeUpdates / seconds*1e-6 : 0.0) << " MLUPS" << std::endl;
+
+    if (fieldWriter.IsRunning())
+    {
+        fieldWriter.Stop();
+        std::cout << fieldWriter.GetWrittenCount() << " field frames written to "
+            << fieldWriter.GetIndexPath() << ", " << fieldWriter.GetDroppedCount() << " dropped, "
+            << fieldWriter.GetFailedCount() << " failed, " << fieldSeconds*1e3
+            << " ms spent on the solver thread" << std::endl;
+    }
+
+    if (!options.savePath.empty())
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        CheckpointStatus status = SaveCheckpoint(&lbm, options.savePath, firstStep + timeStep);
+        if (status != CHECKPOINT_OK)
+        {
+            std::cerr << "Cannot save " << options.savePath << ": "
+                << GetCheckpointStatusName(status) << std::endl;
+            lbm.DeallocateHostMemory();
+            return 1;
+        }
+        std::cout << "Saved step " << firstStep + timeStep << " to " << options.savePath << " in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+            start).count() << " ms" << std::endl;
+    }
+
+    lbm.DeallocateHostMemory();
+    return 0;
+}
@@ -2,6 +2,33 @@
 #include "CppUnitTest.h"
 #include "Mouse.h"
 #include "Panel.h"
+#include "Graphics/CpuLbm.h"
+#include "CpuKernel.h"
+#include "LbmNode.h"
+#include "Domain.h"
+#include "ActiveTiles.h"
+#include "Checkpoint.h"
+#include "FieldWriter.h"
+#include "FpsTracker.h"
+#include "FrameProfiler.h"
+#include "LatticeStorage.h"
+#include "NodeLists.h"
+#include "ObstructionDeltaQueue.h"
+#include "ObstructionGrid.h"
+#include "ObstructionStore.h"
+#include "ResidualMonitor.h"
+#include "SnapshotTripleBuffer.h"
+#include "StepBudgetController.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 #define EPSILON 0.01f
 
@@ -222,6 +249,1550 @@ namespace utest_LBM_GL_CPP
 	};
 
 
+	TEST_CLASS(CollideIsa)
+	{
+	public:
+		TEST_METHOD(VectorMatchesScalar)
+		{
+			// 120 wide, so the AVX-512 rows end in a partial vector
+			const CollisionModel models[4] = { COLLISION_BGK, COLLISION_TRT, COLLISION_MRT,
+				COLLISION_MRT_SMAGORINSKY };
+			Obstruction cylinder = { CIRCLE, 40.f, 32.f, 6.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int m = 0; m < 4; m++)
+			{
+				for (int isa = SIMD_AVX2; isa <= DetectSimdIsa(); isa++)
+				{
+					CpuLbm scalar(120, 64);
+					CpuLbm vector(120, 64);
+					CpuLbm* solvers[2] = { &scalar, &vector };
+					for (int n = 0; n < 2; n++)
+					{
+						solvers[n]->GetDomain()->SetXDimVisible(120);
+						solvers[n]->GetDomain()->SetYDimVisible(64);
+						solvers[n]->SetInletVelocity(0.125f);
+						solvers[n]->SetOmega(m == COLLISION_MRT_SMAGORINSKY ? 1.9f : 1.6f);
+						solvers[n]->SetNumberOfThreads(1);
+						solvers[n]->SetTimeStepsPerFrame(10);
+						solvers[n]->SetCollisionModel(models[m]);
+						solvers[n]->SetSimdIsa(n == 0 ? SIMD_SCALAR : static_cast<SimdIsa>(isa));
+						solvers[n]->AllocateHostMemory();
+						solvers[n]->InitializeHostMemory();
+						int obstId = solvers[n]->GetHostObst()->Add(cylinder);
+						UpdateSolverObstructions(solvers[n], obstId, cylinder, 1.f);
+						InitializeDomain(solvers[n]);
+						MarchSolution(solvers[n]);
+					}
+					Assert::AreEqual(isa, static_cast<int>(vector.GetSimdIsa()));
+					float difference = 0.f;
+					for (int y = 0; y < 64; y++)
+					{
+						for (int x = 0; x < 120; x++)
+						{
+							LbmNode nodeScalar, nodeVector;
+							ReadNodeDistributions(&scalar, nodeScalar, x, y);
+							ReadNodeDistributions(&vector, nodeVector, x, y);
+							for (int i = 0; i < 9; i++)
+							{
+								difference = std::max(difference, std::fabs(
+									nodeScalar.GetDistribution(i) - nodeVector.GetDistribution(i)));
+							}
+						}
+					}
+					// the vector code may contract into FMAs, so only rounding may differ
+					Assert::IsTrue(difference < 1e-5f);
+				}
+			}
+		}
+	};
+
+
+	TEST_CLASS(InPlaceStreaming)
+	{
+	public:
+		TEST_METHOD(MatchesTwoBuffer)
+		{
+			CpuLbm twoBuffer(128, 64);
+			CpuLbm inPlace(128, 64);
+			CpuLbm* solvers[2] = { &twoBuffer, &inPlace };
+			Obstruction cylinder = { CIRCLE, 40.f, 32.f, 6.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int n = 0; n < 2; n++)
+			{
+				solvers[n]->GetDomain()->SetXDimVisible(128);
+				solvers[n]->GetDomain()->SetYDimVisible(64);
+				solvers[n]->SetInletVelocity(0.125f);
+				solvers[n]->SetOmega(1.9f);
+				solvers[n]->SetNumberOfThreads(1);
+				solvers[n]->SetTimeStepsPerFrame(1);
+				solvers[n]->SetStreamingMode(n == 0 ? StreamingMode::TWO_BUFFER : StreamingMode::IN_PLACE);
+				solvers[n]->AllocateHostMemory();
+				solvers[n]->InitializeHostMemory();
+				int obstId = solvers[n]->GetHostObst()->Add(cylinder);
+				UpdateSolverObstructions(solvers[n], obstId, cylinder, 1.f);
+				InitializeDomain(solvers[n]);
+			}
+			// largest difference between the distributions of the two solvers over a block of nodes
+			auto maxDifference = [&](const int x0, const int y0, const int x1, const int y1)
+			{
+				float difference = 0.f;
+				for (int y = y0; y < y1; y++)
+				{
+					for (int x = x0; x < x1; x++)
+					{
+						LbmNode nodeA, nodeB;
+						ReadNodeDistributions(&twoBuffer, nodeA, x, y);
+						ReadNodeDistributions(&inPlace, nodeB, x, y);
+						for (int i = 0; i < 9; i++)
+						{
+							difference = std::max(difference,
+								std::fabs(nodeA.GetDistribution(i) - nodeB.GetDistribution(i)));
+						}
+					}
+				}
+				return difference;
+			};
+			Assert::AreEqual(0.f, maxDifference(0, 0, 128, 64));
+			for (int pair = 0; pair < 3; pair++)
+			{
+				MarchSolution(&twoBuffer);
+				MarchSolution(&inPlace);
+				// the inlet, outlet and symmetry edges, then the whole domain
+				Assert::IsTrue(maxDifference(0, 0, 1, 64) < 1e-6f);
+				Assert::IsTrue(maxDifference(127, 0, 128, 64) < 1e-6f);
+				Assert::IsTrue(maxDifference(0, 0, 128, 1) < 1e-6f);
+				Assert::IsTrue(maxDifference(0, 63, 128, 64) < 1e-6f);
+				Assert::IsTrue(maxDifference(0, 0, 128, 64) < 1e-6f);
+			}
+		}
+	};
+
+
+	TEST_CLASS(TemporalBlocking)
+	{
+	public:
+		TEST_METHOD(MatchesPlainSweeps)
+		{
+			// 2x2 tiles with the cylinder on their shared corner, so every halo is crossed
+			CpuLbm plain(256, 128);
+			CpuLbm depth2(256, 128);
+			CpuLbm depth4(256, 128);
+			CpuLbm* solvers[3] = { &plain, &depth2, &depth4 };
+			Obstruction cylinder = { CIRCLE, 128.f, 64.f, 10.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int n = 0; n < 3; n++)
+			{
+				solvers[n]->GetDomain()->SetXDimVisible(256);
+				solvers[n]->GetDomain()->SetYDimVisible(128);
+				solvers[n]->SetInletVelocity(0.125f);
+				solvers[n]->SetOmega(1.9f);
+				solvers[n]->SetNumberOfThreads(2);
+				// five pairs, so the depth 4 solver also takes a shorter last pass
+				solvers[n]->SetTimeStepsPerFrame(5);
+				solvers[n]->SetTemporalBlockingDepth(2 * n);
+				solvers[n]->AllocateHostMemory();
+				solvers[n]->InitializeHostMemory();
+				int obstId = solvers[n]->GetHostObst()->Add(cylinder);
+				UpdateSolverObstructions(solvers[n], obstId, cylinder, 1.f);
+				InitializeDomain(solvers[n]);
+			}
+			Assert::AreEqual(4, depth4.GetTemporalBlockingDepth());
+			for (int frame = 0; frame < 4; frame++)
+			{
+				for (int n = 0; n < 3; n++)
+					MarchSolution(solvers[n]);
+				float difference = 0.f;
+				for (int y = 0; y < 128; y++)
+				{
+					for (int x = 0; x < 256; x++)
+					{
+						LbmNode nodePlain;
+						ReadNodeDistributions(&plain, nodePlain, x, y);
+						for (int n = 1; n < 3; n++)
+						{
+							LbmNode nodeTiled;
+							ReadNodeDistributions(solvers[n], nodeTiled, x, y);
+							for (int i = 0; i < 9; i++)
+							{
+								difference = std::max(difference, std::fabs(
+									nodePlain.GetDistribution(i) - nodeTiled.GetDistribution(i)));
+							}
+						}
+					}
+				}
+				Assert::IsTrue(difference < 1e-6f);
+			}
+		}
+
+		TEST_METHOD(OddDepthRoundsUp)
+		{
+			CpuLbm lbm(128, 64);
+			lbm.SetTemporalBlockingDepth(3);
+			Assert::AreEqual(4, lbm.GetTemporalBlockingDepth());
+			lbm.SetTemporalBlockingDepth(0);
+			Assert::AreEqual(0, lbm.GetTemporalBlockingDepth());
+		}
+	};
+
+
+	TEST_CLASS(LatticeStorageTest)
+	{
+	public:
+		TEST_METHOD(HalfRoundTrip)
+		{
+			Assert::AreEqual(static_cast<unsigned short>(0x3c00), FloatToHalf(1.f));
+			Assert::AreEqual(static_cast<unsigned short>(0xc000), FloatToHalf(-2.f));
+			Assert::AreEqual(static_cast<unsigned short>(0x7bff), FloatToHalf(65504.f));
+			Assert::AreEqual(static_cast<unsigned short>(0x7c00), FloatToHalf(1e6f));
+			// smallest normal and subnormal halves come back exactly
+			const float exact[6] = { 0.f, 0.5f, -0.375f, 65504.f, ldexpf(1.f, -14), ldexpf(1.f, -24) };
+			for (int n = 0; n < 6; n++)
+			{
+				Assert::AreEqual(exact[n], HalfToFloat(FloatToHalf(exact[n])));
+			}
+			// ties round to the even mantissa
+			Assert::AreEqual(static_cast<unsigned short>(0x3c00), FloatToHalf(1.f + ldexpf(1.f, -11)));
+			Assert::AreEqual(static_cast<unsigned short>(0x3c02), FloatToHalf(1.f + 3.f*ldexpf(1.f, -11)));
+			for (float value = -0.2f; value < 0.2f; value += 0.00137f)
+			{
+				Assert::IsTrue(fabs(HalfToFloat(FloatToHalf(value)) - value) <=
+					fabs(value)*ldexpf(1.f, -11) + ldexpf(1.f, -25));
+			}
+		}
+
+		TEST_METHOD(Bfloat16RoundTrip)
+		{
+			Assert::AreEqual(static_cast<unsigned short>(0x3f80), FloatToBfloat16(1.f));
+			Assert::AreEqual(static_cast<unsigned short>(0x3f80), FloatToBfloat16(1.f + ldexpf(1.f, -8)));
+			Assert::AreEqual(static_cast<unsigned short>(0x3f82), FloatToBfloat16(1.f + 3.f*ldexpf(1.f, -8)));
+			Assert::AreEqual(-0.375f, Bfloat16ToFloat(FloatToBfloat16(-0.375f)));
+			float nan = Bfloat16ToFloat(FloatToBfloat16(sqrtf(-1.f)));
+			Assert::IsTrue(nan != nan);
+			for (float value = -0.2f; value < 0.2f; value += 0.00137f)
+			{
+				Assert::IsTrue(fabs(Bfloat16ToFloat(FloatToBfloat16(value)) - value) <=
+					fabs(value)*ldexpf(1.f, -8));
+			}
+		}
+
+		TEST_METHOD(Fixed16RoundTrip)
+		{
+			Assert::AreEqual(static_cast<unsigned short>(0), FloatToFixed16(0.f));
+			Assert::AreEqual(-1000.f*FIXED16_SCALE, Fixed16ToFloat(FloatToFixed16(-1000.f*FIXED16_SCALE)));
+			for (float value = -0.2f; value < 0.2f; value += 0.00137f)
+			{
+				Assert::IsTrue(fabs(Fixed16ToFloat(FloatToFixed16(value)) - value) <=
+					0.5f*FIXED16_SCALE);
+			}
+		}
+
+		TEST_METHOD(Fixed16Saturates)
+		{
+			Assert::AreEqual(-0.25f, Fixed16ToFloat(FloatToFixed16(-0.25f)));
+			Assert::AreEqual(-0.25f, Fixed16ToFloat(FloatToFixed16(-0.3f)));
+			Assert::AreEqual(32767.f*FIXED16_SCALE, Fixed16ToFloat(FloatToFixed16(0.25f)));
+			Assert::AreEqual(32767.f*FIXED16_SCALE, Fixed16ToFloat(FloatToFixed16(1.f)));
+		}
+
+		TEST_METHOD(PackedDistributionsKeepWeights)
+		{
+			// the rest state packs to zero deviations in every format and comes back exactly
+			const float rest[2] = { 4.f / 9.f, 4.f / 9.f + 0.01f };
+			const LatticeStorage formats[3] = { STORAGE_FP16, STORAGE_BF16, STORAGE_FIXED16 };
+			for (int n = 0; n < 3; n++)
+			{
+				unsigned short packed[2];
+				float unpacked[2];
+				PackDistributions(packed, rest, 2, 0, formats[n]);
+				UnpackDistributions(unpacked, packed, 2, 0, formats[n]);
+				Assert::AreEqual(static_cast<unsigned short>(0), packed[0]);
+				Assert::AreEqual(rest[0], unpacked[0]);
+				Assert::IsTrue(fabs(unpacked[1] - rest[1]) < 1e-4f);
+			}
+		}
+	};
+
+
+	TEST_CLASS(NodeListsTest)
+	{
+	public:
+		TEST_METHOD(FluidRunsAndBoundaryTypes)
+		{
+			// one node of every type, walls at both ends and fluid runs between them
+			const int image[16] = { 1, 0, 0, 0, 10, 20, 0, 0, 3, 2, 11, 12, 0, 0, 0, 1 };
+			NodeLists nodeLists(1);
+			nodeLists.UpdateRows(image, 16, 16, 0, 1);
+			const RowNodes &row = nodeLists.GetRow(0);
+			const int runs[6] = { 1, 4, 6, 8, 12, 15 };
+			Assert::AreEqual(6, static_cast<int>(row.fluidRuns.size()));
+			for (int n = 0; n < 6; n++)
+				Assert::AreEqual(runs[n], row.fluidRuns[n]);
+			const std::vector<int> &bounceBack = row.boundaryNodes[BOUNDARY_BOUNCE_BACK];
+			Assert::AreEqual(3, static_cast<int>(bounceBack.size()));
+			Assert::AreEqual(0, bounceBack[0]);
+			Assert::AreEqual(4, bounceBack[1]);
+			Assert::AreEqual(15, bounceBack[2]);
+			const int types[5] = { BOUNDARY_MOVING_WALL, BOUNDARY_INLET, BOUNDARY_OUTLET,
+				BOUNDARY_SYMMETRY_TOP, BOUNDARY_SYMMETRY_BOTTOM };
+			const int positions[5] = { 5, 8, 9, 10, 11 };
+			for (int n = 0; n < 5; n++)
+			{
+				Assert::AreEqual(1, static_cast<int>(row.boundaryNodes[types[n]].size()));
+				Assert::AreEqual(positions[n], row.boundaryNodes[types[n]][0]);
+			}
+		}
+
+		TEST_METHOD(FluidRunToRowEnd)
+		{
+			const int image[8] = { 3, 0, 0, 0, 0, 0, 0, 0 };
+			NodeLists nodeLists(1);
+			nodeLists.UpdateRows(image, 8, 8, 0, 1);
+			const RowNodes &row = nodeLists.GetRow(0);
+			Assert::AreEqual(2, static_cast<int>(row.fluidRuns.size()));
+			Assert::AreEqual(1, row.fluidRuns[0]);
+			Assert::AreEqual(8, row.fluidRuns[1]);
+		}
+
+		TEST_METHOD(PartialUpdateKeepsOtherRows)
+		{
+			int image[3 * 8];
+			for (int n = 0; n < 3 * 8; n++)
+				image[n] = n % 8 == 0 ? 3 : 0;
+			NodeLists nodeLists(3);
+			nodeLists.UpdateRows(image, 8, 8, 0, 3);
+			// rows 0 and 2 change in the image, but only row 1 is rebuilt
+			for (int x = 0; x < 8; x++)
+			{
+				image[x] = 1;
+				image[8 + x] = x == 4 ? 20 : 0;
+				image[16 + x] = 1;
+			}
+			nodeLists.UpdateRows(image, 8, 8, 1, 2);
+			for (int y = 0; y < 3; y += 2)
+			{
+				const RowNodes &row = nodeLists.GetRow(y);
+				Assert::AreEqual(2, static_cast<int>(row.fluidRuns.size()));
+				Assert::AreEqual(1, static_cast<int>(row.boundaryNodes[BOUNDARY_INLET].size()));
+				Assert::IsTrue(row.boundaryNodes[BOUNDARY_BOUNCE_BACK].empty());
+			}
+			const RowNodes &row = nodeLists.GetRow(1);
+			Assert::AreEqual(4, static_cast<int>(row.fluidRuns.size()));
+			Assert::AreEqual(0, row.fluidRuns[0]);
+			Assert::AreEqual(4, row.fluidRuns[1]);
+			Assert::AreEqual(5, row.fluidRuns[2]);
+			Assert::AreEqual(8, row.fluidRuns[3]);
+			Assert::IsTrue(row.boundaryNodes[BOUNDARY_INLET].empty());
+			Assert::AreEqual(4, row.boundaryNodes[BOUNDARY_MOVING_WALL][0]);
+		}
+
+		TEST_METHOD(SolverLists)
+		{
+			CpuLbm lbm(128, 64);
+			lbm.GetDomain()->SetXDimVisible(128);
+			lbm.GetDomain()->SetYDimVisible(64);
+			lbm.SetNumberOfThreads(1);
+			lbm.AllocateHostMemory();
+			lbm.InitializeHostMemory();
+			// a square through the top edge, so walls replace part of the symmetry row, and a
+			// moving cylinder for the moving wall list
+			Obstruction square = { SQUARE, 64.f, 60.f, 8.f, 0.f, 0.f, 0.f, ACTIVE };
+			Obstruction cylinder = { CIRCLE, 32.f, 24.f, 6.f, 0.f, 0.05f, 0.f, ACTIVE };
+			int obstId = lbm.GetHostObst()->Add(square);
+			UpdateSolverObstructions(&lbm, obstId, square, 1.f);
+			obstId = lbm.GetHostObst()->Add(cylinder);
+			UpdateSolverObstructions(&lbm, obstId, cylinder, 1.f);
+			lbm.UpdateHostImage();
+			const NodeLists &nodeLists = *lbm.GetNodeLists();
+			int* image = lbm.GetImage();
+			int pitch = lbm.GetDomain()->GetMaxXDim();
+			// fluid is never on the domain edge, which lets the fluid stepper stream unclamped
+			for (int y = 0; y < 64; y++)
+			{
+				const std::vector<int> &runs = nodeLists.GetRow(y).fluidRuns;
+				if (y == 0 || y == 63)
+					Assert::IsTrue(runs.empty());
+				for (size_t n = 0; n < runs.size(); n += 2)
+				{
+					Assert::IsTrue(runs[n] >= 1 && runs[n] < runs[n + 1] && runs[n + 1] <= 127);
+					for (int x = runs[n]; x < runs[n + 1]; x++)
+						Assert::AreEqual(0, image[x + y*pitch]);
+				}
+			}
+			// the flattened lists hold every boundary node once, under the type of its image value
+			std::vector<int> nodes;
+			int offsets[BOUNDARY_TYPE_COUNT + 1];
+			nodeLists.GetBoundaryNodes(nodes, offsets, pitch, 64, *lbm.GetActiveTiles());
+			int boundaryCount = 0;
+			for (int y = 0; y < 64; y++)
+			{
+				for (int x = 0; x < 128; x++)
+				{
+					if (GetBoundaryType(image[x + y*pitch]) != BOUNDARY_NONE &&
+						lbm.GetActiveTiles()->IsNodeActive(x, y))
+						boundaryCount++;
+				}
+			}
+			Assert::AreEqual(0, offsets[0]);
+			Assert::AreEqual(boundaryCount, offsets[BOUNDARY_TYPE_COUNT]);
+			for (int type = 0; type < BOUNDARY_TYPE_COUNT; type++)
+			{
+				Assert::IsTrue(offsets[type] < offsets[type + 1]);
+				for (int n = offsets[type]; n < offsets[type + 1]; n++)
+					Assert::AreEqual(type, static_cast<int>(GetBoundaryType(image[nodes[n]])));
+			}
+		}
+	};
+
+
+	TEST_CLASS(ActiveTilesTest)
+	{
+	public:
+		TEST_METHOD(SolidTileInactive)
+		{
+			// 4x4 tiles, and walls over tile (1, 1) and the ring of nodes around it
+			std::vector<int> image(64 * 64, 0);
+			for (int y = 15; y < 33; y++)
+			{
+				for (int x = 15; x < 33; x++)
+					image[x + y * 64] = 1;
+			}
+			ActiveTiles activeTiles(64, 64);
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(0, 0, 64, 64));
+			Assert::IsFalse(activeTiles.IsActive(1, 1));
+			Assert::IsFalse(activeTiles.IsNodeActive(20, 20));
+			for (int tileY = 0; tileY < 4; tileY++)
+			{
+				for (int tileX = 0; tileX < 4; tileX++)
+				{
+					if (tileX != 1 || tileY != 1)
+						Assert::IsTrue(activeTiles.IsActive(tileX, tileY));
+				}
+			}
+			Assert::AreEqual(15, static_cast<int>(activeTiles.GetActiveTiles().size()));
+			// the tile row of the solid tile is stepped in two spans around it
+			const std::vector<int> &spans = activeTiles.GetRowSpans(20);
+			Assert::AreEqual(4, static_cast<int>(spans.size()));
+			Assert::AreEqual(0, spans[0]);
+			Assert::AreEqual(16, spans[1]);
+			Assert::AreEqual(32, spans[2]);
+			Assert::AreEqual(64, spans[3]);
+			Assert::IsTrue(activeTiles.GetActivatedTiles().empty());
+		}
+
+		TEST_METHOD(FluidInRingKeepsTileActive)
+		{
+			// the tile itself is solid, but fluid next to it still streams from it
+			std::vector<int> image(64 * 64, 0);
+			for (int y = 16; y < 32; y++)
+			{
+				for (int x = 16; x < 32; x++)
+					image[x + y * 64] = 1;
+			}
+			ActiveTiles activeTiles(64, 64);
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(0, 0, 64, 64));
+			Assert::IsTrue(activeTiles.IsActive(1, 1));
+		}
+
+		TEST_METHOD(RemovalReactivatesTile)
+		{
+			std::vector<int> image(64 * 64, 0);
+			ActiveTiles activeTiles(64, 64);
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(0, 0, 64, 64));
+			Assert::AreEqual(16, static_cast<int>(activeTiles.GetActiveTiles().size()));
+			// placing the walls only reclassifies the tiles around the changed rect
+			for (int y = 15; y < 33; y++)
+			{
+				for (int x = 15; x < 33; x++)
+					image[x + y * 64] = 20;
+			}
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(15, 15, 18, 18));
+			Assert::IsFalse(activeTiles.IsActive(1, 1));
+			Assert::AreEqual(15, static_cast<int>(activeTiles.GetActiveTiles().size()));
+			Assert::IsTrue(activeTiles.GetActivatedTiles().empty());
+			// opening a single node of the ring brings the tile back, to be reinitialized
+			image[15 + 20 * 64] = 0;
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(15, 20, 1, 1));
+			Assert::IsTrue(activeTiles.IsActive(1, 1));
+			Assert::AreEqual(16, static_cast<int>(activeTiles.GetActiveTiles().size()));
+			Assert::AreEqual(1, static_cast<int>(activeTiles.GetActivatedTiles().size()));
+			Assert::AreEqual(1 + 1 * 4, activeTiles.GetActivatedTiles()[0]);
+			activeTiles.ClearActivatedTiles();
+			// a tile that never went stale is not reported again
+			activeTiles.Update(&image[0], 64, 64, 64, RectInt(0, 0, 64, 64));
+			Assert::IsTrue(activeTiles.GetActivatedTiles().empty());
+		}
+
+		TEST_METHOD(TilesBeyondDomainInactive)
+		{
+			std::vector<int> image(64 * 64, 0);
+			ActiveTiles activeTiles(64, 64);
+			activeTiles.Update(&image[0], 64, 40, 24, RectInt(0, 0, 64, 64));
+			Assert::IsTrue(activeTiles.IsActive(2, 1));
+			Assert::IsFalse(activeTiles.IsActive(3, 0));
+			Assert::IsFalse(activeTiles.IsActive(0, 2));
+			// the last span ends at the domain edge, not the tile edge
+			const std::vector<int> &spans = activeTiles.GetRowSpans(0);
+			Assert::AreEqual(2, static_cast<int>(spans.size()));
+			Assert::AreEqual(40, spans[1]);
+		}
+
+		TEST_METHOD(SolverReinitializesReactivatedTiles)
+		{
+			CpuLbm lbm(128, 64);
+			lbm.GetDomain()->SetXDimVisible(128);
+			lbm.GetDomain()->SetYDimVisible(64);
+			lbm.SetInletVelocity(0.05f);
+			lbm.SetNumberOfThreads(1);
+			lbm.SetTimeStepsPerFrame(5);
+			lbm.AllocateHostMemory();
+			lbm.InitializeHostMemory();
+			Obstruction square = { SQUARE, 64.f, 32.f, 20.f, 0.f, 0.f, 0.f, ACTIVE };
+			int obstId = lbm.GetHostObst()->Add(square);
+			UpdateSolverObstructions(&lbm, obstId, square, 1.f);
+			InitializeDomain(&lbm);
+			MarchSolution(&lbm);
+			Assert::IsFalse(lbm.GetActiveTiles()->IsNodeActive(64, 32));
+			// what a skipped tile holds is never read, so poison it
+			for (int y = 32; y < 48; y++)
+			{
+				for (int x = 64; x < 80; x++)
+				{
+					for (int i = 0; i < 9; i++)
+					{
+						lbm.GetFA()[f_mem(i, x, y, *lbm.GetDomain())] = 5.f;
+						lbm.GetFB()[f_mem(i, x, y, *lbm.GetDomain())] = 5.f;
+					}
+				}
+			}
+			RemoveSolverObstruction(&lbm, obstId);
+			lbm.GetHostObst()->Remove(obstId);
+			MarchSolution(&lbm);
+			Assert::IsTrue(lbm.GetActiveTiles()->IsNodeActive(64, 32));
+			// the tiles under the old square start over from rest and carry flow again
+			for (int y = 24; y < 48; y++)
+			{
+				for (int x = 56; x < 80; x++)
+				{
+					LbmNode node;
+					ReadNodeDistributions(&lbm, node, x, y);
+					Assert::IsTrue(std::fabs(node.ComputeRho() - 1.f) < 0.2f);
+					Assert::IsTrue(std::fabs(node.ComputeU()) < 0.1f);
+				}
+			}
+		}
+	};
+
+
+	TEST_CLASS(ObstructionGridTest)
+	{
+	public:
+		TEST_METHOD(ListedInEveryCellInReach)
+		{
+			// 4x4 cells, a circle on the corner of the first four and a square inside one cell
+			ObstructionGrid grid(128, 128);
+			Obstruction obstructions[2] = {
+				{ CIRCLE, 32.f, 32.f, 4.f, 0.f, 0.f, 0.f, ACTIVE },
+				{ SQUARE, 48.f, 48.f, 2.f, 0.f, 0.f, 0.f, ACTIVE } };
+			grid.Build(obstructions, 2);
+			Assert::AreEqual(16, grid.GetCellCount());
+			const std::vector<int> &cellStart = grid.GetCellStart();
+			const std::vector<int> &ids = grid.GetIds();
+			for (int cellY = 0; cellY < 4; cellY++)
+			{
+				for (int cellX = 0; cellX < 4; cellX++)
+				{
+					int cell = cellX + cellY * 4;
+					int count = cellStart[cell + 1] - cellStart[cell];
+					if (cellX < 2 && cellY < 2)
+					{
+						Assert::IsTrue(count >= 1);
+						Assert::AreEqual(0, ids[cellStart[cell]]);
+					}
+					else
+						Assert::AreEqual(0, count);
+				}
+			}
+			// ids stay ascending within a cell, so overlaps resolve to the lowest id
+			Assert::AreEqual(2, cellStart[1 + 1 * 4 + 1] - cellStart[1 + 1 * 4]);
+			Assert::AreEqual(1, ids[cellStart[1 + 1 * 4] + 1]);
+			Assert::AreEqual(5, static_cast<int>(ids.size()));
+		}
+
+		TEST_METHOD(RebuildDropsStaleEntries)
+		{
+			ObstructionGrid grid(128, 128);
+			Obstruction obstructions[2] = {
+				{ CIRCLE, 32.f, 32.f, 4.f, 0.f, 0.f, 0.f, ACTIVE },
+				{ CIRCLE, 100.f, 16.f, 4.f, 0.f, 0.f, 0.f, ACTIVE } };
+			grid.Build(obstructions, 2);
+			ObstructionGridView view = { &grid.GetCellStart()[0], &grid.GetIds()[0], 4, 4 };
+			Assert::AreEqual(0, FindOverlappingObstruction(32.f, 32.f, obstructions, view));
+			Assert::AreEqual(1, FindOverlappingObstruction(100.f, 16.f, obstructions, view));
+			// moved into the last cell, the first circle is only found there
+			obstructions[0].x = 112.f;
+			obstructions[0].y = 112.f;
+			grid.Build(obstructions, 2);
+			view.cellStart = &grid.GetCellStart()[0];
+			view.ids = &grid.GetIds()[0];
+			Assert::AreEqual(-1, FindOverlappingObstruction(32.f, 32.f, obstructions, view));
+			Assert::AreEqual(0, FindOverlappingObstruction(112.f, 112.f, obstructions, view));
+			for (int cell = 0; cell < 15; cell++)
+			{
+				for (int n = grid.GetCellStart()[cell]; n < grid.GetCellStart()[cell + 1]; n++)
+					Assert::AreNotEqual(0, grid.GetIds()[n]);
+			}
+			// removing the first moves the second into its slot, and inactive ones are not listed
+			obstructions[0] = obstructions[1];
+			grid.Build(obstructions, 1);
+			Assert::AreEqual(2, static_cast<int>(grid.GetIds().size()));
+			obstructions[0].state = INACTIVE;
+			grid.Build(obstructions, 1);
+			Assert::AreEqual(0, static_cast<int>(grid.GetIds().size()));
+			Assert::AreEqual(0, grid.GetCellStart()[16]);
+		}
+
+		TEST_METHOD(OffGridClampedToEdgeCells)
+		{
+			ObstructionGrid grid(128, 128);
+			// centered off the grid but reaching into its left column
+			Obstruction obstructions[2] = {
+				{ CIRCLE, -4.f, 64.f, 4.f, 0.f, 0.f, 0.f, ACTIVE },
+				{ CIRCLE, -40.f, 64.f, 4.f, 0.f, 0.f, 0.f, ACTIVE } };
+			grid.Build(obstructions, 2);
+			Assert::AreEqual(1, grid.GetCellStart()[2 * 4 + 1] - grid.GetCellStart()[2 * 4]);
+			Assert::AreEqual(0, grid.GetIds()[grid.GetCellStart()[2 * 4]]);
+			ObstructionGridView view = { &grid.GetCellStart()[0], &grid.GetIds()[0], 4, 4 };
+			Assert::AreEqual(0, FindOverlappingObstruction(-3.f, 64.f, obstructions, view));
+		}
+	};
+
+
+	TEST_CLASS(ObstructionStoreTest)
+	{
+	public:
+		TEST_METHOD(AddAndSet)
+		{
+			ObstructionStore store;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int i = 0; i < 3; i++)
+			{
+				obst.x = 10.f*i;
+				Assert::AreEqual(i, store.Add(obst));
+			}
+			Assert::AreEqual(3, store.GetCount());
+			Assert::AreEqual(2, store.GetIndex(2));
+			Assert::AreEqual(20.f, store.Get(2).x);
+			obst.x = 15.f;
+			Assert::AreEqual(1, store.Set(1, obst));
+			Assert::AreEqual(3, store.GetCount());
+			Assert::AreEqual(15.f, store.GetData()[1].x);
+			Assert::IsFalse(store.Contains(3));
+			Assert::AreEqual(-1, store.GetIndex(3));
+		}
+
+		TEST_METHOD(RemoveReturnsMovedIndex)
+		{
+			ObstructionStore store;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int i = 0; i < 3; i++)
+			{
+				obst.x = 10.f*i;
+				store.Add(obst);
+			}
+			// the last entry, id 2, moves into the slot of id 0
+			Assert::AreEqual(0, store.Remove(0));
+			Assert::IsFalse(store.Contains(0));
+			Assert::AreEqual(2, store.GetCount());
+			Assert::AreEqual(2, store.GetId(0));
+			Assert::AreEqual(0, store.GetIndex(2));
+			Assert::AreEqual(20.f, store.Get(2).x);
+			Assert::AreEqual(20.f, store.GetData()[0].x);
+			// removing the last entry moves nothing, and a free id is not removed again
+			Assert::AreEqual(-1, store.Remove(1));
+			Assert::AreEqual(-1, store.Remove(0));
+			Assert::AreEqual(1, store.GetCount());
+		}
+
+		TEST_METHOD(AddReusesFreeIds)
+		{
+			ObstructionStore store;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int i = 0; i < 3; i++)
+			{
+				obst.x = 10.f*i;
+				store.Add(obst);
+			}
+			store.Remove(1);
+			obst.x = 30.f;
+			Assert::AreEqual(1, store.Add(obst));
+			Assert::AreEqual(2, store.GetIndex(1));
+			Assert::AreEqual(30.f, store.Get(1).x);
+			Assert::AreEqual(3, store.Add(obst));
+		}
+
+		TEST_METHOD(SetPastEnd)
+		{
+			ObstructionStore store;
+			Obstruction obst = { CIRCLE, 40.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			Assert::AreEqual(0, store.Set(4, obst));
+			Assert::IsTrue(store.Contains(4));
+			Assert::AreEqual(1, store.GetCount());
+			Assert::AreEqual(4, store.GetId(0));
+			// the ids skipped over are free, and one taken by Set is no longer handed out by Add
+			Assert::AreEqual(1, store.Set(2, obst));
+			bool isIdUsed[5] = { false, false, true, false, true };
+			for (int i = 0; i < 3; i++)
+			{
+				int id = store.Add(obst);
+				Assert::IsTrue(id >= 0 && id < 5 && !isIdUsed[id]);
+				isIdUsed[id] = true;
+			}
+			Assert::AreEqual(5, store.Add(obst));
+			Assert::AreEqual(6, store.GetCount());
+		}
+	};
+
+
+	TEST_CLASS(ObstructionDeltaQueueTest)
+	{
+	public:
+		TEST_METHOD(RepeatedPushesCollapse)
+		{
+			ObstructionStore store;
+			ObstructionDeltaQueue queue;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			Assert::IsTrue(queue.IsEmpty());
+			int id = store.Add(obst);
+			queue.Push(store.GetIndex(id));
+			obst.x = 10.f;
+			queue.Push(store.Set(id, obst));
+			obst.x = 20.f;
+			queue.Push(store.Set(id, obst));
+			Assert::IsFalse(queue.IsEmpty());
+			// one delta holding the latest contents
+			const std::vector<ObstructionDelta> &deltas = queue.Pack(store);
+			Assert::AreEqual(1, static_cast<int>(deltas.size()));
+			Assert::AreEqual(0, deltas[0].index);
+			Assert::AreEqual(20.f, deltas[0].obst.x);
+			Assert::IsTrue(queue.IsEmpty());
+			// packing emptied the queue, so the index can be queued again
+			queue.Push(0);
+			Assert::AreEqual(1, static_cast<int>(queue.Pack(store).size()));
+		}
+
+		TEST_METHOD(IndicesPastEndDropped)
+		{
+			ObstructionStore store;
+			ObstructionDeltaQueue queue;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			for (int i = 0; i < 3; i++)
+			{
+				obst.x = 10.f*i;
+				queue.Push(store.GetIndex(store.Add(obst)));
+			}
+			// the last entry moves into slot 0, leaving index 2 past the end
+			queue.PushRemoval(store.Remove(0));
+			const std::vector<ObstructionDelta> &deltas = queue.Pack(store);
+			Assert::AreEqual(2, static_cast<int>(deltas.size()));
+			Assert::AreEqual(0, deltas[0].index);
+			Assert::AreEqual(20.f, deltas[0].obst.x);
+			Assert::AreEqual(1, deltas[1].index);
+			Assert::AreEqual(10.f, deltas[1].obst.x);
+		}
+
+		TEST_METHOD(RemovalWithoutDelta)
+		{
+			ObstructionStore store;
+			ObstructionDeltaQueue queue;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			int id = store.Add(obst);
+			queue.Pack(store);
+			// removing the last entry moves nothing, but the solver still has to drop it
+			queue.PushRemoval(store.Remove(id));
+			Assert::IsFalse(queue.IsEmpty());
+			Assert::AreEqual(0, static_cast<int>(queue.Pack(store).size()));
+			Assert::IsTrue(queue.IsEmpty());
+		}
+
+		TEST_METHOD(ClearForgetsQueued)
+		{
+			ObstructionStore store;
+			ObstructionDeltaQueue queue;
+			Obstruction obst = { CIRCLE, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, ACTIVE };
+			queue.Push(store.GetIndex(store.Add(obst)));
+			queue.PushRemoval(-1);
+			queue.Clear();
+			Assert::IsTrue(queue.IsEmpty());
+			Assert::AreEqual(0, static_cast<int>(queue.Pack(store).size()));
+			queue.Push(0);
+			Assert::AreEqual(1, static_cast<int>(queue.Pack(store).size()));
+		}
+	};
+
+
+	TEST_CLASS(ThreadPoolTest)
+	{
+	public:
+		TEST_METHOD(EveryIndexVisitedOnce)
+		{
+			const int threadCounts[4] = { 1, 2, 3, 8 };
+			const int begin = 5;
+			const int end = 1005;
+			for (int t = 0; t < 4; t++)
+			{
+				ThreadPool threadPool(threadCounts[t], false);
+				Assert::AreEqual(threadCounts[t], threadPool.GetThreadCount());
+				// a band size that does not divide the range, then the one the solver uses
+				const int bandSizes[3] = { 7, 1, threadPool.GetBandSize(end - begin) };
+				for (int b = 0; b < 3; b++)
+				{
+					std::vector<std::atomic<int> > visits(end);
+					for (int i = 0; i < end; i++)
+						visits[i].store(0);
+					std::atomic<int> badThreads(0);
+					threadPool.ParallelFor(begin, end, bandSizes[b],
+						[&](const int bandBegin, const int bandEnd, const int thread)
+					{
+						if (thread < 0 || thread >= threadCounts[t])
+							badThreads++;
+						for (int i = bandBegin; i < bandEnd; i++)
+							visits[i]++;
+					});
+					Assert::AreEqual(0, badThreads.load());
+					for (int i = 0; i < end; i++)
+						Assert::AreEqual(i < begin ? 0 : 1, visits[i].load());
+				}
+			}
+		}
+
+		TEST_METHOD(RepeatedSubmissions)
+		{
+			ThreadPool threadPool(4, false);
+			for (int n = 0; n < 2000; n++)
+			{
+				// ranges from empty to a few bands per thread, some too small to be split at all
+				int count = n % 50;
+				std::atomic<int> sum(0);
+				threadPool.ParallelFor(0, count, 1,
+					[&](const int bandBegin, const int bandEnd, const int thread)
+				{
+					for (int i = bandBegin; i < bandEnd; i++)
+						sum += i + 1;
+				});
+				Assert::AreEqual(count * (count + 1) / 2, sum.load());
+			}
+		}
+	};
+
+
+	TEST_CLASS(SnapshotTripleBufferTest)
+	{
+	public:
+		TEST_METHOD(NothingToReadBeforePublish)
+		{
+			SnapshotTripleBuffer buffer;
+			Assert::AreEqual(-1, buffer.GetReadSlot());
+			Assert::IsFalse(buffer.Acquire());
+			Assert::AreEqual(-1, buffer.GetReadSlot());
+		}
+
+		TEST_METHOD(AcquireSeesPublishedSlot)
+		{
+			SnapshotTripleBuffer buffer;
+			int written = buffer.GetWriteSlot();
+			buffer.Publish();
+			Assert::AreNotEqual(written, buffer.GetWriteSlot());
+			Assert::IsTrue(buffer.Acquire());
+			Assert::AreEqual(written, buffer.GetReadSlot());
+			// nothing new was published, so the consumer keeps its slot
+			Assert::IsFalse(buffer.Acquire());
+			Assert::AreEqual(written, buffer.GetReadSlot());
+		}
+
+		TEST_METHOD(AcquireSeesNewestOnly)
+		{
+			SnapshotTripleBuffer buffer;
+			buffer.Publish();
+			int newest = buffer.GetWriteSlot();
+			buffer.Publish();
+			Assert::IsTrue(buffer.Acquire());
+			Assert::AreEqual(newest, buffer.GetReadSlot());
+			Assert::IsFalse(buffer.Acquire());
+		}
+
+		TEST_METHOD(WriteSlotNeverRead)
+		{
+			SnapshotTripleBuffer buffer;
+			for (int n = 0; n < 20; n++)
+			{
+				buffer.Publish();
+				if (n % 3 == 0)
+					buffer.Acquire();
+				int read = buffer.GetReadSlot();
+				Assert::AreNotEqual(read, buffer.GetWriteSlot());
+				Assert::IsTrue(buffer.GetWriteSlot() >= 0 && buffer.GetWriteSlot() < SNAPSHOT_SLOTS);
+			}
+		}
+
+		TEST_METHOD(ConsumerSeesWholeResultsInOrder)
+		{
+			// each slot holds a result as two copies of its number, which differ if the consumer
+			// ever reads a slot the producer is still filling
+			SnapshotTripleBuffer buffer;
+			int results[SNAPSHOT_SLOTS][2] = {};
+			const int resultCount = 20000;
+			std::thread producer([&]
+			{
+				for (int n = 1; n <= resultCount; n++)
+				{
+					int* slot = results[buffer.GetWriteSlot()];
+					slot[0] = n;
+					slot[1] = n;
+					buffer.Publish();
+				}
+			});
+			int last = 0;
+			bool isTorn = false;
+			bool isOutOfOrder = false;
+			while (last < resultCount)
+			{
+				if (!buffer.Acquire())
+					continue;
+				const int* slot = results[buffer.GetReadSlot()];
+				isTorn = isTorn || slot[0] != slot[1];
+				isOutOfOrder = isOutOfOrder || slot[0] <= last;
+				last = slot[0];
+			}
+			producer.join();
+			Assert::IsFalse(isTorn);
+			Assert::IsFalse(isOutOfOrder);
+		}
+
+		TEST_METHOD(ResetForgetsPublished)
+		{
+			SnapshotTripleBuffer buffer;
+			buffer.Publish();
+			buffer.Acquire();
+			buffer.Publish();
+			buffer.Reset();
+			Assert::AreEqual(-1, buffer.GetReadSlot());
+			Assert::IsFalse(buffer.Acquire());
+		}
+	};
+
+
+	TEST_CLASS(StepBudgetControllerTest)
+	{
+	public:
+		TEST_METHOD(FirstBatchSetsCost)
+		{
+			StepBudgetController budget(10);
+			Assert::AreEqual(0.f, budget.GetMsPerStep());
+			Assert::AreEqual(20, budget.Update(10, 8.f));
+			Assert::IsTrue(AlmostEqual(0.8f, budget.GetMsPerStep()));
+		}
+
+		TEST_METHOD(SmallChangeKeepsSteps)
+		{
+			StepBudgetController budget(10);
+			budget.Update(10, 8.f);
+			// 10% slower than measured moves the ideal batch less than the hysteresis band
+			Assert::AreEqual(20, budget.Update(20, 17.6f));
+			Assert::AreEqual(20, budget.Update(20, 17.6f));
+			Assert::AreEqual(20, budget.GetSteps());
+		}
+
+		TEST_METHOD(LargeChangeResizes)
+		{
+			StepBudgetController budget(10);
+			budget.Update(10, 8.f);
+			// one batch at an eighth of the cost is only smoothed in, so the next one grows by a fifth
+			Assert::AreEqual(24, budget.Update(20, 2.f));
+		}
+
+		TEST_METHOD(OverrunReplacesCost)
+		{
+			StepBudgetController budget(10);
+			budget.Update(10, 8.f);
+			Assert::AreEqual(8, budget.Update(20, 40.f));
+			Assert::IsTrue(AlmostEqual(2.f, budget.GetMsPerStep()));
+		}
+
+		TEST_METHOD(StepsStayInRange)
+		{
+			StepBudgetController budget(1000);
+			Assert::AreEqual(STEP_BUDGET_MAX_STEPS, budget.GetSteps());
+			budget.SetStepRange(5, 10);
+			Assert::AreEqual(10, budget.GetSteps());
+			Assert::AreEqual(10, budget.Update(10, 0.01f));
+			Assert::AreEqual(5, budget.Update(10, 100.f));
+		}
+
+		TEST_METHOD(IdleBatchesIgnored)
+		{
+			StepBudgetController budget(10);
+			budget.Update(10, 8.f);
+			Assert::AreEqual(20, budget.Update(0, 5.f));
+			Assert::AreEqual(20, budget.Update(20, 0.f));
+			Assert::IsTrue(AlmostEqual(0.8f, budget.GetMsPerStep()));
+			budget.SetTargetFrameTime(-1.f);
+			Assert::AreEqual(STEP_BUDGET_DEFAULT_TARGET_MS, budget.GetTargetFrameTime());
+		}
+	};
+
+
+	TEST_CLASS(ResidualMonitorTest)
+	{
+	public:
+		TEST_METHOD(OffUnlessEnabled)
+		{
+			ResidualMonitor monitor;
+			monitor.AddSteps(10 * monitor.GetSampleSteps());
+			Assert::IsFalse(monitor.BeginSample());
+			Assert::IsFalse(monitor.IsConverged());
+		}
+
+		TEST_METHOD(SamplesEveryInterval)
+		{
+			ResidualMonitor monitor;
+			monitor.SetEnabled(true);
+			monitor.SetSampleSteps(100);
+			monitor.AddSteps(60);
+			Assert::IsFalse(monitor.BeginSample());
+			monitor.AddSteps(60);
+			Assert::IsTrue(monitor.BeginSample());
+			Assert::IsTrue(monitor.IsSamplePending());
+			// no second sample while the first is in flight
+			monitor.AddSteps(100);
+			Assert::IsFalse(monitor.BeginSample());
+			ResidualSums still = { 0.f, 1.f, 0.f, 1.f };
+			monitor.AddSample(still);
+			Assert::IsFalse(monitor.IsSamplePending());
+			Assert::IsTrue(monitor.BeginSample());
+		}
+
+		TEST_METHOD(ConvergesOnSecondSample)
+		{
+			ResidualMonitor monitor;
+			monitor.SetEnabled(true);
+			monitor.SetSampleSteps(100);
+			// sums over a single fluid node moving at unit speed
+			ResidualSums still = { 0.f, 1.f, 0.f, 1.f };
+			monitor.AddSteps(100);
+			Assert::IsTrue(monitor.BeginSample());
+			monitor.AddSample(still);
+			Assert::IsFalse(monitor.IsConverged());
+			Assert::AreEqual(0.f, monitor.GetResidual());
+			// a relative velocity change of 1e-6 over 100 steps
+			ResidualSums slow = { 1e-12f, 1.f, 0.f, 1.f };
+			monitor.AddSteps(100);
+			Assert::IsTrue(monitor.BeginSample());
+			monitor.AddSample(slow);
+			Assert::IsTrue(AlmostEqual(1e-8f, monitor.GetResidual()));
+			Assert::IsTrue(monitor.IsConverged());
+			monitor.AddSteps(100);
+			Assert::IsFalse(monitor.BeginSample());
+		}
+
+		TEST_METHOD(LargerResidualDecides)
+		{
+			ResidualMonitor monitor;
+			monitor.SetEnabled(true);
+			monitor.SetSampleSteps(100);
+			ResidualSums samples[2] = { { 0.f, 1.f, 0.f, 1.f }, { 1e-12f, 1.f, 1e-6f, 1.f } };
+			for (int n = 0; n < 2; n++)
+			{
+				monitor.AddSteps(100);
+				Assert::IsTrue(monitor.BeginSample());
+				monitor.AddSample(samples[n]);
+			}
+			Assert::IsTrue(AlmostEqual(1e-5f, monitor.GetResidual()));
+			Assert::IsFalse(monitor.IsConverged());
+		}
+
+		TEST_METHOD(ResetStartsOver)
+		{
+			ResidualMonitor monitor;
+			monitor.SetEnabled(true);
+			monitor.SetSampleSteps(100);
+			ResidualSums still = { 0.f, 1.f, 0.f, 1.f };
+			for (int n = 0; n < 2; n++)
+			{
+				monitor.AddSteps(100);
+				Assert::IsTrue(monitor.BeginSample());
+				monitor.AddSample(still);
+			}
+			Assert::IsTrue(monitor.IsConverged());
+			monitor.Reset();
+			Assert::IsFalse(monitor.IsConverged());
+			// a sample begun before the reset is dropped, and the next one is a new baseline
+			monitor.AddSteps(100);
+			Assert::IsTrue(monitor.BeginSample());
+			monitor.Reset();
+			Assert::IsFalse(monitor.IsSamplePending());
+			monitor.AddSample(still);
+			monitor.AddSteps(100);
+			Assert::IsTrue(monitor.BeginSample());
+			monitor.AddSample(still);
+			Assert::IsFalse(monitor.IsConverged());
+			monitor.AddSteps(100);
+			Assert::IsTrue(monitor.BeginSample());
+			monitor.AddSample(still);
+			Assert::IsTrue(monitor.IsConverged());
+			monitor.SetEnabled(false);
+			Assert::IsFalse(monitor.IsConverged());
+		}
+	};
+
+
+	TEST_CLASS(BytesPerUpdateTest)
+	{
+	public:
+		TEST_METHOD(StreamingAndStorage)
+		{
+			const StreamingMode modes[2] = { StreamingMode::TWO_BUFFER, StreamingMode::IN_PLACE };
+			const LatticeStorage formats[2] = { STORAGE_FP32, STORAGE_FP16 };
+			// rows of 9 fp32 reads and writes per step, and fp16 lattices packed in depth 2 tiles of
+			// 128x64 that read (128 + 4)x(64 + 4) nodes and write 128x64 once per two steps. An
+			// in-place lattice is always fp32 and stepped in rows.
+			const float expected[2][2] = { { 72.f, 18.f * (132 * 68 + 128 * 64) / (128 * 64 * 2) },
+				{ 72.f, 72.f } };
+			for (int m = 0; m < 2; m++)
+			{
+				for (int f = 0; f < 2; f++)
+				{
+					CpuLbm lbm(128, 64);
+					lbm.SetNumberOfThreads(1);
+					lbm.SetStreamingMode(modes[m]);
+					lbm.SetLatticeStorage(formats[f]);
+					lbm.AllocateHostMemory();
+					Assert::IsTrue(AlmostEqual(expected[m][f], GetBytesPerUpdate(&lbm)));
+				}
+			}
+		}
+
+		TEST_METHOD(FallsWithBlockingDepth)
+		{
+			CpuLbm lbm(128, 64);
+			lbm.SetTemporalBlockingDepth(4);
+			Assert::IsTrue(AlmostEqual(36.f * (136 * 72 + 128 * 64) / (128 * 64 * 4),
+				GetBytesPerUpdate(&lbm)));
+			lbm.SetLatticeStorage(STORAGE_BF16);
+			Assert::IsTrue(AlmostEqual(18.f * (136 * 72 + 128 * 64) / (128 * 64 * 4),
+				GetBytesPerUpdate(&lbm)));
+			// blocking is ignored for in-place lattices
+			lbm.SetLatticeStorage(STORAGE_FP32);
+			lbm.SetStreamingMode(StreamingMode::IN_PLACE);
+			Assert::IsTrue(AlmostEqual(72.f, GetBytesPerUpdate(&lbm)));
+		}
+	};
+
+
+	TEST_CLASS(FrameProfilerTest)
+	{
+	public:
+		TEST_METHOD(NearestRankPercentiles)
+		{
+			FrameProfiler &profiler = FrameProfiler::Instance();
+			// 1 to 100 ms in shuffled order, and 1 to 20 ms where the ranks fall between samples
+			for (int i = 0; i < 100; i++)
+			{
+				long long duration = (i * 37 % 100 + 1) * 1000000LL;
+				profiler.Record("utest.percentiles100", 0, duration);
+			}
+			for (int i = 1; i <= 20; i++)
+				profiler.Record("utest.percentiles20", 0, i * 1000000LL);
+			Assert::IsTrue(profiler.WriteChromeTrace("FrameProfilerPercentiles.json"));
+			std::ifstream file("FrameProfilerPercentiles.json");
+			std::stringstream trace;
+			trace << file.rdbuf();
+			file.close();
+			std::remove("FrameProfilerPercentiles.json");
+			Assert::IsTrue(trace.str().find("{\"name\":\"utest.percentiles100\",\"count\":100,"
+				"\"p50Ms\":50.000,\"p95Ms\":95.000,\"p99Ms\":99.000,\"maxMs\":100.000}") !=
+				std::string::npos);
+			// ranks 10, 19 and 20 of 20
+			Assert::IsTrue(trace.str().find("{\"name\":\"utest.percentiles20\",\"count\":20,"
+				"\"p50Ms\":10.000,\"p95Ms\":19.000,\"p99Ms\":20.000,\"maxMs\":20.000}") !=
+				std::string::npos);
+		}
+
+		TEST_METHOD(RingOverwritesOldest)
+		{
+			FrameProfiler &profiler = FrameProfiler::Instance();
+			// slot i holds i ms, and the first 100 are overwritten by the last 100
+			for (long long i = 0; i < FRAME_PROFILER_CAPACITY + 100; i++)
+				profiler.Record("utest.wrap", i * 1000000LL, 2 * i * 1000000LL);
+			Assert::IsTrue(profiler.WriteChromeTrace("FrameProfilerWrap.json"));
+			std::ifstream file("FrameProfilerWrap.json");
+			std::stringstream trace;
+			trace << file.rdbuf();
+			file.close();
+			std::remove("FrameProfilerWrap.json");
+			std::ostringstream summary;
+			summary << "{\"name\":\"utest.wrap\",\"count\":" << FRAME_PROFILER_CAPACITY
+				<< ",\"p50Ms\":" << 100 + FRAME_PROFILER_CAPACITY / 2 - 1 << ".000,";
+			Assert::IsTrue(trace.str().find(summary.str()) != std::string::npos);
+			std::ostringstream maxMs;
+			maxMs << "\"maxMs\":" << FRAME_PROFILER_CAPACITY + 99 << ".000}";
+			Assert::IsTrue(trace.str().find(maxMs.str()) != std::string::npos);
+			// events are written oldest first, starting with the oldest one left
+			Assert::IsTrue(trace.str().find("{\"name\":\"utest.wrap\",\"ph\":\"X\"") <
+				trace.str().find("{\"name\":\"utest.wrap\",\"count\""));
+			Assert::IsTrue(trace.str().find(",\"ts\":0.000,\"dur\":100000.000}") !=
+				std::string::npos);
+		}
+
+		TEST_METHOD(ConcurrentRecordsKept)
+		{
+			FrameProfiler &profiler = FrameProfiler::Instance();
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+			{
+				threads.push_back(std::thread([]()
+				{
+					for (int i = 0; i < 1000; i++)
+					{
+						ScopedTimer timer("utest.threads");
+					}
+				}));
+			}
+			for (int t = 0; t < 4; t++)
+				threads[t].join();
+			Assert::IsTrue(profiler.WriteChromeTrace("FrameProfilerThreads.json"));
+			std::ifstream file("FrameProfilerThreads.json");
+			std::stringstream trace;
+			trace << file.rdbuf();
+			file.close();
+			std::remove("FrameProfilerThreads.json");
+			Assert::IsTrue(trace.str().find("{\"name\":\"utest.threads\",\"count\":4000,") !=
+				std::string::npos);
+		}
+	};
+
+
+	TEST_CLASS(FpsTrackerTest)
+	{
+	public:
+		TEST_METHOD(FpsOverFrameWindow)
+		{
+			FpsTracker tracker;
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			tracker.Tick(now);
+			tracker.Tock();
+			// a single Tick has no frame time yet
+			Assert::AreEqual(0.f, tracker.GetFps());
+			for (int i = 0; i < 10; i++)
+			{
+				now += std::chrono::milliseconds(20);
+				tracker.Tick(now);
+				tracker.Tock();
+			}
+			Assert::IsTrue(AlmostEqual(50.f, tracker.GetFps()));
+			Assert::AreEqual(10, tracker.GetFrameTimeStats().count);
+			// half the window at 10 ms and half at 30 ms average out to 50 fps
+			for (int i = 0; i < FRAME_STATS_WINDOW; i++)
+			{
+				now += std::chrono::milliseconds(i % 2 == 0 ? 10 : 30);
+				tracker.Tick(now);
+			}
+			tracker.Tock();
+			Assert::IsTrue(AlmostEqual(50.f, tracker.GetFps()));
+			FrameStats stats = tracker.GetFrameTimeStats();
+			Assert::AreEqual(FRAME_STATS_WINDOW, stats.count);
+			Assert::IsTrue(AlmostEqual(10.f, stats.min));
+			Assert::IsTrue(AlmostEqual(10.f, stats.p50));
+			Assert::IsTrue(AlmostEqual(30.f, stats.p95));
+			Assert::IsTrue(AlmostEqual(30.f, stats.max));
+			// the older frames have left the window
+			for (int i = 0; i < FRAME_STATS_WINDOW; i++)
+			{
+				now += std::chrono::milliseconds(10);
+				tracker.Tick(now);
+			}
+			tracker.Tock();
+			Assert::IsTrue(AlmostEqual(100.f, tracker.GetFps()));
+			int counts[FRAME_HISTOGRAM_BUCKETS];
+			tracker.GetFrameTimeHistogram(counts);
+			// all in the bucket above 8 ms and up to 12 ms
+			Assert::AreEqual(0, counts[0]);
+			Assert::AreEqual(FRAME_STATS_WINDOW, counts[1]);
+		}
+
+		TEST_METHOD(InputLatencyToPresent)
+		{
+			FpsTracker tracker;
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			tracker.MarkInput(3, now);
+			// a later input needing the same version shows in the same frame
+			tracker.MarkInput(3, now + std::chrono::milliseconds(5));
+			tracker.Present(2, now + std::chrono::milliseconds(16));
+			Assert::AreEqual(0, tracker.GetInputLatencyStats().count);
+			tracker.Present(4, now + std::chrono::milliseconds(40));
+			FrameStats stats = tracker.GetInputLatencyStats();
+			Assert::AreEqual(1, stats.count);
+			Assert::IsTrue(AlmostEqual(40.f, stats.max));
+			tracker.Reset();
+			Assert::AreEqual(0, tracker.GetInputLatencyStats().count);
+			Assert::AreEqual(0.f, tracker.GetFps());
+		}
+	};
+
+
+	TEST_CLASS(CheckpointTest)
+	{
+	public:
+		TEST_METHOD(RoundTrip)
+		{
+			const StreamingMode modes[2] = { StreamingMode::TWO_BUFFER, StreamingMode::IN_PLACE };
+			for (int m = 0; m < 2; m++)
+			{
+				// the saved solver is stepped, the fresh one only initialized with other settings
+				CpuLbm saved(128, 64);
+				CpuLbm loaded(128, 64);
+				CpuLbm* solvers[2] = { &saved, &loaded };
+				Obstruction cylinder = { CIRCLE, 40.f, 32.f, 6.f, 0.f, 0.f, 0.f, ACTIVE };
+				for (int n = 0; n < 2; n++)
+				{
+					solvers[n]->GetDomain()->SetXDimVisible(128);
+					solvers[n]->GetDomain()->SetYDimVisible(64);
+					solvers[n]->SetInletVelocity(n == 0 ? 0.125f : 0.05f);
+					solvers[n]->SetOmega(n == 0 ? 1.9f : 1.5f);
+					solvers[n]->SetCollisionModel(n == 0 ? COLLISION_MRT_SMAGORINSKY :
+						COLLISION_BGK);
+					solvers[n]->SetNumberOfThreads(2);
+					solvers[n]->SetTimeStepsPerFrame(5);
+					solvers[n]->SetStreamingMode(modes[m]);
+					solvers[n]->AllocateHostMemory();
+					solvers[n]->InitializeHostMemory();
+				}
+				int obstId = saved.GetHostObst()->Add(cylinder);
+				UpdateSolverObstructions(&saved, obstId, cylinder, 1.f);
+				InitializeDomain(&saved);
+				InitializeDomain(&loaded);
+				// an odd number of steps, so an in-place lattice is saved in its odd step layout
+				saved.SetTimeStepsPerFrame(3);
+				MarchSolution(&saved);
+				Assert::AreEqual(static_cast<int>(CHECKPOINT_OK),
+					static_cast<int>(SaveCheckpoint(&saved, "CheckpointRoundTrip.icfd", 1234)));
+				CheckpointHeader header;
+				Assert::AreEqual(static_cast<int>(CHECKPOINT_OK),
+					static_cast<int>(ReadCheckpointHeader("CheckpointRoundTrip.icfd", header)));
+				Assert::AreEqual(static_cast<int>(modes[m]), header.streamingMode);
+				Assert::AreEqual(1234LL, header.timeStep);
+				long long timeStep = 0;
+				Assert::AreEqual(static_cast<int>(CHECKPOINT_OK),
+					static_cast<int>(LoadCheckpoint(&loaded, "CheckpointRoundTrip.icfd", timeStep)));
+				std::remove("CheckpointRoundTrip.icfd");
+				Assert::AreEqual(1234LL, timeStep);
+				Assert::AreEqual(1.9f, loaded.GetOmega());
+				Assert::AreEqual(0.125f, loaded.GetInletVelocity());
+				Assert::AreEqual(static_cast<int>(COLLISION_MRT_SMAGORINSKY),
+					static_cast<int>(loaded.GetCollisionModel()));
+				// obstructions with their ids, and the node image they were rasterized into
+				Assert::AreEqual(1, loaded.GetHostObst()->GetCount());
+				Assert::AreEqual(1, loaded.GetSolverObst()->GetCount());
+				Assert::IsTrue(loaded.GetHostObst()->Contains(obstId));
+				Assert::AreEqual(40.f, loaded.GetHostObst()->Get(obstId).x);
+				Assert::AreEqual(6.f, loaded.GetSolverObst()->GetData()[0].r1);
+				int pitch = saved.GetDomain()->GetMaxXDim();
+				for (int n = 0; n < pitch * 64; n++)
+				{
+					Assert::AreEqual(saved.GetImage()[n], loaded.GetImage()[n]);
+					Assert::AreEqual(saved.GetObstIdMap()[n], loaded.GetObstIdMap()[n]);
+				}
+				// the restored run carries on exactly like the saved one
+				loaded.SetTimeStepsPerFrame(3);
+				for (int frame = 0; frame < 2; frame++)
+				{
+					for (int y = 0; y < 64; y++)
+					{
+						for (int x = 0; x < 128; x++)
+						{
+							LbmNode nodeSaved, nodeLoaded;
+							ReadNodeDistributions(&saved, nodeSaved, x, y);
+							ReadNodeDistributions(&loaded, nodeLoaded, x, y);
+							for (int i = 0; i < 9; i++)
+							{
+								Assert::AreEqual(nodeSaved.GetDistribution(i),
+									nodeLoaded.GetDistribution(i));
+							}
+						}
+					}
+					MarchSolution(&saved);
+					MarchSolution(&loaded);
+				}
+			}
+		}
+
+		TEST_METHOD(RejectsOtherLattices)
+		{
+			CpuLbm saved(128, 64);
+			saved.SetNumberOfThreads(1);
+			saved.AllocateHostMemory();
+			saved.InitializeHostMemory();
+			InitializeDomain(&saved);
+			Assert::AreEqual(static_cast<int>(CHECKPOINT_OK),
+				static_cast<int>(SaveCheckpoint(&saved, "CheckpointLattice.icfd", 0)));
+			// an in-place lattice does not take a two-buffer checkpoint, nor does another size
+			CpuLbm inPlace(128, 64);
+			inPlace.SetNumberOfThreads(1);
+			inPlace.SetStreamingMode(StreamingMode::IN_PLACE);
+			inPlace.AllocateHostMemory();
+			CpuLbm larger(256, 64);
+			larger.SetNumberOfThreads(1);
+			larger.AllocateHostMemory();
+			long long timeStep = 0;
+			Assert::AreEqual(static_cast<int>(CHECKPOINT_LATTICE_MISMATCH),
+				static_cast<int>(LoadCheckpoint(&inPlace, "CheckpointLattice.icfd", timeStep)));
+			Assert::AreEqual(static_cast<int>(CHECKPOINT_LATTICE_MISMATCH),
+				static_cast<int>(LoadCheckpoint(&larger, "CheckpointLattice.icfd", timeStep)));
+			std::remove("CheckpointLattice.icfd");
+			Assert::AreEqual(static_cast<int>(CHECKPOINT_IO_ERROR),
+				static_cast<int>(LoadCheckpoint(&saved, "CheckpointLattice.icfd", timeStep)));
+		}
+
+		TEST_METHOD(RejectsOldAndTruncatedFiles)
+		{
+			CpuLbm lbm(128, 64);
+			lbm.SetNumberOfThreads(1);
+			lbm.AllocateHostMemory();
+			lbm.InitializeHostMemory();
+			InitializeDomain(&lbm);
+			Assert::AreEqual(static_cast<int>(CHECKPOINT_OK),
+				static_cast<int>(SaveCheckpoint(&lbm, "CheckpointGood.icfd", 0)));
+			std::ifstream good("CheckpointGood.icfd", std::ios::binary);
+			std::string contents((std::istreambuf_iterator<char>(good)),
+				std::istreambuf_iterator<char>());
+			good.close();
+			std::remove("CheckpointGood.icfd");
+			// the first version had no streaming mode or step count in its header
+			CheckpointHeader header;
+			std::memcpy(&header, contents.data(), sizeof(header));
+			header.version = 1;
+			std::string oldVersion(contents);
+			std::memcpy(&oldVersion[0], &header, sizeof(header));
+			// cut inside the last section, inside the header, and an interrupted save
+			std::string unfinished(contents);
+			std::memset(&unfinished[0], 0, sizeof(header.magic));
+			const std::string files[4] = { oldVersion, contents.substr(0, contents.size() - 1),
+				contents.substr(0, sizeof(header) / 2), unfinished };
+			const CheckpointStatus statuses[4] = { CHECKPOINT_VERSION_MISMATCH,
+				CHECKPOINT_BAD_FORMAT, CHECKPOINT_BAD_FORMAT, CHECKPOINT_BAD_FORMAT };
+			for (int n = 0; n < 4; n++)
+			{
+				std::ofstream file("CheckpointBad.icfd", std::ios::binary);
+				file.write(files[n].data(), files[n].size());
+				file.close();
+				long long timeStep = 0;
+				Assert::AreEqual(static_cast<int>(statuses[n]),
+					static_cast<int>(LoadCheckpoint(&lbm, "CheckpointBad.icfd", timeStep)));
+				std::remove("CheckpointBad.icfd");
+			}
+		}
+	};
+
+
+	TEST_CLASS(FieldWriterTest)
+	{
+	public:
+		TEST_METHOD(DropNewestSkipsRequestedFrame)
+		{
+			FieldWriter writer;
+			Assert::IsTrue(writer.Start("FieldWriterNewest", FIELD_RHO, 4, 4, 2, FIELD_DROP_NEWEST));
+			FieldFrame* first = writer.AcquireFrame(0);
+			FieldFrame* second = writer.AcquireFrame(1);
+			Assert::IsNotNull(first);
+			Assert::IsNotNull(second);
+			// both buffers are held by the caller, so the frame asked for is the one dropped
+			Assert::IsNull(writer.AcquireFrame(2));
+			Assert::AreEqual(1, writer.GetDroppedCount());
+			writer.SubmitFrame(first);
+			writer.SubmitFrame(second);
+			writer.Stop();
+			Assert::AreEqual(2, writer.GetSubmittedCount());
+			Assert::AreEqual(2, writer.GetWrittenCount());
+			Assert::AreEqual(1, writer.GetDroppedCount());
+			Assert::AreEqual(0, writer.GetFailedCount());
+			// the index and the frames the writer left behind
+			std::remove(writer.GetIndexPath().c_str());
+			for (int step = 0; step <= 2; step++)
+			{
+				std::ostringstream path;
+				path << "FieldWriterNewest_" << std::setfill('0') << std::setw(10) << step << ".bin";
+				std::remove(path.str().c_str());
+			}
+		}
+
+		TEST_METHOD(DropOldestTakesBackQueuedFrame)
+		{
+			FieldWriter writer;
+			Assert::IsTrue(writer.Start("FieldWriterOldest", FIELD_RHO | FIELD_U, 4, 4, 2,
+				FIELD_DROP_OLDEST));
+			FieldFrame* first = writer.AcquireFrame(0);
+			FieldFrame* second = writer.AcquireFrame(1);
+			// nothing is queued yet that could be taken back
+			Assert::IsNull(writer.AcquireFrame(2));
+			writer.SubmitFrame(first);
+			writer.SubmitFrame(second);
+			// at most one frame is being written, so the other is free or queued and a frame is
+			// always handed out
+			const int frameCount = 200;
+			bool isAlwaysAcquired = true;
+			for (int step = 3; step < 3 + frameCount; step++)
+			{
+				FieldFrame* frame = writer.AcquireFrame(step);
+				isAlwaysAcquired = isAlwaysAcquired && frame != NULL;
+				writer.SubmitFrame(frame);
+			}
+			writer.Stop();
+			Assert::IsTrue(isAlwaysAcquired);
+			Assert::AreEqual(2 + frameCount, writer.GetSubmittedCount());
+			Assert::AreEqual(0, writer.GetFailedCount());
+			Assert::IsTrue(writer.GetWrittenCount() >= 1);
+			// every submitted frame was either written or taken back
+			Assert::AreEqual(writer.GetSubmittedCount(),
+				writer.GetWrittenCount() + writer.GetDroppedCount() - 1);
+			// the index and the frames the writer left behind
+			std::remove(writer.GetIndexPath().c_str());
+			for (int step = 0; step <= 2 + frameCount; step++)
+			{
+				std::ostringstream path;
+				path << "FieldWriterOldest_" << std::setfill('0') << std::setw(10) << step << ".bin";
+				std::remove(path.str().c_str());
+			}
+		}
+
+		TEST_METHOD(WaitLosesNoFrame)
+		{
+			FieldWriter writer;
+			Assert::IsTrue(writer.Start("FieldWriterWait", FIELD_ALL_VARIABLES, 4, 4, 2, FIELD_WAIT));
+			FieldFrame* held = writer.AcquireFrame(0);
+			writer.SubmitFrame(writer.AcquireFrame(1));
+			// blocks until the writer is done with frame 1
+			FieldFrame* frame = writer.AcquireFrame(2);
+			Assert::IsNotNull(frame);
+			writer.SubmitFrame(frame);
+			writer.SubmitFrame(held);
+			const int frameCount = 100;
+			for (int step = 3; step < 3 + frameCount; step++)
+			{
+				writer.SubmitFrame(writer.AcquireFrame(step));
+			}
+			writer.Stop();
+			Assert::AreEqual(3 + frameCount, writer.GetSubmittedCount());
+			Assert::AreEqual(3 + frameCount, writer.GetWrittenCount());
+			Assert::AreEqual(0, writer.GetDroppedCount());
+			Assert::AreEqual(0, writer.GetFailedCount());
+			// the index and the frames the writer left behind
+			std::remove(writer.GetIndexPath().c_str());
+			for (int step = 0; step <= 2 + frameCount; step++)
+			{
+				std::ostringstream path;
+				path << "FieldWriterWait_" << std::setfill('0') << std::setw(10) << step << ".bin";
+				std::remove(path.str().c_str());
+			}
+		}
+	};
+
+
 	TEST_CLASS(MouseTest)
 	{
 	public: